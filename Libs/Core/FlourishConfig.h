@@ -93,3 +93,18 @@
 		#define FL_STACK_TRACE_ENABLED FL_OFF
 	#endif
 #endif
+
+//-------------------------------------------------------------------------------
+// Task Profiling (FL_TASK_PROFILING_ENABLED)
+// 
+// Setting FL_TASK_PROFILING_ENABLED to FL_ON makes TaskManager record when tasks are
+// queued, stolen, started and finished, and when its threads sleep, into a
+// Flourish::TaskProfiler that can be written out as a Chrome trace. If set to FL_OFF
+// none of it is compiled in.
+//
+// By default this is disabled for all builds
+
+#if !defined(FL_TASK_PROFILING_ENABLED)
+	#undef FL_TASK_PROFILING_ENABLED
+	#define FL_TASK_PROFILING_ENABLED FL_OFF
+#endif
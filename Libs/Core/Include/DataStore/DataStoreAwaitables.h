@@ -0,0 +1,109 @@
+#pragma once
+
+// Coroutines need C++20. Everything here is left out of C++17 builds
+#if defined(__cpp_impl_coroutine)
+
+#include <cassert>
+#include <coroutine>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "DataStore/DataStorePath.h"
+#include "DataStore/DataStoreReadStream.h"
+#include "DataStore/IReadableDataStore.h"
+#include "Task/CoTask.h"
+
+namespace Flourish
+{
+    // What a read awaited in a CoTask gives back. Unlike the callback parameter, the
+    // error message is copied, so it's still valid after the data store has moved on
+    struct DataStoreReadResult
+    {
+        bool HasError() const
+        {
+            return _stream == nullptr;
+        }
+
+        std::shared_ptr<DataStoreReadStream> _stream;
+        std::string _error;
+    };
+
+    namespace DataStoreAwaitablesInternal
+    {
+        // Starts the read when the coroutine suspends, and queues a task on the
+        // coroutine's TaskManager to carry on with it once the callback is called
+        template<typename StartRead>
+        class ReadAwaiter
+        {
+        public:
+            explicit ReadAwaiter(StartRead startRead)
+                : _startRead(std::move(startRead))
+                , _result()
+            {
+            }
+
+            bool await_ready()
+            {
+                return false;
+            }
+
+            template<typename AwaitingPromise>
+            void await_suspend(std::coroutine_handle<AwaitingPromise> awaiting)
+            {
+                auto taskManager = awaiting.promise().GetTaskManager();
+                assert(taskManager != nullptr); // Only coroutines that have been started or awaited by one that has can read
+                std::coroutine_handle<> handle = awaiting;
+                auto result = &_result;
+                // The callback can be called before this returns, and carry on with
+                // the coroutine on another thread, so nothing is touched after this
+                _startRead([taskManager, handle, result](DataStoreReadCallbackParam param) {
+                    if(param.HasError())
+                    {
+                        result->_error = param.GetError();
+                    }
+                    else
+                    {
+                        result->_stream = param.Value();
+                    }
+                    taskManager->AddTaskWithNoChildrenOrDependencies(taskManager->WorkItemWithTaskAllocator([handle](void*){
+                        handle.resume();
+                    }));
+                });
+            }
+
+            DataStoreReadResult await_resume()
+            {
+                return std::move(_result);
+            }
+
+        private:
+            StartRead _startRead;
+            DataStoreReadResult _result;
+        };
+
+        template<typename StartRead>
+        ReadAwaiter<StartRead> MakeReadAwaiter(StartRead startRead)
+        {
+            return ReadAwaiter<StartRead>(std::move(startRead));
+        }
+    }
+
+    // co_await in a CoTask to open a path for reading without blocking
+    inline auto OpenForReadAsync(IReadableDataStore* dataStore, DataStorePath path)
+    {
+        return DataStoreAwaitablesInternal::MakeReadAwaiter([dataStore, path = std::move(path)](DataStoreReadCallback callback) {
+            dataStore->OpenForRead(path, std::move(callback));
+        });
+    }
+
+    // co_await in a CoTask to read more of the stream without blocking
+    inline auto RefreshAsync(DataStoreReadStream* stream)
+    {
+        return DataStoreAwaitablesInternal::MakeReadAwaiter([stream](DataStoreReadCallback callback) {
+            stream->Refresh(std::move(callback));
+        });
+    }
+}
+
+#endif
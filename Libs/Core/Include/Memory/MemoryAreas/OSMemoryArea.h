@@ -8,7 +8,7 @@ namespace Flourish { namespace Memory
 	// OS Memory Area
 	//
 	// Provides a memory area allocated by the OS's virtual memory functions.
-	class OSMemoryArea : MemoryArea
+	class OSMemoryArea : public MemoryArea
 	{
 	public:
 		explicit OSMemoryArea(size_t size)
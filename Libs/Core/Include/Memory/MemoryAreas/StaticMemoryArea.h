@@ -8,7 +8,7 @@ namespace Flourish { namespace Memory
 	//
 	// Provides memory from a buffer defined staticly at compile time
 	template<size_t BUFFER_SIZE>
-	class StaticMemoryArea : MemoryArea
+	class StaticMemoryArea : public MemoryArea
 	{
 	public:
 		StaticMemoryArea()
@@ -44,6 +44,11 @@
     #define FL_PLATFORM_OSX FL_ON
     #undef FL_PLATFORM_UNIX
     #define FL_PLATFORM_UNIX FL_ON
+#elif defined(__linux__)
+    #undef FL_PLATFORM_LINUX
+    #define FL_PLATFORM_LINUX FL_ON
+    #undef FL_PLATFORM_UNIX
+    #define FL_PLATFORM_UNIX FL_ON
 #else
 	#error Unable to determine the platform for FL_PLATFORM_*
 #endif
@@ -13,6 +13,14 @@
 	#define FL_FUNCTION						__PRETTY_FUNCTION__
 	#define FL_NO_INLINE					__attribute__( (noinline) )
 
+	#if FL_ENABLED(FL_CPU_ARCH_X86)
+		#define FL_CPU_PAUSE()				__builtin_ia32_pause()
+	#elif FL_ENABLED(FL_CPU_ARCH_ARM)
+		#define FL_CPU_PAUSE()				__asm__ __volatile__("yield")
+	#else
+		#define FL_CPU_PAUSE()
+	#endif
+
 #define FL_DLL_EXPORT
 #elif FL_ENABLED(FL_COMPILER_MSVC)
 	#define FL_ALIGN(alignment)				__declspec(align(alignment))
@@ -20,6 +28,15 @@
 	#define FL_FORCE_INLINE					__forceinline
 	#define FL_NO_INLINE					__declspec(noinline)
 
+	#include <intrin.h>
+	#if FL_ENABLED(FL_CPU_ARCH_X86)
+		#define FL_CPU_PAUSE()				_mm_pause()
+	#elif FL_ENABLED(FL_CPU_ARCH_ARM)
+		#define FL_CPU_PAUSE()				__yield()
+	#else
+		#define FL_CPU_PAUSE()
+	#endif
+
 	#ifdef FL_COMPILE_AS_DLL
 		#define FL_DLL_EXPORT				__declspec(dllexport)
 	#else
@@ -29,6 +46,9 @@
 	#error "Unknown Compiler"
 #endif
 
+//Size to align data to so it doesn't share a cache line with other data (avoiding false sharing)
+#define FL_CACHE_LINE_SIZE 64
+
 //Help functions for aligning common types correctly
 #define FL_ALIGNED_STRUCT(alignment, structName) struct FL_ALIGN(alignment) structName
 #define FL_ALIGNED_CLASS(alignment, structName) class FL_ALIGN(alignment) structName
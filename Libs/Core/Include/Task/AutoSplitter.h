@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "Platform/PlatformFeatures.h"
+
+namespace Flourish
+{
+    // Splitter that picks its own grain size, so the same call site works well
+    // whatever the number of cores.
+    //
+    // Data is always split until there are about CHUNKS_PER_THREAD chunks for
+    // every thread. Below that, chunks are only split further while some of the
+    // task system's threads are idle and so would steal the other half.
+    //
+    // Leaves are timed, and if they finish in less than MINIMUM_LEAF_DURATION the
+    // minimum count is raised so the cost of a task isn't more than the work in it.
+    // This is most effective with LazyParallelFor, where later splits see the
+    // measurements from earlier leaves.
+    //
+    // Use one AutoSplitter per loop, it's safe to call from any number of threads
+    template<typename DataType, typename TaskSystem = class TaskManager>
+    class AutoSplitter
+    {
+    public:
+        static const uint32_t CHUNKS_PER_THREAD = 4u;
+        static constexpr std::chrono::nanoseconds MINIMUM_LEAF_DURATION = std::chrono::microseconds(10);
+
+        // A minimumCount of 0 is treated as 1, a single element can't be split
+        AutoSplitter(uint32_t dataCount, TaskSystem* taskSystem, uint32_t minimumCount = 1u)
+            : _taskSystem(taskSystem)
+            , _targetCount(std::max({ 1u, minimumCount, dataCount / ((taskSystem->GetNumThreads() + 1u) * CHUNKS_PER_THREAD) }))
+            , _minimumCount(std::max(1u, minimumCount))
+        {
+        }
+
+        AutoSplitter(const AutoSplitter&) = delete;
+        AutoSplitter& operator=(const AutoSplitter&) = delete;
+
+        bool ShouldSplit(DataType*, uint32_t dataCount)
+        {
+            if(dataCount <= _minimumCount.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+            if(dataCount > _targetCount)
+            {
+                return true;
+            }
+            // Every thread has a few chunks already, only split more if some of them have run out
+            return _taskSystem->GetNumIdleThreads() > 0;
+        }
+
+        void OnLeafExecuted(DataType*, uint32_t dataCount, std::chrono::nanoseconds duration)
+        {
+            if(duration >= MINIMUM_LEAF_DURATION || dataCount == 0)
+            {
+                return;
+            }
+            // Estimate how many elements would take the minimum duration. It's never raised
+            // above the target count, so there are always enough chunks to go around
+            auto durationCount = std::max<int64_t>(duration.count(), 1);
+            auto wantedCount = static_cast<uint64_t>(MINIMUM_LEAF_DURATION.count()) * dataCount / static_cast<uint64_t>(durationCount);
+            auto newMinimumCount = static_cast<uint32_t>(std::min<uint64_t>(wantedCount, _targetCount));
+            auto minimumCount = _minimumCount.load(std::memory_order_relaxed);
+            while(newMinimumCount > minimumCount && !_minimumCount.compare_exchange_weak(minimumCount, newMinimumCount, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        uint32_t GetTargetCount() const
+        {
+            return _targetCount;
+        }
+
+        uint32_t GetMinimumCount() const
+        {
+            return _minimumCount.load(std::memory_order_relaxed);
+        }
+
+    private:
+        TaskSystem* _taskSystem;
+        uint32_t _targetCount;
+        std::atomic<uint32_t> _minimumCount;
+    };
+
+    // Splitter that always splits the same data into the same chunks, whatever the
+    // timing or number of idle threads. Chunk boundaries are at multiples of a whole
+    // number of cache lines from the start of the data, so neighbouring chunks never
+    // share a cache line, and running the same loop again touches the same lines in
+    // each chunk
+    template<typename DataType, typename TaskSystem = class TaskManager>
+    class AffinitySplitter
+    {
+    public:
+        static const uint32_t CHUNKS_PER_THREAD = 4u;
+        static const uint32_t ELEMENTS_PER_CACHE_LINE = sizeof(DataType) >= FL_CACHE_LINE_SIZE ? 1u : static_cast<uint32_t>(FL_CACHE_LINE_SIZE / sizeof(DataType));
+
+        AffinitySplitter(uint32_t dataCount, TaskSystem* taskSystem)
+            : _chunkCount(RoundUpToCacheLine(std::max(1u, dataCount / ((taskSystem->GetNumThreads() + 1u) * CHUNKS_PER_THREAD))))
+        {
+        }
+
+        bool ShouldSplit(DataType*, uint32_t dataCount)
+        {
+            return dataCount > _chunkCount;
+        }
+
+        // Every range starts on a chunk boundary, so splitting on one keeps it that way
+        uint32_t GetSplitCount(DataType*, uint32_t dataCount)
+        {
+            return ((dataCount / 2u + _chunkCount - 1u) / _chunkCount) * _chunkCount;
+        }
+
+        uint32_t GetChunkCount() const
+        {
+            return _chunkCount;
+        }
+
+    private:
+        static uint32_t RoundUpToCacheLine(uint32_t count)
+        {
+            return ((count + ELEMENTS_PER_CACHE_LINE - 1u) / ELEMENTS_PER_CACHE_LINE) * ELEMENTS_PER_CACHE_LINE;
+        }
+
+        uint32_t _chunkCount;
+    };
+}
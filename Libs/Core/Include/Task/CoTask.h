@@ -0,0 +1,362 @@
+#pragma once
+
+// Coroutines need C++20. Everything here is left out of C++17 builds
+#if defined(__cpp_impl_coroutine)
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "Memory/Memory.h"
+#include "Task/Task.h"
+#include "Task/TaskManager.h"
+
+namespace Flourish
+{
+    template<typename ResultType = void>
+    class CoTask;
+
+    namespace CoTaskInternal
+    {
+        template<typename ParameterType>
+        constexpr bool IsAllocator()
+        {
+            typedef std::remove_cv_t<std::remove_reference_t<ParameterType>> Type;
+            return std::is_base_of<Memory::IAllocator, Type>::value
+                || (std::is_pointer<Type>::value && std::is_base_of<Memory::IAllocator, std::remove_cv_t<std::remove_pointer_t<Type>>>::value);
+        }
+
+        template<typename ParameterType>
+        Memory::IAllocator* GetAllocator(ParameterType& parameter)
+        {
+            if constexpr (std::is_pointer<std::remove_cv_t<ParameterType>>::value)
+            {
+                return parameter;
+            }
+            else
+            {
+                return &parameter;
+            }
+        }
+
+        inline Memory::IAllocator* FindAllocator()
+        {
+            return nullptr;
+        }
+
+        // Returns the first parameter that is an allocator
+        template<typename FirstParameter, typename... OtherParameters>
+        Memory::IAllocator* FindAllocator(FirstParameter& first, OtherParameters&... others)
+        {
+            if constexpr (IsAllocator<FirstParameter>())
+            {
+                return GetAllocator(first);
+            }
+            else
+            {
+                return FindAllocator(others...);
+            }
+        }
+
+        // The part of the promise that doesn't depend on the result type
+        class PromiseBase
+        {
+        public:
+            // The allocator is stored in front of the frame, so the frame can be freed
+            static const size_t FRAME_HEADER_SIZE = alignof(std::max_align_t);
+
+            // Coroutine frames are allocated from the first allocator in the
+            // coroutine's parameters (for member functions, the object comes first)
+            template<typename... Parameters>
+            static void* operator new(size_t size, Parameters&... parameters)
+            {
+                static_assert((IsAllocator<Parameters>() || ...),
+                              "A coroutine returning CoTask must take a Memory::IAllocator (by reference or pointer) to allocate its frame from");
+                auto allocator = FindAllocator(parameters...);
+                auto memory = static_cast<char*>(FL_ALLOC_ALIGN(*allocator, size + FRAME_HEADER_SIZE, alignof(std::max_align_t)));
+                *reinterpret_cast<Memory::IAllocator**>(memory) = allocator;
+                return memory + FRAME_HEADER_SIZE;
+            }
+
+            static void operator delete(void* frame, size_t)
+            {
+                auto memory = static_cast<char*>(frame) - FRAME_HEADER_SIZE;
+                auto allocator = *reinterpret_cast<Memory::IAllocator**>(memory);
+                FL_FREE_ALIGN(*allocator, memory);
+            }
+
+            PromiseBase()
+                : _continuation()
+                , _taskManager(nullptr)
+                , _finishedTask(0)
+            {
+            }
+
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            auto final_suspend() noexcept
+            {
+                struct FinalAwaiter
+                {
+                    bool await_ready() noexcept
+                    {
+                        return false;
+                    }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept
+                    {
+                        // Whatever was waiting carries on straight away on this thread
+                        if(_promise->_continuation)
+                        {
+                            return _promise->_continuation;
+                        }
+                        if(_promise->_taskManager != nullptr)
+                        {
+                            // Once this is called the frame may be destroyed, so it mustn't be touched afterwards
+                            _promise->_taskManager->FinishAdd(_promise->_finishedTask);
+                        }
+                        return std::noop_coroutine();
+                    }
+
+                    void await_resume() noexcept
+                    {
+                    }
+
+                    PromiseBase* _promise;
+                };
+                return FinalAwaiter{ this };
+            }
+
+            void unhandled_exception()
+            {
+                // Flourish is built without exceptions
+                std::abort();
+            }
+
+            // co_await on a TaskId suspends until the task has finished, and carries
+            // on in a task queued by whichever thread finishes it
+            auto await_transform(TaskId taskId)
+            {
+                struct TaskAwaiter
+                {
+                    bool await_ready()
+                    {
+                        return _taskManager->IsComplete(_taskId);
+                    }
+
+                    void await_suspend(std::coroutine_handle<> handle)
+                    {
+                        auto resumeTask = _taskManager->BeginAdd(_taskManager->WorkItemWithTaskAllocator([handle](void*){
+                            handle.resume();
+                        }));
+                        _taskManager->AddDependency(_taskId, resumeTask);
+                        _taskManager->FinishAdd(resumeTask);
+                    }
+
+                    void await_resume()
+                    {
+                    }
+
+                    TaskManager* _taskManager;
+                    TaskId _taskId;
+                };
+                assert(_taskManager != nullptr); // Only coroutines that have been started or awaited by one that has can wait on tasks
+                return TaskAwaiter{ _taskManager, taskId };
+            }
+
+            template<typename Awaitable>
+            Awaitable&& await_transform(Awaitable&& awaitable)
+            {
+                return std::forward<Awaitable>(awaitable);
+            }
+
+            TaskManager* GetTaskManager() const
+            {
+                return _taskManager;
+            }
+
+        protected:
+            template<typename ResultType>
+            friend class Flourish::CoTask;
+
+            std::coroutine_handle<> _continuation;
+            TaskManager* _taskManager;
+            TaskId _finishedTask;
+        };
+
+        template<typename ResultType>
+        class Promise : public PromiseBase
+        {
+        public:
+            CoTask<ResultType> get_return_object();
+
+            template<typename ValueType>
+            void return_value(ValueType&& value)
+            {
+                _result.emplace(std::forward<ValueType>(value));
+            }
+
+            ResultType TakeResult()
+            {
+                assert(_result.has_value()); // The coroutine hasn't finished
+                return std::move(*_result);
+            }
+
+        private:
+            std::optional<ResultType> _result;
+        };
+
+        template<>
+        class Promise<void> : public PromiseBase
+        {
+        public:
+            CoTask<void> get_return_object();
+
+            void return_void()
+            {
+            }
+
+            void TakeResult()
+            {
+            }
+        };
+    }
+
+    // A coroutine that runs its body on TaskManager threads, and can co_await
+    //
+    //   - a TaskId, carrying on once the task has finished
+    //   - another CoTask, which runs straight away and carries on once it has finished
+    //   - the data store awaitables in DataStore/DataStoreAwaitables.h
+    //
+    // without blocking the thread it's running on. It carries on in a task queued
+    // when whatever it waited for finishes, so it may carry on on a different thread.
+    //
+    // Nothing runs until the CoTask is started or awaited. The coroutine's frame is
+    // allocated from a Memory::IAllocator, which has to be one of its parameters
+    template<typename ResultType>
+    class CoTask
+    {
+    public:
+        typedef CoTaskInternal::Promise<ResultType> promise_type;
+
+        explicit CoTask(std::coroutine_handle<promise_type> handle)
+            : _handle(handle)
+        {
+        }
+
+        CoTask(CoTask&& other) noexcept
+            : _handle(std::exchange(other._handle, nullptr))
+        {
+        }
+
+        CoTask& operator=(CoTask&& other) noexcept
+        {
+            if(this != &other)
+            {
+                Destroy();
+                _handle = std::exchange(other._handle, nullptr);
+            }
+            return *this;
+        }
+
+        CoTask(const CoTask&) = delete;
+        CoTask& operator=(const CoTask&) = delete;
+
+        ~CoTask()
+        {
+            Destroy();
+        }
+
+        // Queues a task that starts the coroutine. Returns a task that finishes once the
+        // coroutine has, which can be waited on or depended on like any other task.
+        // The CoTask must stay alive until then
+        TaskId Start(TaskManager* taskManager)
+        {
+            auto& promise = _handle.promise();
+            promise._taskManager = taskManager;
+            promise._finishedTask = taskManager->BeginAdd(WorkItem::Empty());
+            std::coroutine_handle<> handle = _handle;
+            taskManager->AddTaskWithNoChildrenOrDependencies(taskManager->WorkItemWithTaskAllocator([handle](void*){
+                handle.resume();
+            }));
+            return promise._finishedTask;
+        }
+
+        bool IsDone() const
+        {
+            return _handle && _handle.done();
+        }
+
+        // Only valid once the coroutine has finished
+        ResultType TakeResult()
+        {
+            assert(IsDone());
+            return _handle.promise().TakeResult();
+        }
+
+        // Awaiting a CoTask starts it, and the awaiting coroutine carries on once it has finished
+        auto operator co_await() noexcept
+        {
+            return Awaiter{ _handle };
+        }
+
+    private:
+        struct Awaiter
+        {
+            bool await_ready() noexcept
+            {
+                return false;
+            }
+
+            template<typename AwaitingPromise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<AwaitingPromise> awaiting) noexcept
+            {
+                auto& promise = _handle.promise();
+                promise._continuation = awaiting;
+                promise._taskManager = awaiting.promise().GetTaskManager();
+                return _handle;
+            }
+
+            ResultType await_resume()
+            {
+                return _handle.promise().TakeResult();
+            }
+
+            std::coroutine_handle<promise_type> _handle;
+        };
+
+        void Destroy()
+        {
+            if(_handle)
+            {
+                _handle.destroy();
+                _handle = nullptr;
+            }
+        }
+
+        std::coroutine_handle<promise_type> _handle;
+    };
+
+    namespace CoTaskInternal
+    {
+        template<typename ResultType>
+        CoTask<ResultType> Promise<ResultType>::get_return_object()
+        {
+            return CoTask<ResultType>(std::coroutine_handle<Promise<ResultType>>::from_promise(*this));
+        }
+
+        inline CoTask<void> Promise<void>::get_return_object()
+        {
+            return CoTask<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Flourish
+{
+    // Where a logical CPU (a hardware thread) sits in the machine. The ids are only
+    // meaningful compared with the ids of other CPUs from the same topology
+    struct LogicalCpu
+    {
+        // What the OS calls the CPU, used to pin threads to it
+        uint32_t _osIndex;
+        // CPUs on the same core are SMT siblings
+        uint32_t _coreId;
+        uint32_t _lastLevelCacheId;
+        uint32_t _numaNode;
+    };
+
+    // How far apart two CPUs are, nearest first. Taking work from a nearer CPU is
+    // cheaper, as the task and whatever it touches are more likely to be in a cache
+    // they share, rather than having to come across from another socket
+    enum class CpuDistance : uint8_t
+    {
+        SameCore,
+        SameCache,
+        SameNode,
+        Remote
+    };
+
+    const uint32_t NUM_CPU_DISTANCES = 4;
+
+    // The logical CPUs the process can run on, and how they share cores, caches and memory
+    class CpuTopology
+    {
+    public:
+        // Reads the topology from the OS. Anything that can't be read is treated as not
+        // shared, so if nothing can, every CPU is its own core on a single NUMA node
+        static CpuTopology Detect();
+
+        // Pins the calling thread to the CPU. Returns false if the OS doesn't support
+        // pinning threads, or wouldn't pin it
+        static bool PinCurrentThread(const LogicalCpu& cpu);
+
+        // If cpus is empty, every CPU std::thread::hardware_concurrency counts is its own core
+        explicit CpuTopology(std::vector<LogicalCpu> cpus);
+
+        uint32_t GetNumCpus() const
+        {
+            return static_cast<uint32_t>(_cpus.size());
+        }
+
+        const LogicalCpu& GetCpu(uint32_t cpuIdx) const
+        {
+            return _cpus[cpuIdx];
+        }
+
+        CpuDistance GetDistance(uint32_t firstCpuIdx, uint32_t secondCpuIdx) const;
+
+        // The order to give CPUs to threads in. Every core gets a thread before any core gets
+        // a second one on its SMT sibling, and cores sharing a cache or node are next to each
+        // other, so threads next to each other in the order share as much as they can
+        std::vector<uint32_t> GetPlacementOrder() const;
+
+    private:
+        std::vector<LogicalCpu> _cpus;
+    };
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Flourish
+{
+    // A fiber is a stack and the saved registers of whatever was running on it,
+    // so a thread can stop running one fiber part way through and carry on with another.
+    //
+    // Switching is cooperative, a fiber only stops running when it switches to another
+    // fiber. A thread has to call ConvertCurrentThread before switching to any fiber,
+    // which saves where the thread was into that fiber so it can be switched back to.
+    //
+    // On Windows the OS allocates fiber stacks itself, so the stack passed to Create is
+    // only used for its size
+    class Fiber
+    {
+    public:
+        typedef void (*EntryFunction)(void* userData);
+
+        Fiber();
+        ~Fiber();
+
+        Fiber(const Fiber&) = delete;
+        Fiber& operator=(const Fiber&) = delete;
+
+        // Sets the fiber up to call entryFunction(userData) on the stack the first time it's
+        // switched to. entryFunction must never return, it has to switch to another fiber instead
+        void Create(void* stack, size_t stackSize, EntryFunction entryFunction, void* userData);
+
+        // Lets the current thread switch to fibers, using this fiber to hold where the thread was
+        void ConvertCurrentThread();
+
+        // Must be called on the thread ConvertCurrentThread was called on, once it's back on this fiber
+        void RevertCurrentThread();
+
+        // Saves the current thread's state into from, which must be the fiber running now, and
+        // carries on from wherever to was saved. Returns when something switches back to from,
+        // which could be on another thread
+        static void Switch(Fiber* from, Fiber* to);
+
+    private:
+        // Holds the platform's saved registers, and the function that starts a new fiber
+        struct Context;
+
+        Context* _context;
+        EntryFunction _entryFunction;
+        void* _userData;
+    };
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Memory/MemoryArea.h"
+#include "Task/Fiber.h"
+#include "Task/TaskFreeList.h"
+
+namespace Flourish
+{
+    // A fixed number of fibers, with their stacks cut out of a memory area.
+    //
+    // Every fiber starts at entryFunction the first time it's switched to. A fiber
+    // that's released keeps its state, so the next time it's acquired and switched
+    // to it carries on from where it last switched away
+    class FiberPool
+    {
+    public:
+        // Stacks are aligned to this, and their size rounded down to a multiple of it
+        static const size_t STACK_ALIGNMENT = 16u;
+
+        // Makes as many fibers of stackSize as fit in the memory area, which
+        // must stay alive until the pool is destroyed
+        FiberPool(Memory::MemoryArea* stackArea, size_t stackSize, Fiber::EntryFunction entryFunction, void* userData);
+        ~FiberPool();
+
+        FiberPool(const FiberPool&) = delete;
+        FiberPool& operator=(const FiberPool&) = delete;
+
+        // Returns a free fiber, or nullptr if they're all in use
+        Fiber* Acquire();
+
+        // Returns a fiber to the pool. It must not be running on any thread
+        void Release(Fiber* fiber);
+
+        uint32_t GetNumFibers() const
+        {
+            return _freeList.GetCapacity();
+        }
+
+    private:
+        static uint32_t GetNumFibers(Memory::MemoryArea* stackArea, size_t stackSize);
+
+        Fiber* _fibers;
+        TaskFreeList _freeList;
+    };
+}
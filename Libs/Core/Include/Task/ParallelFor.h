@@ -3,33 +3,54 @@
 #include <functional>
 #include <utility>
 
+#include "Task/SplitterTraits.h"
 #include "Task/Task.h"
 
 namespace Flourish
 {
-    template<typename DataType, typename Splitter, typename TaskSystem>
-    void ParallelForFunc(TaskId parentTask, DataType* data, int32_t dataCount, Splitter* splitter, std::function<void(DataType*,uint32_t)> workFunc, TaskSystem* taskSystem)
+    template<typename DataType, typename Splitter, typename WorkFunc, typename TaskSystem>
+    void ParallelForFunc(TaskId parentTask, DataType* data, int32_t dataCount, Splitter* splitter, const WorkFunc& workFunc, TaskSystem* taskSystem)
     {
         if(!splitter->ShouldSplit(data, dataCount))
         {
-            auto taskId = taskSystem->BeginAdd(taskSystem->WorkItemWithTaskAllocator([=](void*){
-                workFunc(data, dataCount);
-            }));
+            // Each leaf takes its own copy of the work function, so nothing it uses goes away with
+            // the ParallelFor. The splitter is only kept if it's told about leaves, which leaves
+            // room to store a std::function inline. Anything larger comes from the task allocator
+            TaskId taskId;
+            if constexpr (SplitterTraits::HasOnLeafExecuted<Splitter, DataType>::value)
+            {
+                taskId = taskSystem->BeginAdd(taskSystem->WorkItemWithTaskAllocator([leafFunc = workFunc, splitter, data, dataCount](void*){
+                    SplitterTraits::RunLeaf(splitter, leafFunc, data, dataCount);
+                }));
+            }
+            else
+            {
+                taskId = taskSystem->BeginAdd(taskSystem->WorkItemWithTaskAllocator([leafFunc = workFunc, data, dataCount](void*){
+                    leafFunc(data, dataCount);
+                }));
+            }
             taskSystem->AddChild(parentTask, taskId);
             taskSystem->FinishAdd(taskId);
         }
         else
         {
-            auto leftSize = dataCount / 2u;
+            auto leftSize = SplitterTraits::GetSplitCount(splitter, data, dataCount);
             ParallelForFunc(parentTask, data, leftSize, splitter, workFunc, taskSystem);
             ParallelForFunc(parentTask, data + leftSize, dataCount - leftSize, splitter, workFunc, taskSystem);
         }
     }
-    
-    template<typename DataType, typename Splitter, typename TaskSystem = class TaskManager>
+
+    // Splits the data up front on the thread that calls Run, adding a task for every leaf.
+    //
+    // WorkFunc defaults to a std::function, but can be any callable taking (DataType*, uint32_t).
+    // Constructing without template arguments deduces the callable's type, so the leaves call
+    // it directly instead of through a std::function.
+    //
+    // Passing a TaskGroup as the task system puts every leaf in the group, so the loop can be
+    // cancelled, or waited on along with the rest of the group
+    template<typename DataType, typename Splitter, typename TaskSystem = class TaskManager, typename WorkFunc = std::function<void(DataType*,uint32_t)>>
     class ParallelFor
     {
-        typedef std::function<void(DataType*,uint32_t)> WorkFunc;
     public:
         ParallelFor(DataType* data, uint32_t dataCount, Splitter* splitter, WorkFunc workFunc, TaskSystem* taskSystem)
             : _data(data)
@@ -39,7 +60,7 @@ namespace Flourish
             , _taskSystem(taskSystem)
         {
         }
-        
+
         TaskId Run()
         {
             auto taskId = _taskSystem->BeginAdd(WorkItem::Empty());
@@ -47,7 +68,7 @@ namespace Flourish
             _taskSystem->FinishAdd(taskId);
             return taskId;
         }
-        
+
     private:
         DataType* _data;
         uint32_t _dataCount;
@@ -55,4 +76,67 @@ namespace Flourish
         WorkFunc _workFunc;
         TaskSystem* _taskSystem;
     };
+
+    // Splits the data as it runs, rather than up front. Run only adds a single task for
+    // the whole range. Whichever thread executes a range keeps splitting it, adding a task
+    // for the right half and carrying on with the left, until the splitter says stop and it
+    // calls the work function. A stolen range is split further by the thread that stole it,
+    // so the first leaf starts straight away rather than after every leaf has been added.
+    //
+    // As the splitter is called from whichever threads run the ranges, it must be safe to
+    // call concurrently. The LazyParallelFor must stay alive until the task returned by
+    // Run has finished
+    template<typename DataType, typename Splitter, typename WorkFunc, typename TaskSystem = class TaskManager>
+    class LazyParallelFor
+    {
+    public:
+        LazyParallelFor(DataType* data, uint32_t dataCount, Splitter* splitter, WorkFunc workFunc, TaskSystem* taskSystem)
+            : _data(data)
+            , _dataCount(dataCount)
+            , _splitter(splitter)
+            , _workFunc(std::move(workFunc))
+            , _taskSystem(taskSystem)
+            , _rootTask(0)
+        {
+        }
+
+        LazyParallelFor(const LazyParallelFor&) = delete;
+        LazyParallelFor& operator=(const LazyParallelFor&) = delete;
+
+        TaskId Run()
+        {
+            _rootTask = _taskSystem->BeginAdd(WorkItem::Empty());
+            AddRange(_data, _dataCount);
+            _taskSystem->FinishAdd(_rootTask);
+            return _rootTask;
+        }
+
+    private:
+        void AddRange(DataType* data, uint32_t dataCount)
+        {
+            auto taskId = _taskSystem->BeginAdd(_taskSystem->WorkItemWithTaskAllocator([this, data, dataCount](void*){
+                RunRange(data, dataCount);
+            }));
+            _taskSystem->AddChild(_rootTask, taskId);
+            _taskSystem->FinishAdd(taskId);
+        }
+
+        void RunRange(DataType* data, uint32_t dataCount)
+        {
+            while(_splitter->ShouldSplit(data, dataCount))
+            {
+                auto leftSize = SplitterTraits::GetSplitCount(_splitter, data, dataCount);
+                AddRange(data + leftSize, dataCount - leftSize);
+                dataCount = leftSize;
+            }
+            SplitterTraits::RunLeaf(_splitter, _workFunc, data, dataCount);
+        }
+
+        DataType* _data;
+        uint32_t _dataCount;
+        Splitter* _splitter;
+        WorkFunc _workFunc;
+        TaskSystem* _taskSystem;
+        TaskId _rootTask;
+    };
 }
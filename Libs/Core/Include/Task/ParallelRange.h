@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Task/SplitterTraits.h"
+
+namespace Flourish
+{
+    template<typename DataType>
+    struct ParallelRange
+    {
+        DataType* _data;
+        uint32_t _dataCount;
+    };
+
+    // Splits the data the same way ParallelFor does, adding the leaves to ranges in order
+    template<typename DataType, typename Splitter>
+    void SplitIntoRanges(DataType* data, uint32_t dataCount, Splitter* splitter, std::vector<ParallelRange<DataType>>& ranges)
+    {
+        if(!splitter->ShouldSplit(data, dataCount))
+        {
+            ranges.push_back({ data, dataCount });
+        }
+        else
+        {
+            auto leftSize = SplitterTraits::GetSplitCount(splitter, data, dataCount);
+            SplitIntoRanges(data, leftSize, splitter, ranges);
+            SplitIntoRanges(data + leftSize, dataCount - leftSize, splitter, ranges);
+        }
+    }
+}
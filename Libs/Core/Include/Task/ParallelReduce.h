@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Platform/PlatformFeatures.h"
+#include "Task/ParallelRange.h"
+#include "Task/Task.h"
+
+namespace Flourish
+{
+    // Reduces the data to a single value. The data is split up front with the splitter,
+    // and each leaf runs
+    //
+    //     ResultType reduceFunc(DataType* data, uint32_t dataCount, ResultType identity)
+    //
+    // into its own cache line sized slot, so leaves never write to the same cache line.
+    // GetResult then combines the leaves in order with
+    //
+    //     ResultType combineFunc(ResultType left, ResultType right)
+    //
+    // so as long as the splitter splits the same way each time (CountSplitter or
+    // AffinitySplitter, but not AutoSplitter) the result is the same every time, even
+    // for floating point.
+    //
+    // The ParallelReduce must stay alive until the task returned by Run has finished
+    template<typename DataType, typename ResultType, typename Splitter, typename ReduceFunc, typename CombineFunc, typename TaskSystem = class TaskManager>
+    class ParallelReduce
+    {
+    public:
+        ParallelReduce(DataType* data, uint32_t dataCount, Splitter* splitter, ResultType identity, ReduceFunc reduceFunc, CombineFunc combineFunc, TaskSystem* taskSystem)
+            : _data(data)
+            , _dataCount(dataCount)
+            , _splitter(splitter)
+            , _identity(std::move(identity))
+            , _reduceFunc(std::move(reduceFunc))
+            , _combineFunc(std::move(combineFunc))
+            , _taskSystem(taskSystem)
+            , _ranges()
+            , _partials()
+        {
+        }
+
+        ParallelReduce(const ParallelReduce&) = delete;
+        ParallelReduce& operator=(const ParallelReduce&) = delete;
+
+        TaskId Run()
+        {
+            _ranges.clear();
+            SplitIntoRanges(_data, _dataCount, _splitter, _ranges);
+            _partials.assign(_ranges.size(), PaddedResult{ _identity });
+
+            auto taskId = _taskSystem->BeginAdd(WorkItem::Empty());
+            for(size_t rangeIdx = 0; rangeIdx < _ranges.size(); rangeIdx++)
+            {
+                auto leafId = _taskSystem->BeginAdd(_taskSystem->WorkItemWithTaskAllocator([this, rangeIdx](void*){
+                    auto& range = _ranges[rangeIdx];
+                    _partials[rangeIdx]._value = _reduceFunc(range._data, range._dataCount, _identity);
+                }));
+                _taskSystem->AddChild(taskId, leafId);
+                _taskSystem->FinishAdd(leafId);
+            }
+            _taskSystem->FinishAdd(taskId);
+            return taskId;
+        }
+
+        // Only valid once the task returned by Run has finished
+        ResultType GetResult() const
+        {
+            auto result = _identity;
+            for(auto& partial : _partials)
+            {
+                result = _combineFunc(result, partial._value);
+            }
+            return result;
+        }
+
+    private:
+        struct alignas(FL_CACHE_LINE_SIZE) PaddedResult
+        {
+            ResultType _value;
+        };
+
+        DataType* _data;
+        uint32_t _dataCount;
+        Splitter* _splitter;
+        ResultType _identity;
+        ReduceFunc _reduceFunc;
+        CombineFunc _combineFunc;
+        TaskSystem* _taskSystem;
+        std::vector<ParallelRange<DataType>> _ranges;
+        std::vector<PaddedResult> _partials;
+    };
+}
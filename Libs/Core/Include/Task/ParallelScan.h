@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Platform/PlatformFeatures.h"
+#include "Task/ParallelRange.h"
+#include "Task/Task.h"
+
+namespace Flourish
+{
+    enum class ScanType
+    {
+        Inclusive,
+        Exclusive
+    };
+
+    // Writes the running total of the input to the output using
+    //
+    //     ResultType combineFunc(ResultType left, ResultType right)
+    //
+    // An inclusive scan includes each element in its own output, an exclusive scan
+    // starts with the identity. The input and output can be the same array.
+    //
+    // This runs in two passes. The data is split up front with the splitter, then each
+    // leaf totals its range into its own cache line sized slot. Once every leaf has
+    // finished, a single task works out the total before each leaf in order and adds a
+    // task per leaf to write its output starting from that total. As the leaves are
+    // combined in order, the output is the same every time as long as the splitter
+    // splits the same way each time.
+    //
+    // The task system must support AddDependency. The scan must stay alive until the
+    // task returned by Run has finished. Use ParallelInclusiveScan or ParallelExclusiveScan
+    template<typename DataType, typename ResultType, typename Splitter, typename CombineFunc, typename TaskSystem, ScanType scanType>
+    class ParallelScan
+    {
+    public:
+        ParallelScan(DataType* input, ResultType* output, uint32_t dataCount, Splitter* splitter, ResultType identity, CombineFunc combineFunc, TaskSystem* taskSystem)
+            : _input(input)
+            , _output(output)
+            , _dataCount(dataCount)
+            , _splitter(splitter)
+            , _identity(std::move(identity))
+            , _combineFunc(std::move(combineFunc))
+            , _taskSystem(taskSystem)
+            , _rootTask(0)
+            , _ranges()
+            , _partials()
+            , _total(_identity)
+        {
+        }
+
+        ParallelScan(const ParallelScan&) = delete;
+        ParallelScan& operator=(const ParallelScan&) = delete;
+
+        TaskId Run()
+        {
+            _ranges.clear();
+            SplitIntoRanges(_input, _dataCount, _splitter, _ranges);
+            _partials.assign(_ranges.size(), PaddedResult{ _identity });
+            _total = _identity;
+
+            _rootTask = _taskSystem->BeginAdd(WorkItem::Empty());
+            // The leaves of the first pass are children of their own task, so the
+            // second pass only needs a single dependency
+            auto totalsTask = _taskSystem->BeginAdd(WorkItem::Empty());
+            auto offsetsTask = _taskSystem->BeginAdd(_taskSystem->WorkItemWithTaskAllocator([this](void*){
+                AddOutputTasks();
+            }));
+            _taskSystem->AddChild(_rootTask, offsetsTask);
+            _taskSystem->AddDependency(totalsTask, offsetsTask);
+            for(size_t rangeIdx = 0; rangeIdx < _ranges.size(); rangeIdx++)
+            {
+                auto leafId = _taskSystem->BeginAdd(_taskSystem->WorkItemWithTaskAllocator([this, rangeIdx](void*){
+                    TotalRange(rangeIdx);
+                }));
+                _taskSystem->AddChild(totalsTask, leafId);
+                _taskSystem->FinishAdd(leafId);
+            }
+            _taskSystem->FinishAdd(totalsTask);
+            _taskSystem->FinishAdd(offsetsTask);
+            _taskSystem->FinishAdd(_rootTask);
+            return _rootTask;
+        }
+
+        // The combination of every element. Only valid once the task returned by Run has finished
+        ResultType GetTotal() const
+        {
+            return _total;
+        }
+
+    private:
+        struct alignas(FL_CACHE_LINE_SIZE) PaddedResult
+        {
+            ResultType _value;
+        };
+
+        void TotalRange(size_t rangeIdx)
+        {
+            auto& range = _ranges[rangeIdx];
+            auto total = _identity;
+            for(uint32_t index = 0; index < range._dataCount; index++)
+            {
+                total = _combineFunc(total, range._data[index]);
+            }
+            _partials[rangeIdx]._value = total;
+        }
+
+        void AddOutputTasks()
+        {
+            // Turn each leaf's total into the total of everything before it
+            auto runningTotal = _identity;
+            for(auto& partial : _partials)
+            {
+                auto leafTotal = partial._value;
+                partial._value = runningTotal;
+                runningTotal = _combineFunc(runningTotal, leafTotal);
+            }
+            _total = runningTotal;
+
+            for(size_t rangeIdx = 0; rangeIdx < _ranges.size(); rangeIdx++)
+            {
+                auto leafId = _taskSystem->BeginAdd(_taskSystem->WorkItemWithTaskAllocator([this, rangeIdx](void*){
+                    OutputRange(rangeIdx);
+                }));
+                _taskSystem->AddChild(_rootTask, leafId);
+                _taskSystem->FinishAdd(leafId);
+            }
+        }
+
+        void OutputRange(size_t rangeIdx)
+        {
+            auto& range = _ranges[rangeIdx];
+            auto output = _output + (range._data - _input);
+            auto runningTotal = _partials[rangeIdx]._value;
+            for(uint32_t index = 0; index < range._dataCount; index++)
+            {
+                // Read the input first in case it's the same as the output
+                auto value = range._data[index];
+                if constexpr (scanType == ScanType::Inclusive)
+                {
+                    runningTotal = _combineFunc(runningTotal, value);
+                    output[index] = runningTotal;
+                }
+                else
+                {
+                    output[index] = runningTotal;
+                    runningTotal = _combineFunc(runningTotal, value);
+                }
+            }
+        }
+
+        DataType* _input;
+        ResultType* _output;
+        uint32_t _dataCount;
+        Splitter* _splitter;
+        ResultType _identity;
+        CombineFunc _combineFunc;
+        TaskSystem* _taskSystem;
+        TaskId _rootTask;
+        std::vector<ParallelRange<DataType>> _ranges;
+        std::vector<PaddedResult> _partials;
+        ResultType _total;
+    };
+
+    template<typename DataType, typename ResultType, typename Splitter, typename CombineFunc, typename TaskSystem = class TaskManager>
+    class ParallelInclusiveScan : public ParallelScan<DataType, ResultType, Splitter, CombineFunc, TaskSystem, ScanType::Inclusive>
+    {
+    public:
+        using ParallelScan<DataType, ResultType, Splitter, CombineFunc, TaskSystem, ScanType::Inclusive>::ParallelScan;
+    };
+
+    template<typename DataType, typename ResultType, typename Splitter, typename CombineFunc, typename TaskSystem = class TaskManager>
+    class ParallelExclusiveScan : public ParallelScan<DataType, ResultType, Splitter, CombineFunc, TaskSystem, ScanType::Exclusive>
+    {
+    public:
+        using ParallelScan<DataType, ResultType, Splitter, CombineFunc, TaskSystem, ScanType::Exclusive>::ParallelScan;
+    };
+
+    template<typename DataType, typename ResultType, typename Splitter, typename CombineFunc, typename TaskSystem>
+    ParallelInclusiveScan(DataType*, ResultType*, uint32_t, Splitter*, ResultType, CombineFunc, TaskSystem*) -> ParallelInclusiveScan<DataType, ResultType, Splitter, CombineFunc, TaskSystem>;
+
+    template<typename DataType, typename ResultType, typename Splitter, typename CombineFunc, typename TaskSystem>
+    ParallelExclusiveScan(DataType*, ResultType*, uint32_t, Splitter*, ResultType, CombineFunc, TaskSystem*) -> ParallelExclusiveScan<DataType, ResultType, Splitter, CombineFunc, TaskSystem>;
+}
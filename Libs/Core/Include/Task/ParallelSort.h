@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "Memory/Memory.h"
+#include "Platform/PlatformFeatures.h"
+#include "Task/Task.h"
+#include "Task/WorkItem.h"
+
+namespace Flourish
+{
+    namespace SortInternal
+    {
+        // The data is cut into about this many blocks per thread, so a thread that
+        // finishes early can pick up another block
+        const uint32_t BLOCKS_PER_THREAD = 4u;
+
+        // Blocks smaller than this cost more to schedule than to sort
+        const uint32_t MINIMUM_BLOCK_SIZE = 4096u;
+
+        const uint32_t RADIX_BITS = 8u;
+        const uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+        const uint32_t RADIX_MASK = RADIX_SIZE - 1u;
+
+        template<typename TaskSystem>
+        uint32_t GetBlockSize(uint32_t dataCount, TaskSystem* taskSystem)
+        {
+            // The thread that waits helps out, so it counts as a thread too
+            auto numBlocks = (taskSystem->GetNumThreads() + 1u) * BLOCKS_PER_THREAD;
+            auto blockSize = (dataCount + numBlocks - 1u) / numBlocks;
+            return std::max(blockSize, MINIMUM_BLOCK_SIZE);
+        }
+
+        // Runs blockFunc(blockIdx) for every block as a child of one task, and waits
+        // for them all. The waiting thread executes blocks while it waits
+        template<typename TaskSystem, typename BlockFunc>
+        void RunBlocksAndWait(uint32_t numBlocks, const BlockFunc& blockFunc, TaskSystem* taskSystem)
+        {
+            auto taskId = taskSystem->BeginAdd(WorkItem::Empty());
+            for(uint32_t blockIdx = 0; blockIdx < numBlocks; blockIdx++)
+            {
+                auto blockId = taskSystem->BeginAdd(taskSystem->WorkItemWithTaskAllocator([&blockFunc, blockIdx](void*){
+                    blockFunc(blockIdx);
+                }));
+                taskSystem->AddChild(taskId, blockId);
+                taskSystem->FinishAdd(blockId);
+            }
+            taskSystem->FinishAdd(taskId);
+            taskSystem->Wait(taskId);
+        }
+
+        // Returns how many of the first outputCount elements of merging left and right
+        // come from left. Equal elements are taken from left first, so the merge is stable
+        template<typename DataType, typename Compare>
+        uint64_t GetMergeSplit(const DataType* left, uint64_t leftCount, const DataType* right, uint64_t rightCount, uint64_t outputCount, Compare& compare)
+        {
+            auto low = outputCount > rightCount ? outputCount - rightCount : 0u;
+            auto high = std::min(outputCount, leftCount);
+            while(low < high)
+            {
+                auto leftTaken = low + (high - low) / 2u;
+                auto rightTaken = outputCount - leftTaken;
+                if(rightTaken > 0u && !compare(right[rightTaken - 1u], left[leftTaken]))
+                {
+                    low = leftTaken + 1u;
+                }
+                else
+                {
+                    high = leftTaken;
+                }
+            }
+            return low;
+        }
+
+        // Maps a key to an unsigned integer that sorts in the same order,
+        // by flipping the sign bit of signed integers and the sign bit of
+        // positive floats (or every bit of negative ones)
+        template<typename KeyType>
+        auto ToRadixKey(KeyType key)
+        {
+            static_assert((std::is_integral<KeyType>::value && !std::is_same<KeyType, bool>::value) || std::is_floating_point<KeyType>::value,
+                          "Radix sort keys must be integers or floating point");
+            if constexpr (std::is_floating_point<KeyType>::value)
+            {
+                static_assert(sizeof(KeyType) == sizeof(uint32_t) || sizeof(KeyType) == sizeof(uint64_t), "Only 32 and 64 bit floating point keys are supported");
+                typedef std::conditional_t<sizeof(KeyType) == sizeof(uint32_t), uint32_t, uint64_t> Bits;
+                const Bits signBit = Bits(1) << (sizeof(Bits) * 8u - 1u);
+                Bits bits;
+                memcpy(&bits, &key, sizeof(bits));
+                return (bits & signBit) != 0 ? Bits(~bits) : Bits(bits | signBit);
+            }
+            else
+            {
+                typedef std::make_unsigned_t<KeyType> Bits;
+                auto bits = static_cast<Bits>(key);
+                if constexpr (std::is_signed<KeyType>::value)
+                {
+                    bits ^= Bits(1) << (sizeof(Bits) * 8u - 1u);
+                }
+                return bits;
+            }
+        }
+
+        template<typename DataType>
+        DataType* AllocateScratch(Memory::IAllocator* allocator, size_t count)
+        {
+            return static_cast<DataType*>(FL_ALLOC_ALIGN(*allocator, count * sizeof(DataType), std::max<size_t>(alignof(DataType), FL_CACHE_LINE_SIZE)));
+        }
+    }
+
+    // Sorts the data with a stable merge sort, and returns once it's sorted.
+    //
+    // The data is cut into blocks which are sorted in parallel with std::stable_sort,
+    // and then merged in rounds, each round doubling the length of the sorted runs.
+    // Every merge is cut up into block sized pieces as well, so the last rounds still
+    // run in parallel.
+    //
+    // The merges ping pong between the data and a scratch buffer of the same size,
+    // taken from scratchAllocator and freed before returning. As the elements are
+    // copied bit for bit between the two, DataType has to be trivially copyable.
+    // The calling thread executes tasks while it waits
+    template<typename DataType, typename Compare, typename TaskSystem = class TaskManager>
+    void ParallelSort(DataType* data, uint32_t dataCount, Compare compare, Memory::IAllocator* scratchAllocator, TaskSystem* taskSystem)
+    {
+        static_assert(std::is_trivially_copyable<DataType>::value, "ParallelSort copies elements to scratch memory, so they must be trivially copyable");
+
+        auto blockSize = SortInternal::GetBlockSize(dataCount, taskSystem);
+        auto numBlocks = (dataCount + blockSize - 1u) / blockSize;
+        if(numBlocks <= 1u)
+        {
+            std::stable_sort(data, data + dataCount, compare);
+            return;
+        }
+
+        SortInternal::RunBlocksAndWait(numBlocks, [&](uint32_t blockIdx) {
+            auto blockStart = blockIdx * blockSize;
+            auto blockEnd = std::min(blockStart + blockSize, dataCount);
+            std::stable_sort(data + blockStart, data + blockEnd, compare);
+        }, taskSystem);
+
+        auto scratch = SortInternal::AllocateScratch<DataType>(scratchAllocator, dataCount);
+        DataType* source = data;
+        DataType* destination = scratch;
+        for(uint64_t runLength = blockSize; runLength < dataCount; runLength *= 2u)
+        {
+            // Runs are a whole number of blocks long, so each block of the output comes from exactly one pair of runs
+            SortInternal::RunBlocksAndWait(numBlocks, [&](uint32_t blockIdx) {
+                uint64_t outputStart = uint64_t(blockIdx) * blockSize;
+                uint64_t outputEnd = std::min<uint64_t>(outputStart + blockSize, dataCount);
+                uint64_t leftStart = outputStart - outputStart % (runLength * 2u);
+                uint64_t rightStart = std::min<uint64_t>(leftStart + runLength, dataCount);
+                uint64_t rightEnd = std::min<uint64_t>(rightStart + runLength, dataCount);
+
+                auto left = source + leftStart;
+                auto right = source + rightStart;
+                auto leftCount = rightStart - leftStart;
+                auto rightCount = rightEnd - rightStart;
+                auto fromLeftStart = SortInternal::GetMergeSplit(left, leftCount, right, rightCount, outputStart - leftStart, compare);
+                auto fromLeftEnd = SortInternal::GetMergeSplit(left, leftCount, right, rightCount, outputEnd - leftStart, compare);
+                std::merge(left + fromLeftStart, left + fromLeftEnd,
+                           right + (outputStart - leftStart - fromLeftStart), right + (outputEnd - leftStart - fromLeftEnd),
+                           destination + outputStart, compare);
+            }, taskSystem);
+            std::swap(source, destination);
+        }
+
+        if(source != data)
+        {
+            SortInternal::RunBlocksAndWait(numBlocks, [&](uint32_t blockIdx) {
+                auto blockStart = blockIdx * blockSize;
+                auto blockEnd = std::min(blockStart + blockSize, dataCount);
+                std::copy(source + blockStart, source + blockEnd, data + blockStart);
+            }, taskSystem);
+        }
+        FL_FREE_ALIGN(*scratchAllocator, scratch);
+    }
+
+    template<typename DataType, typename TaskSystem = class TaskManager>
+    void ParallelSort(DataType* data, uint32_t dataCount, Memory::IAllocator* scratchAllocator, TaskSystem* taskSystem)
+    {
+        ParallelSort(data, dataCount, std::less<DataType>(), scratchAllocator, taskSystem);
+    }
+
+    // Sorts the data by the key keyFunc returns for each element, and returns once it's sorted.
+    // Keys can be any integer or floating point type; negative floats sort before positive ones.
+    //
+    // This is a stable least significant digit radix sort, taking one pass per byte of the
+    // key. Each pass counts the digits in every block in parallel, works out where each
+    // block's elements go, then moves them in parallel. Passes where every key has the
+    // same digit are skipped, so small keys in wide types sort quicker.
+    //
+    // The passes ping pong between the data and a scratch buffer of the same size, taken
+    // from scratchAllocator along with the digit counts and freed before returning.
+    // DataType has to be trivially copyable. The calling thread executes tasks while it waits
+    template<typename DataType, typename KeyFunc, typename TaskSystem = class TaskManager>
+    void ParallelRadixSort(DataType* data, uint32_t dataCount, KeyFunc keyFunc, Memory::IAllocator* scratchAllocator, TaskSystem* taskSystem)
+    {
+        static_assert(std::is_trivially_copyable<DataType>::value, "ParallelRadixSort copies elements to scratch memory, so they must be trivially copyable");
+        using SortInternal::RADIX_BITS;
+        using SortInternal::RADIX_MASK;
+        using SortInternal::RADIX_SIZE;
+
+        typedef decltype(SortInternal::ToRadixKey(keyFunc(*data))) RadixKey;
+        const uint32_t numPasses = sizeof(RadixKey) * 8u / RADIX_BITS;
+
+        if(dataCount <= 1u)
+        {
+            return;
+        }
+
+        auto blockSize = SortInternal::GetBlockSize(dataCount, taskSystem);
+        auto numBlocks = (dataCount + blockSize - 1u) / blockSize;
+        auto scratch = SortInternal::AllocateScratch<DataType>(scratchAllocator, dataCount);
+        auto digitCounts = SortInternal::AllocateScratch<uint32_t>(scratchAllocator, size_t(numBlocks) * RADIX_SIZE);
+
+        DataType* source = data;
+        DataType* destination = scratch;
+        for(uint32_t pass = 0; pass < numPasses; pass++)
+        {
+            auto shift = pass * RADIX_BITS;
+            SortInternal::RunBlocksAndWait(numBlocks, [&](uint32_t blockIdx) {
+                auto counts = digitCounts + size_t(blockIdx) * RADIX_SIZE;
+                std::fill(counts, counts + RADIX_SIZE, 0u);
+                auto blockStart = blockIdx * blockSize;
+                auto blockEnd = std::min(blockStart + blockSize, dataCount);
+                for(auto index = blockStart; index < blockEnd; index++)
+                {
+                    counts[(SortInternal::ToRadixKey(keyFunc(source[index])) >> shift) & RADIX_MASK]++;
+                }
+            }, taskSystem);
+
+            // Turn the counts into where each block writes its first element of each digit,
+            // so blocks keep their order within a digit and the sort stays stable
+            uint32_t offset = 0;
+            bool allTheSameDigit = false;
+            for(uint32_t digit = 0; digit < RADIX_SIZE; digit++)
+            {
+                auto digitStart = offset;
+                for(uint32_t blockIdx = 0; blockIdx < numBlocks; blockIdx++)
+                {
+                    auto& count = digitCounts[size_t(blockIdx) * RADIX_SIZE + digit];
+                    auto blockCount = count;
+                    count = offset;
+                    offset += blockCount;
+                }
+                allTheSameDigit |= (offset - digitStart) == dataCount;
+            }
+            if(allTheSameDigit)
+            {
+                continue;
+            }
+
+            SortInternal::RunBlocksAndWait(numBlocks, [&](uint32_t blockIdx) {
+                auto offsets = digitCounts + size_t(blockIdx) * RADIX_SIZE;
+                auto blockStart = blockIdx * blockSize;
+                auto blockEnd = std::min(blockStart + blockSize, dataCount);
+                for(auto index = blockStart; index < blockEnd; index++)
+                {
+                    destination[offsets[(SortInternal::ToRadixKey(keyFunc(source[index])) >> shift) & RADIX_MASK]++] = source[index];
+                }
+            }, taskSystem);
+            std::swap(source, destination);
+        }
+
+        if(source != data)
+        {
+            SortInternal::RunBlocksAndWait(numBlocks, [&](uint32_t blockIdx) {
+                auto blockStart = blockIdx * blockSize;
+                auto blockEnd = std::min(blockStart + blockSize, dataCount);
+                std::copy(source + blockStart, source + blockEnd, data + blockStart);
+            }, taskSystem);
+        }
+        FL_FREE_ALIGN(*scratchAllocator, digitCounts);
+        FL_FREE_ALIGN(*scratchAllocator, scratch);
+    }
+
+    template<typename DataType, typename TaskSystem = class TaskManager>
+    void ParallelRadixSort(DataType* data, uint32_t dataCount, Memory::IAllocator* scratchAllocator, TaskSystem* taskSystem)
+    {
+        ParallelRadixSort(data, dataCount, [](const DataType& value) { return value; }, scratchAllocator, taskSystem);
+    }
+}
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Memory/Memory.h"
+#include "Platform/PlatformFeatures.h"
+#include "Task/Task.h"
+#include "Task/WorkItem.h"
+
+namespace Flourish
+{
+    enum class PipelineStageMode : uint8_t
+    {
+        // Any number of tokens can be in the stage at once
+        Parallel,
+        // One token at a time, in the order the input stage read them
+        SerialInOrder,
+        // One token at a time, in whatever order they get there
+        SerialOutOfOrder
+    };
+
+    // Streams items through a series of stages, like read, decompress, parse, write.
+    // Each item is carried in a token, a TokenType from a pool of maxTokens allocated up
+    // front, so no more than maxTokens items are ever in flight however far ahead the
+    // input gets. A token is reused for the next item once it has been through every stage.
+    //
+    // The input stage runs
+    //
+    //     bool inputFunc(TokenType& token)
+    //
+    // on a free token, one at a time, and returns false once there's nothing left to read.
+    // Each stage added with AddStage then runs
+    //
+    //     void stageFunc(TokenType& token)
+    //
+    // on every token, in the order the stages were added. Serial stages run one token at a
+    // time, so they can write to a file or keep state without a lock.
+    //
+    // A token is carried through the stages by a single task, so its data stays in the
+    // cache of the thread working on it. If it gets to a serial stage another token is in,
+    // it waits there without a task, and is picked up by the token in front once that
+    // leaves the stage. As soon as the input stage has read an item it adds a task to read
+    // the next one into a free token, so the items are read one after another while
+    // earlier ones move through the other stages.
+    //
+    // The Pipeline must stay alive until the task returned by Run has finished
+    template<typename TokenType, typename TaskSystem = class TaskManager, typename InputFunc = std::function<bool(TokenType&)>, typename StageFunc = std::function<void(TokenType&)>>
+    class Pipeline
+    {
+    public:
+        Pipeline(uint32_t maxTokens, Memory::IAllocator* tokenAllocator, InputFunc inputFunc, TaskSystem* taskSystem)
+            : _maxTokens(maxTokens)
+            , _tokenAllocator(tokenAllocator)
+            , _tokens(FL_NEW_RAW_ARRAY_ALIGNED(*tokenAllocator, Token, maxTokens, FL_CACHE_LINE_SIZE))
+            , _inputFunc(std::move(inputFunc))
+            , _taskSystem(taskSystem)
+            , _stages()
+            , _rootTask(0)
+            , _inputMutex()
+            , _freeTokens()
+            , _nextSequence(0)
+            , _isInputBusy(false)
+            , _isInputFinished(false)
+        {
+            assert(maxTokens != 0); // Nothing could ever be read
+            _freeTokens.reserve(maxTokens);
+        }
+
+        ~Pipeline()
+        {
+            for(auto stage : _stages)
+            {
+                FL_DELETE_RAW_ALIGNED(*_tokenAllocator, stage);
+            }
+            FL_DELETE_RAW_ARRAY_ALIGNED(*_tokenAllocator, _tokens);
+        }
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        // Stages run in the order they're added. Can't be called while the pipeline is running
+        void AddStage(PipelineStageMode mode, StageFunc stageFunc)
+        {
+            _stages.push_back(FL_NEW_RAW_ALIGNED(*_tokenAllocator, Stage, FL_CACHE_LINE_SIZE, mode, std::move(stageFunc), _maxTokens));
+        }
+
+        // Reads and processes items until the input stage runs out. The pipeline can be
+        // run again once the task has finished
+        TaskId Run()
+        {
+            _freeTokens.clear();
+            for(uint32_t tokenIdx = 1; tokenIdx < _maxTokens; tokenIdx++)
+            {
+                _freeTokens.push_back(&_tokens[tokenIdx]);
+            }
+            _nextSequence = 0;
+            _isInputBusy = true;
+            _isInputFinished = false;
+            for(auto stage : _stages)
+            {
+                stage->_nextSequence = 0;
+            }
+
+            _rootTask = _taskSystem->BeginAdd(WorkItem::Empty());
+            AddTokenTask(&_tokens[0], INPUT_STAGE, false);
+            _taskSystem->FinishAdd(_rootTask);
+            return _rootTask;
+        }
+
+    private:
+        static const uint32_t INPUT_STAGE = UINT32_MAX;
+
+        // Each on its own cache line, so threads working on neighbouring tokens don't share one
+        struct alignas(FL_CACHE_LINE_SIZE) Token
+        {
+            TokenType _value;
+            // The order the input stage read it in
+            uint64_t _sequence;
+        };
+
+        struct alignas(FL_CACHE_LINE_SIZE) Stage
+        {
+            Stage(PipelineStageMode mode, StageFunc stageFunc, uint32_t maxTokens)
+                : _mode(mode)
+                , _stageFunc(std::move(stageFunc))
+                , _mutex()
+                , _isBusy(false)
+                , _nextSequence(0)
+                , _waitingTokens(mode != PipelineStageMode::Parallel ? maxTokens : 0u, nullptr)
+                , _firstWaitingIdx(0)
+                , _numWaiting(0)
+            {
+            }
+
+            PipelineStageMode _mode;
+            StageFunc _stageFunc;
+            // The rest is only used by serial stages
+            std::mutex _mutex;
+            bool _isBusy;
+            // In order, the sequence of the token allowed in next
+            uint64_t _nextSequence;
+            // In order, indexed by sequence. Every token from _nextSequence onwards is still
+            // in flight, so no two waiting tokens ever share a slot. Out of order, a FIFO
+            std::vector<Token*> _waitingTokens;
+            uint32_t _firstWaitingIdx;
+            uint32_t _numWaiting;
+        };
+
+        void AddTokenTask(Token* token, uint32_t stageIdx, bool isInStage)
+        {
+            auto taskId = _taskSystem->BeginAdd(_taskSystem->WorkItemWithTaskAllocator([this, token, stageIdx, isInStage](void*){
+                RunToken(token, stageIdx, isInStage);
+            }));
+            // Only ever added by the task that added Run's task, or by another token's task,
+            // so the root is always still open
+            _taskSystem->AddChild(_rootTask, taskId);
+            _taskSystem->FinishAdd(taskId);
+        }
+
+        // Carries the token on from stageIdx until it has to wait at a serial stage. isInStage
+        // is true if it has already been let into the serial stage stageIdx
+        void RunToken(Token* token, uint32_t stageIdx, bool isInStage)
+        {
+            while(true)
+            {
+                if(stageIdx == INPUT_STAGE)
+                {
+                    if(!ReadInput(token))
+                    {
+                        return;
+                    }
+                    stageIdx = 0;
+                }
+                if(stageIdx == _stages.size())
+                {
+                    if(!ReleaseToken(token))
+                    {
+                        return;
+                    }
+                    stageIdx = INPUT_STAGE;
+                    continue;
+                }
+
+                auto stage = _stages[stageIdx];
+                if(stage->_mode == PipelineStageMode::Parallel)
+                {
+                    stage->_stageFunc(token->_value);
+                }
+                else
+                {
+                    if(!isInStage && !EnterSerialStage(stage, token))
+                    {
+                        return;
+                    }
+                    isInStage = false;
+                    stage->_stageFunc(token->_value);
+                    auto waitingToken = LeaveSerialStage(stage);
+                    if(waitingToken != nullptr)
+                    {
+                        AddTokenTask(waitingToken, stageIdx, true);
+                    }
+                }
+                stageIdx++;
+            }
+        }
+
+        // Runs the input stage on the token, which has the input stage to itself.
+        // Returns false if there was nothing left to read
+        bool ReadInput(Token* token)
+        {
+            if(!_inputFunc(token->_value))
+            {
+                std::lock_guard<std::mutex> lock(_inputMutex);
+                _isInputFinished = true;
+                _freeTokens.push_back(token);
+                return false;
+            }
+            token->_sequence = _nextSequence++;
+
+            // Hand the input stage on to a free token, so the next item is read while this one carries on
+            Token* freeToken = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(_inputMutex);
+                if(!_freeTokens.empty())
+                {
+                    freeToken = _freeTokens.back();
+                    _freeTokens.pop_back();
+                }
+                else
+                {
+                    _isInputBusy = false;
+                }
+            }
+            if(freeToken != nullptr)
+            {
+                AddTokenTask(freeToken, INPUT_STAGE, false);
+            }
+            return true;
+        }
+
+        // Called once the token has been through every stage. Returns true if the token
+        // should go straight on to read the next item, as the input stage was waiting for one
+        bool ReleaseToken(Token* token)
+        {
+            std::lock_guard<std::mutex> lock(_inputMutex);
+            if(!_isInputBusy && !_isInputFinished)
+            {
+                _isInputBusy = true;
+                return true;
+            }
+            _freeTokens.push_back(token);
+            return false;
+        }
+
+        // Returns false if the token has to wait for the token in the stage to let it in
+        bool EnterSerialStage(Stage* stage, Token* token)
+        {
+            std::lock_guard<std::mutex> lock(stage->_mutex);
+            if(stage->_mode == PipelineStageMode::SerialInOrder)
+            {
+                if(!stage->_isBusy && token->_sequence == stage->_nextSequence)
+                {
+                    stage->_isBusy = true;
+                    return true;
+                }
+                stage->_waitingTokens[token->_sequence % _maxTokens] = token;
+                return false;
+            }
+            if(!stage->_isBusy)
+            {
+                stage->_isBusy = true;
+                return true;
+            }
+            stage->_waitingTokens[(stage->_firstWaitingIdx + stage->_numWaiting) % _maxTokens] = token;
+            stage->_numWaiting++;
+            return false;
+        }
+
+        // Returns the waiting token to let into the stage next, which is already counted as in it
+        Token* LeaveSerialStage(Stage* stage)
+        {
+            std::lock_guard<std::mutex> lock(stage->_mutex);
+            Token* nextToken = nullptr;
+            if(stage->_mode == PipelineStageMode::SerialInOrder)
+            {
+                stage->_nextSequence++;
+                auto& waitingToken = stage->_waitingTokens[stage->_nextSequence % _maxTokens];
+                nextToken = waitingToken;
+                waitingToken = nullptr;
+            }
+            else if(stage->_numWaiting != 0)
+            {
+                nextToken = stage->_waitingTokens[stage->_firstWaitingIdx];
+                stage->_firstWaitingIdx = (stage->_firstWaitingIdx + 1u) % _maxTokens;
+                stage->_numWaiting--;
+            }
+            stage->_isBusy = nextToken != nullptr;
+            return nextToken;
+        }
+
+        uint32_t _maxTokens;
+        Memory::IAllocator* _tokenAllocator;
+        Token* _tokens;
+        InputFunc _inputFunc;
+        TaskSystem* _taskSystem;
+        std::vector<Stage*> _stages;
+        TaskId _rootTask;
+        // Guards the free tokens, and which token has the input stage
+        std::mutex _inputMutex;
+        std::vector<Token*> _freeTokens;
+        // Only touched by the token with the input stage
+        uint64_t _nextSequence;
+        bool _isInputBusy;
+        bool _isInputFinished;
+    };
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Platform/PlatformFeatures.h"
+#include "Task/Task.h"
+#include "Task/TaskQueue.h"
+
+namespace Flourish
+{
+    // One TaskQueue for each TaskPriority. The same threading rules as TaskQueue
+    // apply, Push, Pop and the priority order are for the owning thread only,
+    // Steal can be called from any thread.
+    //
+    // To stop lower priorities starving, the owner counts how many tasks it has
+    // executed since it last executed a task of each priority. Once that reaches
+    // MAXIMUM_TASKS_BEFORE_AGING the priority is moved to the front of the order
+    // until it gets to execute something
+    class PriorityTaskQueue
+    {
+    public:
+        static constexpr uint32_t MAXIMUM_TASKS_BEFORE_AGING = 32u;
+
+        // Each priority's queue allocates its tasks from the allocator
+        explicit PriorityTaskQueue(Memory::IAllocator* allocator);
+
+        // Pushes to the queue for the task's priority
+        void Push(Task* task);
+        Task* Pop(TaskPriority priority);
+        Task* Steal(TaskPriority priority);
+        // Steals a task of the priority, and moves up to half of the rest of them into
+        // destination. Must be called on the thread that owns destination
+        Task* StealBatch(TaskPriority priority, PriorityTaskQueue* destination);
+
+        // Fills in the order the owning thread should look for tasks in, aged priorities first
+        void GetPriorityOrder(TaskPriority (&order)[NUM_TASK_PRIORITIES]) const;
+
+        // Whether the priority has gone MAXIMUM_TASKS_BEFORE_AGING tasks without executing
+        bool IsAged(TaskPriority priority) const
+        {
+            return _tasksSinceExecuted[static_cast<uint32_t>(priority)] >= MAXIMUM_TASKS_BEFORE_AGING;
+        }
+
+        // Called by the owning thread every time it executes a task
+        void OnTaskExecuted(TaskPriority priority);
+
+        // Called by the owning thread when it couldn't find a task of this priority
+        // anywhere, so an empty priority doesn't stay at the front of the order
+        void OnNoTaskFound(TaskPriority priority);
+
+    private:
+        // Each queue is a whole number of cache lines, so stealing from one priority
+        // doesn't take lines away from the owner's other queues
+        TaskQueue _queues[NUM_TASK_PRIORITIES];
+        uint32_t _tasksSinceExecuted[NUM_TASK_PRIORITIES];
+    };
+
+    static_assert(alignof(TaskQueue) >= FL_CACHE_LINE_SIZE && sizeof(TaskQueue) % FL_CACHE_LINE_SIZE == 0, "Queues of different priorities must not share a cache line");
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace Flourish
+{
+    // A splitter decides how ParallelFor divides its data up. Every splitter has
+    //
+    //     bool ShouldSplit(DataType* data, uint32_t dataCount)
+    //
+    // and can optionally have
+    //
+    //     uint32_t GetSplitCount(DataType* data, uint32_t dataCount)
+    //         The number of elements that go in the left half of a split, instead of half
+    //     void OnLeafExecuted(DataType* data, uint32_t dataCount, std::chrono::nanoseconds duration)
+    //         Called after every leaf with how long it took. Leaves are only timed if this exists
+    //
+    // These helpers call the optional functions if the splitter has them
+    namespace SplitterTraits
+    {
+        template<typename Splitter, typename DataType, typename = void>
+        struct HasGetSplitCount : std::false_type {};
+
+        template<typename Splitter, typename DataType>
+        struct HasGetSplitCount<Splitter, DataType, std::void_t<decltype(std::declval<Splitter&>().GetSplitCount(std::declval<DataType*>(), uint32_t()))>> : std::true_type {};
+
+        template<typename Splitter, typename DataType, typename = void>
+        struct HasOnLeafExecuted : std::false_type {};
+
+        template<typename Splitter, typename DataType>
+        struct HasOnLeafExecuted<Splitter, DataType, std::void_t<decltype(std::declval<Splitter&>().OnLeafExecuted(std::declval<DataType*>(), uint32_t(), std::chrono::nanoseconds()))>> : std::true_type {};
+
+        template<typename Splitter, typename DataType>
+        uint32_t GetSplitCount(Splitter* splitter, DataType* data, uint32_t dataCount)
+        {
+            if constexpr (HasGetSplitCount<Splitter, DataType>::value)
+            {
+                return splitter->GetSplitCount(data, dataCount);
+            }
+            else
+            {
+                (void)splitter;
+                (void)data;
+                return dataCount / 2u;
+            }
+        }
+
+        template<typename Splitter, typename DataType, typename WorkFunc>
+        void RunLeaf(Splitter* splitter, const WorkFunc& workFunc, DataType* data, uint32_t dataCount)
+        {
+            if constexpr (HasOnLeafExecuted<Splitter, DataType>::value)
+            {
+                auto start = std::chrono::steady_clock::now();
+                workFunc(data, dataCount);
+                splitter->OnLeafExecuted(data, dataCount, std::chrono::steady_clock::now() - start);
+            }
+            else
+            {
+                (void)splitter;
+                workFunc(data, dataCount);
+            }
+        }
+    }
+}
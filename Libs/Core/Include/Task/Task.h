@@ -1,56 +1,96 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <functional>
+
+#include "Platform/PlatformFeatures.h"
+#include "Task/WorkItem.h"
 
 namespace Flourish
 {
-    typedef std::function<void(void*)> WorkItemFunction;
+    class TaskGroup;
+
     typedef uint32_t TaskId;
 
 	const TaskId INVALID_TASK_ID = UINT32_MAX;
-    
-    // A work item is a function and some data
-    // it is assumed that the function knows what
-    // to do with the void* data
-    struct WorkItem
+
+    // Tasks are executed in priority order, although lower priorities are still
+    // run now and again so they are never starved completely
+    enum class TaskPriority : uint8_t
     {
-    public:
-        WorkItemFunction _function;
-        void* _data;
-        
-        WorkItem(WorkItemFunction function, void* data)
+        High,
+        Normal,
+        Background
+    };
+
+    const uint32_t NUM_TASK_PRIORITIES = 3;
+
+    // Which thread a task has to run on. Thread 0 is the thread that created the
+    // TaskManager (the main thread), and the workers are 1 to TaskManager::GetNumThreads()
+    struct ThreadAffinity
+    {
+        static const uint32_t ANY_THREAD = UINT32_MAX;
+
+        static ThreadAffinity AnyThread()
         {
-            _function = std::move(function);
-            _data = data;
+            return ThreadAffinity{ ANY_THREAD };
         }
-        
-        WorkItem(WorkItemFunction function)
-            : WorkItem(std::move(function), nullptr)
+
+        static ThreadAffinity MainThread()
         {
+            return ThreadAffinity{ 0 };
         }
-        
-        static WorkItem Empty()
+
+        static ThreadAffinity Thread(uint32_t threadIdx)
         {
-            return WorkItem([](void*){});
+            return ThreadAffinity{ threadIdx };
         }
-        
-        void operator()()
+
+        bool IsAnyThread() const
         {
-            _function(_data);
+            return _threadIdx == ANY_THREAD;
         }
+
+        uint32_t _threadIdx;
     };
 
-    struct Task
+    // An edge in the dependency graph. Each task keeps a singly linked list of
+    // these, one for every task that can't start until it has finished
+    struct TaskDependency
     {
-        TaskId _id;
-        WorkItem _workItem;
+        TaskId _dependent;
+        uint32_t _next;
+    };
+
+    // Laid out by who writes to it. The first cache line holds the atomics other threads
+    // change while the task is in flight, as its children and dependencies finish and
+    // tasks are made to depend on it. Everything else is written by the thread adding
+    // the task before it's queued, and after that only read, so it starts on the next
+    // line. The executing thread (and anyone looking the task up by id) then never
+    // has its lines taken away by those writes, and as every task is a whole number
+    // of lines, neither does the task next to it in the pool
+    struct alignas(FL_CACHE_LINE_SIZE) Task
+    {
+        std::atomic_uint _openWorkItems;
+        // The number of tasks that have to finish before this one can start, plus
+        // one that is released by FinishAdd
+        std::atomic_uint _unfinishedDependencies;
+        // The id of the task in the high bits and the index of the first
+        // TaskDependency in the low bits, see TaskManager::AddDependency
+        std::atomic<uint64_t> _dependents;
+        // Links the task into a TaskInjectionQueue (or a thread's mailbox, which is one too)
+        std::atomic<Task*> _nextInjected;
+
+        // Only changed when the slot is reused
+        alignas(FL_CACHE_LINE_SIZE) std::atomic<TaskId> _id;
         TaskId _parentId;
+        TaskPriority _priority;
         bool _added;
-        std::atomic_uint _openWorkItems;
-        TaskId _dependency;
-        uint8_t padding[24];
+        ThreadAffinity _threadAffinity;
+        // Set if the task was added through a TaskGroup
+        TaskGroup* _group;
+        WorkItem _workItem;
         
         Task()
             : Task(WorkItem::Empty())
@@ -59,14 +99,23 @@ namespace Flourish
         }
         
         Task(const WorkItem& workItem)
-            : _id(0)
-            , _workItem(workItem)
+            : _openWorkItems(1)
+            , _unfinishedDependencies(1)
+            , _dependents(0)
+            , _nextInjected(nullptr)
+            , _id(0)
             , _parentId(0)
+            , _priority(TaskPriority::Normal)
             , _added(false)
-            , _openWorkItems(1)
-            , _dependency(0)
+            , _threadAffinity(ThreadAffinity::AnyThread())
+            , _group(nullptr)
+            , _workItem(workItem)
         {
-            _workItem = workItem;
+            
         }
     };
+
+    static_assert(alignof(Task) == FL_CACHE_LINE_SIZE && sizeof(Task) % FL_CACHE_LINE_SIZE == 0, "Tasks in the pool must each start on their own cache line");
+    static_assert(offsetof(Task, _nextInjected) + sizeof(Task::_nextInjected) <= FL_CACHE_LINE_SIZE, "The atomics other threads write to must fit in the first cache line");
+    static_assert(offsetof(Task, _id) == FL_CACHE_LINE_SIZE, "Everything the executing thread reads must be off the first cache line");
 }
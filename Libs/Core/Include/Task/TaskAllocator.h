@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Memory/IAllocator.h"
+#include "Platform/PlatformFeatures.h"
+
+namespace Flourish
+{
+    // An allocator for task data, like work item functions too large to store inline,
+    // owned by one thread. Memory is handed out in blocks of a few fixed sizes, carved
+    // one after another out of chunks taken from the backing allocator. Freed blocks go
+    // on a list for their size, and chunks are only given back when the allocator is
+    // destroyed, so once a thread has warmed up adding tasks never touches the heap.
+    //
+    // Only the owning thread allocates from the chunks, without any locks or atomics.
+    // A block freed on another thread, which is most of them once tasks are stolen, is
+    // pushed on to a lock free list for its size, and the owner takes the whole list in
+    // one go when it runs out of blocks of that size.
+    //
+    // Other threads can allocate from it too, they just get memory from the backing
+    // allocator. So do allocations larger than MAX_BLOCK_SIZE
+    class TaskAllocator : public Memory::IAllocator
+    {
+    public:
+        static const size_t MIN_BLOCK_SIZE = 64u;
+        static const size_t MAX_BLOCK_SIZE = 4096u;
+        static const size_t CHUNK_SIZE = 64u * 1024u;
+
+        // backingAllocator must be thread safe and outlive the TaskAllocator
+        explicit TaskAllocator(Memory::IAllocator* backingAllocator);
+        // Blocks still allocated from the chunks are freed with them
+        ~TaskAllocator() override;
+
+        TaskAllocator(const TaskAllocator&) = delete;
+        TaskAllocator& operator=(const TaskAllocator&) = delete;
+
+        // Makes the current thread the owner of the allocator. A thread owns one
+        // allocator at a time, nullptr gives it up
+        static void SetOwnedByCurrentThread(TaskAllocator* allocator);
+
+        void* Alloc(size_t size, const Debug::SourceInfo& sourceInfo) override;
+        // Can be called from any thread
+        void Free(void* ptr) override;
+        size_t GetAllocationSize(void* ptr) override;
+        size_t GetMetaDataAllocationSize(void* ptr) override;
+
+        // The number of chunks taken from the backing allocator
+        uint32_t GetNumChunks() const
+        {
+            return static_cast<uint32_t>(_chunks.size());
+        }
+
+    private:
+        // MIN_BLOCK_SIZE, doubling up to MAX_BLOCK_SIZE
+        static const uint32_t NUM_SIZE_CLASSES = 7u;
+        // Allocated from the backing allocator instead of a chunk
+        static const uint32_t BACKING_SIZE_CLASS = NUM_SIZE_CLASSES;
+
+        // In front of every allocation
+        struct alignas(alignof(std::max_align_t)) BlockHeader
+        {
+            union
+            {
+                // While the block is on a free list
+                BlockHeader* _next;
+                // For blocks from the backing allocator
+                size_t _size;
+            };
+            uint32_t _sizeClass;
+        };
+
+        static uint32_t GetSizeClass(size_t size)
+        {
+            uint32_t sizeClass = 0;
+            while(sizeClass < NUM_SIZE_CLASSES && size > (MIN_BLOCK_SIZE << sizeClass))
+            {
+                sizeClass++;
+            }
+            return sizeClass;
+        }
+
+        static TaskAllocator* GetOwnedByCurrentThread();
+        BlockHeader* AllocateFromBacking(size_t size);
+        BlockHeader* AllocateFromChunk(uint32_t sizeClass);
+
+        static thread_local TaskAllocator* _ownedByCurrentThread;
+
+        Memory::IAllocator* _backingAllocator;
+        // Only touched by the owner
+        BlockHeader* _freeBlocks[NUM_SIZE_CLASSES];
+        char* _chunkPosition;
+        char* _chunkEnd;
+        std::vector<void*> _chunks;
+        // Blocks freed by other threads, on their own cache line as every other thread writes to them
+        alignas(FL_CACHE_LINE_SIZE) std::atomic<BlockHeader*> _remoteFreeBlocks[NUM_SIZE_CLASSES];
+    };
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Flourish
+{
+    // Lock-free stack of indices into a fixed size array of slots. Used to
+    // hand out free slots from the task pools without taking a lock.
+    //
+    // The head is tagged with a counter that is bumped on every Pop, so if an
+    // index is popped and pushed back between another thread reading the head
+    // and doing its compare exchange (the ABA problem) the exchange will fail
+    class TaskFreeList
+    {
+    public:
+        static const uint32_t EMPTY = UINT32_MAX;
+
+        // Creates the free list with every index from 0 to capacity - 1 free.
+        // Lower indices are handed out first
+        explicit TaskFreeList(uint32_t capacity);
+        ~TaskFreeList();
+
+        TaskFreeList(const TaskFreeList&) = delete;
+        TaskFreeList& operator=(const TaskFreeList&) = delete;
+
+        // Returns a free index, or EMPTY if every index is in use
+        uint32_t Pop();
+
+        // Returns an index previously returned by Pop to the list
+        void Push(uint32_t index);
+
+        uint32_t GetCapacity() const
+        {
+            return _capacity;
+        }
+
+    private:
+        static uint64_t MakeHead(uint32_t index, uint32_t tag)
+        {
+            return (static_cast<uint64_t>(tag) << 32u) | index;
+        }
+
+        static uint32_t GetIndex(uint64_t head)
+        {
+            return static_cast<uint32_t>(head);
+        }
+
+        static uint32_t GetTag(uint64_t head)
+        {
+            return static_cast<uint32_t>(head >> 32u);
+        }
+
+        std::atomic<uint64_t> _head;
+        std::atomic<uint32_t>* _next;
+        uint32_t _capacity;
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Platform/PlatformFeatures.h"
+
+namespace Flourish
+{
+    // Lock-free queue of indices into a fixed size array of slots. Like TaskFreeList,
+    // but freed indices go to the back, so the slot freed longest ago is reused first
+    // instead of the same few being reused over and over.
+    //
+    // Each cell in the ring has a sequence number that says whether it's waiting for
+    // a Push or a Pop at the current position, so Push and Pop only have to claim a
+    // position with a compare exchange and then fill in or read the cell. As there
+    // are never more free indices than slots, a Push always finds room
+    class TaskFreeQueue
+    {
+    public:
+        static const uint32_t EMPTY = UINT32_MAX;
+
+        // Creates the queue with every index from 0 to capacity - 1 free.
+        // Lower indices are handed out first
+        explicit TaskFreeQueue(uint32_t capacity);
+        ~TaskFreeQueue();
+
+        TaskFreeQueue(const TaskFreeQueue&) = delete;
+        TaskFreeQueue& operator=(const TaskFreeQueue&) = delete;
+
+        // Returns the index that has been free the longest, or EMPTY if every index
+        // is in use. May also return EMPTY while another thread is part way through
+        // pushing the only free index
+        uint32_t Pop();
+
+        // Returns an index previously returned by Pop to the back of the queue
+        void Push(uint32_t index);
+
+        uint32_t GetCapacity() const
+        {
+            return _capacity;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<uint32_t> _sequence;
+            uint32_t _index;
+        };
+
+        // Positions are allowed to wrap, the ring is never big enough for it to matter
+        static int32_t Distance(uint32_t from, uint32_t to)
+        {
+            return static_cast<int32_t>(to - from);
+        }
+
+        // Pushed to and popped from by different threads, so on separate cache lines
+        alignas(FL_CACHE_LINE_SIZE) std::atomic<uint32_t> _pushPosition;
+        alignas(FL_CACHE_LINE_SIZE) std::atomic<uint32_t> _popPosition;
+        alignas(FL_CACHE_LINE_SIZE) Cell* _cells;
+        // The ring's size is the capacity rounded up to a power of 2
+        uint32_t _mask;
+        uint32_t _capacity;
+    };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Task/Task.h"
+#include "Task/TaskManager.h"
+
+namespace Flourish
+{
+    // A set of tasks that can be waited on, or cancelled, together. Tasks are added to
+    // the group by adding them through it rather than the TaskManager. It has the same
+    // functions for adding tasks as TaskManager, so it can be passed to ParallelFor and
+    // the other parallel algorithms as their task system, and every task they add is
+    // part of the group.
+    //
+    // Once cancelled, a task in the group that hasn't started is skipped (it finishes
+    // without running its work item), so a cancelled ParallelFor finishes as soon as the
+    // leaves already running have. Tasks that have started aren't stopped, long running
+    // ones can check IsCancelled.
+    //
+    // Tasks can be added from any thread until WaitAll is called, and from tasks in the
+    // group while it's waiting. The destructor waits for every task in the group
+    class TaskGroup
+    {
+    public:
+        explicit TaskGroup(TaskManager* taskManager);
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        TaskId BeginAdd(WorkItem workItem, TaskPriority priority = TaskPriority::Normal);
+        TaskId AddTaskWithNoChildrenOrDependencies(WorkItem workItem, TaskPriority priority = TaskPriority::Normal);
+
+        // The rest are the same as TaskManager's, so the group can be used as a task system
+
+        void AddDependency(TaskId root, TaskId dependent)
+        {
+            _taskManager->AddDependency(root, dependent);
+        }
+
+        void AddChild(TaskId parent, TaskId child)
+        {
+            _taskManager->AddChild(parent, child);
+        }
+
+        void FinishAdd(TaskId id)
+        {
+            _taskManager->FinishAdd(id);
+        }
+
+        void Wait(TaskId id)
+        {
+            _taskManager->Wait(id);
+        }
+
+        uint32_t GetNumThreads() const
+        {
+            return _taskManager->GetNumThreads();
+        }
+
+        uint32_t GetNumIdleThreads() const
+        {
+            return _taskManager->GetNumIdleThreads();
+        }
+
+        template<typename Callable>
+        WorkItem WorkItemWithTaskAllocator(Callable callable, void* data = nullptr)
+        {
+            return _taskManager->WorkItemWithTaskAllocator(std::move(callable), data);
+        }
+
+        // Tasks in the group that haven't started yet won't run. Can be called from any thread
+        void Cancel()
+        {
+            _cancelled.store(true, std::memory_order_relaxed);
+        }
+
+        bool IsCancelled() const
+        {
+            return _cancelled.load(std::memory_order_relaxed);
+        }
+
+        // Helps execute tasks until every task in the group has finished. The group can
+        // be used again afterwards, although once cancelled it stays cancelled
+        void WaitAll();
+
+    private:
+        friend class TaskManager;
+
+        // Called by the TaskManager when a task in the group has finished
+        void OnTaskFinished()
+        {
+            if(_numUnfinished.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                // Only WaitAll or the destructor can have let go of the group's own count,
+                // and they wait on this task, so the group is still alive
+                _taskManager->FinishAdd(_allFinishedTask);
+            }
+        }
+
+        TaskManager* _taskManager;
+        std::atomic_bool _cancelled;
+        // Every unfinished task in the group, plus one held by the group until it waits
+        std::atomic_uint _numUnfinished;
+        // Added once the count reaches zero, so waiting on it waits for the group
+        TaskId _allFinishedTask;
+    };
+}
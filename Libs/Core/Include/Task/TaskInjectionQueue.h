@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+
+#include "Task/Task.h"
+
+namespace Flourish
+{
+    // Lock-free queue that any thread can push tasks to, for threads that don't
+    // have a TaskQueue of their own. It's intrusive (tasks are linked through
+    // Task::_nextInjected) so pushing never allocates.
+    //
+    // Based on Dmitry Vyukov's intrusive MPSC queue. Push is wait-free and
+    // can be called from any number of threads. Pop is only safe from a single
+    // consumer at a time, so it takes a try-lock and returns nullptr if another
+    // thread is already popping. Pop can also return nullptr for a moment while
+    // a push is half done, the task will be returned by a later Pop
+    class TaskInjectionQueue
+    {
+    public:
+        TaskInjectionQueue();
+
+        TaskInjectionQueue(const TaskInjectionQueue&) = delete;
+        TaskInjectionQueue& operator=(const TaskInjectionQueue&) = delete;
+
+        void Push(Task* task);
+        Task* Pop();
+
+    private:
+        Task* PopWithLock();
+
+        std::atomic<Task*> _head;
+        Task* _tail;
+        std::atomic_flag _consumerLock;
+        // Always in the queue so the head and tail never have to be null
+        Task _stub;
+    };
+}
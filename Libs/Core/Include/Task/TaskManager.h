@@ -6,21 +6,70 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
 
+#include "Memory/Allocators/MallocAllocator.h"
+#include "Memory/MemoryArea.h"
+#include "Platform/PlatformFeatures.h"
+#include "Task/CpuTopology.h"
 #include "Task/Task.h"
+#include "Task/TaskAllocator.h"
+#include "Task/TaskFreeList.h"
+#include "Task/TaskInjectionQueue.h"
+#include "Task/TaskParkingLot.h"
+#include "Task/TaskPool.h"
 #include "Task/TaskThreadGate.h"
+#include "Task/TaskTimerWheel.h"
+#include "Task/TaskWaitTable.h"
+
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+#include "Task/TaskProfiler.h"
+#endif
 
 namespace Flourish
 {
-    class TaskQueue;
+    class Fiber;
+    class FiberPool;
+    class PriorityTaskQueue;
 	class TaskManager
 	{
 	public:
         
         static const int32_t AutomaticallyDetectNumThreads = -1;
-        static const uint32_t MaxConcurrentTasks = 4096;
         
-        TaskManager(int32_t numThreads = TaskManager::AutomaticallyDetectNumThreads);
+        // The number of tasks that can be in flight at once. If this many tasks
+        // are open, BeginAdd will help execute tasks until one finishes
+        static const uint32_t MaxConcurrentTasks = TaskPool::MAXIMUM_CAPACITY;
+        
+        // The number of dependencies between unfinished tasks that can exist at once.
+        // If this many are in use, AddDependency will help execute tasks until one is freed
+        static const uint32_t MaxConcurrentDependencies = MaxConcurrentTasks * 4;
+        
+        // How long Wait sleeps for when there's nothing to help with before looking
+        // for work again. It's woken as soon as the task finishes, this only
+        // matters if more work for any thread turns up while it's asleep, a task
+        // pinned to the waiting thread wakes it too
+        static constexpr std::chrono::microseconds MaxWaitSleepDuration = std::chrono::microseconds(1000);
+        
+        static const size_t DefaultFiberStackSize = 64 * 1024;
+        
+        // If numThreads is AutomaticallyDetectNumThreads, a worker is started for every CPU the
+        // process can run on but one, which is left for the thread creating the TaskManager, and
+        // each worker is pinned to its own CPU. Workers spread across cores before doubling up on
+        // SMT siblings. Workers given an explicit number of threads are left where the OS puts them.
+        //
+        // Workers steal from the queues of threads on the same core first, then the same cache or
+        // NUMA node, and only then from other nodes.
+        //
+        // idleSpinCount is how many times an idle worker checks for work before going to sleep.
+        //
+        // If fiberStackArea is given the worker threads run tasks on fibers, with stacks of
+        // fiberStackSize cut out of the memory area (see Wait). There must be room for more
+        // fibers than worker threads, and the memory area must outlive the TaskManager
+        TaskManager(int32_t numThreads = TaskManager::AutomaticallyDetectNumThreads, uint32_t idleSpinCount = TaskThreadGate<>::DEFAULT_SPIN_COUNT,
+                    Memory::MemoryArea* fiberStackArea = nullptr, size_t fiberStackSize = DefaultFiberStackSize);
 		~TaskManager();
 
 		TaskManager(TaskManager& other) = delete;
@@ -29,37 +78,247 @@ namespace Flourish
 		TaskManager(TaskManager&& other) = delete;
 		TaskManager& operator=(TaskManager&&) = delete;
 
-		TaskId BeginAdd(WorkItem workItem);
-        TaskId AddDependentTasks(TaskId root, std::vector<TaskId> dependencies);
+		TaskId BeginAdd(WorkItem workItem, TaskPriority priority = TaskPriority::Normal);
+        // Adds a task that only runs on the given thread. It goes in that thread's mailbox,
+        // which other threads never steal from. The thread checks its mailbox before looking
+        // for any other work, in the order tasks were added (the priority is ignored).
+        // Tasks for the main thread only run when it calls PumpMainThread, Wait or BeginAdd
+        // has to help. A pinned task that waits on a fiber helps instead of being put to
+        // one side, so it never carries on on another thread
+        TaskId BeginAdd(WorkItem workItem, ThreadAffinity threadAffinity, TaskPriority priority = TaskPriority::Normal);
+        // Makes every task in dependencies wait for root to finish, then finishes adding
+        // them. Returns root
+        TaskId AddDependentTasks(TaskId root, const std::vector<TaskId>& dependencies);
+        // Makes dependent wait for root to finish before it can start. Must be called
+        // before FinishAdd for dependent. If root has already finished this does nothing.
+        // No thread waits on root, dependent is queued by whichever thread finishes root
+        void AddDependency(TaskId root, TaskId dependent);
         void AddChild(TaskId parent, TaskId child);
         void FinishAdd(TaskId id);
-        TaskId AddTaskWithNoChildrenOrDependencies(WorkItem workItem);
+        TaskId AddTaskWithNoChildrenOrDependencies(WorkItem workItem, TaskPriority priority = TaskPriority::Normal);
+        // Adds a task that is queued once delay has passed. Like any other task it can be
+        // waited on or depended on, and it takes up one of the MaxConcurrentTasks until it
+        // has run. There is no timer thread, idle threads sleep until the next timer is due
+        // and whichever thread notices first queues it, so it's late by up to
+        // TaskTimerWheel::TICK_DURATION plus however long a thread takes to get to it
+        TaskId AddDelayed(WorkItem workItem, std::chrono::microseconds delay, TaskPriority priority = TaskPriority::Normal);
+        // Adds a task running a copy of workItem every period, the first a period from now,
+        // until CancelPeriodic is called. Periods that are missed because every thread was
+        // busy are skipped, rather than run back to back
+        TimerId AddPeriodic(WorkItem workItem, std::chrono::microseconds period, TaskPriority priority = TaskPriority::Normal);
+        // Stops the timer adding any more tasks. A task it has already added still runs
+        void CancelPeriodic(TimerId id);
+        // Helps execute tasks until the task has finished. If there is nothing to help
+        // with, sleeps until the task finishes.
+        //
+        // When running tasks on fibers, a task on a worker thread that waits is put to one
+        // side instead, and the worker carries on with other tasks on another fiber. Once the
+        // task it's waiting for finishes, the first worker to notice picks it back up. This
+        // means the rest of the task may run on a different thread, so it mustn't hold on to
+        // anything thread local across the Wait. If every fiber is in use it helps instead
 		void Wait(TaskId id);
+        // Runs tasks from the main thread's mailbox, and nothing else, until it's empty
+        // or budget has passed. A task that has started isn't stopped when the budget
+        // runs out. Must be called on the thread that created the TaskManager.
+        // Returns the number of tasks run
+        uint32_t PumpMainThread(std::chrono::microseconds budget);
+        // Returns true once the task has finished. An id that refers to a task that
+        // finished a long time ago (so its slot has been reused) is also complete
+        bool IsComplete(TaskId id);
+        // The number of worker threads, not counting the thread that created the TaskManager
+        uint32_t GetNumThreads() const
+        {
+            return _numThreads;
+        }
+        // The number of threads that are waiting for work right now
+        uint32_t GetNumIdleThreads() const
+        {
+            return _numIdleThreads.load(std::memory_order_relaxed);
+        }
+        // Whether a thread with a queue of its own steals up to half of another thread's
+        // tasks at once, which is the default, or one at a time. Can be changed at any time
+        void SetStealsBatches(bool stealsBatches)
+        {
+            _stealsBatches.store(stealsBatches, std::memory_order_relaxed);
+        }
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+        // What every thread with a queue has been doing. Collect or write it out from one
+        // thread at a time. Threads without a queue of their own aren't recorded
+        TaskProfiler* GetProfiler()
+        {
+            return _profiler;
+        }
+#endif
+        // Creates a work item for the callable. Small callables are stored inline in
+        // the work item, larger ones are stored using the current thread's TaskAllocator
         template<typename Callable>
         WorkItem WorkItemWithTaskAllocator(Callable callable, void* data = nullptr)
         {
-            // TODO: Make this use an allocator
-            return WorkItem(WorkItemFunction(callable), data);
+            return WorkItem(std::move(callable), data, GetCurrentThreadAllocator());
         }
 
 	private:
-        void CreateTasks();
+        friend class TaskGroup;
+
 		void CreateAndStartWorkerThreads();
 		void WorkerThreadFunc(int32_t threadIdx);
-        void WaitForTaskAndExecute(std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
-        int32_t GetIdealNumThreads();
+        void WaitForTaskAndExecute(std::chrono::microseconds timeout = std::chrono::microseconds::zero());
+        int32_t GetIdealNumThreads(const CpuTopology& topology);
+        void ExecuteTask(Task* task);
         Task* GetTaskToExecute();
+        // Looks for a task of the priority on every queue but the current thread's own
+        Task* StealTaskToExecute(TaskPriority priority);
+        Task* GetTaskFromCurrentThreadMailbox();
+        Task* AllocateTask();
         Task* GetTaskFromId(TaskId id);
         void FinishTask(Task* task);
-        void CreateTaskQueueForCurrentThread(uint32_t threadIdx);
+        void QueueTask(Task* task);
+        void ReleaseDependency(Task* task);
+        void ReleaseDependents(Task* task);
+        uint32_t AllocateDependency();
+        void AddTimer(TaskTimerWheel::Timer* timer, std::chrono::microseconds delay);
+        // Queues the tasks for any timers that are due, unless another thread already is
+        void QueueDueTimers();
+        // Returns false if there are no timers
+        bool GetTimeUntilNextTimer(std::chrono::microseconds& timeUntilNextTimer);
+        
+        // What a thread does with the fiber it has just switched away from, once it's running
+        // on the new fiber. It can't be done before switching, as another thread could pick the
+        // fiber up and switch to it before the first thread has finished saving its state
+        enum class FiberAction : uint8_t
+        {
+            None,
+            Release,
+            Wait
+        };
+        
+        struct FiberThreadState;
+        
+        // The queues a thread steals from, nearest first. Queues the same distance away are
+        // tried starting from a random one, so thieves don't all go for the same victim
+        struct StealOrder
+        {
+            std::vector<uint32_t> _queueIndices;
+            // Where the queues at each distance end in _queueIndices
+            uint32_t _distanceEnds[NUM_CPU_DISTANCES];
+        };
+        
+        static constexpr uint32_t NO_CPU = UINT32_MAX;
+        
+        // threadCpus is the index in topology of the CPU each thread with a queue is pinned to, or NO_CPU
+        void CreateStealOrders(const CpuTopology& topology, const std::vector<uint32_t>& threadCpus);
+        static uint32_t GetRandomNumber();
+        
+        // Tasks pinned to one thread. Only that thread pops from its mailbox, so the
+        // injection queue's single consumer is never contended. _numTasks is counted up
+        // before a push and down after a pop, so a sleeping owner can tell it has work
+        struct alignas(FL_CACHE_LINE_SIZE) ThreadMailbox
+        {
+            ThreadMailbox()
+                : _queue()
+                , _numTasks(0)
+                , _parkingSpot()
+                , _waitingOn(INVALID_TASK_ID)
+            {
+            }
+            
+            TaskInjectionQueue _queue;
+            std::atomic_uint _numTasks;
+            // Where the owning thread sleeps at the gate, so a task pinned to it wakes only it
+            TaskParkingLot::Spot _parkingSpot;
+            // The task the owning thread is sleeping in Wait for, so a task pinned to it can wake it
+            std::atomic<TaskId> _waitingOn;
+        };
+        
+        struct WaitingFiber
+        {
+            Fiber* _fiber;
+            TaskId _waitingOn;
+        };
+        
+        static void FiberMain(void* taskManager);
+        void RunWorkerFibers(uint32_t threadIdx);
+        void RunFiberLoop();
+        void WaitOnFiber(TaskId id);
+        bool ResumeWaitingFiber(FiberAction currentFiberAction, TaskId waitingOn);
+        void SwitchToFiber(Fiber* fiber, FiberAction currentFiberAction, TaskId waitingOn);
+        void FinishFiberSwitch();
+        static FiberThreadState* GetCurrentFiberThreadState();
+        // Everything about the current thread is read through these, see GetCurrentThreadTaskQueue
+        static PriorityTaskQueue* GetCurrentThreadTaskQueue();
+        static ThreadMailbox* GetCurrentThreadMailbox();
+        static StealOrder* GetCurrentThreadStealOrder();
+        static uint32_t& GetCurrentThreadRandomState();
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+        static TaskEventRing* GetCurrentThreadEventRing();
+#endif
+        
+        static const uint32_t NO_DEPENDENTS = TaskFreeList::EMPTY;
+        static const uint32_t DEPENDENTS_CLOSED = TaskFreeList::EMPTY - 1;
+        
+        static uint64_t MakeDependentsHead(TaskId id, uint32_t firstDependency)
+        {
+            return (static_cast<uint64_t>(id) << 32u) | firstDependency;
+        }
+        
+        static TaskId GetDependentsOwner(uint64_t head)
+        {
+            return static_cast<TaskId>(head >> 32u);
+        }
+        
+        static uint32_t GetFirstDependency(uint64_t head)
+        {
+            return static_cast<uint32_t>(head);
+        }
+        void SetTaskQueueForCurrentThread(uint32_t threadIdx);
+        Memory::IAllocator* GetCurrentThreadAllocator();
         
-        std::atomic_uint _nextTaskId;
-        Task* _allTasks;
+        // Where the thread allocators get their chunks from, and what threads without a queue allocate from
+        Memory::MallocAllocator _heapAllocator;
+        // One for every thread with a queue. Declared before the task pool so any work
+        // items left in it are destroyed before the allocators they were allocated from
+        std::vector<std::unique_ptr<TaskAllocator>> _threadAllocators;
+        static thread_local Memory::IAllocator* _currentThreadAllocator;
+        TaskPool _taskPool;
+        TaskDependency* _dependencies;
+        TaskFreeList _dependencyFreeList;
         uint32_t _numThreads;
 		std::thread* _workerThreads;
-        TaskQueue** _taskQueues;
-        static thread_local TaskQueue* _currentThreadTaskQueue;
-        TaskThreadGate<std::condition_variable> _taskThreadGate;
+        PriorityTaskQueue** _taskQueues;
+        static thread_local PriorityTaskQueue* _currentThreadTaskQueue;
+        // One for every thread with a queue, indexed the same way, plus one for every other thread
+        StealOrder* _stealOrders;
+        static thread_local StealOrder* _currentThreadStealOrder;
+        static thread_local uint32_t _currentThreadRandomState;
+        // The CPU each worker pins itself to. Empty if they aren't pinned
+        std::vector<LogicalCpu> _workerCpus;
+        // One for every thread with a queue, indexed the same way
+        ThreadMailbox* _mailboxes;
+        static thread_local ThreadMailbox* _currentThreadMailbox;
+        // Tasks queued by threads that don't have a queue of their own
+        TaskInjectionQueue _injectionQueues[NUM_TASK_PRIORITIES];
+        TaskThreadGate<TaskParkingLot> _taskThreadGate;
+        TaskWaitTable _taskWaitTable;
+        std::atomic_uint _numIdleThreads;
+        std::atomic_bool _stealsBatches;
         std::atomic_bool _exiting;
+        // Only set when running tasks on fibers
+        FiberPool* _fiberPool;
+        FiberThreadState* _fiberThreadStates;
+        static thread_local FiberThreadState* _currentFiberThreadState;
+        std::mutex _waitingFibersMutex;
+        std::vector<WaitingFiber> _waitingFibers;
+        std::atomic_uint _numWaitingFibers;
+        // Delayed and periodic tasks waiting for their time
+        std::mutex _timerMutex;
+        TaskTimerWheel _timerWheel;
+        std::unordered_map<TimerId, TaskTimerWheel::Timer*> _periodicTimers;
+        TimerId _nextTimerId;
+        // The wheel's next tick, so threads can check whether a timer might be due without the lock
+        std::atomic<uint64_t> _nextTimerTick;
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+        TaskProfiler* _profiler;
+        static thread_local TaskEventRing* _currentThreadEventRing;
+#endif
 	};
 }
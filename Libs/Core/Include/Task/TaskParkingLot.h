@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace Flourish
+{
+    // The wait mechanism TaskManager's TaskThreadGate sleeps on. A thread that has been
+    // given a spot sleeps on a condition variable of its own, so something only that
+    // thread can do, like running a task pinned to it, wakes it and no other thread.
+    // Threads without a spot share a condition variable.
+    //
+    // Like a condition variable's, the waits must be called with the gate's mutex
+    // locked, and so must the notifies, which a condition variable doesn't need
+    class TaskParkingLot
+    {
+    public:
+        struct Spot
+        {
+            Spot()
+                : _condition()
+                , _nextSleeping(nullptr)
+                , _notified(false)
+            {
+            }
+
+            std::condition_variable _condition;
+            Spot* _nextSleeping;
+            // Set by the notify_one that picked this spot, so another notify_one picks a different one
+            bool _notified;
+        };
+
+        TaskParkingLot();
+
+        TaskParkingLot(const TaskParkingLot&) = delete;
+        TaskParkingLot& operator=(const TaskParkingLot&) = delete;
+
+        // The spot the current thread sleeps on, or nullptr to share
+        static void SetCurrentThreadSpot(Spot* spot);
+
+        template<class Predicate>
+        void wait(std::unique_lock<std::mutex>& lock, Predicate predicate)
+        {
+            auto spot = GetCurrentThreadSpot();
+            if(spot == nullptr)
+            {
+                _sharedCondition.wait(lock, predicate);
+                return;
+            }
+            Park(spot);
+            while(!predicate())
+            {
+                spot->_condition.wait(lock);
+                spot->_notified = false;
+            }
+            Unpark(spot);
+        }
+
+        template<class Rep, class Period, class Predicate>
+        bool wait_for(std::unique_lock<std::mutex>& lock, const std::chrono::duration<Rep, Period>& duration, Predicate predicate)
+        {
+            auto spot = GetCurrentThreadSpot();
+            if(spot == nullptr)
+            {
+                return _sharedCondition.wait_for(lock, duration, predicate);
+            }
+            auto deadline = std::chrono::steady_clock::now() + duration;
+            Park(spot);
+            auto result = true;
+            while(!predicate())
+            {
+                if(spot->_condition.wait_until(lock, deadline) == std::cv_status::timeout)
+                {
+                    result = predicate();
+                    break;
+                }
+                spot->_notified = false;
+            }
+            Unpark(spot);
+            return result;
+        }
+
+        void notify_one();
+        void notify_all();
+        // Wakes the thread sleeping on spot, if there is one, to check its predicate again
+        void notify(Spot* spot);
+
+    private:
+        static Spot* GetCurrentThreadSpot();
+        void Park(Spot* spot);
+        void Unpark(Spot* spot);
+
+        std::condition_variable _sharedCondition;
+        // Every spot with a thread asleep on it
+        Spot* _sleepingSpots;
+        static thread_local Spot* _currentThreadSpot;
+    };
+}
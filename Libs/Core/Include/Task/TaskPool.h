@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Task/Task.h"
+#include "Task/TaskFreeQueue.h"
+
+namespace Flourish
+{
+    // Owns the storage for every task in the TaskManager and hands out free
+    // slots from a lock-free queue.
+    //
+    // A TaskId encodes both the index of the slot and the generation of the slot,
+    // which is bumped every time it's reused. This means an id that outlives its
+    // task is detected as stale, instead of silently referring to whatever task
+    // is now using the slot.
+    //
+    // Generations do wrap eventually, and an id held across that many reuses of its
+    // slot would refer to a live task again. The index only takes the bits it needs,
+    // leaving the rest for the generation, and slots are reused oldest first rather
+    // than the same hot slot every time. So with capacity slots free an id is only
+    // at risk after about capacity * MAXIMUM_GENERATION allocations, around 4 billion
+    // for the TaskManager's pool. With most slots in flight that shrinks towards
+    // MAXIMUM_GENERATION reuses of the few free ones
+    class TaskPool
+    {
+    public:
+        // Enough for TaskManager::MaxConcurrentTasks, which is defined from this
+        static const uint32_t INDEX_BITS = 12u;
+        static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1u;
+        static const uint32_t MAXIMUM_CAPACITY = 1u << INDEX_BITS;
+
+        // Generations wrap before reaching the maximum so that a valid id can
+        // never be INVALID_TASK_ID. Generation 0 is never used, so a valid id
+        // can never be 0 either
+        static const uint32_t MAXIMUM_GENERATION = (UINT32_MAX >> INDEX_BITS) - 1u;
+
+        explicit TaskPool(uint32_t capacity);
+        ~TaskPool();
+
+        TaskPool(const TaskPool&) = delete;
+        TaskPool& operator=(const TaskPool&) = delete;
+
+        // Returns a free task with a new id, or nullptr if all the tasks are in use
+        Task* Allocate();
+
+        // Returns the task to the pool. Its id stays stale until the slot is reused
+        void Free(Task* task);
+
+        // Returns the task with this id, or nullptr if the id is invalid or stale
+        Task* GetTask(TaskId id);
+
+        uint32_t GetCapacity() const
+        {
+            return _freeList.GetCapacity();
+        }
+
+        static uint32_t GetIndex(TaskId id)
+        {
+            return id & INDEX_MASK;
+        }
+
+        static uint32_t GetGeneration(TaskId id)
+        {
+            return id >> INDEX_BITS;
+        }
+
+    private:
+        static TaskId MakeId(uint32_t index, uint32_t generation)
+        {
+            return (generation << INDEX_BITS) | index;
+        }
+
+        Task* _tasks;
+        TaskFreeQueue _freeList;
+    };
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Platform/PlatformFeatures.h"
+#include "Task/Task.h"
+
+#if FL_ENABLED(FL_CPU_ARCH_X86)
+    #if FL_ENABLED(FL_COMPILER_MSVC)
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+#endif
+
+namespace Flourish
+{
+    enum class TaskEventType : uint8_t
+    {
+        // A task was put on a queue or in a mailbox, ready to run
+        Enqueue,
+        Begin,
+        End,
+        // A task was taken from another thread's queue
+        Steal,
+        // The thread went to sleep, waiting for work or for a task to finish
+        Park,
+        Unpark
+    };
+
+    struct TaskEvent
+    {
+        uint64_t _timestamp;
+        // INVALID_TASK_ID for parks that aren't waiting on a task
+        TaskId _taskId;
+        // The thread a task was stolen from
+        uint16_t _otherThreadIdx;
+        TaskEventType _type;
+    };
+
+    // Events recorded by one thread, and collected by another. Neither takes a lock.
+    // When the ring is full new events are dropped (and counted), rather than
+    // overwriting ones the collector might be reading
+    class TaskEventRing
+    {
+    public:
+        // Must be a power of 2
+        explicit TaskEventRing(uint32_t capacity);
+        ~TaskEventRing();
+
+        TaskEventRing(const TaskEventRing&) = delete;
+        TaskEventRing& operator=(const TaskEventRing&) = delete;
+
+        // Only called by the thread that owns the ring
+        void Record(TaskEventType type, TaskId taskId, uint32_t otherThreadIdx = 0)
+        {
+            auto numWritten = _numWritten.load(std::memory_order_relaxed);
+            if(numWritten - _cachedNumRead >= _capacity)
+            {
+                // Might be full, see how much has been collected since we last looked
+                _cachedNumRead = _numRead.load(std::memory_order_acquire);
+                if(numWritten - _cachedNumRead >= _capacity)
+                {
+                    _numDropped.store(_numDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            auto& event = _events[numWritten & (_capacity - 1u)];
+            event._timestamp = GetTimestamp();
+            event._taskId = taskId;
+            event._otherThreadIdx = static_cast<uint16_t>(otherThreadIdx);
+            event._type = type;
+            _numWritten.store(numWritten + 1, std::memory_order_release);
+        }
+
+        // Moves every event recorded so far onto the end of events. Only one thread
+        // can collect from a ring at once
+        void Collect(std::vector<TaskEvent>& events);
+
+        // How many events have been dropped because the ring was full
+        uint32_t GetNumDropped() const
+        {
+            return _numDropped.load(std::memory_order_relaxed);
+        }
+
+        // The cycle counter where there is one, so recording is as cheap as possible.
+        // TaskProfiler works out how long a tick is when it writes the trace
+        static uint64_t GetTimestamp()
+        {
+#if FL_ENABLED(FL_CPU_ARCH_X86)
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+        }
+
+    private:
+        TaskEvent* _events;
+        uint32_t _capacity;
+        // Written by the owner
+        alignas(FL_CACHE_LINE_SIZE) std::atomic_uint _numWritten;
+        uint32_t _cachedNumRead;
+        std::atomic_uint _numDropped;
+        // Written by the collector
+        alignas(FL_CACHE_LINE_SIZE) std::atomic_uint _numRead;
+    };
+
+    // An event ring for every thread with a task queue, and the events collected from them
+    // so far. The events can be written out as a Chrome trace, which can be opened in
+    // chrome://tracing or ui.perfetto.dev. TaskManager records into one when
+    // FL_TASK_PROFILING_ENABLED is on (see FlourishConfig.h)
+    class TaskProfiler
+    {
+    public:
+        static const uint32_t DEFAULT_EVENTS_PER_THREAD = 64u * 1024u;
+
+        // Thread 0 is the thread that created the TaskManager, like ThreadAffinity
+        TaskProfiler(uint32_t numThreads, uint32_t eventsPerThread = DEFAULT_EVENTS_PER_THREAD);
+        ~TaskProfiler();
+
+        TaskProfiler(const TaskProfiler&) = delete;
+        TaskProfiler& operator=(const TaskProfiler&) = delete;
+
+        uint32_t GetNumThreads() const
+        {
+            return _numThreads;
+        }
+
+        TaskEventRing* GetRing(uint32_t threadIdx)
+        {
+            return _rings[threadIdx];
+        }
+
+        // Takes everything recorded so far out of the rings, so they have room for more.
+        // Only one thread can collect at once
+        void Collect();
+
+        const std::vector<TaskEvent>& GetEvents(uint32_t threadIdx) const
+        {
+            return _events[threadIdx];
+        }
+
+        uint32_t GetNumDropped() const;
+
+        // Collects, then appends every event collected so far to json as a Chrome trace.
+        // Tasks are spans on the thread that ran them, with how long they were queued for,
+        // and sleeping threads are shown as idle. A task that waits on a fiber and carries
+        // on on another thread is cut short on the first thread
+        void WriteChromeTrace(std::string& json);
+
+        // Forgets every event collected so far
+        void Clear();
+
+    private:
+        double GetTicksPerMicrosecond() const;
+
+        uint32_t _numThreads;
+        TaskEventRing** _rings;
+        std::vector<TaskEvent>* _events;
+        // When the profiler was created, by both clocks, so ticks can be turned into time
+        uint64_t _startTimestamp;
+        int64_t _startTimeNs;
+    };
+}
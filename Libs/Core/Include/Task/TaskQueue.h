@@ -1,32 +1,420 @@
 #pragma once
 
 #include <atomic>
+#include <cassert>
 #include <cstdint>
+#include <new>
+
+#include "Memory/IAllocator.h"
+#include "Memory/Memory.h"
+#include "Platform/PlatformFeatures.h"
 
 namespace Flourish
 {
     struct Task;
-    
+
+    // What BasicTaskQueue is built from. The tests swap these for atomics that let a
+    // model checker choose the order every operation happens in
+    struct DefaultTaskQueueTraits
+    {
+        template<typename T>
+        using Atomic = std::atomic<T>;
+
+        static const uint32_t MAXIMUM_STEAL_BATCH = 32u;
+
+        // The seq_cst fence the owner and the steals pair up on
+        static void SeqCstFence();
+    };
+
     // TaskQueue assumes that Push and Pop will only be called on the same
     // thread, (so Push and Pop cannot be called concurrently). However Steal
     // is assumed to be called on a different thread, so may be run concurrently
     // with either Pop, Push, or another Steal
-    class TaskQueue
+    //
+    // StealBatch takes up to half of the tasks (at most MAXIMUM_STEAL_BATCH) with a
+    // single compare and swap. To stop a batch taking a task Pop has already taken,
+    // Pop only skips the compare and swap when there are at least MAXIMUM_STEAL_BATCH
+    // tasks between it and the top of the queue
+    //
+    // The tasks are held in a circular array allocated from the allocator passed in.
+    // When Push finds it full it's replaced with one twice the size. A steal may still
+    // be reading the old array, so it's kept until the owner sees that no steals are
+    // running, and freed then
+    template<typename Traits>
+    class BasicTaskQueue
     {
     public:
-        static const uint32_t MAXIMUM_NUMBER_OF_TASKS = 4096u;
+        // Must be a power of 2, like any initial capacity passed in
+        static const uint32_t DEFAULT_INITIAL_CAPACITY = 256u;
+
+        static const uint32_t MAXIMUM_STEAL_BATCH = Traits::MAXIMUM_STEAL_BATCH;
+
+        explicit BasicTaskQueue(Memory::IAllocator* allocator, uint32_t initialCapacity = DEFAULT_INITIAL_CAPACITY);
+        ~BasicTaskQueue();
+
+        BasicTaskQueue(const BasicTaskQueue&) = delete;
+        BasicTaskQueue& operator=(const BasicTaskQueue&) = delete;
 
-		// Mask used for cheap modulo operators. Only works if MAXIMUM_NUMBER_OF_TASKS is a power of 2
-		static const uint32_t MASK = TaskQueue::MAXIMUM_NUMBER_OF_TASKS - 1u;
-        
-        TaskQueue();
         void Push(Task* task);
         Task* Pop();
         Task* Steal();
-        
+        // Steals the oldest task and returns it, and moves up to half of the rest into
+        // destination. Must be called on the thread that owns destination
+        Task* StealBatch(BasicTaskQueue* destination);
+
+        // How many tasks fit before the queue has to grow again. Only for the owning thread
+        uint32_t GetCapacity() const
+        {
+            return _array.load(std::memory_order_relaxed)->_capacity;
+        }
+
     private:
-        std::atomic_long _top;
-        std::atomic_long _bottom;
-        Task* _tasks[MAXIMUM_NUMBER_OF_TASKS];
+        template<typename T>
+        using Atomic = typename Traits::template Atomic<T>;
+
+        struct TaskArray
+        {
+            Atomic<Task*>& operator[](uint32_t index)
+            {
+                // The tasks follow straight after the header, and the capacity is a power of 2
+                return reinterpret_cast<Atomic<Task*>*>(this + 1)[index & (_capacity - 1u)];
+            }
+
+            uint32_t _capacity;
+            // Links arrays that have been replaced but may still be read by a steal
+            TaskArray* _nextRetired;
+        };
+
+        // Steals increment this before looking at the array, so once the owner has replaced
+        // the array and then seen this at zero, nothing can still be reading the old one
+        class StealScope
+        {
+        public:
+            explicit StealScope(BasicTaskQueue* queue)
+                : _queue(queue)
+            {
+                _queue->_numSteals.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            ~StealScope()
+            {
+                _queue->_numSteals.fetch_sub(1, std::memory_order_release);
+            }
+
+        private:
+            BasicTaskQueue* _queue;
+        };
+
+        // The top of the queue is packed with a tag in the high bits. Pop bumps the tag
+        // when it takes a task near the top, which makes any batch steal that read the
+        // top before then fail, as it may have read an out of date bottom
+        static uint64_t MakeTop(uint32_t tag, uint32_t index)
+        {
+            return (static_cast<uint64_t>(tag) << 32u) | index;
+        }
+
+        static uint32_t GetTag(uint64_t top)
+        {
+            return static_cast<uint32_t>(top >> 32u);
+        }
+
+        static uint32_t GetIndex(uint64_t top)
+        {
+            return static_cast<uint32_t>(top);
+        }
+
+        // Indices are allowed to wrap, the queue is never big enough for it to matter
+        static int32_t Distance(uint32_t from, uint32_t to)
+        {
+            return static_cast<int32_t>(to - from);
+        }
+
+        // A quick look, without counting a steal in or fencing, so a thief probing an empty
+        // queue only reads the owner's cache lines instead of writing to them. May be out of
+        // date, which is no worse than losing the race to take the last task
+        bool LooksEmpty() const
+        {
+            return Distance(GetIndex(_top.load(std::memory_order_relaxed)), _bottom.load(std::memory_order_relaxed)) <= 0;
+        }
+
+        TaskArray* AllocateArray(uint32_t capacity);
+        void FreeArray(TaskArray* array);
+        void Grow(uint32_t top, uint32_t bottom);
+        void FreeRetiredArrays();
+
+        // Written by thieves on every steal, so on a line of their own and the owner's
+        // Push and Pop don't lose theirs each time
+        alignas(FL_CACHE_LINE_SIZE) Atomic<uint64_t> _top;
+        Atomic<uint32_t> _numSteals;
+        // Written by the owner
+        alignas(FL_CACHE_LINE_SIZE) Atomic<uint32_t> _bottom;
+        Atomic<TaskArray*> _array;
+        // Only used by the owner. The top only ever moves up, so the queue can't be
+        // fuller than this says, Push only has to look at the real top when it might be full
+        uint32_t _cachedTop;
+        TaskArray* _retiredArrays;
+        Memory::IAllocator* _allocator;
     };
+
+    typedef BasicTaskQueue<DefaultTaskQueueTraits> TaskQueue;
+    // Instantiated once, in TaskQueue.cpp
+    extern template class BasicTaskQueue<DefaultTaskQueueTraits>;
+
+    template<typename Traits>
+    BasicTaskQueue<Traits>::BasicTaskQueue(Memory::IAllocator* allocator, uint32_t initialCapacity)
+        : _top(0)
+        , _numSteals(0)
+        , _bottom(0)
+        , _array(nullptr)
+        , _cachedTop(0)
+        , _retiredArrays(nullptr)
+        , _allocator(allocator)
+    {
+        assert(initialCapacity != 0 && (initialCapacity & (initialCapacity - 1u)) == 0); // The capacity has to be a power of 2
+        _array.store(AllocateArray(initialCapacity), std::memory_order_relaxed);
+    }
+
+    template<typename Traits>
+    BasicTaskQueue<Traits>::~BasicTaskQueue()
+    {
+        assert(_numSteals.load(std::memory_order_relaxed) == 0); // Something is still stealing from a queue that's being destroyed
+        FreeRetiredArrays();
+        FreeArray(_array.load(std::memory_order_relaxed));
+    }
+
+    // The orderings follow Le, Pop, Cohen and Zappa Nardelli, "Correct and Efficient
+    // Work-Stealing for Weak Memory Models". Only the owner writes _bottom and the
+    // array, so it can read them relaxed. Everything a steal reads is published by
+    // the release store of _bottom (or of _array, when it grows), and the one place
+    // a store has to be seen before a load, on both sides, is fenced with seq_cst
+
+    // We assume that this method can only be called concurrently
+    // with Steal.
+    // So, Steal reads from _bottom and writes to _top
+    // Push only reads _top, when the queue might be full, and if Steal reads an incorrect
+    // _bottom (e.g. before it has been updated at the end of the function)
+    // it will just return nullptr and no harm has been done
+    template<typename Traits>
+    void BasicTaskQueue<Traits>::Push(Task* task)
+    {
+        uint32_t currentBottom = _bottom.load(std::memory_order_relaxed);
+        auto array = _array.load(std::memory_order_relaxed);
+        if(Distance(_cachedTop, currentBottom) >= static_cast<int32_t>(array->_capacity))
+        {
+            // Might be full, see how much has been stolen since we last looked. Acquire,
+            // so the steals have finished reading the slots they took before we reuse them
+            _cachedTop = GetIndex(_top.load(std::memory_order_acquire));
+            if(Distance(_cachedTop, currentBottom) >= static_cast<int32_t>(array->_capacity))
+            {
+                Grow(_cachedTop, currentBottom);
+                array = _array.load(std::memory_order_relaxed);
+            }
+        }
+        (*array)[currentBottom].store(task, std::memory_order_relaxed);
+        // Publishes the task, and whatever was written to it before it was pushed
+        _bottom.store(currentBottom + 1, std::memory_order_release);
+    }
+
+    // We assume that this method can only be called concurrently
+    // with Steal.
+    template<typename Traits>
+    Task* BasicTaskQueue<Traits>::Pop()
+    {
+        uint32_t newBottom = _bottom.load(std::memory_order_relaxed) - 1;
+        _bottom.store(newBottom, std::memory_order_relaxed);
+        // Pairs with the fence in the steals. Either a steal sees the new bottom,
+        // or we see the top it read
+        Traits::SeqCstFence();
+        uint64_t currentTop = _top.load(std::memory_order_relaxed);
+        while(true)
+        {
+            auto topIndex = GetIndex(currentTop);
+            auto numTasksAbove = Distance(topIndex, newBottom);
+            if(numTasksAbove < 0)
+            {
+                // Queue was empty
+                _bottom.store(topIndex, std::memory_order_relaxed);
+                _cachedTop = topIndex;
+                // A good time to tidy up, as there's nothing else to do
+                FreeRetiredArrays();
+                return nullptr;
+            }
+
+            // The queue has something in it
+            auto task = (*_array.load(std::memory_order_relaxed))[newBottom].load(std::memory_order_relaxed);
+            if(numTasksAbove >= static_cast<int32_t>(MAXIMUM_STEAL_BATCH))
+            {
+                // Further from the top than any steal can reach, we don't
+                // have to worry about conflicting with a steal
+                return task;
+            }
+
+            if(numTasksAbove == 0)
+            {
+                // This is the last item in the queue
+                if(!_top.compare_exchange_strong(currentTop, MakeTop(GetTag(currentTop), topIndex + 1),
+                                                 std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    // Steal got there first
+                    task = nullptr;
+                }
+
+                _bottom.store(topIndex + 1, std::memory_order_relaxed);
+                return task;
+            }
+
+            // A batch steal that read _bottom before we decremented it could still take
+            // this task. Bumping the tag makes it fail, and any steal that comes after
+            // this will see the new _bottom
+            if(_top.compare_exchange_weak(currentTop, MakeTop(GetTag(currentTop) + 1, topIndex),
+                                          std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return task;
+            }
+            // A steal moved the top, look again
+        }
+    }
+
+    // We assume this method can be called concurrently with either
+    // Push, Pop, or another Steal
+    template<typename Traits>
+    Task* BasicTaskQueue<Traits>::Steal()
+    {
+        if(LooksEmpty())
+        {
+            return nullptr;
+        }
+        // Only the array has to be read inside the scope, which it still is
+        StealScope stealScope(this);
+        uint64_t currentTop = _top.load(std::memory_order_acquire);
+        // Pairs with the fence in Pop (and the one freeing retired arrays)
+        Traits::SeqCstFence();
+        uint32_t currentBottom = _bottom.load(std::memory_order_acquire);
+        auto topIndex = GetIndex(currentTop);
+        if(Distance(topIndex, currentBottom) > 0)
+        {
+            // The queue has something in it. The array is read after the bottom, so if the
+            // bottom includes a task pushed after the array grew, we see the new array
+            auto task = (*_array.load(std::memory_order_acquire))[topIndex].load(std::memory_order_relaxed);
+            if(!_top.compare_exchange_strong(currentTop, MakeTop(GetTag(currentTop), topIndex + 1),
+                                             std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                // Something else (probably another Steal) took this item
+                return nullptr;
+            }
+            return task;
+        }
+        // Queue is empty
+        return nullptr;
+    }
+
+    // We assume this method can be called concurrently with either
+    // Push, Pop, or another Steal on this queue
+    template<typename Traits>
+    Task* BasicTaskQueue<Traits>::StealBatch(BasicTaskQueue* destination)
+    {
+        if(LooksEmpty())
+        {
+            return nullptr;
+        }
+        StealScope stealScope(this);
+        uint64_t currentTop = _top.load(std::memory_order_acquire);
+        Traits::SeqCstFence();
+        uint32_t currentBottom = _bottom.load(std::memory_order_acquire);
+        auto topIndex = GetIndex(currentTop);
+        auto numTasks = Distance(topIndex, currentBottom);
+        if(numTasks <= 0)
+        {
+            // Queue is empty
+            return nullptr;
+        }
+
+        // Rounding up, so the last task can be stolen
+        auto numTasksToSteal = static_cast<uint32_t>(numTasks + 1) / 2u;
+        if(numTasksToSteal > MAXIMUM_STEAL_BATCH)
+        {
+            numTasksToSteal = MAXIMUM_STEAL_BATCH;
+        }
+        Task* stolenTasks[MAXIMUM_STEAL_BATCH];
+        auto array = _array.load(std::memory_order_acquire);
+        for(uint32_t taskIdx = 0; taskIdx < numTasksToSteal; taskIdx++)
+        {
+            stolenTasks[taskIdx] = (*array)[topIndex + taskIdx].load(std::memory_order_relaxed);
+        }
+        if(!_top.compare_exchange_strong(currentTop, MakeTop(GetTag(currentTop), topIndex + numTasksToSteal),
+                                         std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            // Something else took some of them, or a Pop near the top changed the tag
+            return nullptr;
+        }
+
+        for(uint32_t taskIdx = 1; taskIdx < numTasksToSteal; taskIdx++)
+        {
+            destination->Push(stolenTasks[taskIdx]);
+        }
+        return stolenTasks[0];
+    }
+
+    template<typename Traits>
+    typename BasicTaskQueue<Traits>::TaskArray* BasicTaskQueue<Traits>::AllocateArray(uint32_t capacity)
+    {
+        auto memory = FL_ALLOC_ALIGN(*_allocator, sizeof(TaskArray) + capacity * sizeof(Atomic<Task*>), FL_CACHE_LINE_SIZE);
+        auto array = new (memory) TaskArray();
+        array->_capacity = capacity;
+        array->_nextRetired = nullptr;
+        auto tasks = reinterpret_cast<Atomic<Task*>*>(array + 1);
+        for(uint32_t taskIdx = 0; taskIdx < capacity; taskIdx++)
+        {
+            new (&tasks[taskIdx]) Atomic<Task*>(nullptr);
+        }
+        return array;
+    }
+
+    template<typename Traits>
+    void BasicTaskQueue<Traits>::FreeArray(TaskArray* array)
+    {
+        // Everything in the array is trivially destructible
+        FL_FREE_ALIGN(*_allocator, array);
+    }
+
+    template<typename Traits>
+    void BasicTaskQueue<Traits>::Grow(uint32_t top, uint32_t bottom)
+    {
+        auto oldArray = _array.load(std::memory_order_relaxed);
+        auto newArray = AllocateArray(oldArray->_capacity * 2u);
+        // Only the owner writes to the array, so nothing can change while we copy.
+        // Steals can still take tasks from the top, from either array
+        for(auto index = top; index != bottom; index++)
+        {
+            (*newArray)[index].store((*oldArray)[index].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        // Release, so a steal that sees the new array sees the tasks copied into it
+        _array.store(newArray, std::memory_order_release);
+        oldArray->_nextRetired = _retiredArrays;
+        _retiredArrays = oldArray;
+        FreeRetiredArrays();
+    }
+
+    template<typename Traits>
+    void BasicTaskQueue<Traits>::FreeRetiredArrays()
+    {
+        if(_retiredArrays == nullptr)
+        {
+            return;
+        }
+        // Pairs with the fence in the steals, which comes after they count themselves in
+        // and before they read the array. Either we see the steal counted, or it sees
+        // the latest array. Acquire, so steals that have finished are done with the old ones
+        Traits::SeqCstFence();
+        if(_numSteals.load(std::memory_order_acquire) != 0)
+        {
+            return;
+        }
+        while(_retiredArrays != nullptr)
+        {
+            auto nextRetired = _retiredArrays->_nextRetired;
+            FreeArray(_retiredArrays);
+            _retiredArrays = nextRetired;
+        }
+    }
 }
@@ -1,72 +1,154 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <condition_variable>
 
+#include "Platform/PlatformFeatures.h"
+
 namespace Flourish
 {
+    // Gate that idle threads wait at until there is more work.
+    //
+    // This is an eventcount: the open flag and the number of sleeping threads
+    // share one atomic, so opening the gate is a single atomic operation and
+    // the mutex and wait mechanism are only touched if a thread is actually
+    // asleep. Waiting threads spin (with a pause instruction) for a while
+    // before going to sleep, as new work usually turns up quickly
     template<typename WaitMechanism = std::condition_variable>
     class TaskThreadGate
     {
     public:
-        TaskThreadGate()
-        : _open(false)
-        , _openPermenently(false)
+        static const uint32_t DEFAULT_SPIN_COUNT = 1024u;
+
+        explicit TaskThreadGate(uint32_t spinCount = DEFAULT_SPIN_COUNT)
+        : _state(0)
+        , _spinCount(spinCount)
         , _waitMechanism()
         {
-            
+
         }
-        
+
         void OpenAndNotifyOne()
         {
-            OpenAndNotify(false);
+            OpenAndNotify(OPEN, false);
         }
-        
+
         void OpenAndNotifyAll()
         {
-            OpenAndNotify(true);
+            OpenAndNotify(OPEN, true);
         }
-        
+
         void OpenPermenentlyAndNotifyAll()
         {
+            OpenAndNotify(OPEN | OPEN_PERMENENTLY, true);
+        }
+
+        // Calls notify with the wait mechanism, under the lock, if any thread is asleep, but
+        // leaves the gate as it is. For waking particular threads whose wake condition has
+        // become true, rather than whichever thread the wait mechanism would pick
+        template<typename Notify>
+        void NotifySleepers(const Notify& notify)
+        {
+            if(GetNumSleepers() == 0)
+            {
+                return;
+            }
             std::unique_lock<std::mutex> lock(_mutex);
-            _openPermenently = true;
-            _open = true;
-            _waitMechanism.notify_all();
+            notify(_waitMechanism);
+        }
+
+        // Waits for at most waitDuration, or until the gate opens if it's zero
+        void Wait(std::chrono::microseconds waitDuration = std::chrono::microseconds::zero())
+        {
+            Wait(waitDuration, [] { return false; });
         }
-        
-        void Wait(std::chrono::milliseconds waitDuration = std::chrono::milliseconds::zero())
+
+        // Also lets the thread through, without closing the gate, as soon as wakeCondition
+        // returns true. It's checked while spinning and every time the thread is woken, so
+        // whatever makes it true has to open the gate afterwards to wake sleeping threads
+        template<typename WakeCondition>
+        void Wait(std::chrono::microseconds waitDuration, const WakeCondition& wakeCondition)
         {
+            for(uint32_t spin = 0; spin < _spinCount; spin++)
+            {
+                if(wakeCondition() || TryPassThrough())
+                {
+                    return;
+                }
+                FL_CPU_PAUSE();
+            }
+
             std::unique_lock<std::mutex> lock(_mutex);
-            if(!_open)
+            // Registering as a sleeper before checking the gate means either we
+            // see it open, or whoever opens it sees us and notifies
+            _state.fetch_add(ONE_SLEEPER);
+            if(!wakeCondition() && !TryPassThrough())
             {
-				if(waitDuration > std::chrono::milliseconds::zero())
+				if(waitDuration > std::chrono::microseconds::zero())
 				{
-					_waitMechanism.wait_for(lock, waitDuration, [&] { return _open; });
+					_waitMechanism.wait_for(lock, waitDuration, [&] { return wakeCondition() || TryPassThrough(); });
 				}
 				else
 				{
-					_waitMechanism.wait(lock, [&] { return _open; });
+					_waitMechanism.wait(lock, [&] { return wakeCondition() || TryPassThrough(); });
 				}
             }
-            if(!_openPermenently)
-            {
-                _open = false;
-            }
+            _state.fetch_sub(ONE_SLEEPER);
         }
-        
+
+        uint32_t GetNumSleepers() const
+        {
+            return _state.load() >> SLEEPER_SHIFT;
+        }
+
 #if defined(FL_RUNNING_TESTS)
         WaitMechanism* GetWaitMechanism()
         {
             return &_waitMechanism;
         }
 #endif
-        
+
     private:
-        void OpenAndNotify(bool notifyAll)
+        static const uint32_t OPEN = 1u;
+        static const uint32_t OPEN_PERMENENTLY = 2u;
+        static const uint32_t SLEEPER_SHIFT = 2u;
+        static const uint32_t ONE_SLEEPER = 1u << SLEEPER_SHIFT;
+
+        // Returns true if the gate was open, and closes it again unless it's open permenently
+        bool TryPassThrough()
         {
+            auto state = _state.load(std::memory_order_relaxed);
+            while(true)
+            {
+                if((state & OPEN) == 0)
+                {
+                    return false;
+                }
+                if((state & OPEN_PERMENENTLY) != 0)
+                {
+                    return true;
+                }
+                if(_state.compare_exchange_weak(state, state & ~OPEN, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+        }
+
+        void OpenAndNotify(uint32_t openFlags, bool notifyAll)
+        {
+            auto previousState = _state.fetch_or(openFlags);
+            if((previousState >> SLEEPER_SHIFT) == 0)
+            {
+                // Nobody is asleep, anyone spinning will see the gate open
+                return;
+            }
+            // Taking the lock means a sleeper is either waiting, or hasn't
+            // checked the gate yet and will see it open
             std::unique_lock<std::mutex> lock(_mutex);
-            _open = true;
             if(notifyAll)
             {
                 _waitMechanism.notify_all();
@@ -76,9 +158,9 @@ namespace Flourish
                 _waitMechanism.notify_one();
             }
         }
-        
-        bool _open;
-        bool _openPermenently;
+
+        std::atomic<uint32_t> _state;
+        uint32_t _spinCount;
         std::mutex _mutex;
         WaitMechanism _waitMechanism;
     };
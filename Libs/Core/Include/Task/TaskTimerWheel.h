@@ -0,0 +1,149 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "Task/Task.h"
+
+namespace Flourish
+{
+    typedef uint32_t TimerId;
+
+    // Timers waiting to queue a task, sorted into a hierarchical timing wheel. Time is
+    // counted in ticks of TICK_DURATION. The first level has a slot for each of the next
+    // SLOTS_PER_LEVEL ticks, and each level after that has slots SLOTS_PER_LEVEL times as
+    // wide. Adding and removing a timer is O(1), and as time moves on each timer is moved
+    // down a level (once per level at most) until it's in the slot for the tick it's due.
+    //
+    // It isn't thread safe, TaskManager keeps it behind a lock
+    class TaskTimerWheel
+    {
+    public:
+        static constexpr std::chrono::microseconds TICK_DURATION = std::chrono::microseconds(100);
+        static constexpr uint32_t LEVEL_SHIFT = 6u;
+        static constexpr uint32_t SLOTS_PER_LEVEL = 1u << LEVEL_SHIFT;
+        static constexpr uint32_t NUM_LEVELS = 4u;
+        static constexpr uint64_t NO_TICK = UINT64_MAX;
+
+        struct Timer
+        {
+            Timer* _next;
+            // Whatever points at this timer, the slot or the timer before it
+            Timer** _previousNext;
+            uint64_t _expiryTick;
+            // Zero for a timer that only fires once
+            uint64_t _periodTicks;
+            // A task that has been begun, and is finished when the timer fires. Periodic
+            // timers instead add a new task running a copy of _workItem each time
+            TaskId _taskId;
+            WorkItem _workItem;
+            TaskPriority _priority;
+            TimerId _id;
+        };
+
+        explicit TaskTimerWheel(std::chrono::steady_clock::time_point startTime);
+        // Deletes any timers still in the wheel
+        ~TaskTimerWheel();
+
+        TaskTimerWheel(const TaskTimerWheel&) = delete;
+        TaskTimerWheel& operator=(const TaskTimerWheel&) = delete;
+
+        // The tick time is in. Safe to call from any thread
+        uint64_t GetTick(std::chrono::steady_clock::time_point time) const
+        {
+            if(time <= _startTime)
+            {
+                return 0;
+            }
+            return static_cast<uint64_t>((time - _startTime) / TICK_DURATION);
+        }
+
+        std::chrono::steady_clock::time_point GetTime(uint64_t tick) const
+        {
+            return _startTime + TICK_DURATION * tick;
+        }
+
+        uint64_t GetCurrentTick() const
+        {
+            return _currentTick;
+        }
+
+        // Timers due at or before the current tick fire on the next one
+        void Add(Timer* timer);
+        void Remove(Timer* timer);
+
+        // Moves the current tick on to tick, calling onExpired(timer) for every timer that's due.
+        // The timer has been removed from the wheel, onExpired can add it again or delete it
+        template<typename OnExpired>
+        void Advance(uint64_t tick, const OnExpired& onExpired)
+        {
+            while(_currentTick < tick)
+            {
+                // Skip straight to the next tick with anything to do
+                auto nextTick = GetNextTick();
+                if(nextTick > tick)
+                {
+                    _currentTick = tick;
+                    return;
+                }
+                _currentTick = nextTick;
+                // Move timers down from the slots that start at this tick
+                for(uint32_t level = 1; level < NUM_LEVELS; level++)
+                {
+                    if((_currentTick & ((1ull << (level * LEVEL_SHIFT)) - 1u)) != 0)
+                    {
+                        break;
+                    }
+                    auto timer = TakeSlot(level, GetSlotIdx(level, _currentTick));
+                    while(timer != nullptr)
+                    {
+                        auto nextTimer = timer->_next;
+                        // The current tick's slot on the first level is still to come, so timers due now go in it
+                        Insert(timer, timer->_expiryTick > _currentTick ? timer->_expiryTick : _currentTick);
+                        timer = nextTimer;
+                    }
+                }
+                auto timer = TakeSlot(0, GetSlotIdx(0, _currentTick));
+                while(timer != nullptr)
+                {
+                    auto nextTimer = timer->_next;
+                    if(timer->_expiryTick <= _currentTick)
+                    {
+                        onExpired(timer);
+                    }
+                    else
+                    {
+                        // Too far away to fit in the wheel when it was added
+                        Add(timer);
+                    }
+                    timer = nextTimer;
+                }
+            }
+        }
+
+        // The next tick anything has to be done at, either a timer firing or timers moving
+        // down a level. It's never later than the next timer is due. NO_TICK if it's empty
+        uint64_t GetNextTick() const;
+
+        uint32_t GetNumTimers() const
+        {
+            return _numTimers;
+        }
+
+    private:
+        static uint32_t GetSlotIdx(uint32_t level, uint64_t tick)
+        {
+            return static_cast<uint32_t>(tick >> (level * LEVEL_SHIFT)) & (SLOTS_PER_LEVEL - 1u);
+        }
+
+        // Puts the timer in the slot for tick, which mustn't be before the current tick
+        void Insert(Timer* timer, uint64_t tick);
+        // Removes every timer from the slot and returns the first one
+        Timer* TakeSlot(uint32_t level, uint32_t slotIdx);
+
+        std::chrono::steady_clock::time_point _startTime;
+        uint64_t _currentTick;
+        uint32_t _numTimers;
+        Timer* _slots[NUM_LEVELS][SLOTS_PER_LEVEL];
+    };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "Platform/PlatformFeatures.h"
+#include "Task/Task.h"
+
+namespace Flourish
+{
+    // Lets a thread sleep until a particular task has finished, without every
+    // finishing task having to wake every waiting thread.
+    //
+    // Tasks are hashed into a fixed number of buckets, each with its own mutex
+    // and condition variable. A waiter registers in the bucket for its task
+    // before checking if the task is complete, and a finishing task only takes
+    // the bucket lock if someone is registered, so finishing a task nobody is
+    // waiting on costs a single atomic load
+    class TaskWaitTable
+    {
+    public:
+        static const uint32_t NUM_BUCKETS = 64u;
+
+        TaskWaitTable();
+
+        TaskWaitTable(const TaskWaitTable&) = delete;
+        TaskWaitTable& operator=(const TaskWaitTable&) = delete;
+
+        // Sleeps until isComplete returns true after NotifyCompleted is called for
+        // the id, or until the timeout. isComplete must read the task's open work
+        // items with sequentially consistent ordering
+        template<typename IsCompleteFunction>
+        void WaitForCompletion(TaskId id, std::chrono::microseconds timeout, IsCompleteFunction isComplete)
+        {
+            auto& bucket = GetBucket(id);
+            std::unique_lock<std::mutex> lock(bucket._mutex);
+            // Registering before checking means either we see the task complete
+            // here, or the finishing thread sees us registered and notifies
+            bucket._numWaiters++;
+            bucket._condition.wait_for(lock, timeout, isComplete);
+            bucket._numWaiters--;
+        }
+
+        // Called after a task's open work items reaches zero
+        void NotifyCompleted(TaskId id);
+
+    private:
+        struct alignas(FL_CACHE_LINE_SIZE) Bucket
+        {
+            std::mutex _mutex;
+            std::condition_variable _condition;
+            std::atomic_uint _numWaiters;
+        };
+
+        Bucket& GetBucket(TaskId id)
+        {
+            // The low bits of an id are the task's index, so consecutive tasks
+            // land in different buckets
+            return _buckets[id & (NUM_BUCKETS - 1u)];
+        }
+
+        Bucket _buckets[NUM_BUCKETS];
+    };
+}
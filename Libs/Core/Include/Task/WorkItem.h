@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "Memory/Memory.h"
+
+namespace Flourish
+{
+    // A work item is a function and some data
+    // it is assumed that the function knows what
+    // to do with the void* data
+    //
+    // The function is stored inside the work item if it fits in
+    // INLINE_STORAGE_SIZE bytes, so typical lambdas never touch the heap.
+    // Larger functions are stored in memory from the allocator passed in,
+    // and don't compile without one
+    class WorkItem
+    {
+    public:
+        static const size_t INLINE_STORAGE_SIZE = 48;
+        static const size_t INLINE_STORAGE_ALIGNMENT = alignof(std::max_align_t);
+
+        template<typename Callable>
+        static constexpr bool FitsInline()
+        {
+            return sizeof(Callable) <= INLINE_STORAGE_SIZE
+                && alignof(Callable) <= INLINE_STORAGE_ALIGNMENT
+                && std::is_nothrow_move_constructible<Callable>::value;
+        }
+
+        template<typename Callable, typename = std::enable_if_t<!std::is_same<std::decay_t<Callable>, WorkItem>::value>>
+        WorkItem(Callable&& callable, void* data = nullptr)
+            : WorkItem(std::forward<Callable>(callable), data, nullptr)
+        {
+            static_assert(FitsInline<std::decay_t<Callable>>(), "Work item function is too large to store inline, an allocator has to be given");
+        }
+
+        // The allocator is only used if the function is too large to store inline
+        template<typename Callable, typename = std::enable_if_t<!std::is_same<std::decay_t<Callable>, WorkItem>::value>>
+        WorkItem(Callable&& callable, void* data, Memory::IAllocator* allocator)
+            : _invoke(nullptr)
+            , _manage(nullptr)
+            , _data(data)
+            , _allocator(allocator)
+            , _isHeapAllocated(false)
+        {
+            typedef std::decay_t<Callable> StoredCallable;
+            if constexpr (FitsInline<StoredCallable>())
+            {
+                new (_storage) StoredCallable(std::forward<Callable>(callable));
+                _invoke = &InvokeInline<StoredCallable>;
+                _manage = &ManageInline<StoredCallable>;
+            }
+            else
+            {
+                FL_ASSERT_MSG(allocator != nullptr, "Work item function is too large to store inline and no allocator was given");
+                SetHeapCallable(FL_NEW_RAW_ALIGNED(*allocator, StoredCallable, HeapAlignment<StoredCallable>(), std::forward<Callable>(callable)));
+                _isHeapAllocated = true;
+                _invoke = &InvokeHeap<StoredCallable>;
+                _manage = &ManageHeap<StoredCallable>;
+            }
+        }
+
+        WorkItem(const WorkItem& other)
+            : _invoke(other._invoke)
+            , _manage(other._manage)
+            , _data(other._data)
+            , _allocator(other._allocator)
+            , _isHeapAllocated(other._isHeapAllocated)
+        {
+            _manage(ManageOperation::Copy, this, const_cast<WorkItem*>(&other));
+        }
+
+        WorkItem(WorkItem&& other) noexcept
+            : _invoke(other._invoke)
+            , _manage(other._manage)
+            , _data(other._data)
+            , _allocator(other._allocator)
+            , _isHeapAllocated(other._isHeapAllocated)
+        {
+            _manage(ManageOperation::Move, this, &other);
+        }
+
+        WorkItem& operator=(const WorkItem& other)
+        {
+            if(this != &other)
+            {
+                WorkItem copy(other);
+                *this = std::move(copy);
+            }
+            return *this;
+        }
+
+        WorkItem& operator=(WorkItem&& other) noexcept
+        {
+            if(this != &other)
+            {
+                _manage(ManageOperation::Destroy, this, nullptr);
+                _invoke = other._invoke;
+                _manage = other._manage;
+                _data = other._data;
+                _allocator = other._allocator;
+                _isHeapAllocated = other._isHeapAllocated;
+                _manage(ManageOperation::Move, this, &other);
+            }
+            return *this;
+        }
+
+        ~WorkItem()
+        {
+            _manage(ManageOperation::Destroy, this, nullptr);
+        }
+
+        static WorkItem Empty()
+        {
+            return WorkItem([](void*){});
+        }
+
+        void operator()()
+        {
+            _invoke(this);
+        }
+
+        // Releases the function (and anything it captured), leaving an empty work item
+        void Reset()
+        {
+            _manage(ManageOperation::Destroy, this, nullptr);
+            SetEmpty();
+        }
+
+        // Returns true if the function had to be stored in memory from the allocator
+        bool IsHeapAllocated() const
+        {
+            return _isHeapAllocated;
+        }
+
+    private:
+        enum class ManageOperation
+        {
+            Copy,
+            Move,
+            Destroy
+        };
+
+        typedef void (*InvokeFunction)(WorkItem* workItem);
+        typedef void (*ManageFunction)(ManageOperation operation, WorkItem* workItem, WorkItem* other);
+
+        template<typename Callable>
+        static constexpr size_t HeapAlignment()
+        {
+            return alignof(Callable) > sizeof(void*) ? alignof(Callable) : sizeof(void*);
+        }
+
+        void SetEmpty()
+        {
+            new (_storage) EmptyCallable();
+            _invoke = &InvokeInline<EmptyCallable>;
+            _manage = &ManageInline<EmptyCallable>;
+            _isHeapAllocated = false;
+        }
+
+        template<typename Callable>
+        Callable* GetInlineCallable()
+        {
+            return std::launder(reinterpret_cast<Callable*>(_storage));
+        }
+
+        void SetHeapCallable(void* callable)
+        {
+            *reinterpret_cast<void**>(_storage) = callable;
+        }
+
+        template<typename Callable>
+        Callable* GetHeapCallable()
+        {
+            return static_cast<Callable*>(*reinterpret_cast<void**>(_storage));
+        }
+
+        template<typename Callable>
+        static void InvokeInline(WorkItem* workItem)
+        {
+            (*workItem->GetInlineCallable<Callable>())(workItem->_data);
+        }
+
+        template<typename Callable>
+        static void ManageInline(ManageOperation operation, WorkItem* workItem, WorkItem* other)
+        {
+            switch(operation)
+            {
+                case ManageOperation::Copy:
+                    new (workItem->_storage) Callable(*other->GetInlineCallable<Callable>());
+                    break;
+                case ManageOperation::Move:
+                    new (workItem->_storage) Callable(std::move(*other->GetInlineCallable<Callable>()));
+                    break;
+                case ManageOperation::Destroy:
+                    workItem->GetInlineCallable<Callable>()->~Callable();
+                    break;
+            }
+        }
+
+        template<typename Callable>
+        static void InvokeHeap(WorkItem* workItem)
+        {
+            (*workItem->GetHeapCallable<Callable>())(workItem->_data);
+        }
+
+        template<typename Callable>
+        static void ManageHeap(ManageOperation operation, WorkItem* workItem, WorkItem* other)
+        {
+            switch(operation)
+            {
+                case ManageOperation::Copy:
+                    workItem->SetHeapCallable(FL_NEW_RAW_ALIGNED(*workItem->_allocator, Callable, HeapAlignment<Callable>(), *other->GetHeapCallable<Callable>()));
+                    break;
+                case ManageOperation::Move:
+                    // The moved from work item is left holding an empty function
+                    // so it no longer owns the memory
+                    workItem->SetHeapCallable(other->GetHeapCallable<Callable>());
+                    other->SetEmpty();
+                    break;
+                case ManageOperation::Destroy:
+                {
+                    auto callable = workItem->GetHeapCallable<Callable>();
+                    FL_DELETE_RAW_ALIGNED(*workItem->_allocator, callable);
+                    break;
+                }
+            }
+        }
+
+        struct EmptyCallable
+        {
+            void operator()(void*) {}
+        };
+
+        alignas(INLINE_STORAGE_ALIGNMENT) unsigned char _storage[INLINE_STORAGE_SIZE];
+        InvokeFunction _invoke;
+        ManageFunction _manage;
+        void* _data;
+        Memory::IAllocator* _allocator;
+        bool _isHeapAllocated;
+    };
+}
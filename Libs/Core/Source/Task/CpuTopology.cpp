@@ -0,0 +1,71 @@
+#include "Task/CpuTopology.h"
+
+#include <algorithm>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+namespace Flourish
+{
+    CpuTopology::CpuTopology(std::vector<LogicalCpu> cpus)
+        : _cpus(std::move(cpus))
+    {
+        if(_cpus.empty())
+        {
+            // If this can't be detected either, there must be at least the CPU we're running on
+            auto numCpus = std::max(std::thread::hardware_concurrency(), 1u);
+            for(uint32_t cpuIdx = 0; cpuIdx < numCpus; cpuIdx++)
+            {
+                _cpus.push_back(LogicalCpu{ cpuIdx, cpuIdx, cpuIdx, 0 });
+            }
+        }
+    }
+
+    CpuDistance CpuTopology::GetDistance(uint32_t firstCpuIdx, uint32_t secondCpuIdx) const
+    {
+        auto& first = _cpus[firstCpuIdx];
+        auto& second = _cpus[secondCpuIdx];
+        if(first._coreId == second._coreId)
+        {
+            return CpuDistance::SameCore;
+        }
+        if(first._lastLevelCacheId == second._lastLevelCacheId)
+        {
+            return CpuDistance::SameCache;
+        }
+        if(first._numaNode == second._numaNode)
+        {
+            return CpuDistance::SameNode;
+        }
+        return CpuDistance::Remote;
+    }
+
+    std::vector<uint32_t> CpuTopology::GetPlacementOrder() const
+    {
+        // How many SMT siblings come before each CPU on its core
+        std::vector<uint32_t> smtRanks(_cpus.size(), 0);
+        for(uint32_t cpuIdx = 0; cpuIdx < _cpus.size(); cpuIdx++)
+        {
+            for(uint32_t otherCpuIdx = 0; otherCpuIdx < cpuIdx; otherCpuIdx++)
+            {
+                if(_cpus[otherCpuIdx]._coreId == _cpus[cpuIdx]._coreId)
+                {
+                    smtRanks[cpuIdx]++;
+                }
+            }
+        }
+
+        std::vector<uint32_t> order(_cpus.size());
+        for(uint32_t cpuIdx = 0; cpuIdx < order.size(); cpuIdx++)
+        {
+            order[cpuIdx] = cpuIdx;
+        }
+        std::sort(order.begin(), order.end(), [&](uint32_t first, uint32_t second) {
+            auto& firstCpu = _cpus[first];
+            auto& secondCpu = _cpus[second];
+            return std::tie(smtRanks[first], firstCpu._numaNode, firstCpu._lastLevelCacheId, firstCpu._coreId, first)
+                 < std::tie(smtRanks[second], secondCpu._numaNode, secondCpu._lastLevelCacheId, secondCpu._coreId, second);
+        });
+        return order;
+    }
+}
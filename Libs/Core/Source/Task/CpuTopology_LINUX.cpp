@@ -0,0 +1,172 @@
+#include "Platform/Platform.h"
+#if FL_ENABLED(FL_PLATFORM_LINUX)
+
+#include "Task/CpuTopology.h"
+
+#include <sched.h>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+namespace Flourish
+{
+    namespace
+    {
+        const char* const CpuSysfsPath = "/sys/devices/system/cpu";
+        const char* const NodeSysfsPath = "/sys/devices/system/node";
+        const uint32_t MaxCacheIndices = 16;
+        // Set on ids made up from a CPU's index when the real one can't be read, so they
+        // can't collide with a real id, which for cores is (package << 16) | core_id
+        const uint32_t FallbackIdBit = 1u << 31u;
+
+        bool ReadLine(const char* path, char* buffer, size_t bufferSize)
+        {
+            auto file = fopen(path, "r");
+            if(file == nullptr)
+            {
+                return false;
+            }
+            auto readLine = fgets(buffer, static_cast<int>(bufferSize), file) != nullptr;
+            fclose(file);
+            return readLine;
+        }
+
+        bool ReadNumber(const char* path, uint32_t& number)
+        {
+            char buffer[32];
+            if(!ReadLine(path, buffer, sizeof(buffer)))
+            {
+                return false;
+            }
+            number = static_cast<uint32_t>(strtoul(buffer, nullptr, 10));
+            return true;
+        }
+
+        // Reads a list in the kernel's cpulist format, like "0-3,8,10-11"
+        bool ReadCpuList(const char* path, std::vector<uint32_t>& cpus)
+        {
+            // Big enough for the longest lists on machines with thousands of CPUs
+            char buffer[8192];
+            if(!ReadLine(path, buffer, sizeof(buffer)))
+            {
+                return false;
+            }
+            auto current = buffer;
+            while(*current >= '0' && *current <= '9')
+            {
+                char* end = nullptr;
+                auto first = static_cast<uint32_t>(strtoul(current, &end, 10));
+                auto last = first;
+                if(*end == '-')
+                {
+                    last = static_cast<uint32_t>(strtoul(end + 1, &end, 10));
+                }
+                for(auto cpu = first; cpu <= last; cpu++)
+                {
+                    cpus.push_back(cpu);
+                }
+                current = *end == ',' ? end + 1 : end;
+            }
+            return true;
+        }
+
+        // The first CPU sharing the highest level of cache, which is the same for every CPU sharing it
+        bool ReadLastLevelCacheId(uint32_t cpu, uint32_t& cacheId)
+        {
+            char path[128];
+            uint32_t lastLevel = 0;
+            for(uint32_t cacheIdx = 0; cacheIdx < MaxCacheIndices; cacheIdx++)
+            {
+                uint32_t level = 0;
+                snprintf(path, sizeof(path), "%s/cpu%u/cache/index%u/level", CpuSysfsPath, cpu, cacheIdx);
+                if(!ReadNumber(path, level))
+                {
+                    break;
+                }
+                std::vector<uint32_t> sharedCpus;
+                snprintf(path, sizeof(path), "%s/cpu%u/cache/index%u/shared_cpu_list", CpuSysfsPath, cpu, cacheIdx);
+                if(level > lastLevel && ReadCpuList(path, sharedCpus) && !sharedCpus.empty())
+                {
+                    lastLevel = level;
+                    cacheId = sharedCpus[0];
+                }
+            }
+            return lastLevel != 0;
+        }
+    }
+
+    CpuTopology CpuTopology::Detect()
+    {
+        std::vector<uint32_t> onlineCpus;
+        char path[128];
+        snprintf(path, sizeof(path), "%s/online", CpuSysfsPath);
+        if(!ReadCpuList(path, onlineCpus) || onlineCpus.empty())
+        {
+            return CpuTopology({});
+        }
+
+        // Only the CPUs we're allowed to run on, which may be fewer in a container
+        cpu_set_t allowedCpus;
+        CPU_ZERO(&allowedCpus);
+        auto knowAllowedCpus = sched_getaffinity(0, sizeof(allowedCpus), &allowedCpus) == 0;
+
+        std::vector<uint32_t> cpuNodes(onlineCpus.back() + 1, 0);
+        std::vector<uint32_t> nodes;
+        snprintf(path, sizeof(path), "%s/online", NodeSysfsPath);
+        if(ReadCpuList(path, nodes))
+        {
+            for(auto node : nodes)
+            {
+                std::vector<uint32_t> nodeCpus;
+                snprintf(path, sizeof(path), "%s/node%u/cpulist", NodeSysfsPath, node);
+                ReadCpuList(path, nodeCpus);
+                for(auto cpu : nodeCpus)
+                {
+                    if(cpu < cpuNodes.size())
+                    {
+                        cpuNodes[cpu] = node;
+                    }
+                }
+            }
+        }
+
+        std::vector<LogicalCpu> cpus;
+        for(auto cpu : onlineCpus)
+        {
+            if(knowAllowedCpus && (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowedCpus)))
+            {
+                continue;
+            }
+            // Anything missing falls back to the CPU's own index, so it isn't shared
+            LogicalCpu logicalCpu = { cpu, cpu | FallbackIdBit, cpu | FallbackIdBit, cpuNodes[cpu] };
+            // Core ids are only unique within a package
+            uint32_t package = 0;
+            uint32_t core = 0;
+            snprintf(path, sizeof(path), "%s/cpu%u/topology/physical_package_id", CpuSysfsPath, cpu);
+            auto readPackage = ReadNumber(path, package);
+            snprintf(path, sizeof(path), "%s/cpu%u/topology/core_id", CpuSysfsPath, cpu);
+            if(readPackage && ReadNumber(path, core))
+            {
+                logicalCpu._coreId = (package << 16u) | core;
+            }
+            ReadLastLevelCacheId(cpu, logicalCpu._lastLevelCacheId);
+            cpus.push_back(logicalCpu);
+        }
+        return CpuTopology(std::move(cpus));
+    }
+
+    bool CpuTopology::PinCurrentThread(const LogicalCpu& cpu)
+    {
+        if(cpu._osIndex >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu._osIndex, &cpuSet);
+        // On Linux a pid of 0 means the calling thread, not the whole process
+        return sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+    }
+}
+
+#endif
@@ -0,0 +1,21 @@
+#include "Platform/Platform.h"
+#if FL_ENABLED(FL_PLATFORM_OSX)
+
+#include "Task/CpuTopology.h"
+
+namespace Flourish
+{
+    CpuTopology CpuTopology::Detect()
+    {
+        // macOS doesn't say which logical CPUs share a core or cache
+        return CpuTopology({});
+    }
+
+    bool CpuTopology::PinCurrentThread(const LogicalCpu&)
+    {
+        // Threads can't be pinned on macOS, the closest is an affinity tag the scheduler may ignore
+        return false;
+    }
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include "Platform/Platform.h"
+#if FL_ENABLED(FL_PLATFORM_WINDOWS)
+
+#include "Task/CpuTopology.h"
+
+#include <utility>
+#include <windows.h>
+
+namespace Flourish
+{
+    namespace
+    {
+        // Windows splits CPUs into groups of up to 64, the OS index is the group and bit combined
+        const uint32_t CpusPerGroup = 64;
+
+        template<typename Function>
+        void ForEachCpuInMask(const GROUP_AFFINITY& groupAffinity, Function function)
+        {
+            for(uint32_t bit = 0; bit < CpusPerGroup; bit++)
+            {
+                if((groupAffinity.Mask & (static_cast<KAFFINITY>(1) << bit)) != 0)
+                {
+                    function(groupAffinity.Group * CpusPerGroup + bit);
+                }
+            }
+        }
+
+        LogicalCpu* FindCpu(std::vector<LogicalCpu>& cpus, uint32_t osIndex)
+        {
+            for(auto& cpu : cpus)
+            {
+                if(cpu._osIndex == osIndex)
+                {
+                    return &cpu;
+                }
+            }
+            return nullptr;
+        }
+    }
+
+    CpuTopology CpuTopology::Detect()
+    {
+        DWORD length = 0;
+        GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+        if(GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+        {
+            return CpuTopology({});
+        }
+        std::vector<char> buffer(length);
+        if(!GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length))
+        {
+            return CpuTopology({});
+        }
+
+        // The cores come first, every other relation refers to CPUs they've listed
+        std::vector<LogicalCpu> cpus;
+        std::vector<uint32_t> cacheLevels;
+        uint32_t numCores = 0;
+        uint32_t numCaches = 0;
+        for(uint32_t pass = 0; pass < 2; pass++)
+        {
+            for(DWORD offset = 0; offset < length;)
+            {
+                auto info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data() + offset);
+                offset += info->Size;
+                if(pass == 0 && info->Relationship == RelationProcessorCore)
+                {
+                    for(WORD groupIdx = 0; groupIdx < info->Processor.GroupCount; groupIdx++)
+                    {
+                        ForEachCpuInMask(info->Processor.GroupMask[groupIdx], [&](uint32_t osIndex) {
+                            // Anything not found later isn't shared
+                            cpus.push_back(LogicalCpu{ osIndex, numCores, UINT32_MAX - osIndex, 0 });
+                            cacheLevels.push_back(0);
+                        });
+                    }
+                    numCores++;
+                }
+                else if(pass == 1 && info->Relationship == RelationCache)
+                {
+                    auto level = static_cast<uint32_t>(info->Cache.Level);
+                    ForEachCpuInMask(info->Cache.GroupMask, [&](uint32_t osIndex) {
+                        auto cpu = FindCpu(cpus, osIndex);
+                        if(cpu != nullptr && level > cacheLevels[cpu - cpus.data()])
+                        {
+                            cacheLevels[cpu - cpus.data()] = level;
+                            cpu->_lastLevelCacheId = numCaches;
+                        }
+                    });
+                    numCaches++;
+                }
+                else if(pass == 1 && info->Relationship == RelationNumaNode)
+                {
+                    ForEachCpuInMask(info->NumaNode.GroupMask, [&](uint32_t osIndex) {
+                        auto cpu = FindCpu(cpus, osIndex);
+                        if(cpu != nullptr)
+                        {
+                            cpu->_numaNode = info->NumaNode.NodeNumber;
+                        }
+                    });
+                }
+            }
+        }
+        return CpuTopology(std::move(cpus));
+    }
+
+    bool CpuTopology::PinCurrentThread(const LogicalCpu& cpu)
+    {
+        GROUP_AFFINITY groupAffinity = {};
+        groupAffinity.Group = static_cast<WORD>(cpu._osIndex / CpusPerGroup);
+        groupAffinity.Mask = static_cast<KAFFINITY>(1) << (cpu._osIndex % CpusPerGroup);
+        return SetThreadGroupAffinity(GetCurrentThread(), &groupAffinity, nullptr) != FALSE;
+    }
+}
+
+#endif
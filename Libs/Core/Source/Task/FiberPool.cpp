@@ -0,0 +1,55 @@
+#include "Task/FiberPool.h"
+
+#include <cassert>
+
+#include "Memory/AddressUtils.h"
+
+namespace Flourish
+{
+    FiberPool::FiberPool(Memory::MemoryArea* stackArea, size_t stackSize, Fiber::EntryFunction entryFunction, void* userData)
+        : _fibers(nullptr)
+        , _freeList(GetNumFibers(stackArea, stackSize))
+    {
+        auto numFibers = GetNumFibers();
+        assert(numFibers > 0); // The memory area isn't big enough for a single stack
+        stackSize -= stackSize % STACK_ALIGNMENT;
+        auto stack = static_cast<char*>(Memory::AddressUtils::AlignAddress(stackArea->GetData(), STACK_ALIGNMENT));
+        _fibers = new Fiber[numFibers];
+        for(uint32_t fiberIdx = 0; fiberIdx < numFibers; fiberIdx++)
+        {
+            _fibers[fiberIdx].Create(stack, stackSize, entryFunction, userData);
+            stack += stackSize;
+        }
+    }
+
+    FiberPool::~FiberPool()
+    {
+        delete[] _fibers;
+    }
+
+    Fiber* FiberPool::Acquire()
+    {
+        auto fiberIdx = _freeList.Pop();
+        if(fiberIdx == TaskFreeList::EMPTY)
+        {
+            return nullptr;
+        }
+        return &_fibers[fiberIdx];
+    }
+
+    void FiberPool::Release(Fiber* fiber)
+    {
+        _freeList.Push(static_cast<uint32_t>(fiber - _fibers));
+    }
+
+    uint32_t FiberPool::GetNumFibers(Memory::MemoryArea* stackArea, size_t stackSize)
+    {
+        stackSize -= stackSize % STACK_ALIGNMENT;
+        if(stackSize == 0 || stackArea->GetSize() < STACK_ALIGNMENT)
+        {
+            return 0;
+        }
+        // Leave room to align the start of the memory area
+        return static_cast<uint32_t>((stackArea->GetSize() - (STACK_ALIGNMENT - 1u)) / stackSize);
+    }
+}
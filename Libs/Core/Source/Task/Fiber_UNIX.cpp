@@ -0,0 +1,77 @@
+// macOS only declares the ucontext functions if this is defined before any system header
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 600
+#endif
+
+#include "Platform/Platform.h"
+#if FL_ENABLED(FL_PLATFORM_UNIX)
+
+#include "Task/Fiber.h"
+
+#include <cassert>
+#include <cstdint>
+#include <ucontext.h>
+
+#if defined(__clang__)
+// The ucontext functions are deprecated on macOS, but there is no replacement short of writing the context switch in assembly
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+namespace Flourish
+{
+    struct Fiber::Context
+    {
+        // makecontext can only pass int arguments, so the fiber pointer is split in two
+        static void Start(uint32_t fiberHigh, uint32_t fiberLow)
+        {
+            auto fiber = reinterpret_cast<Fiber*>((static_cast<uintptr_t>(fiberHigh) << 16u << 16u) | fiberLow);
+            fiber->_entryFunction(fiber->_userData);
+            assert(false); // Fiber entry functions must never return, there is nothing to return to
+        }
+
+        ucontext_t _ucontext;
+    };
+
+    Fiber::Fiber()
+        : _context(new Context())
+        , _entryFunction(nullptr)
+        , _userData(nullptr)
+    {
+    }
+
+    Fiber::~Fiber()
+    {
+        delete _context;
+    }
+
+    void Fiber::Create(void* stack, size_t stackSize, EntryFunction entryFunction, void* userData)
+    {
+        _entryFunction = entryFunction;
+        _userData = userData;
+        getcontext(&_context->_ucontext);
+        _context->_ucontext.uc_stack.ss_sp = stack;
+        _context->_ucontext.uc_stack.ss_size = stackSize;
+        _context->_ucontext.uc_link = nullptr;
+        auto fiberBits = reinterpret_cast<uintptr_t>(this);
+        makecontext(&_context->_ucontext, reinterpret_cast<void (*)()>(&Context::Start), 2,
+                    static_cast<uint32_t>(fiberBits >> 16u >> 16u), static_cast<uint32_t>(fiberBits));
+    }
+
+    void Fiber::ConvertCurrentThread()
+    {
+        // Nothing to do, the thread's context is saved the first time it switches away
+    }
+
+    void Fiber::RevertCurrentThread()
+    {
+    }
+
+    void Fiber::Switch(Fiber* from, Fiber* to)
+    {
+        auto result = swapcontext(&from->_context->_ucontext, &to->_context->_ucontext);
+        assert(result == 0);
+        (void)result;
+    }
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include "Platform/Platform.h"
+#if FL_ENABLED(FL_PLATFORM_WINDOWS)
+
+#include "Task/Fiber.h"
+
+#include <cassert>
+#include <windows.h>
+
+namespace Flourish
+{
+    struct Fiber::Context
+    {
+        static VOID CALLBACK Start(LPVOID parameter)
+        {
+            auto fiber = static_cast<Fiber*>(parameter);
+            fiber->_entryFunction(fiber->_userData);
+            assert(false); // Fiber entry functions must never return, the thread would exit
+        }
+
+        LPVOID _fiber;
+        bool _ownsFiber;
+    };
+
+    Fiber::Fiber()
+        : _context(new Context{ nullptr, false })
+        , _entryFunction(nullptr)
+        , _userData(nullptr)
+    {
+    }
+
+    Fiber::~Fiber()
+    {
+        if(_context->_ownsFiber)
+        {
+            DeleteFiber(_context->_fiber);
+        }
+        delete _context;
+    }
+
+    void Fiber::Create(void* stack, size_t stackSize, EntryFunction entryFunction, void* userData)
+    {
+        // Windows won't run a fiber on memory it didn't allocate, so the stack memory goes unused
+        (void)stack;
+        _entryFunction = entryFunction;
+        _userData = userData;
+        _context->_fiber = CreateFiber(stackSize, &Context::Start, this);
+        _context->_ownsFiber = true;
+        assert(_context->_fiber != nullptr);
+    }
+
+    void Fiber::ConvertCurrentThread()
+    {
+        _context->_fiber = ConvertThreadToFiber(nullptr);
+        assert(_context->_fiber != nullptr);
+    }
+
+    void Fiber::RevertCurrentThread()
+    {
+        ConvertFiberToThread();
+        _context->_fiber = nullptr;
+    }
+
+    void Fiber::Switch(Fiber* from, Fiber* to)
+    {
+        // Windows saves the current fiber itself
+        (void)from;
+        SwitchToFiber(to->_context->_fiber);
+    }
+}
+
+#endif
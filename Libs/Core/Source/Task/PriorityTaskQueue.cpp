@@ -0,0 +1,71 @@
+#include "Task/PriorityTaskQueue.h"
+
+namespace Flourish
+{
+    PriorityTaskQueue::PriorityTaskQueue(Memory::IAllocator* allocator)
+        : _queues{ TaskQueue(allocator), TaskQueue(allocator), TaskQueue(allocator) }
+        , _tasksSinceExecuted()
+    {
+    }
+
+    void PriorityTaskQueue::Push(Task* task)
+    {
+        _queues[static_cast<uint32_t>(task->_priority)].Push(task);
+    }
+
+    Task* PriorityTaskQueue::Pop(TaskPriority priority)
+    {
+        return _queues[static_cast<uint32_t>(priority)].Pop();
+    }
+
+    Task* PriorityTaskQueue::Steal(TaskPriority priority)
+    {
+        return _queues[static_cast<uint32_t>(priority)].Steal();
+    }
+
+    Task* PriorityTaskQueue::StealBatch(TaskPriority priority, PriorityTaskQueue* destination)
+    {
+        auto priorityIdx = static_cast<uint32_t>(priority);
+        return _queues[priorityIdx].StealBatch(&destination->_queues[priorityIdx]);
+    }
+
+    void PriorityTaskQueue::GetPriorityOrder(TaskPriority (&order)[NUM_TASK_PRIORITIES]) const
+    {
+        uint32_t orderIdx = 0;
+        // Aged priorities first, then the rest from highest to lowest
+        for(uint32_t priorityIdx = 0; priorityIdx < NUM_TASK_PRIORITIES; priorityIdx++)
+        {
+            if(IsAged(static_cast<TaskPriority>(priorityIdx)))
+            {
+                order[orderIdx++] = static_cast<TaskPriority>(priorityIdx);
+            }
+        }
+        for(uint32_t priorityIdx = 0; priorityIdx < NUM_TASK_PRIORITIES; priorityIdx++)
+        {
+            if(!IsAged(static_cast<TaskPriority>(priorityIdx)))
+            {
+                order[orderIdx++] = static_cast<TaskPriority>(priorityIdx);
+            }
+        }
+    }
+
+    void PriorityTaskQueue::OnTaskExecuted(TaskPriority priority)
+    {
+        for(uint32_t priorityIdx = 0; priorityIdx < NUM_TASK_PRIORITIES; priorityIdx++)
+        {
+            if(priorityIdx == static_cast<uint32_t>(priority))
+            {
+                _tasksSinceExecuted[priorityIdx] = 0;
+            }
+            else if(_tasksSinceExecuted[priorityIdx] < MAXIMUM_TASKS_BEFORE_AGING)
+            {
+                _tasksSinceExecuted[priorityIdx]++;
+            }
+        }
+    }
+
+    void PriorityTaskQueue::OnNoTaskFound(TaskPriority priority)
+    {
+        _tasksSinceExecuted[static_cast<uint32_t>(priority)] = 0;
+    }
+}
@@ -0,0 +1,130 @@
+#include "Task/TaskAllocator.h"
+
+#include "Memory/Memory.h"
+
+namespace Flourish
+{
+    thread_local TaskAllocator* TaskAllocator::_ownedByCurrentThread = nullptr;
+
+    TaskAllocator::TaskAllocator(Memory::IAllocator* backingAllocator)
+        : Memory::IAllocator("TaskAllocator")
+        , _backingAllocator(backingAllocator)
+        , _freeBlocks()
+        , _chunkPosition(nullptr)
+        , _chunkEnd(nullptr)
+        , _chunks()
+    {
+        for(auto& remoteFreeBlocks : _remoteFreeBlocks)
+        {
+            remoteFreeBlocks.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    TaskAllocator::~TaskAllocator()
+    {
+        for(auto chunk : _chunks)
+        {
+            FL_FREE_ALIGN(*_backingAllocator, chunk);
+        }
+    }
+
+    void TaskAllocator::SetOwnedByCurrentThread(TaskAllocator* allocator)
+    {
+        _ownedByCurrentThread = allocator;
+    }
+
+    FL_NO_INLINE TaskAllocator* TaskAllocator::GetOwnedByCurrentThread()
+    {
+        // Never inlined, so the compiler can't reuse the thread local's address from before
+        // a task waited on a fiber. It may have moved to another thread, and would then take
+        // blocks from that thread's free lists without owning them
+        return _ownedByCurrentThread;
+    }
+
+    void* TaskAllocator::Alloc(size_t size, const Debug::SourceInfo& sourceInfo)
+    {
+        FL_UNUSED(sourceInfo);
+        auto sizeClass = GetSizeClass(size);
+        if(sizeClass == BACKING_SIZE_CLASS || GetOwnedByCurrentThread() != this)
+        {
+            return AllocateFromBacking(size) + 1;
+        }
+
+        auto block = _freeBlocks[sizeClass];
+        if(block == nullptr && _remoteFreeBlocks[sizeClass].load(std::memory_order_relaxed) != nullptr)
+        {
+            // Take back everything other threads have freed since last time
+            block = _remoteFreeBlocks[sizeClass].exchange(nullptr, std::memory_order_acquire);
+        }
+        if(block == nullptr)
+        {
+            return AllocateFromChunk(sizeClass) + 1;
+        }
+        _freeBlocks[sizeClass] = block->_next;
+        return block + 1;
+    }
+
+    void TaskAllocator::Free(void* ptr)
+    {
+        auto block = static_cast<BlockHeader*>(ptr) - 1;
+        auto sizeClass = block->_sizeClass;
+        if(sizeClass == BACKING_SIZE_CLASS)
+        {
+            FL_FREE_ALIGN(*_backingAllocator, block);
+            return;
+        }
+        if(GetOwnedByCurrentThread() == this)
+        {
+            block->_next = _freeBlocks[sizeClass];
+            _freeBlocks[sizeClass] = block;
+            return;
+        }
+        // Release, so whatever the block was used for is done before the owner reuses it
+        auto& remoteFreeBlocks = _remoteFreeBlocks[sizeClass];
+        block->_next = remoteFreeBlocks.load(std::memory_order_relaxed);
+        while(!remoteFreeBlocks.compare_exchange_weak(block->_next, block, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    size_t TaskAllocator::GetAllocationSize(void* ptr)
+    {
+        auto block = static_cast<BlockHeader*>(ptr) - 1;
+        if(block->_sizeClass == BACKING_SIZE_CLASS)
+        {
+            return block->_size;
+        }
+        return MIN_BLOCK_SIZE << block->_sizeClass;
+    }
+
+    size_t TaskAllocator::GetMetaDataAllocationSize(void* ptr)
+    {
+        FL_UNUSED(ptr);
+        return sizeof(BlockHeader);
+    }
+
+    TaskAllocator::BlockHeader* TaskAllocator::AllocateFromBacking(size_t size)
+    {
+        auto block = static_cast<BlockHeader*>(FL_ALLOC_ALIGN(*_backingAllocator, sizeof(BlockHeader) + size, alignof(BlockHeader)));
+        block->_size = size;
+        block->_sizeClass = BACKING_SIZE_CLASS;
+        return block;
+    }
+
+    TaskAllocator::BlockHeader* TaskAllocator::AllocateFromChunk(uint32_t sizeClass)
+    {
+        auto blockSize = sizeof(BlockHeader) + (MIN_BLOCK_SIZE << sizeClass);
+        if(static_cast<size_t>(_chunkEnd - _chunkPosition) < blockSize)
+        {
+            // What's left of the old chunk is too small, so it goes unused
+            auto chunk = FL_ALLOC_ALIGN(*_backingAllocator, CHUNK_SIZE, alignof(BlockHeader));
+            _chunks.push_back(chunk);
+            _chunkPosition = static_cast<char*>(chunk);
+            _chunkEnd = _chunkPosition + CHUNK_SIZE;
+        }
+        auto block = reinterpret_cast<BlockHeader*>(_chunkPosition);
+        _chunkPosition += blockSize;
+        block->_sizeClass = sizeClass;
+        return block;
+    }
+}
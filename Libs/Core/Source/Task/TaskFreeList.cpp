@@ -0,0 +1,56 @@
+#include "Task/TaskFreeList.h"
+
+#include <cassert>
+
+namespace Flourish
+{
+    TaskFreeList::TaskFreeList(uint32_t capacity)
+        : _head(MakeHead(capacity > 0 ? 0 : EMPTY, 0))
+        , _next(new std::atomic<uint32_t>[capacity])
+        , _capacity(capacity)
+    {
+        assert(capacity < EMPTY); // EMPTY is reserved for the end of the list
+        for(uint32_t index = 0; index < capacity; index++)
+        {
+            auto next = index + 1;
+            _next[index].store(next < capacity ? next : EMPTY, std::memory_order_relaxed);
+        }
+    }
+
+    TaskFreeList::~TaskFreeList()
+    {
+        delete[] _next;
+    }
+
+    uint32_t TaskFreeList::Pop()
+    {
+        auto head = _head.load(std::memory_order_acquire);
+        while(true)
+        {
+            auto index = GetIndex(head);
+            if(index == EMPTY)
+            {
+                return EMPTY;
+            }
+            // _next[index] may be changed under us if another thread pops and
+            // pushes this index back, but then the tag will have changed and
+            // the exchange below fails
+            auto next = _next[index].load(std::memory_order_relaxed);
+            if(_head.compare_exchange_weak(head, MakeHead(next, GetTag(head) + 1), std::memory_order_acquire, std::memory_order_acquire))
+            {
+                return index;
+            }
+        }
+    }
+
+    void TaskFreeList::Push(uint32_t index)
+    {
+        assert(index < _capacity);
+        auto head = _head.load(std::memory_order_relaxed);
+        do
+        {
+            _next[index].store(GetIndex(head), std::memory_order_relaxed);
+        }
+        while(!_head.compare_exchange_weak(head, MakeHead(index, GetTag(head)), std::memory_order_release, std::memory_order_relaxed));
+    }
+}
@@ -0,0 +1,105 @@
+#include "Task/TaskFreeQueue.h"
+
+#include <cassert>
+
+namespace Flourish
+{
+    namespace
+    {
+        uint32_t RoundUpToPowerOf2(uint32_t value)
+        {
+            uint32_t powerOf2 = 1u;
+            while(powerOf2 < value)
+            {
+                powerOf2 <<= 1u;
+            }
+            return powerOf2;
+        }
+    }
+
+    TaskFreeQueue::TaskFreeQueue(uint32_t capacity)
+        : _pushPosition(capacity)
+        , _popPosition(0)
+        , _cells(new Cell[RoundUpToPowerOf2(capacity)])
+        , _mask(RoundUpToPowerOf2(capacity) - 1u)
+        , _capacity(capacity)
+    {
+        assert(capacity < (1u << 31u)); // Distance has to be able to tell positions apart
+        // The first capacity cells hold every index, as if they'd been pushed, and the
+        // rest are waiting to be pushed to
+        for(uint32_t cellIdx = 0; cellIdx <= _mask; cellIdx++)
+        {
+            _cells[cellIdx]._sequence.store(cellIdx < capacity ? cellIdx + 1u : cellIdx, std::memory_order_relaxed);
+            _cells[cellIdx]._index = cellIdx;
+        }
+    }
+
+    TaskFreeQueue::~TaskFreeQueue()
+    {
+        delete[] _cells;
+    }
+
+    uint32_t TaskFreeQueue::Pop()
+    {
+        auto position = _popPosition.load(std::memory_order_relaxed);
+        while(true)
+        {
+            auto& cell = _cells[position & _mask];
+            // Acquire, so the index written by the Push is visible
+            auto distance = Distance(position + 1u, cell._sequence.load(std::memory_order_acquire));
+            if(distance == 0)
+            {
+                if(_popPosition.compare_exchange_weak(position, position + 1u, std::memory_order_relaxed))
+                {
+                    auto index = cell._index;
+                    // Ready for the Push that wraps around to this cell
+                    cell._sequence.store(position + _mask + 1u, std::memory_order_release);
+                    return index;
+                }
+            }
+            else if(distance < 0)
+            {
+                // Nothing has been pushed to this position yet
+                return EMPTY;
+            }
+            else
+            {
+                // Another thread popped this position first
+                position = _popPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void TaskFreeQueue::Push(uint32_t index)
+    {
+        assert(index < _capacity);
+        auto position = _pushPosition.load(std::memory_order_relaxed);
+        while(true)
+        {
+            auto& cell = _cells[position & _mask];
+            auto distance = Distance(position, cell._sequence.load(std::memory_order_acquire));
+            if(distance == 0)
+            {
+                if(_pushPosition.compare_exchange_weak(position, position + 1u, std::memory_order_relaxed))
+                {
+                    cell._index = index;
+                    // Release, so the Pop that sees the sequence sees the index
+                    cell._sequence.store(position + 1u, std::memory_order_release);
+                    return;
+                }
+            }
+            else if(distance < 0)
+            {
+                // The ring can't be full, as there are never more free indices than slots,
+                // but the Pop that took the index last in this cell hasn't finished with
+                // it yet. It's only a few instructions from doing so
+                position = _pushPosition.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                // Another thread pushed to this position first
+                position = _pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#include "Task/TaskGroup.h"
+
+namespace Flourish
+{
+    TaskGroup::TaskGroup(TaskManager* taskManager)
+        : _taskManager(taskManager)
+        , _cancelled(false)
+        , _numUnfinished(1)
+        , _allFinishedTask(taskManager->BeginAdd(WorkItem::Empty()))
+    {
+    }
+
+    TaskGroup::~TaskGroup()
+    {
+        auto allFinishedTask = _allFinishedTask;
+        OnTaskFinished();
+        _taskManager->Wait(allFinishedTask);
+    }
+
+    TaskId TaskGroup::BeginAdd(WorkItem workItem, TaskPriority priority)
+    {
+        // Counted before the task exists, so the count can't reach zero while it's being added
+        _numUnfinished.fetch_add(1, std::memory_order_relaxed);
+        auto id = _taskManager->BeginAdd(std::move(workItem), priority);
+        // Nothing can run the task until FinishAdd
+        _taskManager->GetTaskFromId(id)->_group = this;
+        return id;
+    }
+
+    TaskId TaskGroup::AddTaskWithNoChildrenOrDependencies(WorkItem workItem, TaskPriority priority)
+    {
+        auto taskId = BeginAdd(std::move(workItem), priority);
+        FinishAdd(taskId);
+        return taskId;
+    }
+
+    void TaskGroup::WaitAll()
+    {
+        auto allFinishedTask = _allFinishedTask;
+        // Let go of the group's own count, so the last task to finish adds allFinishedTask
+        OnTaskFinished();
+        _taskManager->Wait(allFinishedTask);
+        _allFinishedTask = _taskManager->BeginAdd(WorkItem::Empty());
+        _numUnfinished.store(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,70 @@
+#include "Task/TaskInjectionQueue.h"
+
+namespace Flourish
+{
+    TaskInjectionQueue::TaskInjectionQueue()
+        : _head(&_stub)
+        , _tail(&_stub)
+        , _consumerLock()
+        , _stub()
+    {
+        _consumerLock.clear();
+    }
+
+    void TaskInjectionQueue::Push(Task* task)
+    {
+        task->_nextInjected.store(nullptr, std::memory_order_relaxed);
+        auto previous = _head.exchange(task, std::memory_order_acq_rel);
+        // Until this store the task isn't reachable from the tail, Pop sees
+        // that as the queue being empty
+        previous->_nextInjected.store(task, std::memory_order_release);
+    }
+
+    Task* TaskInjectionQueue::Pop()
+    {
+        if(_consumerLock.test_and_set(std::memory_order_acquire))
+        {
+            // Another thread is popping
+            return nullptr;
+        }
+        auto task = PopWithLock();
+        _consumerLock.clear(std::memory_order_release);
+        return task;
+    }
+
+    Task* TaskInjectionQueue::PopWithLock()
+    {
+        auto tail = _tail;
+        auto next = tail->_nextInjected.load(std::memory_order_acquire);
+        if(tail == &_stub)
+        {
+            if(next == nullptr)
+            {
+                return nullptr;
+            }
+            // Skip over the stub
+            _tail = next;
+            tail = next;
+            next = next->_nextInjected.load(std::memory_order_acquire);
+        }
+        if(next != nullptr)
+        {
+            _tail = next;
+            return tail;
+        }
+        if(tail != _head.load(std::memory_order_acquire))
+        {
+            // A push is half done
+            return nullptr;
+        }
+        // The tail is the last task, put the stub back behind it so it can be removed
+        Push(&_stub);
+        next = tail->_nextInjected.load(std::memory_order_acquire);
+        if(next != nullptr)
+        {
+            _tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+}
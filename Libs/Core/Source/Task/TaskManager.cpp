@@ -2,46 +2,93 @@
 
 #include <cassert>
 
-#include "Task/TaskQueue.h"
+#include "Platform/PlatformFeatures.h"
+#include "Task/Fiber.h"
+#include "Task/FiberPool.h"
+#include "Task/PriorityTaskQueue.h"
+#include "Task/TaskGroup.h"
+
+// Records an event on the current thread's ring, if it has one. The arguments
+// aren't evaluated when profiling is off
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+    #define FL_RECORD_TASK_EVENT(...) \
+        do \
+        { \
+            auto eventRing = GetCurrentThreadEventRing(); \
+            if(eventRing != nullptr) \
+            { \
+                eventRing->Record(__VA_ARGS__); \
+            } \
+        } while(false)
+#else
+    #define FL_RECORD_TASK_EVENT(...) do {} while(false)
+#endif
 
 namespace Flourish
 {
-    struct RootAndDependencies
+    struct TaskManager::FiberThreadState
     {
-        RootAndDependencies(TaskManager* taskManager, TaskId root, std::vector<TaskId> dependencies)
+        FiberThreadState()
+            : _threadFiber()
+            , _currentFiber(nullptr)
+            , _previousFiber(nullptr)
+            , _previousFiberAction(FiberAction::None)
+            , _previousFiberWaitingOn(0)
+            , _runningPinnedTask(false)
         {
-            _taskManager = taskManager;
-            _root = root;
-            _dependencies = std::move(dependencies);
         }
         
-        TaskManager* _taskManager;
-        TaskId _root;
-        std::vector<TaskId> _dependencies;
+        // Where the worker thread was before it started running fibers
+        Fiber _threadFiber;
+        Fiber* _currentFiber;
+        Fiber* _previousFiber;
+        FiberAction _previousFiberAction;
+        TaskId _previousFiberWaitingOn;
+        // Set while a pinned task is anywhere on the current fiber's stack, so a Wait
+        // helps instead of switching away and letting another thread carry on with it
+        bool _runningPinnedTask;
     };
     
-    void WaitForRootThenAddDependencies(void* data)
-    {
-        auto rootAndDependencies = static_cast<RootAndDependencies*>(data);
-        rootAndDependencies->_taskManager->Wait(rootAndDependencies->_root);
-        for(auto& dependancy : rootAndDependencies->_dependencies)
-        {
-            rootAndDependencies->_taskManager->FinishAdd(dependancy);
-        }
-        delete rootAndDependencies;
-    }
+    thread_local PriorityTaskQueue* TaskManager::_currentThreadTaskQueue = nullptr;
+    thread_local TaskManager::ThreadMailbox* TaskManager::_currentThreadMailbox = nullptr;
+    thread_local TaskManager::StealOrder* TaskManager::_currentThreadStealOrder = nullptr;
+    thread_local uint32_t TaskManager::_currentThreadRandomState = 0;
+    thread_local Memory::IAllocator* TaskManager::_currentThreadAllocator = nullptr;
+    thread_local TaskManager::FiberThreadState* TaskManager::_currentFiberThreadState = nullptr;
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+    thread_local TaskEventRing* TaskManager::_currentThreadEventRing = nullptr;
+#endif
     
-    thread_local TaskQueue* TaskManager::_currentThreadTaskQueue = nullptr;
-    
-	TaskManager::TaskManager(int32_t numThreads)
-		: _nextTaskId(1)
-        , _allTasks(nullptr)
+	TaskManager::TaskManager(int32_t numThreads, uint32_t idleSpinCount, Memory::MemoryArea* fiberStackArea, size_t fiberStackSize)
+		: _heapAllocator("TaskManager")
+        , _threadAllocators()
+        , _taskPool(MaxConcurrentTasks)
+        , _dependencies(new TaskDependency[MaxConcurrentDependencies])
+        , _dependencyFreeList(MaxConcurrentDependencies)
         , _numThreads(numThreads)
 		, _workerThreads(nullptr)
         , _taskQueues(nullptr)
+        , _stealOrders(nullptr)
+        , _mailboxes(nullptr)
+        , _taskThreadGate(idleSpinCount)
+        , _numIdleThreads(0)
+        , _stealsBatches(true)
         , _exiting(false)
+        , _fiberPool(nullptr)
+        , _fiberThreadStates(nullptr)
+        , _numWaitingFibers(0)
+        , _timerWheel(std::chrono::steady_clock::now())
+        , _periodicTimers()
+        , _nextTimerId(0)
+        , _nextTimerTick(TaskTimerWheel::NO_TICK)
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+        , _profiler(nullptr)
+#endif
 	{
-        CreateTasks();
+        if(fiberStackArea != nullptr)
+        {
+            _fiberPool = new FiberPool(fiberStackArea, fiberStackSize, &TaskManager::FiberMain, this);
+        }
 		CreateAndStartWorkerThreads();
 	}
 
@@ -54,27 +101,101 @@ namespace Flourish
             _workerThreads[threadIdx].join();
         }
 		delete[] _workerThreads;
-        delete _currentThreadTaskQueue;
+        assert(_waitingFibers.empty()); // A task was still waiting when the TaskManager was destroyed
+        delete[] _fiberThreadStates;
+        delete _fiberPool;
+        _currentThreadTaskQueue = nullptr;
+        _currentThreadMailbox = nullptr;
+        _currentThreadStealOrder = nullptr;
+        _currentThreadAllocator = nullptr;
+        TaskAllocator::SetOwnedByCurrentThread(nullptr);
+        TaskParkingLot::SetCurrentThreadSpot(nullptr);
+        for (uint32_t queueIdx = 0; queueIdx < _numThreads + 1; queueIdx++)
+        {
+            delete _taskQueues[queueIdx];
+        }
         delete[] _taskQueues;
+        delete[] _mailboxes;
+        delete[] _stealOrders;
+        delete[] _dependencies;
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+        _currentThreadEventRing = nullptr;
+        delete _profiler;
+#endif
 	}
 
-	TaskId TaskManager::BeginAdd(WorkItem workItem)
+	TaskId TaskManager::BeginAdd(WorkItem workItem, TaskPriority priority)
 	{
-        TaskId taskId = _nextTaskId++;
-        auto task = GetTaskFromId(taskId);
-		task->_id = taskId;
+        auto task = AllocateTask();
 		task->_workItem = std::move(workItem);
+        task->_parentId = 0;
+        task->_priority = priority;
         task->_added = false;
+        task->_threadAffinity = ThreadAffinity::AnyThread();
+        task->_group = nullptr;
         task->_openWorkItems = 1;
-		return task->_id;
+        task->_unfinishedDependencies = 1;
+        auto id = task->_id.load(std::memory_order_relaxed);
+        task->_dependents.store(MakeDependentsHead(id, NO_DEPENDENTS), std::memory_order_release);
+		return id;
 	}
     
-    TaskId TaskManager::AddDependentTasks(TaskId root, std::vector<TaskId> dependencies)
+    TaskId TaskManager::BeginAdd(WorkItem workItem, ThreadAffinity threadAffinity, TaskPriority priority)
+    {
+        assert(threadAffinity.IsAnyThread() || threadAffinity._threadIdx <= _numThreads); // There's no thread with that index
+        auto id = BeginAdd(std::move(workItem), priority);
+        // Nothing can queue the task until FinishAdd
+        GetTaskFromId(id)->_threadAffinity = threadAffinity;
+        return id;
+    }
+    
+    TaskId TaskManager::AddDependentTasks(TaskId root, const std::vector<TaskId>& dependencies)
+    {
+        for(auto dependency : dependencies)
+        {
+            AddDependency(root, dependency);
+            FinishAdd(dependency);
+        }
+        return root;
+    }
+    
+    void TaskManager::AddDependency(TaskId root, TaskId dependent)
     {
-        WorkItem waitForRootThenAddDependencies(&WaitForRootThenAddDependencies, new RootAndDependencies(this, root, std::move(dependencies)));
-        auto wrapperTaskId = BeginAdd(waitForRootThenAddDependencies);
-        FinishAdd(wrapperTaskId);
-        return wrapperTaskId;
+        auto dependentTask = GetTaskFromId(dependent);
+        if(dependentTask == nullptr)
+        {
+            return;
+        }
+        assert(!dependentTask->_added); // Dependencies must be added before FinishAdd
+        auto rootTask = GetTaskFromId(root);
+        if(rootTask == nullptr)
+        {
+            // Already finished
+            return;
+        }
+        dependentTask->_unfinishedDependencies++;
+        
+        auto dependencyIdx = AllocateDependency();
+        _dependencies[dependencyIdx]._dependent = dependent;
+        // The owner is part of the head, so if the root finishes and its slot is
+        // reused while we are adding to it the exchange fails instead of adding
+        // to the list of an unrelated task
+        auto head = rootTask->_dependents.load(std::memory_order_acquire);
+        while(true)
+        {
+            if(GetDependentsOwner(head) != root || GetFirstDependency(head) == DEPENDENTS_CLOSED)
+            {
+                // The root finished before we could add to it
+                _dependencyFreeList.Push(dependencyIdx);
+                ReleaseDependency(dependentTask);
+                return;
+            }
+            _dependencies[dependencyIdx]._next = GetFirstDependency(head);
+            if(rootTask->_dependents.compare_exchange_weak(head, MakeDependentsHead(root, dependencyIdx), std::memory_order_release, std::memory_order_acquire))
+            {
+                return;
+            }
+        }
     }
     
     void TaskManager::AddChild(TaskId parent, TaskId child)
@@ -100,50 +221,181 @@ namespace Flourish
         {
             assert(!task->_added); // If this is hit a task was added twice
             task->_added = true;
-            _currentThreadTaskQueue->Push(task);
-            _taskThreadGate.OpenAndNotifyOne();
+            ReleaseDependency(task);
         }
     }
     
-    TaskId TaskManager::AddTaskWithNoChildrenOrDependencies(Flourish::WorkItem workItem)
+    TaskId TaskManager::AddTaskWithNoChildrenOrDependencies(Flourish::WorkItem workItem, TaskPriority priority)
     {
-        auto taskId = BeginAdd(std::move(workItem));
+        auto taskId = BeginAdd(std::move(workItem), priority);
         FinishAdd(taskId);
         return taskId;
     }
 
+    TaskId TaskManager::AddDelayed(WorkItem workItem, std::chrono::microseconds delay, TaskPriority priority)
+    {
+        // The task is begun now, so it can be waited on, and finished when the timer fires
+        auto taskId = BeginAdd(std::move(workItem), priority);
+        AddTimer(new TaskTimerWheel::Timer{ nullptr, nullptr, 0, 0, taskId, WorkItem::Empty(), priority, 0 }, delay);
+        return taskId;
+    }
+    
+    TimerId TaskManager::AddPeriodic(WorkItem workItem, std::chrono::microseconds period, TaskPriority priority)
+    {
+        // Rounded up, so a period that isn't a whole number of ticks never fires early
+        auto tickCount = static_cast<uint64_t>(TaskTimerWheel::TICK_DURATION.count());
+        uint64_t periodTicks = (static_cast<uint64_t>(period.count()) + tickCount - 1u) / tickCount;
+        auto timer = new TaskTimerWheel::Timer{ nullptr, nullptr, 0, periodTicks != 0 ? periodTicks : 1, 0, std::move(workItem), priority, 0 };
+        {
+            std::lock_guard<std::mutex> lock(_timerMutex);
+            timer->_id = _nextTimerId++;
+            _periodicTimers.emplace(timer->_id, timer);
+        }
+        auto id = timer->_id;
+        AddTimer(timer, period);
+        return id;
+    }
+    
+    void TaskManager::CancelPeriodic(TimerId id)
+    {
+        std::lock_guard<std::mutex> lock(_timerMutex);
+        auto periodicTimer = _periodicTimers.find(id);
+        if(periodicTimer == _periodicTimers.end())
+        {
+            return;
+        }
+        // Timers are only out of the wheel while the lock is held
+        _timerWheel.Remove(periodicTimer->second);
+        delete periodicTimer->second;
+        _periodicTimers.erase(periodicTimer);
+        _nextTimerTick.store(_timerWheel.GetNextTick(), std::memory_order_relaxed);
+    }
+
+    uint32_t TaskManager::PumpMainThread(std::chrono::microseconds budget)
+    {
+        assert(GetCurrentThreadMailbox() == &_mailboxes[0]); // Only the thread that created the TaskManager can pump its mailbox
+        auto deadline = std::chrono::steady_clock::now() + budget;
+        uint32_t numTasksRun = 0;
+        while(std::chrono::steady_clock::now() < deadline)
+        {
+            auto task = GetTaskFromCurrentThreadMailbox();
+            if(task == nullptr)
+            {
+                break;
+            }
+            ExecuteTask(task);
+            numTasksRun++;
+        }
+        return numTasksRun;
+    }
+
 	void TaskManager::Wait(TaskId id)
 	{
-        auto task = GetTaskFromId(id);
-        if(task == nullptr)
+        auto fiberThreadState = _fiberPool != nullptr ? GetCurrentFiberThreadState() : nullptr;
+        if(fiberThreadState != nullptr && !fiberThreadState->_runningPinnedTask)
         {
+            WaitOnFiber(id);
             return;
         }
-		while (task->_openWorkItems > 0)
+		while (!IsComplete(id))
 		{
-            WaitForTaskAndExecute(std::chrono::milliseconds(100));
+            auto task = GetTaskToExecute();
+            if(task != nullptr)
+            {
+                ExecuteTask(task);
+                continue;
+            }
+            // Someone else is running what's left of the task
+            auto sleepDuration = MaxWaitSleepDuration;
+            std::chrono::microseconds timeUntilNextTimer;
+            if(GetTimeUntilNextTimer(timeUntilNextTimer) && timeUntilNextTimer < sleepDuration)
+            {
+                // We may be the only thread that can queue it
+                sleepDuration = timeUntilNextTimer > std::chrono::microseconds::zero() ? timeUntilNextTimer : std::chrono::microseconds::zero();
+            }
+            FL_RECORD_TASK_EVENT(TaskEventType::Park, id);
+            auto mailbox = GetCurrentThreadMailbox();
+            if(mailbox != nullptr)
+            {
+                // Only we can run a task pinned to this thread, so one turning up has to wake us.
+                // Whatever we were waiting on further up the stack is put back afterwards
+                auto outerWaitingOn = mailbox->_waitingOn.exchange(id);
+                _taskWaitTable.WaitForCompletion(id, sleepDuration, [&] { return IsComplete(id) || mailbox->_numTasks.load() != 0; });
+                mailbox->_waitingOn.store(outerWaitingOn);
+            }
+            else
+            {
+                _taskWaitTable.WaitForCompletion(id, sleepDuration, [&] { return IsComplete(id); });
+            }
+            FL_RECORD_TASK_EVENT(TaskEventType::Unpark, id);
 		}
 	}
     
-    void TaskManager::CreateTasks()
+    bool TaskManager::IsComplete(TaskId id)
     {
-        _allTasks = new Task[MaxConcurrentTasks];
+        auto task = _taskPool.GetTask(id);
+        if(task == nullptr)
+        {
+            return true;
+        }
+        if(task->_openWorkItems == 0)
+        {
+            return true;
+        }
+        // The task may have finished and its slot been reused since we looked it up
+        return task->_id.load(std::memory_order_acquire) != id;
     }
 
 	void TaskManager::CreateAndStartWorkerThreads()
 	{
+        auto topology = CpuTopology::Detect();
+        std::vector<uint32_t> threadCpus;
         if(static_cast<int32_t>(_numThreads) == TaskManager::AutomaticallyDetectNumThreads)
         {
-            _numThreads = GetIdealNumThreads();
+            _numThreads = GetIdealNumThreads(topology);
+            // The first CPU is left for the thread creating the TaskManager. It isn't pinned,
+            // it's up to whoever owns it where it runs
+            auto placementOrder = topology.GetPlacementOrder();
+            threadCpus.push_back(NO_CPU);
+            for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+            {
+                auto cpuIdx = placementOrder[threadIdx + 1];
+                threadCpus.push_back(cpuIdx);
+                _workerCpus.push_back(topology.GetCpu(cpuIdx));
+            }
+        }
+        else
+        {
+            threadCpus.assign(_numThreads + 1, NO_CPU);
         }
         _workerThreads = new std::thread[_numThreads];
-        _taskQueues = new TaskQueue*[_numThreads + 1]; // The current, non-worker thread also gets a queue
+        if(_fiberPool != nullptr)
+        {
+            // Each worker needs a fiber to run on, and at least one more to switch to when a task waits
+            assert(_fiberPool->GetNumFibers() > _numThreads);
+            _fiberThreadStates = new FiberThreadState[_numThreads];
+        }
+        // Every thread with a queue gets its own allocator
+        _threadAllocators.reserve(_numThreads + 1);
+        for(uint32_t allocatorIdx = 0; allocatorIdx < _numThreads + 1; allocatorIdx++)
+        {
+            _threadAllocators.emplace_back(new TaskAllocator(&_heapAllocator));
+        }
+        // The queues are all created up front, so a thread can steal from
+        // a worker's queue before the worker has started
+        _taskQueues = new PriorityTaskQueue*[_numThreads + 1]; // The current, non-worker thread also gets a queue
         for(uint32_t queueIdx = 0; queueIdx < _numThreads + 1; queueIdx++)
         {
-            _taskQueues[queueIdx] = nullptr;
+            _taskQueues[queueIdx] = new PriorityTaskQueue(_threadAllocators[queueIdx].get());
         }
+        // Likewise tasks can be pinned to a worker before it has started
+        _mailboxes = new ThreadMailbox[_numThreads + 1];
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+        _profiler = new TaskProfiler(_numThreads + 1);
+#endif
+        CreateStealOrders(topology, threadCpus);
         
-        CreateTaskQueueForCurrentThread(0);
+        SetTaskQueueForCurrentThread(0);
         
 		for (uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
 		{
@@ -153,91 +405,648 @@ namespace Flourish
 
 	void TaskManager::WorkerThreadFunc(int32_t threadIdx)
 	{
-        CreateTaskQueueForCurrentThread(threadIdx);
+        if(!_workerCpus.empty())
+        {
+            // If it can't be pinned it still works, the OS just moves it around
+            CpuTopology::PinCurrentThread(_workerCpus[threadIdx - 1]);
+        }
+        SetTaskQueueForCurrentThread(threadIdx);
+        if(_fiberPool != nullptr)
+        {
+            RunWorkerFibers(threadIdx);
+            return;
+        }
 		while(!_exiting)
 		{
             WaitForTaskAndExecute();
 		}
-        delete _currentThreadTaskQueue;
 	}
     
-	void TaskManager::WaitForTaskAndExecute(std::chrono::milliseconds waitDuration)
+	void TaskManager::WaitForTaskAndExecute(std::chrono::microseconds waitDuration)
     {
         auto task = GetTaskToExecute();
         if(task == nullptr)
         {
+            // Sleep no later than the next timer is due
+            std::chrono::microseconds timeUntilNextTimer;
+            if(GetTimeUntilNextTimer(timeUntilNextTimer))
+            {
+                if(timeUntilNextTimer <= std::chrono::microseconds::zero())
+                {
+                    // Due now, go round again and queue it
+                    return;
+                }
+                if(waitDuration == std::chrono::microseconds::zero() || timeUntilNextTimer < waitDuration)
+                {
+                    waitDuration = timeUntilNextTimer;
+                }
+            }
             // Wait for a more work
-            _taskThreadGate.Wait(waitDuration);
+            _numIdleThreads.fetch_add(1, std::memory_order_relaxed);
+            // The gate only lets one thread through each time it's opened, a task
+            // pinned to this thread has to wake this thread and no other
+            auto mailbox = GetCurrentThreadMailbox();
+            FL_RECORD_TASK_EVENT(TaskEventType::Park, INVALID_TASK_ID);
+            _taskThreadGate.Wait(waitDuration, [mailbox] { return mailbox != nullptr && mailbox->_numTasks.load() != 0; });
+            FL_RECORD_TASK_EVENT(TaskEventType::Unpark, INVALID_TASK_ID);
+            _numIdleThreads.fetch_sub(1, std::memory_order_relaxed);
             return;
         }
-        task->_workItem();
+        ExecuteTask(task);
+    }
+    
+    void TaskManager::ExecuteTask(Task* task)
+    {
+        // Pinned tasks don't come from the priority queues, so they don't count towards their balance
+        auto taskQueue = GetCurrentThreadTaskQueue();
+        if(taskQueue != nullptr && task->_threadAffinity.IsAnyThread())
+        {
+            taskQueue->OnTaskExecuted(task->_priority);
+        }
+        FL_RECORD_TASK_EVENT(TaskEventType::Begin, task->_id.load(std::memory_order_relaxed));
+        auto fiberThreadState = _fiberPool != nullptr ? GetCurrentFiberThreadState() : nullptr;
+        if(task->_group != nullptr && task->_group->IsCancelled())
+        {
+            // The group was cancelled before the task started, so it finishes without running
+        }
+        else if(fiberThreadState == nullptr)
+        {
+            task->_workItem();
+        }
+        else
+        {
+            // Anything the pinned task runs while helping is on the same stack, so it's pinned too
+            auto wasRunningPinnedTask = fiberThreadState->_runningPinnedTask;
+            fiberThreadState->_runningPinnedTask = wasRunningPinnedTask || !task->_threadAffinity.IsAnyThread();
+            task->_workItem();
+            // The task may have carried on on another thread if it wasn't pinned
+            GetCurrentFiberThreadState()->_runningPinnedTask = wasRunningPinnedTask;
+        }
+        // The task isn't finished yet, so its id is still valid
+        FL_RECORD_TASK_EVENT(TaskEventType::End, task->_id.load(std::memory_order_relaxed));
+        // Release anything the work item captured now, rather than when the task is reused
+        task->_workItem.Reset();
         FinishTask(task);
     }
     
-    int32_t TaskManager::GetIdealNumThreads()
+    int32_t TaskManager::GetIdealNumThreads(const CpuTopology& topology)
+    {
+        auto numCpus = topology.GetNumCpus();
+        assert(numCpus != 0);
+        return numCpus - 1;
+    }
+    
+    void TaskManager::CreateStealOrders(const CpuTopology& topology, const std::vector<uint32_t>& threadCpus)
+    {
+        _stealOrders = new StealOrder[_numThreads + 2];
+        for(uint32_t threadIdx = 0; threadIdx < _numThreads + 2; threadIdx++)
+        {
+            // Threads without a queue of their own could be anywhere. So could threads that
+            // aren't pinned, so their queues are treated as being on another node
+            auto threadCpu = threadIdx < _numThreads + 1 ? threadCpus[threadIdx] : NO_CPU;
+            auto& stealOrder = _stealOrders[threadIdx];
+            for(uint32_t distanceIdx = 0; distanceIdx < NUM_CPU_DISTANCES; distanceIdx++)
+            {
+                auto distance = static_cast<CpuDistance>(distanceIdx);
+                for(uint32_t queueIdx = 0; queueIdx < _numThreads + 1; queueIdx++)
+                {
+                    // A thread pops from its own queue before stealing
+                    if(queueIdx == threadIdx)
+                    {
+                        continue;
+                    }
+                    auto queueCpu = threadCpus[queueIdx];
+                    auto queueDistance = threadCpu == NO_CPU || queueCpu == NO_CPU ? CpuDistance::Remote : topology.GetDistance(threadCpu, queueCpu);
+                    if(queueDistance == distance)
+                    {
+                        stealOrder._queueIndices.push_back(queueIdx);
+                    }
+                }
+                stealOrder._distanceEnds[distanceIdx] = static_cast<uint32_t>(stealOrder._queueIndices.size());
+            }
+        }
+    }
+    
+    uint32_t TaskManager::GetRandomNumber()
     {
-        auto numConcurrentThreads = std::thread::hardware_concurrency();
-        assert(numConcurrentThreads != 0); // If you hit this, it can't be detected
-        return numConcurrentThreads - 1;
+        // Xorshift, it only has to be cheap and different on each thread
+        auto& currentState = GetCurrentThreadRandomState();
+        auto state = currentState;
+        if(state == 0)
+        {
+            state = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&currentState)) | 1u;
+        }
+        state ^= state << 13u;
+        state ^= state >> 17u;
+        state ^= state << 5u;
+        currentState = state;
+        return state;
     }
     
     Task* TaskManager::GetTaskToExecute()
     {
-        auto task = _currentThreadTaskQueue->Pop();
-        if(task != nullptr)
+        QueueDueTimers();
+        // Nobody else can run what's been pinned to this thread, so it comes first
+        auto pinnedTask = GetTaskFromCurrentThreadMailbox();
+        if(pinnedTask != nullptr)
         {
-            return task;
+            return pinnedTask;
         }
-        // Try stealing from one of the other queues
-        // This will actually check the current thread queue again, but that's okay
-        for (uint32_t queueIdx = 0; queueIdx < _numThreads + 1; queueIdx++)
+        TaskPriority priorityOrder[NUM_TASK_PRIORITIES] = { TaskPriority::High, TaskPriority::Normal, TaskPriority::Background };
+        // Priorities that have already been looked for everywhere
+        uint32_t searchedPriorities = 0;
+        auto taskQueue = GetCurrentThreadTaskQueue();
+        if(taskQueue != nullptr)
         {
-            auto queueToStealFrom = _taskQueues[queueIdx];
-            if(queueToStealFrom == nullptr)
+            taskQueue->GetPriorityOrder(priorityOrder);
+            // Every priority on our own queue before anywhere else, as even looking at an empty
+            // queue on another thread costs cache misses. A priority that has gone too long
+            // without running is looked for everywhere before anything lower is popped, so
+            // a high priority task on another queue still waits at most a few tasks
+            for(auto priority : priorityOrder)
+            {
+                auto task = taskQueue->Pop(priority);
+                if(task != nullptr)
+                {
+                    return task;
+                }
+                if(taskQueue->IsAged(priority))
+                {
+                    task = StealTaskToExecute(priority);
+                    if(task != nullptr)
+                    {
+                        return task;
+                    }
+                    taskQueue->OnNoTaskFound(priority);
+                    searchedPriorities |= 1u << static_cast<uint32_t>(priority);
+                }
+            }
+        }
+        for(auto priority : priorityOrder)
+        {
+            if((searchedPriorities & (1u << static_cast<uint32_t>(priority))) != 0)
             {
                 continue;
             }
-            auto stolenTask = queueToStealFrom->Steal();
-            if(stolenTask != nullptr)
+            auto task = StealTaskToExecute(priority);
+            if(task != nullptr)
             {
-                return stolenTask;
+                return task;
+            }
+            if(taskQueue != nullptr)
+            {
+                taskQueue->OnNoTaskFound(priority);
             }
         }
         return nullptr;
     }
     
-    Task* TaskManager::GetTaskFromId(TaskId id)
+    Task* TaskManager::StealTaskToExecute(TaskPriority priority)
+    {
+        auto taskQueue = GetCurrentThreadTaskQueue();
+        auto stealsBatches = taskQueue != nullptr && _stealsBatches.load(std::memory_order_relaxed);
+        // Try stealing from one of the other queues, nearest first
+        auto stealOrder = GetCurrentThreadStealOrder();
+        if(stealOrder == nullptr)
+        {
+            stealOrder = &_stealOrders[_numThreads + 1];
+        }
+        uint32_t distanceStart = 0;
+        for(auto distanceEnd : stealOrder->_distanceEnds)
+        {
+            auto numQueues = distanceEnd - distanceStart;
+            auto firstQueue = numQueues > 1 ? GetRandomNumber() % numQueues : 0;
+            for(uint32_t queueOffset = 0; queueOffset < numQueues; queueOffset++)
+            {
+                auto queueIdx = stealOrder->_queueIndices[distanceStart + (firstQueue + queueOffset) % numQueues];
+                auto queueToStealFrom = _taskQueues[queueIdx];
+                if(!stealsBatches)
+                {
+                    auto stolenTask = queueToStealFrom->Steal(priority);
+                    if(stolenTask != nullptr)
+                    {
+                        FL_RECORD_TASK_EVENT(TaskEventType::Steal, stolenTask->_id.load(std::memory_order_relaxed), queueIdx);
+                        return stolenTask;
+                    }
+                    continue;
+                }
+                // Taking a batch means we don't come straight back for the next one, and
+                // the rest can be stolen from us by threads nearer to us than the victim
+                auto stolenTask = queueToStealFrom->StealBatch(priority, taskQueue);
+                if(stolenTask != nullptr)
+                {
+                    FL_RECORD_TASK_EVENT(TaskEventType::Steal, stolenTask->_id.load(std::memory_order_relaxed), queueIdx);
+                    if(_numIdleThreads.load(std::memory_order_relaxed) != 0)
+                    {
+                        // A thread woken for the tasks we took may have gone back to sleep
+                        _taskThreadGate.OpenAndNotifyOne();
+                    }
+                    return stolenTask;
+                }
+            }
+            distanceStart = distanceEnd;
+        }
+        // Finally anything queued from threads without a queue
+        return _injectionQueues[static_cast<uint32_t>(priority)].Pop();
+    }
+    
+    Task* TaskManager::GetTaskFromCurrentThreadMailbox()
     {
-        if(id == 0)
+        auto mailbox = GetCurrentThreadMailbox();
+        if(mailbox == nullptr || mailbox->_numTasks.load(std::memory_order_relaxed) == 0)
         {
             return nullptr;
         }
-        // Id's start at 1, so ID 1 is at index 0
-        auto index = (id - 1) % MaxConcurrentTasks;
-        return &_allTasks[index];
+        auto task = mailbox->_queue.Pop();
+        if(task != nullptr)
+        {
+            mailbox->_numTasks.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+    
+    Task* TaskManager::AllocateTask()
+    {
+        auto task = _taskPool.Allocate();
+        while(task == nullptr)
+        {
+            // Every task is in flight. Rather than reuse a slot that is still
+            // running, help finish some of the open tasks until one is free
+            WaitForTaskAndExecute(std::chrono::milliseconds(1));
+            task = _taskPool.Allocate();
+        }
+        return task;
+    }
+    
+    Task* TaskManager::GetTaskFromId(TaskId id)
+    {
+        return _taskPool.GetTask(id);
     }
     
     void TaskManager::FinishTask(Task* task)
     {
-        task->_openWorkItems--;
-        if(task->_openWorkItems <= 0)
+        auto openWorkItems = --task->_openWorkItems;
+        if(openWorkItems == 0)
         {
-        auto parentTask = GetTaskFromId(task->_parentId);
+            auto parentTask = GetTaskFromId(task->_parentId);
             if(parentTask != nullptr)
             {
                 FinishTask(parentTask);
             }
-            // We might have just finished the task
-            // another one was waiting on
-            // We notify all here in-case notify_one
-            // picks a thread that isn't the one that's waiting
-            _taskThreadGate.OpenAndNotifyAll();
+            ReleaseDependents(task);
+            auto id = task->_id.load(std::memory_order_relaxed);
+            auto group = task->_group;
+            // Nothing refers to the task any more, anyone still holding
+            // its id will see it as complete
+            _taskPool.Free(task);
+            // Only wakes threads waiting on this task (or one sharing its bucket)
+            _taskWaitTable.NotifyCompleted(id);
+            if(_numWaitingFibers.load() != 0)
+            {
+                // A fiber may have been waiting on this, and every worker could be asleep
+                _taskThreadGate.OpenAndNotifyOne();
+            }
+            if(group != nullptr)
+            {
+                // Last, so once the group has finished every task in it is complete
+                group->OnTaskFinished();
+            }
+        }
+    }
+    
+    void TaskManager::QueueTask(Task* task)
+    {
+        FL_RECORD_TASK_EVENT(TaskEventType::Enqueue, task->_id.load(std::memory_order_relaxed));
+        if(!task->_threadAffinity.IsAnyThread())
+        {
+            auto& mailbox = _mailboxes[task->_threadAffinity._threadIdx];
+            mailbox._numTasks++;
+            mailbox._queue.Push(task);
+            // Only the owning thread can run it, so it's woken wherever it's asleep, and nobody else is.
+            // Both its waits recheck the number of tasks in the mailbox once woken
+            auto waitingOn = mailbox._waitingOn.load();
+            if(waitingOn != INVALID_TASK_ID)
+            {
+                _taskWaitTable.NotifyCompleted(waitingOn);
+            }
+            _taskThreadGate.NotifySleepers([&mailbox](TaskParkingLot& parkingLot) { parkingLot.notify(&mailbox._parkingSpot); });
+            return;
+        }
+        auto taskQueue = GetCurrentThreadTaskQueue();
+        if(taskQueue == nullptr)
+        {
+            // Not one of our threads
+            _injectionQueues[static_cast<uint32_t>(task->_priority)].Push(task);
+        }
+        else
+        {
+            taskQueue->Push(task);
+        }
+        _taskThreadGate.OpenAndNotifyOne();
+    }
+    
+    void TaskManager::ReleaseDependency(Task* task)
+    {
+        if(--task->_unfinishedDependencies == 0)
+        {
+            QueueTask(task);
+        }
+    }
+    
+    void TaskManager::ReleaseDependents(Task* task)
+    {
+        // Closing the list means any dependency added from now on sees the task as finished
+        auto id = task->_id.load(std::memory_order_relaxed);
+        auto head = task->_dependents.exchange(MakeDependentsHead(id, DEPENDENTS_CLOSED), std::memory_order_acq_rel);
+        auto dependencyIdx = GetFirstDependency(head);
+        while(dependencyIdx != NO_DEPENDENTS)
+        {
+            auto& dependency = _dependencies[dependencyIdx];
+            auto nextDependencyIdx = dependency._next;
+            // The dependent can't start until we release it, so its id is still valid
+            auto dependentTask = GetTaskFromId(dependency._dependent);
+            assert(dependentTask != nullptr);
+            _dependencyFreeList.Push(dependencyIdx);
+            ReleaseDependency(dependentTask);
+            dependencyIdx = nextDependencyIdx;
+        }
+    }
+    
+    uint32_t TaskManager::AllocateDependency()
+    {
+        auto dependencyIdx = _dependencyFreeList.Pop();
+        while(dependencyIdx == TaskFreeList::EMPTY)
+        {
+            // Every dependency is in use, help finish some of the open tasks until one is free
+            WaitForTaskAndExecute(std::chrono::milliseconds(1));
+            dependencyIdx = _dependencyFreeList.Pop();
+        }
+        return dependencyIdx;
+    }
+    
+    void TaskManager::AddTimer(TaskTimerWheel::Timer* timer, std::chrono::microseconds delay)
+    {
+        bool isNextTimer;
+        {
+            std::lock_guard<std::mutex> lock(_timerMutex);
+            // The tick after the one it's due in, so it never fires early
+            timer->_expiryTick = _timerWheel.GetTick(std::chrono::steady_clock::now() + delay) + 1;
+            _timerWheel.Add(timer);
+            auto nextTimerTick = _timerWheel.GetNextTick();
+            isNextTimer = nextTimerTick < _nextTimerTick.load(std::memory_order_relaxed);
+            _nextTimerTick.store(nextTimerTick, std::memory_order_relaxed);
+        }
+        if(isNextTimer)
+        {
+            // Any sleeping threads are waiting for a later timer, or none at all
+            _taskThreadGate.OpenAndNotifyOne();
+        }
+    }
+    
+    void TaskManager::QueueDueTimers()
+    {
+        // Cheap enough to check every time a thread looks for work, it only reads the clock if there are timers
+        auto nextTimerTick = _nextTimerTick.load(std::memory_order_relaxed);
+        if(nextTimerTick == TaskTimerWheel::NO_TICK)
+        {
+            return;
+        }
+        auto currentTick = _timerWheel.GetTick(std::chrono::steady_clock::now());
+        if(currentTick < nextTimerTick)
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(_timerMutex, std::try_to_lock);
+        if(!lock.owns_lock())
+        {
+            // Another thread is already on it
+            return;
+        }
+        std::vector<TaskId> dueTasks;
+        std::vector<std::pair<WorkItem, TaskPriority>> duePeriodicWorkItems;
+        _timerWheel.Advance(currentTick, [&](TaskTimerWheel::Timer* timer) {
+            if(timer->_periodTicks == 0)
+            {
+                dueTasks.push_back(timer->_taskId);
+                delete timer;
+                return;
+            }
+            duePeriodicWorkItems.emplace_back(timer->_workItem, timer->_priority);
+            auto numPeriodsDue = (currentTick - timer->_expiryTick) / timer->_periodTicks + 1;
+            timer->_expiryTick += numPeriodsDue * timer->_periodTicks;
+            _timerWheel.Add(timer);
+        });
+        _nextTimerTick.store(_timerWheel.GetNextTick(), std::memory_order_relaxed);
+        lock.unlock();
+        
+        // Adding tasks can mean helping with others, which could add timers, so it's done without the lock
+        for(auto taskId : dueTasks)
+        {
+            FinishAdd(taskId);
         }
+        for(auto& duePeriodicWorkItem : duePeriodicWorkItems)
+        {
+            AddTaskWithNoChildrenOrDependencies(std::move(duePeriodicWorkItem.first), duePeriodicWorkItem.second);
+        }
+    }
+    
+    bool TaskManager::GetTimeUntilNextTimer(std::chrono::microseconds& timeUntilNextTimer)
+    {
+        auto nextTimerTick = _nextTimerTick.load(std::memory_order_relaxed);
+        if(nextTimerTick == TaskTimerWheel::NO_TICK)
+        {
+            return false;
+        }
+        // Rounded up, so a thread sleeping this long doesn't wake just before it's due
+        timeUntilNextTimer = std::chrono::ceil<std::chrono::microseconds>(_timerWheel.GetTime(nextTimerTick) - std::chrono::steady_clock::now());
+        return true;
+    }
+    
+    void TaskManager::SetTaskQueueForCurrentThread(uint32_t threadIdx)
+    {
+        _currentThreadTaskQueue = _taskQueues[threadIdx];
+        _currentThreadMailbox = &_mailboxes[threadIdx];
+        _currentThreadStealOrder = &_stealOrders[threadIdx];
+        _currentThreadAllocator = _threadAllocators[threadIdx].get();
+        TaskAllocator::SetOwnedByCurrentThread(_threadAllocators[threadIdx].get());
+        TaskParkingLot::SetCurrentThreadSpot(&_mailboxes[threadIdx]._parkingSpot);
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+        _currentThreadEventRing = _profiler->GetRing(threadIdx);
+#endif
+    }
+    
+    FL_NO_INLINE Memory::IAllocator* TaskManager::GetCurrentThreadAllocator()
+    {
+        // Never inlined for the same reason as GetCurrentFiberThreadState, work items
+        // are created by tasks that may have moved thread after waiting on a fiber
+        auto allocator = _currentThreadAllocator;
+        if(allocator == nullptr)
+        {
+            return &_heapAllocator;
+        }
+        return allocator;
+    }
+    
+    void TaskManager::FiberMain(void* taskManager)
+    {
+        auto manager = static_cast<TaskManager*>(taskManager);
+        manager->FinishFiberSwitch();
+        while(true)
+        {
+            // A fiber that was released when its thread exited can still be
+            // picked up by a Wait on another thread, so it goes round again
+            manager->RunFiberLoop();
+        }
+    }
+    
+    void TaskManager::RunWorkerFibers(uint32_t threadIdx)
+    {
+        // Worker thread indices start at 1, 0 is the thread that created the TaskManager
+        auto state = &_fiberThreadStates[threadIdx - 1];
+        _currentFiberThreadState = state;
+        state->_threadFiber.ConvertCurrentThread();
+        state->_currentFiber = &state->_threadFiber;
+        auto fiber = _fiberPool->Acquire();
+        assert(fiber != nullptr);
+        SwitchToFiber(fiber, FiberAction::None, 0);
+        // Back once the TaskManager is exiting
+        state->_threadFiber.RevertCurrentThread();
+        _currentFiberThreadState = nullptr;
+    }
+    
+    void TaskManager::RunFiberLoop()
+    {
+        while(!_exiting)
+        {
+            // Carrying on with a task that was waiting comes before starting a new one,
+            // as whatever it's part of has been going longer
+            if(!ResumeWaitingFiber(FiberAction::Release, 0))
+            {
+                WaitForTaskAndExecute();
+            }
+        }
+        SwitchToFiber(&GetCurrentFiberThreadState()->_threadFiber, FiberAction::Release, 0);
+    }
+    
+    void TaskManager::WaitOnFiber(TaskId id)
+    {
+        while(!IsComplete(id))
+        {
+            auto fiber = _fiberPool->Acquire();
+            if(fiber != nullptr)
+            {
+                SwitchToFiber(fiber, FiberAction::Wait, id);
+                continue;
+            }
+            // Every fiber is in use. Swapping straight to a waiting fiber that can carry
+            // on means a task we'd otherwise help with isn't stuck underneath us
+            if(!ResumeWaitingFiber(FiberAction::Wait, id))
+            {
+                WaitForTaskAndExecute(std::chrono::milliseconds(1));
+            }
+        }
+    }
+    
+    bool TaskManager::ResumeWaitingFiber(FiberAction currentFiberAction, TaskId waitingOn)
+    {
+        if(_numWaitingFibers.load() == 0)
+        {
+            return false;
+        }
+        Fiber* fiber = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(_waitingFibersMutex);
+            for(auto& waitingFiber : _waitingFibers)
+            {
+                if(IsComplete(waitingFiber._waitingOn))
+                {
+                    fiber = waitingFiber._fiber;
+                    waitingFiber = _waitingFibers.back();
+                    _waitingFibers.pop_back();
+                    _numWaitingFibers--;
+                    break;
+                }
+            }
+        }
+        if(fiber == nullptr)
+        {
+            return false;
+        }
+        SwitchToFiber(fiber, currentFiberAction, waitingOn);
+        return true;
+    }
+    
+    void TaskManager::SwitchToFiber(Fiber* fiber, FiberAction currentFiberAction, TaskId waitingOn)
+    {
+        auto state = GetCurrentFiberThreadState();
+        auto currentFiber = state->_currentFiber;
+        state->_previousFiber = currentFiber;
+        state->_previousFiberAction = currentFiberAction;
+        state->_previousFiberWaitingOn = waitingOn;
+        state->_currentFiber = fiber;
+        Fiber::Switch(currentFiber, fiber);
+        // Something has switched back to this fiber, maybe on another thread
+        FinishFiberSwitch();
+    }
+    
+    void TaskManager::FinishFiberSwitch()
+    {
+        auto state = GetCurrentFiberThreadState();
+        switch(state->_previousFiberAction)
+        {
+            case FiberAction::None:
+                break;
+            case FiberAction::Release:
+                _fiberPool->Release(state->_previousFiber);
+                break;
+            case FiberAction::Wait:
+            {
+                std::lock_guard<std::mutex> lock(_waitingFibersMutex);
+                _waitingFibers.push_back(WaitingFiber{ state->_previousFiber, state->_previousFiberWaitingOn });
+                _numWaitingFibers++;
+                break;
+            }
+        }
+        state->_previousFiber = nullptr;
+        state->_previousFiberAction = FiberAction::None;
+    }
+    
+    FL_NO_INLINE TaskManager::FiberThreadState* TaskManager::GetCurrentFiberThreadState()
+    {
+        // Never inlined, so the compiler can't reuse the thread local's address from
+        // before a fiber switch, when the fiber may have moved to another thread
+        return _currentFiberThreadState;
+    }
+    
+    // Never inlined for the same reason as GetCurrentFiberThreadState. A task that waited
+    // on a fiber finishes on whichever thread resumed it, and has to queue what it releases
+    // on that thread's queue, not push to the old thread's as if it owned it
+    FL_NO_INLINE PriorityTaskQueue* TaskManager::GetCurrentThreadTaskQueue()
+    {
+        return _currentThreadTaskQueue;
+    }
+    
+    FL_NO_INLINE TaskManager::ThreadMailbox* TaskManager::GetCurrentThreadMailbox()
+    {
+        return _currentThreadMailbox;
+    }
+    
+    FL_NO_INLINE TaskManager::StealOrder* TaskManager::GetCurrentThreadStealOrder()
+    {
+        return _currentThreadStealOrder;
+    }
+    
+    FL_NO_INLINE uint32_t& TaskManager::GetCurrentThreadRandomState()
+    {
+        return _currentThreadRandomState;
     }
     
-    void TaskManager::CreateTaskQueueForCurrentThread(uint32_t threadIdx)
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+    FL_NO_INLINE TaskEventRing* TaskManager::GetCurrentThreadEventRing()
     {
-        _currentThreadTaskQueue = new TaskQueue();
-        _taskQueues[threadIdx] = _currentThreadTaskQueue;
+        // Never inlined for the same reason as GetCurrentFiberThreadState, a task
+        // that waits on a fiber can finish on another thread
+        return _currentThreadEventRing;
     }
+#endif
 }
@@ -0,0 +1,71 @@
+#include "Task/TaskParkingLot.h"
+
+#include "Platform/PlatformFeatures.h"
+
+namespace Flourish
+{
+    thread_local TaskParkingLot::Spot* TaskParkingLot::_currentThreadSpot = nullptr;
+
+    TaskParkingLot::TaskParkingLot()
+        : _sharedCondition()
+        , _sleepingSpots(nullptr)
+    {
+    }
+
+    void TaskParkingLot::SetCurrentThreadSpot(Spot* spot)
+    {
+        _currentThreadSpot = spot;
+    }
+
+    FL_NO_INLINE TaskParkingLot::Spot* TaskParkingLot::GetCurrentThreadSpot()
+    {
+        // Never inlined, as a worker's idle loop can run on a fiber that has moved thread
+        return _currentThreadSpot;
+    }
+
+    void TaskParkingLot::notify_one()
+    {
+        for(auto spot = _sleepingSpots; spot != nullptr; spot = spot->_nextSleeping)
+        {
+            if(!spot->_notified)
+            {
+                spot->_notified = true;
+                spot->_condition.notify_one();
+                return;
+            }
+        }
+        _sharedCondition.notify_one();
+    }
+
+    void TaskParkingLot::notify_all()
+    {
+        for(auto spot = _sleepingSpots; spot != nullptr; spot = spot->_nextSleeping)
+        {
+            spot->_notified = true;
+            spot->_condition.notify_one();
+        }
+        _sharedCondition.notify_all();
+    }
+
+    void TaskParkingLot::notify(Spot* spot)
+    {
+        spot->_condition.notify_one();
+    }
+
+    void TaskParkingLot::Park(Spot* spot)
+    {
+        spot->_notified = false;
+        spot->_nextSleeping = _sleepingSpots;
+        _sleepingSpots = spot;
+    }
+
+    void TaskParkingLot::Unpark(Spot* spot)
+    {
+        auto link = &_sleepingSpots;
+        while(*link != spot)
+        {
+            link = &(*link)->_nextSleeping;
+        }
+        *link = spot->_nextSleeping;
+    }
+}
@@ -0,0 +1,60 @@
+#include "Task/TaskPool.h"
+
+#include <cassert>
+
+namespace Flourish
+{
+    TaskPool::TaskPool(uint32_t capacity)
+        : _tasks(new Task[capacity])
+        , _freeList(capacity)
+    {
+        assert(capacity <= MAXIMUM_CAPACITY); // The index has to fit in INDEX_BITS
+    }
+
+    TaskPool::~TaskPool()
+    {
+        delete[] _tasks;
+    }
+
+    Task* TaskPool::Allocate()
+    {
+        auto index = _freeList.Pop();
+        if(index == TaskFreeQueue::EMPTY)
+        {
+            return nullptr;
+        }
+        auto task = &_tasks[index];
+        auto generation = GetGeneration(task->_id.load(std::memory_order_relaxed)) + 1u;
+        if(generation > MAXIMUM_GENERATION)
+        {
+            generation = 1u;
+        }
+        task->_id.store(MakeId(index, generation), std::memory_order_relaxed);
+        return task;
+    }
+
+    void TaskPool::Free(Task* task)
+    {
+        _freeList.Push(static_cast<uint32_t>(task - _tasks));
+    }
+
+    Task* TaskPool::GetTask(TaskId id)
+    {
+        if(id == 0 || id == INVALID_TASK_ID)
+        {
+            return nullptr;
+        }
+        auto index = GetIndex(id);
+        if(index >= GetCapacity())
+        {
+            return nullptr;
+        }
+        auto task = &_tasks[index];
+        if(task->_id.load(std::memory_order_acquire) != id)
+        {
+            // The task this id refered to has finished and the slot has been reused
+            return nullptr;
+        }
+        return task;
+    }
+}
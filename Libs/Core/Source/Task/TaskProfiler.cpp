@@ -0,0 +1,210 @@
+#include "Task/TaskProfiler.h"
+
+#include <cassert>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <unordered_map>
+
+namespace Flourish
+{
+    namespace
+    {
+        int64_t GetTimeNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Adds an event to the end of the traceEvents array
+        void AppendEvent(std::string& json, const char* format, ...)
+        {
+            char buffer[256];
+            va_list args;
+            va_start(args, format);
+            auto length = vsnprintf(buffer, sizeof(buffer), format, args);
+            va_end(args);
+            assert(length >= 0 && static_cast<size_t>(length) < sizeof(buffer)); // An event didn't fit in the buffer
+            if(json.back() != '[')
+            {
+                json.push_back(',');
+            }
+            json.append(buffer, static_cast<size_t>(length));
+        }
+    }
+
+    TaskEventRing::TaskEventRing(uint32_t capacity)
+        : _events(new TaskEvent[capacity])
+        , _capacity(capacity)
+        , _numWritten(0)
+        , _cachedNumRead(0)
+        , _numDropped(0)
+        , _numRead(0)
+    {
+        assert(capacity != 0 && (capacity & (capacity - 1u)) == 0); // The capacity has to be a power of 2
+    }
+
+    TaskEventRing::~TaskEventRing()
+    {
+        delete[] _events;
+    }
+
+    void TaskEventRing::Collect(std::vector<TaskEvent>& events)
+    {
+        auto numRead = _numRead.load(std::memory_order_relaxed);
+        // Acquire, so the events up to here have been written
+        auto numWritten = _numWritten.load(std::memory_order_acquire);
+        for(; numRead != numWritten; numRead++)
+        {
+            events.push_back(_events[numRead & (_capacity - 1u)]);
+        }
+        // Release, so we've finished reading them before the owner writes over them
+        _numRead.store(numRead, std::memory_order_release);
+    }
+
+    TaskProfiler::TaskProfiler(uint32_t numThreads, uint32_t eventsPerThread)
+        : _numThreads(numThreads)
+        , _rings(new TaskEventRing*[numThreads])
+        , _events(new std::vector<TaskEvent>[numThreads])
+        , _startTimestamp(TaskEventRing::GetTimestamp())
+        , _startTimeNs(GetTimeNs())
+    {
+        for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+        {
+            _rings[threadIdx] = new TaskEventRing(eventsPerThread);
+        }
+    }
+
+    TaskProfiler::~TaskProfiler()
+    {
+        for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+        {
+            delete _rings[threadIdx];
+        }
+        delete[] _rings;
+        delete[] _events;
+    }
+
+    void TaskProfiler::Collect()
+    {
+        for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+        {
+            _rings[threadIdx]->Collect(_events[threadIdx]);
+        }
+    }
+
+    uint32_t TaskProfiler::GetNumDropped() const
+    {
+        uint32_t numDropped = 0;
+        for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+        {
+            numDropped += _rings[threadIdx]->GetNumDropped();
+        }
+        return numDropped;
+    }
+
+    void TaskProfiler::WriteChromeTrace(std::string& json)
+    {
+        Collect();
+        auto ticksPerMicrosecond = GetTicksPerMicrosecond();
+        auto toMicroseconds = [&](uint64_t timestamp) {
+            return static_cast<double>(static_cast<int64_t>(timestamp - _startTimestamp)) / ticksPerMicrosecond;
+        };
+
+        // Tasks are usually queued on one thread and run on another
+        std::unordered_map<TaskId, uint64_t> enqueueTimestamps;
+        for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+        {
+            for(auto& event : _events[threadIdx])
+            {
+                if(event._type == TaskEventType::Enqueue)
+                {
+                    enqueueTimestamps[event._taskId] = event._timestamp;
+                }
+            }
+        }
+
+        json.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+        {
+            if(threadIdx == 0)
+            {
+                AppendEvent(json, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"Main thread\"}}");
+            }
+            else
+            {
+                AppendEvent(json, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"Worker %u\"}}", threadIdx, threadIdx);
+            }
+            for(auto& event : _events[threadIdx])
+            {
+                auto time = toMicroseconds(event._timestamp);
+                switch(event._type)
+                {
+                    case TaskEventType::Enqueue:
+                        AppendEvent(json, "{\"name\":\"Enqueue\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"args\":{\"task\":%" PRIu32 "}}",
+                                    threadIdx, time, event._taskId);
+                        break;
+                    case TaskEventType::Begin:
+                    {
+                        auto enqueueTimestamp = enqueueTimestamps.find(event._taskId);
+                        if(enqueueTimestamp != enqueueTimestamps.end() && enqueueTimestamp->second <= event._timestamp)
+                        {
+                            AppendEvent(json, "{\"name\":\"Task\",\"cat\":\"task\",\"ph\":\"B\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"args\":{\"task\":%" PRIu32 ",\"queuedUs\":%.3f}}",
+                                        threadIdx, time, event._taskId, time - toMicroseconds(enqueueTimestamp->second));
+                        }
+                        else
+                        {
+                            // Queued before the profiler started, or its enqueue was dropped
+                            AppendEvent(json, "{\"name\":\"Task\",\"cat\":\"task\",\"ph\":\"B\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"args\":{\"task\":%" PRIu32 "}}",
+                                        threadIdx, time, event._taskId);
+                        }
+                        break;
+                    }
+                    case TaskEventType::End:
+                        AppendEvent(json, "{\"name\":\"Task\",\"cat\":\"task\",\"ph\":\"E\",\"pid\":0,\"tid\":%u,\"ts\":%.3f}", threadIdx, time);
+                        break;
+                    case TaskEventType::Steal:
+                        AppendEvent(json, "{\"name\":\"Steal\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"args\":{\"task\":%" PRIu32 ",\"from\":%u}}",
+                                    threadIdx, time, event._taskId, static_cast<uint32_t>(event._otherThreadIdx));
+                        break;
+                    case TaskEventType::Park:
+                        if(event._taskId == INVALID_TASK_ID)
+                        {
+                            AppendEvent(json, "{\"name\":\"Idle\",\"cat\":\"thread\",\"ph\":\"B\",\"pid\":0,\"tid\":%u,\"ts\":%.3f}", threadIdx, time);
+                        }
+                        else
+                        {
+                            AppendEvent(json, "{\"name\":\"Waiting\",\"cat\":\"thread\",\"ph\":\"B\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"args\":{\"task\":%" PRIu32 "}}",
+                                        threadIdx, time, event._taskId);
+                        }
+                        break;
+                    case TaskEventType::Unpark:
+                        AppendEvent(json, "{\"name\":\"%s\",\"cat\":\"thread\",\"ph\":\"E\",\"pid\":0,\"tid\":%u,\"ts\":%.3f}",
+                                    event._taskId == INVALID_TASK_ID ? "Idle" : "Waiting", threadIdx, time);
+                        break;
+                }
+            }
+        }
+        json.append("]}");
+    }
+
+    void TaskProfiler::Clear()
+    {
+        for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+        {
+            _events[threadIdx].clear();
+        }
+    }
+
+    double TaskProfiler::GetTicksPerMicrosecond() const
+    {
+        // Measured over the whole time the profiler has been running, so it's only
+        // inaccurate if that's very short
+        auto elapsedNs = GetTimeNs() - _startTimeNs;
+        auto elapsedTicks = TaskEventRing::GetTimestamp() - _startTimestamp;
+        if(elapsedNs <= 0 || elapsedTicks == 0)
+        {
+            return 1000.0;
+        }
+        return static_cast<double>(elapsedTicks) * 1000.0 / static_cast<double>(elapsedNs);
+    }
+}
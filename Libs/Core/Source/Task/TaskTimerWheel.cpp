@@ -0,0 +1,122 @@
+#include "Task/TaskTimerWheel.h"
+
+#include <cassert>
+
+namespace Flourish
+{
+    constexpr std::chrono::microseconds TaskTimerWheel::TICK_DURATION;
+
+    TaskTimerWheel::TaskTimerWheel(std::chrono::steady_clock::time_point startTime)
+        : _startTime(startTime)
+        , _currentTick(0)
+        , _numTimers(0)
+        , _slots()
+    {
+    }
+
+    TaskTimerWheel::~TaskTimerWheel()
+    {
+        for(uint32_t level = 0; level < NUM_LEVELS; level++)
+        {
+            for(uint32_t slotIdx = 0; slotIdx < SLOTS_PER_LEVEL; slotIdx++)
+            {
+                auto timer = TakeSlot(level, slotIdx);
+                while(timer != nullptr)
+                {
+                    auto nextTimer = timer->_next;
+                    delete timer;
+                    timer = nextTimer;
+                }
+            }
+        }
+    }
+
+    void TaskTimerWheel::Add(Timer* timer)
+    {
+        // The current tick's slot has already been emptied, so the soonest it can fire is the next one
+        Insert(timer, timer->_expiryTick > _currentTick ? timer->_expiryTick : _currentTick + 1);
+    }
+
+    void TaskTimerWheel::Remove(Timer* timer)
+    {
+        assert(_numTimers != 0); // The timer isn't in the wheel
+        *timer->_previousNext = timer->_next;
+        if(timer->_next != nullptr)
+        {
+            timer->_next->_previousNext = timer->_previousNext;
+        }
+        timer->_next = nullptr;
+        timer->_previousNext = nullptr;
+        _numTimers--;
+    }
+
+    void TaskTimerWheel::Insert(Timer* timer, uint64_t tick)
+    {
+        assert(tick >= _currentTick); // Its slot would have already gone by
+        auto ticksUntilDue = tick - _currentTick;
+        uint32_t level = 0;
+        while(level < NUM_LEVELS - 1 && ticksUntilDue >= (1ull << ((level + 1) * LEVEL_SHIFT)))
+        {
+            level++;
+        }
+        if(ticksUntilDue >= (1ull << (NUM_LEVELS * LEVEL_SHIFT)))
+        {
+            // Further away than the wheel reaches. It goes in the furthest slot, and
+            // is put back in again each time it comes round until it's close enough
+            tick = _currentTick + (1ull << (NUM_LEVELS * LEVEL_SHIFT)) - 1u;
+        }
+        auto& slot = _slots[level][GetSlotIdx(level, tick)];
+        timer->_next = slot;
+        timer->_previousNext = &slot;
+        if(slot != nullptr)
+        {
+            slot->_previousNext = &timer->_next;
+        }
+        slot = timer;
+        _numTimers++;
+    }
+
+    uint64_t TaskTimerWheel::GetNextTick() const
+    {
+        if(_numTimers == 0)
+        {
+            return NO_TICK;
+        }
+        // The first slot with anything in it on each level. On the first level that's when
+        // the timers are due, on the others it's when they move down a level
+        auto nextTick = NO_TICK;
+        for(uint32_t level = 0; level < NUM_LEVELS; level++)
+        {
+            auto currentSlot = _currentTick >> (level * LEVEL_SHIFT);
+            for(uint64_t slotOffset = 1; slotOffset <= SLOTS_PER_LEVEL; slotOffset++)
+            {
+                if(_slots[level][GetSlotIdx(0, currentSlot + slotOffset)] != nullptr)
+                {
+                    auto slotTick = (currentSlot + slotOffset) << (level * LEVEL_SHIFT);
+                    if(slotTick < nextTick)
+                    {
+                        nextTick = slotTick;
+                    }
+                    break;
+                }
+            }
+        }
+        assert(nextTick != NO_TICK);
+        return nextTick;
+    }
+
+    TaskTimerWheel::Timer* TaskTimerWheel::TakeSlot(uint32_t level, uint32_t slotIdx)
+    {
+        auto firstTimer = _slots[level][slotIdx];
+        _slots[level][slotIdx] = nullptr;
+        for(auto timer = firstTimer; timer != nullptr; timer = timer->_next)
+        {
+            _numTimers--;
+        }
+        if(firstTimer != nullptr)
+        {
+            firstTimer->_previousNext = nullptr;
+        }
+        return firstTimer;
+    }
+}
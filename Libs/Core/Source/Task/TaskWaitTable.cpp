@@ -0,0 +1,26 @@
+#include "Task/TaskWaitTable.h"
+
+namespace Flourish
+{
+    TaskWaitTable::TaskWaitTable()
+    {
+        for(auto& bucket : _buckets)
+        {
+            bucket._numWaiters = 0;
+        }
+    }
+
+    void TaskWaitTable::NotifyCompleted(TaskId id)
+    {
+        auto& bucket = GetBucket(id);
+        if(bucket._numWaiters == 0)
+        {
+            return;
+        }
+        // Taking the lock means a waiter that registered is either already
+        // waiting or hasn't checked if the task is complete yet
+        std::unique_lock<std::mutex> lock(bucket._mutex);
+        // Other tasks share the bucket, so wake everyone and let them check
+        bucket._condition.notify_all();
+    }
+}
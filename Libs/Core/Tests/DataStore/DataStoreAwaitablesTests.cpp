@@ -0,0 +1,107 @@
+#include "Test.h"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <string>
+
+#include "DataStore/DataStoreAwaitables.h"
+#include "Memory/Allocators/MallocAllocator.h"
+#include "Task/TaskManager.h"
+
+using namespace Flourish;
+
+namespace
+{
+    // Calls every callback straight away, like the local file data store
+    class ImmediateReadDataStore : public IReadableDataStore
+    {
+    public:
+        std::shared_ptr<DataStoreReadStream> streamToOpen;
+        uint32_t numReads = 0;
+
+        bool Exists(const DataStorePath&) const override
+        {
+            return false;
+        }
+
+        void OpenForRead(const DataStorePath& path, DataStoreReadCallback callback) override
+        {
+            if(streamToOpen == nullptr)
+            {
+                // The message only lives until the callback returns
+                std::string errorMessage = "Missing: ";
+                errorMessage.append(path.AsString());
+                callback(DataStoreReadCallbackParam::Failure(errorMessage.c_str()));
+                return;
+            }
+            callback(DataStoreReadCallbackParam::Successful(streamToOpen));
+        }
+
+        void Close(DataStoreReadStream*) override
+        {
+        }
+
+        bool IsDir(const DataStorePath&) const override
+        {
+            return false;
+        }
+
+        bool IsData(const DataStorePath&) const override
+        {
+            return false;
+        }
+
+        void Enumerate(const DataStorePath&, std::vector<DataStorePath>&) const override
+        {
+        }
+
+    protected:
+        void EnqueueRead(DataStoreReadStream*, DataBuffer*, DataStoreReadCallback callback) override
+        {
+            numReads++;
+            callback(DataStoreReadCallbackParam::Successful(streamToOpen));
+        }
+    };
+
+    CoTask<DataStoreReadResult> OpenAndRefresh(Memory::IAllocator&, IReadableDataStore* dataStore, DataStorePath path)
+    {
+        auto result = co_await OpenForReadAsync(dataStore, path);
+        if(result.HasError())
+        {
+            co_return result;
+        }
+        co_return co_await RefreshAsync(result._stream.get());
+    }
+}
+
+TEST(DataStoreAwaitablesTests, OpenForReadAsyncKeepsTheErrorMessage)
+{
+    Memory::MallocAllocator allocator("CoroutineFrames");
+    TaskManager taskManager(1);
+    ImmediateReadDataStore dataStore;
+    auto coTask = OpenAndRefresh(allocator, &dataStore, DataStorePath("missing.txt"));
+
+    taskManager.Wait(coTask.Start(&taskManager));
+
+    auto result = coTask.TakeResult();
+    EXPECT_TRUE(result.HasError());
+    EXPECT_EQUAL(result._error, std::string("Missing: missing.txt"));
+}
+
+TEST(DataStoreAwaitablesTests, RefreshAsyncReadsMoreOfTheStream)
+{
+    Memory::MallocAllocator allocator("CoroutineFrames");
+    TaskManager taskManager(1);
+    ImmediateReadDataStore dataStore;
+    dataStore.streamToOpen = std::make_shared<DataStoreReadStream>(&dataStore, DataStorePath("data.bin"), DataBuffer(16));
+    auto coTask = OpenAndRefresh(allocator, &dataStore, DataStorePath("data.bin"));
+
+    taskManager.Wait(coTask.Start(&taskManager));
+
+    auto result = coTask.TakeResult();
+    EXPECT_FALSE(result.HasError());
+    EXPECT_EQUAL(result._stream, dataStore.streamToOpen);
+    EXPECT_EQUAL(dataStore.numReads, 1u);
+}
+
+#endif
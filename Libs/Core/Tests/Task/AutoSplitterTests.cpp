@@ -0,0 +1,153 @@
+#include "Test.h"
+
+#include "Task/AutoSplitter.h"
+#include "Task/ParallelFor.h"
+#include "Task/TaskManager.h"
+
+#include "Task/TaskTestHelpers/ImmediateTaskSystem.h"
+#include "Task/TaskTestHelpers/StubTaskSystem.h"
+
+using namespace Flourish;
+using namespace Flourish::TaskTestHelpers;
+
+TEST(AutoSplitterTests, TargetCountGivesEveryThreadSomeChunks)
+{
+    StubTaskSystem stubTaskSystem;
+    stubTaskSystem._numThreads = 3;
+    
+    AutoSplitter<int32_t, StubTaskSystem> autoSplitter(1600, &stubTaskSystem);
+    
+    EXPECT_EQUAL(autoSplitter.GetTargetCount(), 1600u / (4u * AutoSplitter<int32_t, StubTaskSystem>::CHUNKS_PER_THREAD));
+}
+
+TEST(AutoSplitterTests, SplitsAboveTargetCount)
+{
+    StubTaskSystem stubTaskSystem;
+    stubTaskSystem._numThreads = 3;
+    AutoSplitter<int32_t, StubTaskSystem> autoSplitter(1600, &stubTaskSystem);
+    
+    EXPECT_TRUE(autoSplitter.ShouldSplit(nullptr, autoSplitter.GetTargetCount() + 1));
+    EXPECT_FALSE(autoSplitter.ShouldSplit(nullptr, autoSplitter.GetTargetCount())) << "Should not split when no threads are idle";
+}
+
+TEST(AutoSplitterTests, SplitsBelowTargetCountWhenThreadsAreIdle)
+{
+    StubTaskSystem stubTaskSystem;
+    stubTaskSystem._numThreads = 3;
+    stubTaskSystem._numIdleThreads = 1;
+    AutoSplitter<int32_t, StubTaskSystem> autoSplitter(1600, &stubTaskSystem, 10);
+    
+    EXPECT_TRUE(autoSplitter.ShouldSplit(nullptr, autoSplitter.GetTargetCount()));
+    EXPECT_FALSE(autoSplitter.ShouldSplit(nullptr, 10)) << "Should never split at or below the minimum count";
+}
+
+TEST(AutoSplitterTests, NeverSplitsASingleElementWithAZeroMinimumCount)
+{
+    StubTaskSystem stubTaskSystem;
+    stubTaskSystem._numThreads = 3;
+    stubTaskSystem._numIdleThreads = 1;
+    AutoSplitter<int32_t, StubTaskSystem> autoSplitter(4, &stubTaskSystem, 0);
+    
+    EXPECT_FALSE(autoSplitter.ShouldSplit(nullptr, 1));
+    EXPECT_FALSE(autoSplitter.ShouldSplit(nullptr, 0));
+}
+
+TEST(AutoSplitterTests, QuickLeavesRaiseMinimumCount)
+{
+    StubTaskSystem stubTaskSystem;
+    AutoSplitter<int32_t, StubTaskSystem> autoSplitter(100000, &stubTaskSystem);
+    auto minimumDuration = AutoSplitter<int32_t, StubTaskSystem>::MINIMUM_LEAF_DURATION;
+    
+    autoSplitter.OnLeafExecuted(nullptr, 10, minimumDuration / 4);
+    
+    EXPECT_EQUAL(autoSplitter.GetMinimumCount(), 40u);
+    
+    autoSplitter.OnLeafExecuted(nullptr, 10, minimumDuration);
+    
+    EXPECT_EQUAL(autoSplitter.GetMinimumCount(), 40u) << "Leaves that take long enough should not change the minimum count";
+}
+
+TEST(AutoSplitterTests, MinimumCountIsNeverRaisedAboveTargetCount)
+{
+    StubTaskSystem stubTaskSystem;
+    AutoSplitter<int32_t, StubTaskSystem> autoSplitter(100, &stubTaskSystem);
+    
+    autoSplitter.OnLeafExecuted(nullptr, 10, std::chrono::nanoseconds(1));
+    
+    EXPECT_EQUAL(autoSplitter.GetMinimumCount(), autoSplitter.GetTargetCount());
+}
+
+TEST(AutoSplitterTests, ParallelForTellsSplitterHowLongLeavesTook)
+{
+    const uint32_t dummyDataSize = 20;
+    int32_t dummyData[dummyDataSize];
+    StubTaskSystem stubTaskSystem;
+    ImmediateTaskSystem immediateTaskSystem;
+    AutoSplitter<int32_t, StubTaskSystem> autoSplitter(dummyDataSize, &stubTaskSystem);
+    
+    auto parallelFor = ParallelFor(dummyData, dummyDataSize, &autoSplitter, [](int32_t*, uint32_t){}, &immediateTaskSystem);
+    parallelFor.Run();
+    
+    EXPECT_GREATER_THAN(autoSplitter.GetMinimumCount(), 1u) << "An empty leaf should have raised the minimum count";
+}
+
+TEST(AutoSplitterTests, RunsAllTasks)
+{
+    const uint32_t dummyDataSize = 100000;
+    std::vector<int32_t> dummyData(dummyDataSize);
+    TaskManager taskManager;
+    AutoSplitter<int32_t> autoSplitter(dummyDataSize, &taskManager);
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        dummyData[index] = index;
+    }
+    
+    LazyParallelFor parallelFor(dummyData.data(), dummyDataSize, &autoSplitter, [](int32_t* data, uint32_t dataCount){
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            data[index] *= 2;
+        }
+    }, &taskManager);
+    taskManager.Wait(parallelFor.Run());
+    
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        ASSERT_EQUAL(dummyData[index], ((int)index * 2)) << "Data for index " << index << " was incorrect";
+    }
+}
+
+TEST(AffinitySplitterTests, ChunkCountIsAWholeNumberOfCacheLines)
+{
+    StubTaskSystem stubTaskSystem;
+    stubTaskSystem._numThreads = 3;
+    
+    AffinitySplitter<int32_t, StubTaskSystem> affinitySplitter(1000, &stubTaskSystem);
+    
+    EXPECT_EQUAL(affinitySplitter.GetChunkCount() % (FL_CACHE_LINE_SIZE / sizeof(int32_t)), 0u);
+    EXPECT_GREATER_THAN_OR_EQUAL(affinitySplitter.GetChunkCount(), 1000u / (4u * AffinitySplitter<int32_t, StubTaskSystem>::CHUNKS_PER_THREAD));
+}
+
+TEST(AffinitySplitterTests, LeavesStartOnChunkBoundaries)
+{
+    const uint32_t dummyDataSize = 1001;
+    int32_t dummyData[dummyDataSize];
+    StubTaskSystem stubTaskSystem;
+    stubTaskSystem._numThreads = 3;
+    ImmediateTaskSystem immediateTaskSystem;
+    AffinitySplitter<int32_t, StubTaskSystem> affinitySplitter(dummyDataSize, &stubTaskSystem);
+    std::vector<std::pair<int32_t*, uint32_t>> leaves;
+    
+    auto parallelFor = ParallelFor(dummyData, dummyDataSize, &affinitySplitter, [&](int32_t* data, uint32_t dataCount){
+        leaves.emplace_back(data, dataCount);
+    }, &immediateTaskSystem);
+    parallelFor.Run();
+    
+    uint32_t totalCount = 0;
+    for(auto& leaf : leaves)
+    {
+        EXPECT_EQUAL(static_cast<uint32_t>(leaf.first - dummyData) % affinitySplitter.GetChunkCount(), 0u) << "Leaf did not start on a chunk boundary";
+        EXPECT_LESS_THAN_OR_EQUAL(leaf.second, affinitySplitter.GetChunkCount());
+        totalCount += leaf.second;
+    }
+    EXPECT_EQUAL(totalCount, dummyDataSize);
+}
@@ -0,0 +1,104 @@
+#include "Test.h"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <atomic>
+
+#include "Task/CoTask.h"
+#include "Task/TaskManager.h"
+
+#include "Task/TaskTestHelpers/CountingAllocator.h"
+
+using namespace Flourish;
+using namespace Flourish::TaskTestHelpers;
+
+namespace
+{
+    CoTask<int32_t> ReturnValue(Memory::IAllocator&, int32_t value)
+    {
+        co_return value;
+    }
+
+    CoTask<int32_t> AddResultsOfOtherCoTasks(Memory::IAllocator& allocator)
+    {
+        auto first = co_await ReturnValue(allocator, 1);
+        auto second = co_await ReturnValue(allocator, 2);
+        co_return first + second;
+    }
+
+    CoTask<> WaitForTask(Memory::IAllocator*, TaskId taskId, std::atomic_bool& finishedWaiting)
+    {
+        co_await taskId;
+        finishedWaiting = true;
+    }
+}
+
+TEST(CoTaskTests, NothingRunsUntilStarted)
+{
+    CountingAllocator allocator;
+    TaskManager taskManager(0);
+
+    auto coTask = ReturnValue(allocator, 7);
+
+    EXPECT_FALSE(coTask.IsDone());
+}
+
+TEST(CoTaskTests, StartedCoTaskReturnsItsResult)
+{
+    CountingAllocator allocator;
+    TaskManager taskManager(1);
+    auto coTask = ReturnValue(allocator, 7);
+
+    taskManager.Wait(coTask.Start(&taskManager));
+
+    ASSERT_TRUE(coTask.IsDone());
+    EXPECT_EQUAL(coTask.TakeResult(), 7);
+}
+
+TEST(CoTaskTests, AwaitingAnotherCoTaskGivesItsResult)
+{
+    CountingAllocator allocator;
+    TaskManager taskManager(1);
+    auto coTask = AddResultsOfOtherCoTasks(allocator);
+
+    taskManager.Wait(coTask.Start(&taskManager));
+
+    EXPECT_EQUAL(coTask.TakeResult(), 3);
+}
+
+TEST(CoTaskTests, AwaitingATaskIdCarriesOnOnceTheTaskHasFinished)
+{
+    CountingAllocator allocator;
+    TaskManager taskManager(1);
+    std::atomic_bool taskFinished(false);
+    std::atomic_bool finishedWaiting(false);
+    std::atomic_bool finishedBeforeTask(false);
+    auto taskId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+        finishedBeforeTask = finishedWaiting.load();
+        taskFinished = true;
+    }));
+    auto coTask = WaitForTask(&allocator, taskId, finishedWaiting);
+
+    auto coTaskId = coTask.Start(&taskManager);
+    taskManager.FinishAdd(taskId);
+    taskManager.Wait(coTaskId);
+
+    EXPECT_TRUE(taskFinished);
+    EXPECT_TRUE(finishedWaiting);
+    EXPECT_FALSE(finishedBeforeTask) << "The coroutine carried on before the task it awaited had finished";
+}
+
+TEST(CoTaskTests, FramesAreAllocatedFromTheAllocatorParameter)
+{
+    CountingAllocator allocator;
+    TaskManager taskManager(1);
+    {
+        auto coTask = AddResultsOfOtherCoTasks(allocator);
+        taskManager.Wait(coTask.Start(&taskManager));
+
+        EXPECT_EQUAL(allocator._numAllocs, 3u);
+    }
+    EXPECT_EQUAL(allocator._numFrees, allocator._numAllocs);
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include "Task/CpuTopology.h"
+
+using namespace Flourish;
+
+namespace
+{
+    // Two nodes, each with one cache shared by two cores, each with two SMT siblings.
+    // The siblings are numbered like Linux does, after every other core's first CPU
+    CpuTopology MakeTwoNodeTopology()
+    {
+        std::vector<LogicalCpu> cpus;
+        for(uint32_t sibling = 0; sibling < 2; sibling++)
+        {
+            for(uint32_t core = 0; core < 4; core++)
+            {
+                auto node = core / 2;
+                cpus.push_back(LogicalCpu{ sibling * 4 + core, core, node, node });
+            }
+        }
+        return CpuTopology(std::move(cpus));
+    }
+}
+
+TEST(CpuTopologyTests, DetectFindsEachCpuOnce)
+{
+    auto topology = CpuTopology::Detect();
+    
+    ASSERT_GREATER_THAN(topology.GetNumCpus(), 0u);
+    for(uint32_t cpuIdx = 0; cpuIdx < topology.GetNumCpus(); cpuIdx++)
+    {
+        for(uint32_t otherCpuIdx = cpuIdx + 1; otherCpuIdx < topology.GetNumCpus(); otherCpuIdx++)
+        {
+            EXPECT_NOT_EQUAL(topology.GetCpu(cpuIdx)._osIndex, topology.GetCpu(otherCpuIdx)._osIndex);
+        }
+    }
+}
+
+TEST(CpuTopologyTests, WithoutCpusEveryCpuIsItsOwnCoreOnOneNode)
+{
+    CpuTopology topology({});
+    
+    EXPECT_EQUAL(topology.GetNumCpus(), std::max(std::thread::hardware_concurrency(), 1u));
+    if(topology.GetNumCpus() > 1)
+    {
+        EXPECT_EQUAL(topology.GetDistance(0, 1), CpuDistance::SameNode);
+    }
+}
+
+TEST(CpuTopologyTests, DistanceIsTheNearestThingCpusShare)
+{
+    auto topology = MakeTwoNodeTopology();
+    
+    EXPECT_EQUAL(topology.GetDistance(0, 4), CpuDistance::SameCore);
+    EXPECT_EQUAL(topology.GetDistance(0, 1), CpuDistance::SameCache);
+    EXPECT_EQUAL(topology.GetDistance(0, 2), CpuDistance::Remote);
+    EXPECT_EQUAL(topology.GetDistance(5, 3), CpuDistance::Remote);
+}
+
+TEST(CpuTopologyTests, PlacementUsesEveryCoreBeforeAnySmtSibling)
+{
+    auto topology = MakeTwoNodeTopology();
+    
+    auto placementOrder = topology.GetPlacementOrder();
+    
+    ASSERT_EQUAL(placementOrder.size(), 8u);
+    for(uint32_t placementIdx = 0; placementIdx < 4; placementIdx++)
+    {
+        EXPECT_EQUAL(topology.GetCpu(placementOrder[placementIdx])._coreId, placementIdx);
+        EXPECT_EQUAL(topology.GetCpu(placementOrder[placementIdx + 4])._coreId, placementIdx);
+    }
+}
@@ -0,0 +1,75 @@
+#include "Test.h"
+
+#include <vector>
+
+#include "Task/FiberPool.h"
+
+using namespace Flourish;
+
+namespace
+{
+    const size_t TestStackSize = 64 * 1024;
+
+    struct SwitchBackData
+    {
+        Fiber* _returnTo;
+        Fiber* _self;
+        uint32_t _numTimesRun;
+    };
+
+    void CountAndSwitchBack(void* userData)
+    {
+        auto data = static_cast<SwitchBackData*>(userData);
+        while(true)
+        {
+            data->_numTimesRun++;
+            Fiber::Switch(data->_self, data->_returnTo);
+        }
+    }
+
+    void NeverSwitchedTo(void*)
+    {
+    }
+}
+
+TEST(FiberPoolTests, MakesAsManyFibersAsFitInTheMemoryArea)
+{
+    std::vector<char> stackMemory(TestStackSize * 3 + FiberPool::STACK_ALIGNMENT);
+    Memory::MemoryArea stackArea(stackMemory.data(), stackMemory.size());
+    FiberPool fiberPool(&stackArea, TestStackSize, &NeverSwitchedTo, nullptr);
+
+    EXPECT_EQUAL(fiberPool.GetNumFibers(), 3u);
+}
+
+TEST(FiberPoolTests, AcquireReturnsNullOnceEveryFiberIsInUse)
+{
+    std::vector<char> stackMemory(TestStackSize * 2 + FiberPool::STACK_ALIGNMENT);
+    Memory::MemoryArea stackArea(stackMemory.data(), stackMemory.size());
+    FiberPool fiberPool(&stackArea, TestStackSize, &NeverSwitchedTo, nullptr);
+
+    auto firstFiber = fiberPool.Acquire();
+    auto secondFiber = fiberPool.Acquire();
+    EXPECT_NOT_EQUAL(firstFiber, nullptr);
+    EXPECT_NOT_EQUAL(secondFiber, nullptr);
+    EXPECT_EQUAL(fiberPool.Acquire(), nullptr);
+
+    fiberPool.Release(firstFiber);
+    EXPECT_EQUAL(fiberPool.Acquire(), firstFiber);
+}
+
+TEST(FiberPoolTests, FiberCarriesOnFromWhereItSwitchedAway)
+{
+    std::vector<char> stackMemory(TestStackSize + FiberPool::STACK_ALIGNMENT);
+    Memory::MemoryArea stackArea(stackMemory.data(), stackMemory.size());
+    Fiber threadFiber;
+    SwitchBackData data = { &threadFiber, nullptr, 0 };
+    FiberPool fiberPool(&stackArea, TestStackSize, &CountAndSwitchBack, &data);
+    data._self = fiberPool.Acquire();
+
+    threadFiber.ConvertCurrentThread();
+    Fiber::Switch(&threadFiber, data._self);
+    Fiber::Switch(&threadFiber, data._self);
+    threadFiber.RevertCurrentThread();
+
+    EXPECT_EQUAL(data._numTimesRun, 2u);
+}
@@ -4,6 +4,7 @@
 #include "Task/ParallelFor.h"
 #include "Task/TaskManager.h"
 
+#include "Task/TaskTestHelpers/ImmediateTaskSystem.h"
 #include "Task/TaskTestHelpers/MockSplitter.h"
 #include "Task/TaskTestHelpers/MockTaskSystem.h"
 #include "Task/TaskTestHelpers/RecordReplaySplitter.h"
@@ -125,3 +126,165 @@ TEST(ParallelForTests, RunsAllTasks)
         EXPECT_EQUAL(dummyData[index], ((int)index * 2)) << "Data for index " << index << " was incorrect";
     }
 }
+
+TEST(ParallelForTests, RunsAllTasksWithMoreLeavesThanMaxConcurrentTasks)
+{
+    const uint32_t dummyDataSize = TaskManager::MaxConcurrentTasks * 50;
+    std::vector<int32_t> dummyData(dummyDataSize);
+    CountSplitter<int32_t> countSplitter(1);
+    TaskManager taskManager;
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        dummyData[index] = index;
+    }
+    
+    auto parallelFor = ParallelFor<int32_t, CountSplitter<int32_t>>(dummyData.data(), dummyDataSize, &countSplitter, [&](int32_t* data, uint32_t dataCount){
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            data[index] *= 2;
+        }
+    }, &taskManager);
+    
+    auto taskId = parallelFor.Run();
+    taskManager.Wait(taskId);
+    
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        ASSERT_EQUAL(dummyData[index], ((int)index * 2)) << "Data for index " << index << " was incorrect";
+    }
+}
+
+TEST(ParallelForTests, LeavesOfADefaultParallelForAreNotHeapAllocated)
+{
+    const uint32_t dummyDataSize = 20;
+    int32_t dummyData[dummyDataSize];
+    StubSplitter<int32_t> stubSplitter(false);
+    RecordTaskSystem<2> recordTaskSystem;
+    
+    auto parallelFor = ParallelFor<int32_t, StubSplitter<int32_t>, RecordTaskSystem<2>>(dummyData, dummyDataSize, &stubSplitter, [](int32_t*, uint32_t){}, &recordTaskSystem);
+    parallelFor.Run();
+    
+    recordTaskSystem.AssertExpectedNumberOfTasksAdded();
+    EXPECT_EQUAL(recordTaskSystem._numHeapAllocatedWorkItems, 0u) << "The leaf's work item should have fitted inline";
+}
+
+TEST(ParallelForTests, ParallelForCanBeDestroyedBeforeItsTasksRun)
+{
+    const uint32_t dummyDataSize = 100;
+    int32_t dummyData[dummyDataSize];
+    CountSplitter<int32_t> countSplitter(10);
+    TaskManager taskManager(0);
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        dummyData[index] = index;
+    }
+    
+    // No worker threads, so nothing runs until Wait, after the ParallelFor has gone
+    auto taskId = ParallelFor<int32_t, CountSplitter<int32_t>>(dummyData, dummyDataSize, &countSplitter, [](int32_t* data, uint32_t dataCount){
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            data[index] *= 2;
+        }
+    }, &taskManager).Run();
+    taskManager.Wait(taskId);
+    
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        EXPECT_EQUAL(dummyData[index], ((int)index * 2)) << "Data for index " << index << " was incorrect";
+    }
+}
+
+TEST(ParallelForTests, CallableTypeIsDeducedWithoutTemplateArguments)
+{
+    int32_t dummyData[1];
+    StubSplitter<int32_t> stubSplitter(false);
+    StubTaskSystem stubTaskSystem;
+    auto workFunc = [](int32_t*, uint32_t){};
+    
+    auto parallelFor = ParallelFor(dummyData, 1u, &stubSplitter, workFunc, &stubTaskSystem);
+    
+    static_assert(std::is_same<decltype(parallelFor), ParallelFor<int32_t, StubSplitter<int32_t>, StubTaskSystem, decltype(workFunc)>>::value,
+        "Work function should not have been wrapped in a std::function");
+}
+
+TEST(ParallelForTests, LazyShouldNotSplitUntilRangeRuns)
+{
+    const uint32_t dummyDataSize = 20;
+    int32_t dummyData[dummyDataSize];
+    MockSplitter<int32_t> mockSplitter;
+    RecordTaskSystem<2> recordTaskSystem;
+    
+    LazyParallelFor parallelFor(dummyData, dummyDataSize, &mockSplitter, [](int32_t*, uint32_t){}, &recordTaskSystem);
+    
+    parallelFor.Run();
+    
+    recordTaskSystem.AssertExpectedNumberOfTasksAdded();
+    EXPECT_EQUAL(recordTaskSystem._parentTasks[1], TaskId(0)) << "Range task was not parented correclty";
+    EXPECT_EQUAL(mockSplitter._data, nullptr) << "Splitter should not have been asked before the range ran";
+}
+
+TEST(ParallelForTests, LazySplitsOnTheThreadRunningTheRange)
+{
+    const uint32_t dummyDataSize = 19;
+    int32_t dummyData[dummyDataSize];
+    bool shouldSplit[] = {
+        true,
+        false,
+        false
+    };
+    RecordReplaySplitter<int32_t, 3> recordReplaySplitter(shouldSplit);
+    ImmediateTaskSystem immediateTaskSystem;
+    std::vector<std::pair<int32_t*, uint32_t>> leaves;
+    
+    LazyParallelFor parallelFor(dummyData, dummyDataSize, &recordReplaySplitter, [&](int32_t* data, uint32_t dataCount){
+        leaves.emplace_back(data, dataCount);
+    }, &immediateTaskSystem);
+    
+    auto rootId = parallelFor.Run();
+    
+    recordReplaySplitter.AssertUsedAllExpectedResponses();
+    auto expectedOffset = dummyDataSize / 2u;
+    // The right half is added as a task, which the immediate task system runs first
+    EXPECT_EQUAL(recordReplaySplitter._dataList[0], dummyData) << "First split did not have correct data";
+    EXPECT_EQUAL(recordReplaySplitter._dataCountList[0], dummyDataSize) << "First split did not have correct data count";
+    EXPECT_EQUAL(recordReplaySplitter._dataList[1], &dummyData[expectedOffset]) << "Second split did not have correct data";
+    EXPECT_EQUAL(recordReplaySplitter._dataCountList[1], dummyDataSize - expectedOffset) << "Second split did not have correct data count";
+    EXPECT_EQUAL(recordReplaySplitter._dataList[2], dummyData) << "Third split did not have correct data";
+    EXPECT_EQUAL(recordReplaySplitter._dataCountList[2], expectedOffset) << "Third split did not have correct data count";
+    
+    ASSERT_EQUAL(leaves.size(), 2u);
+    EXPECT_EQUAL(leaves[0].first, &dummyData[expectedOffset]);
+    EXPECT_EQUAL(leaves[1].first, dummyData);
+    EXPECT_EQUAL(leaves[0].second + leaves[1].second, dummyDataSize);
+    for(auto& parentTask : immediateTaskSystem._parentTasks)
+    {
+        EXPECT_EQUAL(parentTask.second, rootId) << "Every range should be a child of the root task";
+    }
+}
+
+TEST(ParallelForTests, LazyRunsAllTasksWithMoreLeavesThanMaxConcurrentTasks)
+{
+    const uint32_t dummyDataSize = TaskManager::MaxConcurrentTasks * 50;
+    std::vector<int32_t> dummyData(dummyDataSize);
+    CountSplitter<int32_t> countSplitter(1);
+    TaskManager taskManager;
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        dummyData[index] = index;
+    }
+    
+    LazyParallelFor parallelFor(dummyData.data(), dummyDataSize, &countSplitter, [&](int32_t* data, uint32_t dataCount){
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            data[index] *= 2;
+        }
+    }, &taskManager);
+    
+    auto taskId = parallelFor.Run();
+    taskManager.Wait(taskId);
+    
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        ASSERT_EQUAL(dummyData[index], ((int)index * 2)) << "Data for index " << index << " was incorrect";
+    }
+}
@@ -0,0 +1,116 @@
+#include "Test.h"
+
+#include <cstring>
+
+#include "Task/CountSplitter.h"
+#include "Task/ParallelReduce.h"
+#include "Task/TaskManager.h"
+
+#include "Task/TaskTestHelpers/RecordTaskSystem.h"
+#include "Task/TaskTestHelpers/ReplaySplitter.h"
+#include "Task/TaskTestHelpers/StubSplitter.h"
+#include "Task/TaskTestHelpers/StubTaskSystem.h"
+
+using namespace Flourish;
+using namespace Flourish::TaskTestHelpers;
+
+namespace
+{
+    auto SumRange = [](int32_t* data, uint32_t dataCount, int32_t total) {
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            total += data[index];
+        }
+        return total;
+    };
+    
+    auto Add = [](int32_t left, int32_t right) {
+        return left + right;
+    };
+}
+
+TEST(ParallelReduceTests, ShouldAddTaskForEachLeaf)
+{
+    const uint32_t dummyDataSize = 20;
+    int32_t dummyData[dummyDataSize];
+    bool shouldSplit[] = {
+        true,
+        false,
+        false
+    };
+    ReplaySplitter<int32_t, 3> replaySplitter(shouldSplit);
+    RecordTaskSystem<3> recordTaskSystem;
+    
+    ParallelReduce parallelReduce(dummyData, dummyDataSize, &replaySplitter, 0, SumRange, Add, &recordTaskSystem);
+    parallelReduce.Run();
+    
+    replaySplitter.AssertUsedAllExpectedResponses();
+    recordTaskSystem.AssertExpectedNumberOfTasksAdded();
+    EXPECT_EQUAL(recordTaskSystem._parentTasks[1], TaskId(0)) << "First leaf was not parented correclty";
+    EXPECT_EQUAL(recordTaskSystem._parentTasks[2], TaskId(0)) << "Second leaf was not parented correclty";
+}
+
+TEST(ParallelReduceTests, ResultIsIdentityIfNoLeavesHaveRun)
+{
+    int32_t dummyData[4] = { 1, 2, 3, 4 };
+    StubSplitter<int32_t> stubSplitter(false);
+    StubTaskSystem stubTaskSystem;
+    
+    ParallelReduce parallelReduce(dummyData, 4u, &stubSplitter, 0, SumRange, Add, &stubTaskSystem);
+    parallelReduce.Run();
+    
+    EXPECT_EQUAL(parallelReduce.GetResult(), 0) << "The stub task system never runs the leaves";
+}
+
+TEST(ParallelReduceTests, SumsAllData)
+{
+    const uint32_t dummyDataSize = 100000;
+    std::vector<int32_t> dummyData(dummyDataSize);
+    CountSplitter<int32_t> countSplitter(100);
+    TaskManager taskManager;
+    int32_t expectedTotal = 0;
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        dummyData[index] = index % 7;
+        expectedTotal += index % 7;
+    }
+    
+    ParallelReduce parallelReduce(dummyData.data(), dummyDataSize, &countSplitter, 0, SumRange, Add, &taskManager);
+    taskManager.Wait(parallelReduce.Run());
+    
+    EXPECT_EQUAL(parallelReduce.GetResult(), expectedTotal);
+}
+
+TEST(ParallelReduceTests, FloatResultIsTheSameEveryRun)
+{
+    const uint32_t dummyDataSize = 100000;
+    std::vector<float> dummyData(dummyDataSize);
+    CountSplitter<float> countSplitter(64);
+    TaskManager taskManager;
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        dummyData[index] = 1.0f / static_cast<float>(index + 1);
+    }
+    auto sumRange = [](float* data, uint32_t dataCount, float total) {
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            total += data[index];
+        }
+        return total;
+    };
+    auto add = [](float left, float right) {
+        return left + right;
+    };
+    
+    ParallelReduce firstReduce(dummyData.data(), dummyDataSize, &countSplitter, 0.0f, sumRange, add, &taskManager);
+    taskManager.Wait(firstReduce.Run());
+    for(uint32_t run = 0; run < 10; run++)
+    {
+        ParallelReduce reduce(dummyData.data(), dummyDataSize, &countSplitter, 0.0f, sumRange, add, &taskManager);
+        taskManager.Wait(reduce.Run());
+        
+        auto firstResult = firstReduce.GetResult();
+        auto result = reduce.GetResult();
+        EXPECT_EQUAL(memcmp(&firstResult, &result, sizeof(float)), 0) << "Result was different on run " << run;
+    }
+}
@@ -0,0 +1,105 @@
+#include "Test.h"
+
+#include "Task/CountSplitter.h"
+#include "Task/ParallelScan.h"
+#include "Task/TaskManager.h"
+
+#include "Task/TaskTestHelpers/ImmediateTaskSystem.h"
+#include "Task/TaskTestHelpers/RecordTaskSystem.h"
+#include "Task/TaskTestHelpers/ReplaySplitter.h"
+
+using namespace Flourish;
+using namespace Flourish::TaskTestHelpers;
+
+namespace
+{
+    auto Add = [](int32_t left, int32_t right) {
+        return left + right;
+    };
+}
+
+TEST(ParallelScanTests, OutputTasksWaitForEveryLeafTotal)
+{
+    const uint32_t dummyDataSize = 20;
+    int32_t dummyData[dummyDataSize];
+    bool shouldSplit[] = {
+        true,
+        false,
+        false
+    };
+    ReplaySplitter<int32_t, 3> replaySplitter(shouldSplit);
+    // Root, the task the totals are children of, the task that adds the
+    // output tasks, and a task for each leaf's total
+    RecordTaskSystem<5> recordTaskSystem;
+    
+    ParallelInclusiveScan parallelScan(dummyData, dummyData, dummyDataSize, &replaySplitter, 0, Add, &recordTaskSystem);
+    parallelScan.Run();
+    
+    replaySplitter.AssertUsedAllExpectedResponses();
+    recordTaskSystem.AssertExpectedNumberOfTasksAdded();
+    ASSERT_EQUAL(recordTaskSystem._dependencies.size(), 1u);
+    auto totalsTask = recordTaskSystem._dependencies[0].first;
+    auto offsetsTask = recordTaskSystem._dependencies[0].second;
+    EXPECT_EQUAL(recordTaskSystem._parentTasks[offsetsTask], TaskId(0)) << "Output tasks should be added under the root";
+    EXPECT_EQUAL(recordTaskSystem._parentTasks[3], totalsTask) << "First leaf total was not parented correctly";
+    EXPECT_EQUAL(recordTaskSystem._parentTasks[4], totalsTask) << "Second leaf total was not parented correctly";
+}
+
+TEST(ParallelScanTests, InclusiveScanIncludesEachElement)
+{
+    int32_t data[] = { 1, 2, 3, 4, 5 };
+    int32_t output[5];
+    CountSplitter<int32_t> countSplitter(2);
+    ImmediateTaskSystem immediateTaskSystem;
+    
+    ParallelInclusiveScan parallelScan(data, output, 5u, &countSplitter, 0, Add, &immediateTaskSystem);
+    parallelScan.Run();
+    
+    int32_t expected[] = { 1, 3, 6, 10, 15 };
+    for(uint32_t index = 0; index < 5; index++)
+    {
+        EXPECT_EQUAL(output[index], expected[index]) << "Output for index " << index << " was incorrect";
+    }
+    EXPECT_EQUAL(parallelScan.GetTotal(), 15);
+}
+
+TEST(ParallelScanTests, ExclusiveScanStartsWithIdentity)
+{
+    int32_t data[] = { 1, 2, 3, 4, 5 };
+    CountSplitter<int32_t> countSplitter(2);
+    ImmediateTaskSystem immediateTaskSystem;
+    
+    // In place
+    ParallelExclusiveScan parallelScan(data, data, 5u, &countSplitter, 0, Add, &immediateTaskSystem);
+    parallelScan.Run();
+    
+    int32_t expected[] = { 0, 1, 3, 6, 10 };
+    for(uint32_t index = 0; index < 5; index++)
+    {
+        EXPECT_EQUAL(data[index], expected[index]) << "Output for index " << index << " was incorrect";
+    }
+    EXPECT_EQUAL(parallelScan.GetTotal(), 15);
+}
+
+TEST(ParallelScanTests, ScansAllData)
+{
+    const uint32_t dummyDataSize = 100000;
+    std::vector<int32_t> dummyData(dummyDataSize);
+    std::vector<int32_t> output(dummyDataSize);
+    CountSplitter<int32_t> countSplitter(100);
+    TaskManager taskManager;
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        dummyData[index] = index % 7;
+    }
+    
+    ParallelInclusiveScan parallelScan(dummyData.data(), output.data(), dummyDataSize, &countSplitter, 0, Add, &taskManager);
+    taskManager.Wait(parallelScan.Run());
+    
+    int32_t expectedTotal = 0;
+    for(uint32_t index = 0; index < dummyDataSize; index++)
+    {
+        expectedTotal += dummyData[index];
+        ASSERT_EQUAL(output[index], expectedTotal) << "Output for index " << index << " was incorrect";
+    }
+}
@@ -0,0 +1,179 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Task/ParallelSort.h"
+#include "Task/TaskManager.h"
+
+#include "Task/TaskTestHelpers/CountingAllocator.h"
+
+using namespace Flourish;
+using namespace Flourish::TaskTestHelpers;
+
+namespace
+{
+    // Enough data for several blocks, and an odd number of merge rounds, so the
+    // sorted data has to be copied back out of the scratch memory
+    const uint32_t DummyDataSize = 30001;
+
+    struct KeyAndIndex
+    {
+        int32_t _key;
+        uint32_t _index;
+    };
+
+    template<typename DataType, typename Distribution>
+    std::vector<DataType> MakeRandomData(uint32_t dataCount, Distribution distribution)
+    {
+        std::mt19937 generator(12345u);
+        std::vector<DataType> data(dataCount);
+        for(auto& value : data)
+        {
+            value = static_cast<DataType>(distribution(generator));
+        }
+        return data;
+    }
+
+    std::vector<KeyAndIndex> MakeKeysWithDuplicates(uint32_t dataCount)
+    {
+        auto keys = MakeRandomData<int32_t>(dataCount, std::uniform_int_distribution<int32_t>(-50, 50));
+        std::vector<KeyAndIndex> data(dataCount);
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            data[index] = KeyAndIndex{ keys[index], index };
+        }
+        return data;
+    }
+
+    void ExpectSortedByKeyAndStable(const std::vector<KeyAndIndex>& data)
+    {
+        for(size_t index = 1; index < data.size(); index++)
+        {
+            ASSERT_LESS_THAN_OR_EQUAL(data[index - 1]._key, data[index]._key) << "at index " << index;
+            if(data[index - 1]._key == data[index]._key)
+            {
+                ASSERT_LESS_THAN(data[index - 1]._index, data[index]._index) << "Equal keys should keep their order, at index " << index;
+            }
+        }
+    }
+}
+
+TEST(ParallelSortTests, SortsTheSameAsStdSort)
+{
+    auto data = MakeRandomData<uint32_t>(DummyDataSize, std::uniform_int_distribution<uint32_t>());
+    auto expected = data;
+    std::sort(expected.begin(), expected.end());
+    CountingAllocator allocator;
+    TaskManager taskManager(3);
+
+    ParallelSort(data.data(), DummyDataSize, &allocator, &taskManager);
+
+    EXPECT_EQUAL(data, expected);
+}
+
+TEST(ParallelSortTests, SortsWithTheCompareGiven)
+{
+    auto data = MakeRandomData<int32_t>(DummyDataSize, std::uniform_int_distribution<int32_t>());
+    auto expected = data;
+    std::sort(expected.begin(), expected.end(), std::greater<int32_t>());
+    CountingAllocator allocator;
+    TaskManager taskManager(3);
+
+    ParallelSort(data.data(), DummyDataSize, std::greater<int32_t>(), &allocator, &taskManager);
+
+    EXPECT_EQUAL(data, expected);
+}
+
+TEST(ParallelSortTests, IsStable)
+{
+    auto data = MakeKeysWithDuplicates(DummyDataSize);
+    CountingAllocator allocator;
+    TaskManager taskManager(3);
+
+    ParallelSort(data.data(), DummyDataSize, [](const KeyAndIndex& left, const KeyAndIndex& right) {
+        return left._key < right._key;
+    }, &allocator, &taskManager);
+
+    ExpectSortedByKeyAndStable(data);
+}
+
+TEST(ParallelSortTests, FreesAllScratchMemory)
+{
+    auto data = MakeRandomData<uint32_t>(DummyDataSize, std::uniform_int_distribution<uint32_t>());
+    CountingAllocator allocator;
+    TaskManager taskManager(3);
+
+    ParallelSort(data.data(), DummyDataSize, &allocator, &taskManager);
+
+    EXPECT_GREATER_THAN(allocator._numAllocs, 0u);
+    EXPECT_EQUAL(allocator._numFrees, allocator._numAllocs);
+}
+
+TEST(ParallelSortTests, SortsDataSmallerThanABlockWithoutScratchMemory)
+{
+    std::vector<int32_t> data = { 5, -1, 3, 3, 0 };
+    CountingAllocator allocator;
+    TaskManager taskManager(3);
+
+    ParallelSort(data.data(), static_cast<uint32_t>(data.size()), &allocator, &taskManager);
+
+    EXPECT_EQUAL(data, std::vector<int32_t>({ -1, 0, 3, 3, 5 }));
+    EXPECT_EQUAL(allocator._numAllocs, 0u);
+}
+
+TEST(ParallelRadixSortTests, SortsUnsignedKeys)
+{
+    auto data = MakeRandomData<uint32_t>(DummyDataSize, std::uniform_int_distribution<uint32_t>());
+    auto expected = data;
+    std::sort(expected.begin(), expected.end());
+    CountingAllocator allocator;
+    TaskManager taskManager(3);
+
+    ParallelRadixSort(data.data(), DummyDataSize, &allocator, &taskManager);
+
+    EXPECT_EQUAL(data, expected);
+    EXPECT_EQUAL(allocator._numFrees, allocator._numAllocs);
+}
+
+TEST(ParallelRadixSortTests, SortsNegativeSigned64BitKeys)
+{
+    auto data = MakeRandomData<int64_t>(DummyDataSize, std::uniform_int_distribution<int64_t>(INT64_MIN, INT64_MAX));
+    auto expected = data;
+    std::sort(expected.begin(), expected.end());
+    CountingAllocator allocator;
+    TaskManager taskManager(3);
+
+    ParallelRadixSort(data.data(), DummyDataSize, &allocator, &taskManager);
+
+    EXPECT_EQUAL(data, expected);
+}
+
+TEST(ParallelRadixSortTests, SortsNegativeFloatKeys)
+{
+    auto data = MakeRandomData<float>(DummyDataSize, std::uniform_real_distribution<float>(-1000.0f, 1000.0f));
+    data[0] = -0.0f;
+    data[1] = 0.0f;
+    auto expected = data;
+    std::stable_sort(expected.begin(), expected.end());
+    CountingAllocator allocator;
+    TaskManager taskManager(3);
+
+    ParallelRadixSort(data.data(), DummyDataSize, &allocator, &taskManager);
+
+    EXPECT_EQUAL(data, expected);
+}
+
+TEST(ParallelRadixSortTests, SortsByTheExtractedKeyAndIsStable)
+{
+    auto data = MakeKeysWithDuplicates(DummyDataSize);
+    CountingAllocator allocator;
+    TaskManager taskManager(3);
+
+    ParallelRadixSort(data.data(), DummyDataSize, [](const KeyAndIndex& value) {
+        return value._key;
+    }, &allocator, &taskManager);
+
+    ExpectSortedByKeyAndStable(data);
+}
@@ -0,0 +1,152 @@
+#include "Test.h"
+#include "Task/Pipeline.h"
+#include "Task/TaskManager.h"
+#include "TaskTestHelpers/CountingAllocator.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Flourish;
+
+namespace
+{
+    struct Chunk
+    {
+        uint32_t _index;
+        uint32_t _value;
+    };
+
+    // Reads numChunks chunks, numbering them in order
+    std::function<bool(Chunk&)> ReadChunks(uint32_t numChunks)
+    {
+        auto nextIndex = std::make_shared<uint32_t>(0);
+        return [nextIndex, numChunks](Chunk& chunk) {
+            if(*nextIndex == numChunks)
+            {
+                return false;
+            }
+            chunk._index = (*nextIndex)++;
+            chunk._value = chunk._index;
+            return true;
+        };
+    }
+}
+
+TEST(PipelineTests, SerialInOrderStageSeesItemsInTheOrderTheyWereRead)
+{
+    TaskManager taskManager(2);
+    Memory::MallocAllocator allocator("PipelineTests");
+    std::vector<uint32_t> writtenIndices;
+    Pipeline<Chunk> pipeline(4, &allocator, ReadChunks(200), &taskManager);
+    pipeline.AddStage(PipelineStageMode::Parallel, [](Chunk& chunk) {
+        // Uneven, so later chunks often finish this stage first
+        if(chunk._index % 3 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        chunk._value *= 2;
+    });
+    pipeline.AddStage(PipelineStageMode::SerialInOrder, [&](Chunk& chunk) {
+        EXPECT_EQUAL(chunk._value, chunk._index * 2);
+        writtenIndices.push_back(chunk._index);
+    });
+
+    taskManager.Wait(pipeline.Run());
+
+    ASSERT_EQUAL(writtenIndices.size(), 200u);
+    for(uint32_t index = 0; index < 200; index++)
+    {
+        ASSERT_EQUAL(writtenIndices[index], index);
+    }
+}
+
+TEST(PipelineTests, NoMoreThanMaxTokensAreInFlight)
+{
+    TaskManager taskManager(2);
+    Memory::MallocAllocator allocator("PipelineTests");
+    std::atomic_uint numInFlight(0);
+    std::atomic_uint maxInFlight(0);
+    auto readChunks = ReadChunks(500);
+    Pipeline<Chunk> pipeline(3, &allocator, [&](Chunk& chunk) {
+        if(!readChunks(chunk))
+        {
+            return false;
+        }
+        auto newNumInFlight = ++numInFlight;
+        auto previousMax = maxInFlight.load();
+        while(newNumInFlight > previousMax && !maxInFlight.compare_exchange_weak(previousMax, newNumInFlight))
+        {
+        }
+        return true;
+    }, &taskManager);
+    pipeline.AddStage(PipelineStageMode::Parallel, [](Chunk&) {
+        std::this_thread::yield();
+    });
+    pipeline.AddStage(PipelineStageMode::Parallel, [&](Chunk&) {
+        numInFlight--;
+    });
+
+    taskManager.Wait(pipeline.Run());
+
+    EXPECT_EQUAL(numInFlight.load(), 0u);
+    EXPECT_TRUE(maxInFlight.load() <= 3u) << maxInFlight.load() << " items were in flight with 3 tokens";
+}
+
+TEST(PipelineTests, SerialOutOfOrderStageRunsOneTokenAtATime)
+{
+    TaskManager taskManager(2);
+    Memory::MallocAllocator allocator("PipelineTests");
+    std::atomic_bool isInStage(false);
+    std::atomic_bool overlapped(false);
+    uint32_t total = 0;
+    Pipeline<Chunk> pipeline(8, &allocator, ReadChunks(300), &taskManager);
+    pipeline.AddStage(PipelineStageMode::SerialOutOfOrder, [&](Chunk& chunk) {
+        if(isInStage.exchange(true))
+        {
+            overlapped = true;
+        }
+        total += chunk._value;
+        std::this_thread::yield();
+        isInStage = false;
+    });
+
+    taskManager.Wait(pipeline.Run());
+
+    EXPECT_FALSE(overlapped.load()) << "Two tokens were in a serial stage at once";
+    EXPECT_EQUAL(total, 299u * 300u / 2u);
+}
+
+TEST(PipelineTests, TokensComeFromTheAllocatorAndCanBeRunAgain)
+{
+    TaskManager taskManager(1);
+    TaskTestHelpers::CountingAllocator allocator;
+    uint32_t numWritten = 0;
+    {
+        uint32_t numChunksLeft = 0;
+        Pipeline<Chunk> pipeline(4, &allocator, [&](Chunk& chunk) {
+            if(numChunksLeft == 0)
+            {
+                return false;
+            }
+            chunk._value = numChunksLeft--;
+            return true;
+        }, &taskManager);
+        pipeline.AddStage(PipelineStageMode::SerialInOrder, [&](Chunk&) {
+            numWritten++;
+        });
+
+        numChunksLeft = 10;
+        taskManager.Wait(pipeline.Run());
+        numChunksLeft = 20;
+        taskManager.Wait(pipeline.Run());
+
+        // The tokens and the stage
+        EXPECT_EQUAL(allocator._numAllocs, 2u);
+    }
+
+    EXPECT_EQUAL(numWritten, 30u);
+    EXPECT_EQUAL(allocator._numFrees, 2u);
+}
@@ -0,0 +1,88 @@
+#include "Test.h"
+#include "Task/PriorityTaskQueue.h"
+#include "Memory/Allocators/MallocAllocator.h"
+
+using namespace Flourish;
+
+TEST(PriorityTaskQueueTests, TasksArePushedToTheirPriority)
+{
+    Memory::MallocAllocator allocator("PriorityTaskQueueTests");
+    PriorityTaskQueue queue(&allocator);
+    Task highTask;
+    Task backgroundTask;
+    highTask._priority = TaskPriority::High;
+    backgroundTask._priority = TaskPriority::Background;
+    
+    queue.Push(&backgroundTask);
+    queue.Push(&highTask);
+    
+    EXPECT_EQUAL(queue.Pop(TaskPriority::Normal), nullptr);
+    EXPECT_EQUAL(queue.Steal(TaskPriority::Background), &backgroundTask);
+    EXPECT_EQUAL(queue.Pop(TaskPriority::High), &highTask);
+}
+
+TEST(PriorityTaskQueueTests, OrderIsHighestPriorityFirst)
+{
+    Memory::MallocAllocator allocator("PriorityTaskQueueTests");
+    PriorityTaskQueue queue(&allocator);
+    TaskPriority order[NUM_TASK_PRIORITIES];
+    
+    queue.GetPriorityOrder(order);
+    
+    EXPECT_EQUAL(order[0], TaskPriority::High);
+    EXPECT_EQUAL(order[1], TaskPriority::Normal);
+    EXPECT_EQUAL(order[2], TaskPriority::Background);
+}
+
+TEST(PriorityTaskQueueTests, StarvedPriorityMovesToFront)
+{
+    Memory::MallocAllocator allocator("PriorityTaskQueueTests");
+    PriorityTaskQueue queue(&allocator);
+    TaskPriority order[NUM_TASK_PRIORITIES];
+    
+    for(uint32_t index = 0; index < PriorityTaskQueue::MAXIMUM_TASKS_BEFORE_AGING; index++)
+    {
+        queue.OnTaskExecuted(TaskPriority::High);
+        queue.OnTaskExecuted(TaskPriority::Normal);
+    }
+    queue.GetPriorityOrder(order);
+    
+    EXPECT_EQUAL(order[0], TaskPriority::Background) << "Background should have been aged to the front";
+    EXPECT_EQUAL(order[1], TaskPriority::High);
+    EXPECT_EQUAL(order[2], TaskPriority::Normal);
+}
+
+TEST(PriorityTaskQueueTests, ExecutingOrFindingNothingResetsAging)
+{
+    Memory::MallocAllocator allocator("PriorityTaskQueueTests");
+    PriorityTaskQueue queue(&allocator);
+    TaskPriority order[NUM_TASK_PRIORITIES];
+    
+    for(uint32_t index = 0; index < PriorityTaskQueue::MAXIMUM_TASKS_BEFORE_AGING; index++)
+    {
+        queue.OnTaskExecuted(TaskPriority::High);
+    }
+    queue.OnTaskExecuted(TaskPriority::Normal);
+    queue.OnNoTaskFound(TaskPriority::Background);
+    queue.GetPriorityOrder(order);
+    
+    EXPECT_EQUAL(order[0], TaskPriority::High);
+    EXPECT_EQUAL(order[1], TaskPriority::Normal);
+    EXPECT_EQUAL(order[2], TaskPriority::Background);
+}
+
+TEST(PriorityTaskQueueTests, PriorityIsAgedOnceItHasWaitedForTheLimit)
+{
+    Memory::MallocAllocator allocator("PriorityTaskQueueTests");
+    PriorityTaskQueue queue(&allocator);
+    
+    for(uint32_t index = 0; index < PriorityTaskQueue::MAXIMUM_TASKS_BEFORE_AGING - 1; index++)
+    {
+        queue.OnTaskExecuted(TaskPriority::Normal);
+    }
+    EXPECT_FALSE(queue.IsAged(TaskPriority::High));
+    
+    queue.OnTaskExecuted(TaskPriority::Normal);
+    EXPECT_TRUE(queue.IsAged(TaskPriority::High));
+    EXPECT_FALSE(queue.IsAged(TaskPriority::Normal));
+}
@@ -0,0 +1,102 @@
+#include "Test.h"
+#include "Memory/Memory.h"
+#include "Task/TaskAllocator.h"
+#include "TaskTestHelpers/CountingAllocator.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace Flourish;
+
+namespace
+{
+    // Owns the allocator on the current thread until it goes out of scope
+    class OwnedTaskAllocator : public TaskAllocator
+    {
+    public:
+        explicit OwnedTaskAllocator(Memory::IAllocator* backingAllocator)
+            : TaskAllocator(backingAllocator)
+        {
+            TaskAllocator::SetOwnedByCurrentThread(this);
+        }
+
+        ~OwnedTaskAllocator() override
+        {
+            TaskAllocator::SetOwnedByCurrentThread(nullptr);
+        }
+    };
+}
+
+TEST(TaskAllocatorTests, FreedBlocksAreReusedByTheOwner)
+{
+    TaskTestHelpers::CountingAllocator backingAllocator;
+    OwnedTaskAllocator allocator(&backingAllocator);
+
+    auto first = FL_ALLOC(allocator, 100);
+    FL_FREE(allocator, first);
+    auto second = FL_ALLOC(allocator, 100);
+    auto differentSize = FL_ALLOC(allocator, 1000);
+
+    EXPECT_EQUAL(second, first);
+    EXPECT_NOT_EQUAL(differentSize, first);
+    EXPECT_EQUAL(allocator.GetAllocationSize(second), 128u);
+    EXPECT_EQUAL(allocator.GetAllocationSize(differentSize), 1024u);
+    EXPECT_EQUAL(backingAllocator._numAllocs, 1u) << "Both blocks should have come from the same chunk";
+    FL_FREE(allocator, second);
+    FL_FREE(allocator, differentSize);
+}
+
+TEST(TaskAllocatorTests, BlocksFreedOnOtherThreadsAreTakenBackByTheOwner)
+{
+    TaskTestHelpers::CountingAllocator backingAllocator;
+    OwnedTaskAllocator allocator(&backingAllocator);
+    std::vector<void*> blocks;
+    for(uint32_t blockIdx = 0; blockIdx < 100; blockIdx++)
+    {
+        blocks.push_back(FL_ALLOC(allocator, 64));
+    }
+    auto numChunks = allocator.GetNumChunks();
+
+    std::thread otherThread([&]{
+        for(auto block : blocks)
+        {
+            FL_FREE(allocator, block);
+        }
+    });
+    otherThread.join();
+    std::vector<void*> reusedBlocks;
+    for(uint32_t blockIdx = 0; blockIdx < 100; blockIdx++)
+    {
+        reusedBlocks.push_back(FL_ALLOC(allocator, 64));
+    }
+
+    EXPECT_EQUAL(allocator.GetNumChunks(), numChunks) << "New chunks were allocated instead of reusing the freed blocks";
+    std::sort(blocks.begin(), blocks.end());
+    std::sort(reusedBlocks.begin(), reusedBlocks.end());
+    EXPECT_TRUE(blocks == reusedBlocks);
+    for(auto block : reusedBlocks)
+    {
+        FL_FREE(allocator, block);
+    }
+}
+
+TEST(TaskAllocatorTests, LargeAllocationsAndOtherThreadsUseTheBackingAllocator)
+{
+    TaskTestHelpers::CountingAllocator backingAllocator;
+    OwnedTaskAllocator allocator(&backingAllocator);
+
+    auto large = FL_ALLOC(allocator, TaskAllocator::MAX_BLOCK_SIZE + 1);
+    void* fromOtherThread = nullptr;
+    std::thread otherThread([&]{
+        fromOtherThread = FL_ALLOC(allocator, 64);
+    });
+    otherThread.join();
+
+    EXPECT_EQUAL(allocator.GetNumChunks(), 0u);
+    EXPECT_EQUAL(backingAllocator._numAllocs, 2u);
+    EXPECT_EQUAL(allocator.GetAllocationSize(large), TaskAllocator::MAX_BLOCK_SIZE + 1);
+    FL_FREE(allocator, large);
+    FL_FREE(allocator, fromOtherThread);
+    EXPECT_EQUAL(backingAllocator._numFrees, 2u);
+}
@@ -0,0 +1,110 @@
+#include "Test.h"
+
+#include <atomic>
+#include <vector>
+
+#include "Task/CountSplitter.h"
+#include "Task/ParallelFor.h"
+#include "Task/TaskGroup.h"
+#include "Task/TaskManager.h"
+
+using namespace Flourish;
+
+TEST(TaskGroupTests, WaitAllWaitsForEveryTaskInTheGroup)
+{
+    TaskManager taskManager(2);
+    TaskGroup group(&taskManager);
+    std::atomic_uint numRun(0);
+    std::vector<TaskId> taskIds;
+
+    for(uint32_t taskIdx = 0; taskIdx < 100; taskIdx++)
+    {
+        taskIds.push_back(group.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numRun++;
+        })));
+    }
+    group.WaitAll();
+
+    EXPECT_EQUAL(numRun.load(), 100u);
+    for(auto taskId : taskIds)
+    {
+        ASSERT_TRUE(taskManager.IsComplete(taskId));
+    }
+}
+
+TEST(TaskGroupTests, WaitAllWaitsForTasksAddedByTasksInTheGroup)
+{
+    TaskManager taskManager(2);
+    TaskGroup group(&taskManager);
+    CountSplitter<int32_t> splitter(16);
+    std::vector<int32_t> data(10000, 1);
+    std::atomic_uint numProcessed(0);
+    LazyParallelFor parallelFor(data.data(), static_cast<uint32_t>(data.size()), &splitter, [&](int32_t*, uint32_t dataCount){
+        numProcessed += dataCount;
+    }, &group);
+
+    parallelFor.Run();
+    group.WaitAll();
+
+    EXPECT_EQUAL(numProcessed.load(), 10000u);
+}
+
+TEST(TaskGroupTests, CancelledTasksFinishWithoutRunning)
+{
+    // No workers, so nothing runs until the group is waited on
+    TaskManager taskManager(0);
+    TaskGroup group(&taskManager);
+    std::atomic_uint numRun(0);
+    std::vector<TaskId> taskIds;
+
+    for(uint32_t taskIdx = 0; taskIdx < 10; taskIdx++)
+    {
+        taskIds.push_back(group.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numRun++;
+        })));
+    }
+    group.Cancel();
+    group.WaitAll();
+
+    EXPECT_EQUAL(numRun.load(), 0u);
+    for(auto taskId : taskIds)
+    {
+        ASSERT_TRUE(taskManager.IsComplete(taskId));
+    }
+}
+
+TEST(TaskGroupTests, CancellingAParallelForSkipsTheLeavesThatHaventStarted)
+{
+    TaskManager taskManager(0);
+    TaskGroup group(&taskManager);
+    CountSplitter<int32_t> splitter(1);
+    std::vector<int32_t> data(1000, 1);
+    uint32_t numLeavesRun = 0;
+    ParallelFor parallelFor(data.data(), static_cast<uint32_t>(data.size()), &splitter, [&](int32_t*, uint32_t){
+        numLeavesRun++;
+        group.Cancel();
+    }, &group);
+
+    auto rootTask = parallelFor.Run();
+    group.WaitAll();
+
+    EXPECT_EQUAL(numLeavesRun, 1u);
+    EXPECT_TRUE(taskManager.IsComplete(rootTask));
+}
+
+TEST(TaskGroupTests, TasksCanBeAddedAgainAfterWaitAll)
+{
+    TaskManager taskManager(1);
+    TaskGroup group(&taskManager);
+    std::atomic_uint numRun(0);
+    auto workItem = taskManager.WorkItemWithTaskAllocator([&](void*){
+        numRun++;
+    });
+
+    group.AddTaskWithNoChildrenOrDependencies(workItem);
+    group.WaitAll();
+    group.AddTaskWithNoChildrenOrDependencies(workItem);
+    group.WaitAll();
+
+    EXPECT_EQUAL(numRun.load(), 2u);
+}
@@ -0,0 +1,80 @@
+#include "Test.h"
+#include "Task/TaskInjectionQueue.h"
+
+#include <thread>
+#include <vector>
+
+using namespace Flourish;
+
+TEST(TaskInjectionQueueTests, PopReturnsNullIfEmpty)
+{
+    TaskInjectionQueue queue;
+    auto result = queue.Pop();
+    EXPECT_EQUAL(result, nullptr);
+}
+
+TEST(TaskInjectionQueueTests, PopReturnsTasksInOrderAdded)
+{
+    TaskInjectionQueue queue;
+    Task taskA;
+    Task taskB;
+    
+    queue.Push(&taskA);
+    queue.Push(&taskB);
+    
+    EXPECT_EQUAL(queue.Pop(), &taskA);
+    EXPECT_EQUAL(queue.Pop(), &taskB);
+    EXPECT_EQUAL(queue.Pop(), nullptr);
+}
+
+TEST(TaskInjectionQueueTests, TaskCanBePushedAgainAfterPop)
+{
+    TaskInjectionQueue queue;
+    Task task;
+    
+    queue.Push(&task);
+    EXPECT_EQUAL(queue.Pop(), &task);
+    queue.Push(&task);
+    EXPECT_EQUAL(queue.Pop(), &task);
+    EXPECT_EQUAL(queue.Pop(), nullptr);
+}
+
+TEST(TaskInjectionQueueTests, EveryTaskPushedFromManyThreadsIsPoppedOnce)
+{
+    const uint32_t numThreads = 4;
+    const uint32_t numTasksPerThread = 2000;
+    TaskInjectionQueue queue;
+    std::vector<Task> tasks(numThreads * numTasksPerThread);
+    std::vector<uint32_t> timesPopped(tasks.size(), 0);
+    
+    std::vector<std::thread> threads;
+    for(uint32_t threadIdx = 0; threadIdx < numThreads; threadIdx++)
+    {
+        threads.emplace_back([&, threadIdx]() {
+            for(uint32_t taskIdx = 0; taskIdx < numTasksPerThread; taskIdx++)
+            {
+                queue.Push(&tasks[threadIdx * numTasksPerThread + taskIdx]);
+            }
+        });
+    }
+    size_t numPopped = 0;
+    while(numPopped < tasks.size())
+    {
+        auto task = queue.Pop();
+        if(task != nullptr)
+        {
+            timesPopped[static_cast<size_t>(task - tasks.data())]++;
+            numPopped++;
+        }
+    }
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+    
+    EXPECT_EQUAL(queue.Pop(), nullptr);
+    for(auto count : timesPopped)
+    {
+        EXPECT_EQUAL(count, 1u);
+    }
+}
@@ -1,5 +1,7 @@
 #include "Test.h"
 #include "Task/TaskManager.h"
+#include "Task/FiberPool.h"
+#include "Task/PriorityTaskQueue.h"
 
 using namespace Flourish;
 
@@ -94,3 +96,593 @@ TEST(TaskManagerTests, ParentDoesNotFinishUntilChildFinishes)
     
     EXPECT_EQUAL(numChildrenFinished, 3u) << "Not all children finished before parent";
 }
+
+TEST(TaskManagerTests, MoreTasksThanMaxConcurrentTasksAllRun)
+{
+    TaskManager taskManager;
+    const uint32_t numTasks = TaskManager::MaxConcurrentTasks * 4;
+    std::atomic_uint numTasksRun(0);
+    std::vector<TaskId> taskIds;
+    
+    for(uint32_t index = 0; index < numTasks; index++)
+    {
+        taskIds.push_back(taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numTasksRun++;
+        })));
+    }
+    for(auto taskId : taskIds)
+    {
+        taskManager.Wait(taskId);
+    }
+    
+    EXPECT_EQUAL(numTasksRun, numTasks) << "Not all tasks ran";
+}
+
+TEST(TaskManagerTests, TasksAllRunWhenStealingOneAtATime)
+{
+    TaskManager taskManager;
+    taskManager.SetStealsBatches(false);
+    const uint32_t numTasks = TaskManager::MaxConcurrentTasks / 2;
+    std::atomic_uint numTasksRun(0);
+    
+    auto parentId = taskManager.BeginAdd(WorkItem::Empty());
+    for(uint32_t index = 0; index < numTasks; index++)
+    {
+        auto childId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numTasksRun++;
+        }));
+        taskManager.AddChild(parentId, childId);
+        taskManager.FinishAdd(childId);
+    }
+    taskManager.FinishAdd(parentId);
+    taskManager.Wait(parentId);
+    
+    EXPECT_EQUAL(numTasksRun, numTasks) << "Not all tasks ran";
+}
+
+TEST(TaskManagerTests, StaleTaskIdIsComplete)
+{
+    TaskManager taskManager(0);
+    
+    auto staleId = taskManager.AddTaskWithNoChildrenOrDependencies(WorkItem::Empty());
+    taskManager.Wait(staleId);
+    // Run enough tasks that the slot used by the first task is reused
+    for(uint32_t index = 0; index < TaskManager::MaxConcurrentTasks * 2; index++)
+    {
+        auto taskId = taskManager.BeginAdd(WorkItem::Empty());
+        EXPECT_NOT_EQUAL(taskId, staleId) << "Task id was reused";
+        EXPECT_FALSE(taskManager.IsComplete(taskId)) << "New task should not be complete";
+        EXPECT_TRUE(taskManager.IsComplete(staleId)) << "Stale task id should be complete";
+        taskManager.FinishAdd(taskId);
+        taskManager.Wait(taskId);
+    }
+}
+
+TEST(TaskManagerTests, DependentWaitsForAllRoots)
+{
+    TaskManager taskManager;
+    std::atomic_uint numRootsFinished(0);
+    uint32_t numRootsFinishedBeforeDependent = 0;
+    
+    auto dependentId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+        numRootsFinishedBeforeDependent = numRootsFinished;
+    }));
+    std::vector<TaskId> rootIds;
+    for(uint32_t index = 0; index < 8; index++)
+    {
+        auto rootId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numRootsFinished++;
+        }));
+        taskManager.AddDependency(rootId, dependentId);
+        rootIds.push_back(rootId);
+    }
+    taskManager.FinishAdd(dependentId);
+    for(auto rootId : rootIds)
+    {
+        taskManager.FinishAdd(rootId);
+    }
+    
+    taskManager.Wait(dependentId);
+    
+    EXPECT_EQUAL(numRootsFinishedBeforeDependent, 8u) << "Dependent ran before all its roots finished";
+}
+
+TEST(TaskManagerTests, DependencyOnFinishedTaskRunsImmediately)
+{
+    TaskManager taskManager(0);
+    bool dependentHasRun = false;
+    
+    auto rootId = taskManager.AddTaskWithNoChildrenOrDependencies(WorkItem::Empty());
+    taskManager.Wait(rootId);
+    auto dependentId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+        dependentHasRun = true;
+    }));
+    taskManager.AddDependency(rootId, dependentId);
+    taskManager.FinishAdd(dependentId);
+    
+    taskManager.Wait(dependentId);
+    
+    EXPECT_TRUE(dependentHasRun) << "Dependent of a finished task did not run";
+}
+
+TEST(TaskManagerTests, LongDependencyChainRunsInOrder)
+{
+    TaskManager taskManager(0);
+    const uint32_t chainLength = TaskManager::MaxConcurrentTasks * 2;
+    uint32_t numTasksRun = 0;
+    bool ranInOrder = true;
+    
+    TaskId previousId = 0;
+    for(uint32_t index = 0; index < chainLength; index++)
+    {
+        auto taskId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&, index](void*){
+            ranInOrder = ranInOrder && numTasksRun == index;
+            numTasksRun++;
+        }));
+        taskManager.AddDependency(previousId, taskId);
+        taskManager.FinishAdd(taskId);
+        previousId = taskId;
+    }
+    taskManager.Wait(previousId);
+    
+    EXPECT_EQUAL(numTasksRun, chainLength) << "Not all tasks in the chain ran";
+    EXPECT_TRUE(ranInOrder) << "Tasks in the chain ran out of order";
+}
+
+TEST(TaskManagerTests, LayeredGraphWithMoreEdgesThanMaxConcurrentDependencies)
+{
+    TaskManager taskManager;
+    const uint32_t tasksPerLayer = 64;
+    const uint32_t numLayers = (TaskManager::MaxConcurrentDependencies / (tasksPerLayer * tasksPerLayer)) * 4;
+    std::vector<std::atomic_uint> numTasksRunInLayer(numLayers);
+    std::atomic_uint numTasksRunEarly(0);
+    
+    std::vector<TaskId> previousLayer;
+    for(uint32_t layer = 0; layer < numLayers; layer++)
+    {
+        std::vector<TaskId> currentLayer;
+        for(uint32_t index = 0; index < tasksPerLayer; index++)
+        {
+            auto taskId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&, layer](void*){
+                if(layer > 0 && numTasksRunInLayer[layer - 1] != tasksPerLayer)
+                {
+                    numTasksRunEarly++;
+                }
+                numTasksRunInLayer[layer]++;
+            }));
+            for(auto previousId : previousLayer)
+            {
+                taskManager.AddDependency(previousId, taskId);
+            }
+            currentLayer.push_back(taskId);
+        }
+        for(auto taskId : currentLayer)
+        {
+            taskManager.FinishAdd(taskId);
+        }
+        previousLayer = std::move(currentLayer);
+    }
+    for(auto taskId : previousLayer)
+    {
+        taskManager.Wait(taskId);
+    }
+    
+    EXPECT_EQUAL(numTasksRunEarly, 0u) << "A task ran before every task in the previous layer finished";
+    EXPECT_EQUAL(numTasksRunInLayer[numLayers - 1], tasksPerLayer) << "Not all tasks in the last layer ran";
+}
+
+TEST(TaskManagerTests, HighPriorityTaskRunsBeforeQueuedBackgroundTasks)
+{
+    TaskManager taskManager(0);
+    uint32_t numBackgroundTasksRun = 0;
+    uint32_t numBackgroundTasksRunBeforeHigh = UINT32_MAX;
+    
+    for(uint32_t index = 0; index < 16; index++)
+    {
+        taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numBackgroundTasksRun++;
+        }), TaskPriority::Background);
+    }
+    auto highId = taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+        numBackgroundTasksRunBeforeHigh = numBackgroundTasksRun;
+    }), TaskPriority::High);
+    
+    taskManager.Wait(highId);
+    
+    EXPECT_EQUAL(numBackgroundTasksRunBeforeHigh, 0u) << "Background tasks ran before the high priority task";
+}
+
+TEST(TaskManagerTests, BackgroundTasksAreNotStarvedByHighPriorityTasks)
+{
+    TaskManager taskManager(0);
+    const uint32_t numTasks = PriorityTaskQueue::MAXIMUM_TASKS_BEFORE_AGING * 8;
+    uint32_t numBackgroundTasksRun = 0;
+    
+    for(uint32_t index = 0; index < numTasks; index++)
+    {
+        taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numBackgroundTasksRun++;
+        }), TaskPriority::Background);
+    }
+    std::vector<TaskId> highIds;
+    for(uint32_t index = 0; index < numTasks; index++)
+    {
+        highIds.push_back(taskManager.AddTaskWithNoChildrenOrDependencies(WorkItem::Empty(), TaskPriority::High));
+    }
+    
+    for(auto highId : highIds)
+    {
+        taskManager.Wait(highId);
+    }
+    
+    EXPECT_GREATER_THAN(numBackgroundTasksRun, 0u) << "Background tasks were starved by high priority tasks";
+}
+
+// A thread with tasks of its own only looks elsewhere for a priority once it has
+// aged, so a high priority task added from another thread waits for at most that many
+TEST(TaskManagerTests, HighPriorityTaskFromAnotherThreadRunsOnceItHasAged)
+{
+    TaskManager taskManager(0);
+    const uint32_t numTasks = PriorityTaskQueue::MAXIMUM_TASKS_BEFORE_AGING * 4;
+    uint32_t numNormalTasksRun = 0;
+    uint32_t numNormalTasksRunBeforeHigh = UINT32_MAX;
+    
+    std::vector<TaskId> normalIds;
+    for(uint32_t index = 0; index < numTasks; index++)
+    {
+        normalIds.push_back(taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numNormalTasksRun++;
+        })));
+    }
+    TaskId highId = 0;
+    std::thread otherThread([&]() {
+        highId = taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numNormalTasksRunBeforeHigh = numNormalTasksRun;
+        }), TaskPriority::High);
+    });
+    otherThread.join();
+    
+    for(auto normalId : normalIds)
+    {
+        taskManager.Wait(normalId);
+    }
+    taskManager.Wait(highId);
+    
+    EXPECT_LESS_THAN_OR_EQUAL(numNormalTasksRunBeforeHigh, PriorityTaskQueue::MAXIMUM_TASKS_BEFORE_AGING) << "The high priority task waited for more than the aging limit";
+}
+
+TEST(TaskManagerTests, TasksCanBeAddedFromThreadsWithoutAQueue)
+{
+    TaskManager taskManager(0);
+    std::atomic_uint numTasksRun(0);
+    
+    std::thread otherThread([&]() {
+        std::vector<TaskId> taskIds;
+        for(uint32_t index = 0; index < 100; index++)
+        {
+            taskIds.push_back(taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+                numTasksRun++;
+            })));
+        }
+        for(auto taskId : taskIds)
+        {
+            taskManager.Wait(taskId);
+        }
+    });
+    otherThread.join();
+    
+    EXPECT_EQUAL(numTasksRun, 100u) << "Not all tasks added from another thread ran";
+}
+
+TEST(TaskManagerTests, WaitOnTaskRunningOnAnotherThread)
+{
+    TaskManager taskManager(1);
+    std::atomic_bool taskStarted(false);
+    std::atomic_bool taskFinished(false);
+    
+    auto taskId = taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+        taskStarted = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        taskFinished = true;
+    }));
+    // Let the worker take the task, so Wait has nothing to help with
+    while(!taskStarted)
+    {
+        std::this_thread::yield();
+    }
+    taskManager.Wait(taskId);
+    
+    EXPECT_TRUE(taskFinished) << "Wait returned before the task finished";
+}
+
+namespace
+{
+    const size_t TestFiberStackSize = 256 * 1024;
+    
+    // Waits without helping, so tasks only run on the worker threads
+    bool WaitWithoutHelping(std::atomic_bool& flag)
+    {
+        auto giveUpTime = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while(!flag && std::chrono::steady_clock::now() < giveUpTime)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return flag;
+    }
+}
+
+TEST(TaskManagerTests, TasksOnWorkersRunOnFiberStacksFromTheMemoryArea)
+{
+    std::vector<char> stackMemory(TestFiberStackSize * 4);
+    Memory::MemoryArea stackArea(stackMemory.data(), stackMemory.size());
+    TaskManager taskManager(1, TaskThreadGate<>::DEFAULT_SPIN_COUNT, &stackArea, TestFiberStackSize);
+    std::atomic<char*> stackAddress(nullptr);
+    std::atomic_bool taskFinished(false);
+    
+    taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+        char localOnStack = 0;
+        stackAddress = &localOnStack;
+        taskFinished = true;
+    }));
+    
+    ASSERT_TRUE(WaitWithoutHelping(taskFinished));
+    EXPECT_TRUE(stackAddress >= stackMemory.data() && stackAddress < stackMemory.data() + stackMemory.size()) << "The task didn't run on a fiber stack";
+}
+
+TEST(TaskManagerTests, WaitingTaskOnAFiberDoesNotBlockTasksItWouldHaveHelpedWith)
+{
+    // If waitingTask helped out while it waited it would run blockedTask on top of itself.
+    // blockedTask waits for a task that can't start until waitingTask finishes, so neither
+    // would ever finish
+    std::vector<char> stackMemory(TestFiberStackSize * 4);
+    Memory::MemoryArea stackArea(stackMemory.data(), stackMemory.size());
+    TaskManager taskManager(1, TaskThreadGate<>::DEFAULT_SPIN_COUNT, &stackArea, TestFiberStackSize);
+    std::atomic_bool waitingTaskFinished(false);
+    std::atomic_bool blockedTaskFinished(false);
+    
+    auto afterWaitingTask = taskManager.BeginAdd(WorkItem::Empty());
+    auto waitingTask = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+        auto quickTask = taskManager.AddTaskWithNoChildrenOrDependencies(WorkItem::Empty());
+        // Added last, so it's the first the worker picks up
+        taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+            taskManager.Wait(afterWaitingTask);
+            blockedTaskFinished = true;
+        }));
+        taskManager.Wait(quickTask);
+        waitingTaskFinished = true;
+    }));
+    taskManager.AddDependency(waitingTask, afterWaitingTask);
+    taskManager.FinishAdd(afterWaitingTask);
+    taskManager.FinishAdd(waitingTask);
+    
+    ASSERT_TRUE(WaitWithoutHelping(blockedTaskFinished)) << "The tasks deadlocked";
+    EXPECT_TRUE(waitingTaskFinished);
+}
+
+TEST(TaskManagerTests, NestedWaitsFinishWhenEveryFiberIsInUse)
+{
+    // Only room for the worker's fiber and one more, so the inner waits have to help instead
+    std::vector<char> stackMemory(TestFiberStackSize * 2 + FiberPool::STACK_ALIGNMENT);
+    Memory::MemoryArea stackArea(stackMemory.data(), stackMemory.size());
+    TaskManager taskManager(1, TaskThreadGate<>::DEFAULT_SPIN_COUNT, &stackArea, TestFiberStackSize);
+    std::atomic_uint depthReached(0);
+    std::atomic_bool outerTaskFinished(false);
+    std::function<void(uint32_t)> addNestedTask = [&](uint32_t depth) {
+        auto taskId = taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&, depth](void*){
+            depthReached = std::max(depthReached.load(), depth);
+            if(depth < 5)
+            {
+                addNestedTask(depth + 1);
+            }
+        }));
+        taskManager.Wait(taskId);
+    };
+    
+    taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+        addNestedTask(1);
+        outerTaskFinished = true;
+    }));
+    
+    ASSERT_TRUE(WaitWithoutHelping(outerTaskFinished));
+    EXPECT_EQUAL(depthReached, 5u);
+}
+
+TEST(TaskManagerTests, TasksPinnedToAWorkerOnlyRunOnThatWorker)
+{
+    TaskManager taskManager(3);
+    std::mutex threadIdsMutex;
+    std::vector<std::thread::id> threadIds;
+    std::vector<TaskId> taskIds;
+    
+    for(uint32_t index = 0; index < 100; index++)
+    {
+        auto taskId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+            std::lock_guard<std::mutex> lock(threadIdsMutex);
+            threadIds.push_back(std::this_thread::get_id());
+        }), ThreadAffinity::Thread(2));
+        taskManager.FinishAdd(taskId);
+        taskIds.push_back(taskId);
+    }
+    // Helping here mustn't run any of them on this thread
+    for(auto taskId : taskIds)
+    {
+        taskManager.Wait(taskId);
+    }
+    
+    ASSERT_EQUAL(threadIds.size(), 100u);
+    for(auto threadId : threadIds)
+    {
+        EXPECT_EQUAL(threadId, threadIds[0]) << "A pinned task ran on a different thread";
+    }
+    EXPECT_NOT_EQUAL(threadIds[0], std::this_thread::get_id()) << "A task pinned to a worker ran on the main thread";
+}
+
+TEST(TaskManagerTests, TasksPinnedToTheMainThreadOnlyRunWhenItIsPumped)
+{
+    TaskManager taskManager(2);
+    std::atomic_uint numTasksRun(0);
+    
+    for(uint32_t index = 0; index < 10; index++)
+    {
+        taskManager.AddTaskWithNoChildrenOrDependencies(WorkItem::Empty());
+        auto taskId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+            numTasksRun++;
+        }), ThreadAffinity::MainThread());
+        taskManager.FinishAdd(taskId);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    
+    EXPECT_EQUAL(numTasksRun, 0u) << "A worker ran a task pinned to the main thread";
+    EXPECT_EQUAL(taskManager.PumpMainThread(std::chrono::seconds(10)), 10u);
+    EXPECT_EQUAL(numTasksRun, 10u);
+}
+
+TEST(TaskManagerTests, PumpMainThreadStopsOnceTheBudgetHasPassed)
+{
+    TaskManager taskManager(1);
+    
+    for(uint32_t index = 0; index < 10; index++)
+    {
+        auto taskId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }), ThreadAffinity::MainThread());
+        taskManager.FinishAdd(taskId);
+    }
+    
+    EXPECT_EQUAL(taskManager.PumpMainThread(std::chrono::milliseconds(1)), 1u) << "Tasks were started after the budget had passed";
+    EXPECT_EQUAL(taskManager.PumpMainThread(std::chrono::seconds(10)), 9u);
+}
+
+TEST(TaskManagerTests, TaskPinnedToAThreadSleepingInWaitWakesIt)
+{
+    const uint32_t numHops = 100;
+    TaskManager taskManager(1);
+
+    // Each hop has to run on the main thread while it's asleep in Wait, and then back on the worker
+    auto hoppingTask = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+        for(uint32_t hop = 0; hop < numHops; hop++)
+        {
+            auto hopTask = taskManager.BeginAdd(WorkItem::Empty(), ThreadAffinity::MainThread());
+            taskManager.FinishAdd(hopTask);
+            taskManager.Wait(hopTask);
+        }
+    }), ThreadAffinity::Thread(1));
+    auto start = std::chrono::steady_clock::now();
+    taskManager.FinishAdd(hoppingTask);
+    taskManager.Wait(hoppingTask);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_LESS_THAN(elapsed, TaskManager::MaxWaitSleepDuration * numHops / 2) << "The main thread slept through tasks pinned to it";
+}
+
+TEST(TaskManagerTests, PinnedTaskThatWaitsOnAFiberCarriesOnOnTheSameThread)
+{
+    std::vector<char> stackMemory(TestFiberStackSize * 6);
+    Memory::MemoryArea stackArea(stackMemory.data(), stackMemory.size());
+    TaskManager taskManager(2, TaskThreadGate<>::DEFAULT_SPIN_COUNT, &stackArea, TestFiberStackSize);
+    std::atomic_bool sameThread(true);
+    
+    auto pinnedTasks = taskManager.BeginAdd(WorkItem::Empty());
+    for(uint32_t index = 0; index < 20; index++)
+    {
+        auto pinnedTask = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&](void*){
+            auto threadIdBeforeWait = std::this_thread::get_id();
+            // Long enough that the other worker would pick the fiber back up first
+            auto sleepingTask = taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([](void*){
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }));
+            taskManager.Wait(sleepingTask);
+            if(std::this_thread::get_id() != threadIdBeforeWait)
+            {
+                sameThread = false;
+            }
+        }), ThreadAffinity::Thread(1));
+        taskManager.AddChild(pinnedTasks, pinnedTask);
+        taskManager.FinishAdd(pinnedTask);
+    }
+    taskManager.FinishAdd(pinnedTasks);
+    taskManager.Wait(pinnedTasks);
+    
+    EXPECT_TRUE(sameThread) << "A pinned task carried on on another thread after waiting";
+}
+
+TEST(TaskManagerTests, DelayedTaskRunsOnceTheDelayHasPassed)
+{
+    TaskManager taskManager(1);
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<std::chrono::steady_clock::duration> runAfter(std::chrono::steady_clock::duration::zero());
+    
+    auto taskId = taskManager.AddDelayed(taskManager.WorkItemWithTaskAllocator([&](void*){
+        runAfter = std::chrono::steady_clock::now() - start;
+    }), std::chrono::milliseconds(20));
+    EXPECT_FALSE(taskManager.IsComplete(taskId));
+    taskManager.Wait(taskId);
+    
+    EXPECT_TRUE(runAfter.load() >= std::chrono::milliseconds(20)) << "The task ran before its delay";
+}
+
+TEST(TaskManagerTests, IdleWorkerWakesForAnEarlierTimer)
+{
+    TaskManager taskManager(1);
+    std::atomic_bool laterTaskHasRun(false);
+    std::atomic_bool earlierTaskHasRun(false);
+    
+    taskManager.AddDelayed(taskManager.WorkItemWithTaskAllocator([&](void*){
+        laterTaskHasRun = true;
+    }), std::chrono::seconds(10));
+    // Let the worker go to sleep until the later timer
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    taskManager.AddDelayed(taskManager.WorkItemWithTaskAllocator([&](void*){
+        earlierTaskHasRun = true;
+    }), std::chrono::milliseconds(1));
+    auto giveUpTime = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(!earlierTaskHasRun && std::chrono::steady_clock::now() < giveUpTime)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    
+    EXPECT_TRUE(earlierTaskHasRun) << "The worker slept through the earlier timer";
+    EXPECT_FALSE(laterTaskHasRun);
+}
+
+TEST(TaskManagerTests, PeriodicTaskRunsUntilCancelled)
+{
+    TaskManager taskManager(1);
+    std::atomic_uint numRuns(0);
+    
+    auto timerId = taskManager.AddPeriodic(taskManager.WorkItemWithTaskAllocator([&](void*){
+        numRuns++;
+    }), std::chrono::milliseconds(1));
+    auto giveUpTime = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(numRuns < 5 && std::chrono::steady_clock::now() < giveUpTime)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    taskManager.CancelPeriodic(timerId);
+    // One could have been queued just before it was cancelled
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto numRunsWhenCancelled = numRuns.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    
+    EXPECT_TRUE(numRunsWhenCancelled >= 5u);
+    EXPECT_EQUAL(numRuns.load(), numRunsWhenCancelled) << "The task kept running after it was cancelled";
+}
+
+TEST(TaskManagerTests, PeriodicTaskNeverRunsMoreOftenThanItsPeriod)
+{
+    TaskManager taskManager(1);
+    std::atomic_uint numRuns(0);
+    // Not a whole number of timer ticks
+    const auto period = TaskTimerWheel::TICK_DURATION + TaskTimerWheel::TICK_DURATION / 2;
+    
+    auto startTime = std::chrono::steady_clock::now();
+    auto timerId = taskManager.AddPeriodic(taskManager.WorkItemWithTaskAllocator([&](void*){
+        numRuns++;
+    }), period);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto numRunsSoFar = numRuns.load();
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+    taskManager.CancelPeriodic(timerId);
+    
+    EXPECT_TRUE(numRunsSoFar <= static_cast<uint32_t>(elapsed / period) + 1u) << numRunsSoFar << " runs in " << std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() << "us";
+}
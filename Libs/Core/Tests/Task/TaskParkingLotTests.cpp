@@ -0,0 +1,121 @@
+#include "Test.h"
+
+#include "Task/TaskParkingLot.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace Flourish;
+
+namespace
+{
+    // Parks a thread on a spot of its own until woken is set
+    class ParkedThread
+    {
+    public:
+        ParkedThread(TaskParkingLot& lot, std::mutex& mutex)
+            : _spot()
+            , _parked(false)
+            , _woken(false)
+            , _thread([this, &lot, &mutex] {
+                TaskParkingLot::SetCurrentThreadSpot(&_spot);
+                std::unique_lock<std::mutex> lock(mutex);
+                _parked = true;
+                lot.wait(lock, [this] { return _woken.load(); });
+                TaskParkingLot::SetCurrentThreadSpot(nullptr);
+            })
+        {
+            while(!_parked.load())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        TaskParkingLot::Spot _spot;
+        std::atomic_bool _parked;
+        std::atomic_bool _woken;
+        std::thread _thread;
+    };
+}
+
+TEST(TaskParkingLot, WaitForWithoutASpotTimesOut)
+{
+    TaskParkingLot lot;
+    std::mutex mutex;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    EXPECT_FALSE(lot.wait_for(lock, std::chrono::microseconds(100), [] { return false; }));
+}
+
+TEST(TaskParkingLot, WaitForOnASpotTimesOut)
+{
+    TaskParkingLot lot;
+    std::mutex mutex;
+    TaskParkingLot::Spot spot;
+    TaskParkingLot::SetCurrentThreadSpot(&spot);
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto result = lot.wait_for(lock, std::chrono::microseconds(100), [] { return false; });
+    TaskParkingLot::SetCurrentThreadSpot(nullptr);
+
+    EXPECT_FALSE(result);
+}
+
+TEST(TaskParkingLot, NotifyWakesTheThreadOnTheSpot)
+{
+    TaskParkingLot lot;
+    std::mutex mutex;
+    ParkedThread parked(lot, mutex);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        parked._woken = true;
+        lot.notify(&parked._spot);
+    }
+    parked._thread.join();
+}
+
+TEST(TaskParkingLot, NotifyOneWakesADifferentThreadEachTime)
+{
+    TaskParkingLot lot;
+    std::mutex mutex;
+    ParkedThread first(lot, mutex);
+    ParkedThread second(lot, mutex);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        first._woken = true;
+        second._woken = true;
+        lot.notify_one();
+        lot.notify_one();
+    }
+    first._thread.join();
+    second._thread.join();
+}
+
+TEST(TaskParkingLot, NotifyAllWakesEveryThread)
+{
+    TaskParkingLot lot;
+    std::mutex mutex;
+    ParkedThread parked(lot, mutex);
+    std::atomic_bool sharedWoken(false);
+    std::atomic_bool sharedParked(false);
+    std::thread shared([&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        sharedParked = true;
+        lot.wait(lock, [&] { return sharedWoken.load(); });
+    });
+    while(!sharedParked.load())
+    {
+        std::this_thread::yield();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        parked._woken = true;
+        sharedWoken = true;
+        lot.notify_all();
+    }
+    parked._thread.join();
+    shared.join();
+}
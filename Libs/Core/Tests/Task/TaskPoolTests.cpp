@@ -0,0 +1,100 @@
+#include "Test.h"
+#include "Task/TaskPool.h"
+
+using namespace Flourish;
+
+TEST(TaskPoolTests, AllocateReturnsNullIfFull)
+{
+    TaskPool pool(2);
+    
+    auto taskA = pool.Allocate();
+    auto taskB = pool.Allocate();
+    auto taskC = pool.Allocate();
+    
+    EXPECT_NOT_EQUAL(taskA, nullptr);
+    EXPECT_NOT_EQUAL(taskB, nullptr);
+    EXPECT_EQUAL(taskC, nullptr) << "Pool should have been full";
+}
+
+TEST(TaskPoolTests, AllocatedTasksHaveUniqueIds)
+{
+    TaskPool pool(2);
+    
+    auto taskA = pool.Allocate();
+    auto taskB = pool.Allocate();
+    
+    EXPECT_NOT_EQUAL(taskA->_id.load(), taskB->_id.load());
+    EXPECT_NOT_EQUAL(taskA->_id.load(), TaskId(0));
+    EXPECT_NOT_EQUAL(taskA->_id.load(), INVALID_TASK_ID);
+}
+
+TEST(TaskPoolTests, GetTaskReturnsTaskForId)
+{
+    TaskPool pool(2);
+    
+    auto task = pool.Allocate();
+    
+    EXPECT_EQUAL(pool.GetTask(task->_id), task);
+}
+
+TEST(TaskPoolTests, GetTaskReturnsNullForInvalidIds)
+{
+    TaskPool pool(2);
+    
+    EXPECT_EQUAL(pool.GetTask(TaskId(0)), nullptr);
+    EXPECT_EQUAL(pool.GetTask(INVALID_TASK_ID), nullptr);
+}
+
+TEST(TaskPoolTests, FreedTaskIsReusedWithNewId)
+{
+    TaskPool pool(1);
+    
+    auto task = pool.Allocate();
+    TaskId oldId = task->_id;
+    pool.Free(task);
+    auto reusedTask = pool.Allocate();
+    
+    EXPECT_EQUAL(reusedTask, task) << "Freed slot should have been reused";
+    EXPECT_NOT_EQUAL(reusedTask->_id.load(), oldId) << "Reused slot should have a new generation";
+    EXPECT_EQUAL(TaskPool::GetIndex(reusedTask->_id), TaskPool::GetIndex(oldId));
+}
+
+TEST(TaskPoolTests, SlotFreedLongestAgoIsReusedFirst)
+{
+    TaskPool pool(3);
+    
+    auto taskA = pool.Allocate();
+    auto taskB = pool.Allocate();
+    pool.Free(taskB);
+    pool.Free(taskA);
+    
+    EXPECT_NOT_EQUAL(pool.Allocate(), taskB) << "The slot that was never used should have come first";
+    EXPECT_EQUAL(pool.Allocate(), taskB);
+    EXPECT_EQUAL(pool.Allocate(), taskA);
+    EXPECT_EQUAL(pool.Allocate(), nullptr);
+}
+
+TEST(TaskPoolTests, GetTaskReturnsNullForStaleId)
+{
+    TaskPool pool(1);
+    
+    auto task = pool.Allocate();
+    TaskId oldId = task->_id;
+    pool.Free(task);
+    pool.Allocate();
+    
+    EXPECT_EQUAL(pool.GetTask(oldId), nullptr) << "Stale id should not refer to the reused task";
+}
+
+TEST(TaskPoolTests, GenerationWrapsWithoutProducingInvalidIds)
+{
+    TaskPool pool(1);
+    
+    for(uint32_t generation = 0; generation < TaskPool::MAXIMUM_GENERATION + 2u; generation++)
+    {
+        auto task = pool.Allocate();
+        ASSERT_NOT_EQUAL(task->_id.load(), TaskId(0));
+        ASSERT_NOT_EQUAL(task->_id.load(), INVALID_TASK_ID);
+        pool.Free(task);
+    }
+}
@@ -0,0 +1,93 @@
+#include "Test.h"
+#include "Task/TaskProfiler.h"
+#include "Task/TaskManager.h"
+
+#include <string>
+#include <vector>
+
+using namespace Flourish;
+
+TEST(TaskProfilerTests, RingCollectsEventsInTheOrderTheyWereRecorded)
+{
+    TaskEventRing ring(8);
+    std::vector<TaskEvent> events;
+
+    ring.Record(TaskEventType::Enqueue, 1);
+    ring.Record(TaskEventType::Begin, 1);
+    ring.Record(TaskEventType::Steal, 2, 3);
+    ring.Collect(events);
+
+    ASSERT_EQUAL(events.size(), 3u);
+    EXPECT_EQUAL(events[0]._type, TaskEventType::Enqueue);
+    EXPECT_EQUAL(events[1]._type, TaskEventType::Begin);
+    EXPECT_EQUAL(events[2]._type, TaskEventType::Steal);
+    EXPECT_EQUAL(events[2]._taskId, 2u);
+    EXPECT_EQUAL(events[2]._otherThreadIdx, 3u);
+    EXPECT_TRUE(events[0]._timestamp <= events[2]._timestamp);
+}
+
+TEST(TaskProfilerTests, FullRingDropsNewEventsUntilCollected)
+{
+    TaskEventRing ring(4);
+    std::vector<TaskEvent> events;
+
+    for(TaskId taskId = 0; taskId < 6; taskId++)
+    {
+        ring.Record(TaskEventType::Enqueue, taskId);
+    }
+    ring.Collect(events);
+    ring.Record(TaskEventType::Enqueue, 6);
+    ring.Collect(events);
+
+    EXPECT_EQUAL(ring.GetNumDropped(), 2u);
+    ASSERT_EQUAL(events.size(), 5u);
+    EXPECT_EQUAL(events[3]._taskId, 3u);
+    EXPECT_EQUAL(events[4]._taskId, 6u) << "Collecting should have made room for more";
+}
+
+TEST(TaskProfilerTests, ChromeTraceHasTasksWithHowLongTheyWereQueued)
+{
+    TaskProfiler profiler(2, 16);
+    profiler.GetRing(0)->Record(TaskEventType::Enqueue, 7);
+    profiler.GetRing(1)->Record(TaskEventType::Steal, 7, 0);
+    profiler.GetRing(1)->Record(TaskEventType::Begin, 7);
+    profiler.GetRing(1)->Record(TaskEventType::End, 7);
+    profiler.GetRing(1)->Record(TaskEventType::Park, INVALID_TASK_ID);
+    profiler.GetRing(1)->Record(TaskEventType::Unpark, INVALID_TASK_ID);
+    std::string json;
+
+    profiler.WriteChromeTrace(json);
+
+    EXPECT_EQUAL(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[{"), 0u);
+    EXPECT_EQUAL(json.rfind("}]}"), json.size() - 3);
+    EXPECT_NOT_EQUAL(json.find("\"args\":{\"name\":\"Worker 1\"}"), std::string::npos);
+    EXPECT_NOT_EQUAL(json.find("\"name\":\"Steal\""), std::string::npos);
+    EXPECT_NOT_EQUAL(json.find("\"ph\":\"B\",\"pid\":0,\"tid\":1"), std::string::npos);
+    EXPECT_NOT_EQUAL(json.find("\"task\":7,\"queuedUs\":"), std::string::npos);
+    EXPECT_NOT_EQUAL(json.find("\"name\":\"Idle\",\"cat\":\"thread\",\"ph\":\"E\""), std::string::npos);
+    EXPECT_EQUAL(profiler.GetEvents(1).size(), 5u);
+}
+
+#if FL_ENABLED(FL_TASK_PROFILING_ENABLED)
+TEST(TaskProfilerTests, TaskManagerRecordsTasksItRuns)
+{
+    TaskManager taskManager(0);
+    auto taskId = taskManager.AddTaskWithNoChildrenOrDependencies(WorkItem::Empty());
+    taskManager.Wait(taskId);
+
+    taskManager.GetProfiler()->Collect();
+
+    std::vector<TaskEventType> types;
+    for(auto& event : taskManager.GetProfiler()->GetEvents(0))
+    {
+        if(event._taskId == taskId)
+        {
+            types.push_back(event._type);
+        }
+    }
+    ASSERT_EQUAL(types.size(), 3u);
+    EXPECT_EQUAL(types[0], TaskEventType::Enqueue);
+    EXPECT_EQUAL(types[1], TaskEventType::Begin);
+    EXPECT_EQUAL(types[2], TaskEventType::End);
+}
+#endif
@@ -1,26 +1,202 @@
 #include "Test.h"
 #include "Task/TaskQueue.h"
 #include "Task/Task.h"
+#include "TaskTestHelpers/CountingAllocator.h"
+#include "TaskTestHelpers/ModelChecker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <thread>
+#include <vector>
 
 using namespace Flourish;
 
+namespace
+{
+    const uint32_t OWNER_THREAD = 0;
+
+    // Ways to break the queue, only for checking that the model checker notices
+    enum class Weakening
+    {
+        None,
+        NoOwnerFences,
+        // Release stores and acquire loads become relaxed
+        NoReleases,
+        NoAcquires
+    };
+
+    template<typename T, Weakening Weaken>
+    class WeakenedModelAtomic : public TaskTestHelpers::ModelAtomic<T>
+    {
+    public:
+        WeakenedModelAtomic(T value = T())
+            : TaskTestHelpers::ModelAtomic<T>(value)
+        {
+        }
+
+        T load(std::memory_order order = std::memory_order_seq_cst) const
+        {
+            auto weaken = Weaken == Weakening::NoAcquires && order == std::memory_order_acquire;
+            return TaskTestHelpers::ModelAtomic<T>::load(weaken ? std::memory_order_relaxed : order);
+        }
+
+        void store(T value, std::memory_order order = std::memory_order_seq_cst)
+        {
+            auto weaken = Weaken == Weakening::NoReleases && order == std::memory_order_release;
+            TaskTestHelpers::ModelAtomic<T>::store(value, weaken ? std::memory_order_relaxed : order);
+        }
+    };
+
+    // Swaps the queue's atomics for ones the model checker controls
+    template<uint32_t MaximumStealBatch, Weakening Weaken = Weakening::None>
+    struct ModelTaskQueueTraits
+    {
+        template<typename T>
+        using Atomic = typename std::conditional<Weaken == Weakening::None, TaskTestHelpers::ModelAtomic<T>, WeakenedModelAtomic<T, Weaken>>::type;
+
+        static const uint32_t MAXIMUM_STEAL_BATCH = MaximumStealBatch;
+
+        static void SeqCstFence()
+        {
+            auto checker = TaskTestHelpers::ModelChecker::GetCurrent();
+            if(TaskTestHelpers::ModelChecker::IsModelling() && (Weaken != Weakening::NoOwnerFences || checker->GetRunningThread() != OWNER_THREAD))
+            {
+                checker->Fence();
+            }
+        }
+    };
+
+    // A queue, owned by thread 0, and the tasks that go in it, set up again for every
+    // order the model checker tries. Each thread also owns a destination queue to steal
+    // batches into
+    template<typename Traits>
+    class QueueModel
+    {
+    public:
+        typedef BasicTaskQueue<Traits> Queue;
+
+        static const uint32_t MAXIMUM_TASKS = 8u;
+
+        QueueModel()
+            : _allocator()
+            , _queue()
+            , _destinations()
+            , _tasks()
+            , _timesTaken()
+            , _numTasks(0)
+        {
+        }
+
+        // Call from the model checker's setup
+        void Reset(uint32_t initialCapacity, uint32_t numTasks, uint32_t numTasksPushed)
+        {
+            assert(numTasks <= MAXIMUM_TASKS && numTasksPushed <= numTasks);
+            // The last order's queues have gone, so nothing can be using what they freed
+            _allocator.ReleaseFreed();
+            _queue.reset(new Queue(&_allocator, initialCapacity));
+            for(auto& destination : _destinations)
+            {
+                destination.reset(new Queue(&_allocator, initialCapacity));
+            }
+            _numTasks = numTasks;
+            for(uint32_t taskIdx = 0; taskIdx < numTasks; taskIdx++)
+            {
+                _timesTaken[taskIdx] = 0;
+            }
+            for(uint32_t taskIdx = 0; taskIdx < numTasksPushed; taskIdx++)
+            {
+                _queue->Push(&_tasks[taskIdx]);
+            }
+        }
+
+        Queue& GetQueue()
+        {
+            return *_queue;
+        }
+
+        Queue& GetDestination(uint32_t threadIdx)
+        {
+            return *_destinations[threadIdx];
+        }
+
+        Task* GetTask(uint32_t taskIdx)
+        {
+            return &_tasks[taskIdx];
+        }
+
+        void Took(Task* task)
+        {
+            if(task != nullptr)
+            {
+                _timesTaken[task - _tasks]++;
+            }
+        }
+
+        // Call from the model checker's check. Takes whatever is left in the queues,
+        // then every task should have been taken once
+        void ExpectEveryTaskTakenOnce()
+        {
+            for(auto task = _queue->Pop(); task != nullptr; task = _queue->Pop())
+            {
+                Took(task);
+            }
+            for(auto& destination : _destinations)
+            {
+                for(auto task = destination->Pop(); task != nullptr; task = destination->Pop())
+                {
+                    Took(task);
+                }
+            }
+            for(uint32_t taskIdx = 0; taskIdx < _numTasks; taskIdx++)
+            {
+                TaskTestHelpers::ModelChecker::GetCurrent()->Expect(_timesTaken[taskIdx] != 0, "A task was lost");
+                TaskTestHelpers::ModelChecker::GetCurrent()->Expect(_timesTaken[taskIdx] < 2, "A task was taken twice");
+            }
+            _queue.reset();
+            for(auto& destination : _destinations)
+            {
+                destination.reset();
+            }
+        }
+
+    private:
+        TaskTestHelpers::ModelAllocator _allocator;
+        std::unique_ptr<Queue> _queue;
+        std::unique_ptr<Queue> _destinations[TaskTestHelpers::ModelChecker::MAXIMUM_THREADS];
+        Task _tasks[MAXIMUM_TASKS];
+        uint32_t _timesTaken[MAXIMUM_TASKS];
+        uint32_t _numTasks;
+    };
+
+    void ExpectCheckedEveryOrder(const TaskTestHelpers::ModelChecker::Result& result)
+    {
+        EXPECT_TRUE(result._passed) << result._failure;
+        EXPECT_TRUE(result._complete) << "Gave up after " << result._numExecutions << " orders";
+    }
+}
+
 TEST(TaskQueueTests, PopReturnsNullIfEmpty)
 {
-    TaskQueue queue;
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue queue(&allocator);
     auto result = queue.Pop();
     EXPECT_EQUAL(result, nullptr);
 }
 
 TEST(TaskQueueTests, StealReturnsNullIfEmpty)
 {
-    TaskQueue queue;
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue queue(&allocator);
     auto result = queue.Steal();
     EXPECT_EQUAL(result, nullptr);
 }
 
 TEST(TaskQueueTests, PopReturnsLastTaskAdded)
 {
-    TaskQueue queue;
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue queue(&allocator);
     Task taskA;
     Task taskB;
     
@@ -33,7 +209,8 @@ TEST(TaskQueueTests, PopReturnsLastTaskAdded)
 
 TEST(TaskQueueTests, StealReturnsFirstTaskAdded)
 {
-    TaskQueue queue;
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue queue(&allocator);
     Task taskA;
     Task taskB;
     
@@ -43,3 +220,455 @@ TEST(TaskQueueTests, StealReturnsFirstTaskAdded)
     auto result = queue.Steal();
     EXPECT_EQUAL(result, &taskA);
 }
+
+TEST(TaskQueueTests, StealBatchReturnsFirstTaskAddedAndMovesHalfTheRest)
+{
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue queue(&allocator);
+    TaskQueue destination(&allocator);
+    Task tasks[10];
+    for(auto& task : tasks)
+    {
+        queue.Push(&task);
+    }
+    
+    EXPECT_EQUAL(queue.StealBatch(&destination), &tasks[0]);
+    
+    // The five oldest were taken, and the four that weren't returned are in the same order
+    EXPECT_EQUAL(destination.Steal(), &tasks[1]);
+    EXPECT_EQUAL(destination.Pop(), &tasks[4]);
+    EXPECT_EQUAL(queue.Steal(), &tasks[5]);
+    EXPECT_EQUAL(queue.Pop(), &tasks[9]);
+}
+
+TEST(TaskQueueTests, StealBatchTakesTheLastTask)
+{
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue queue(&allocator);
+    TaskQueue destination(&allocator);
+    Task task;
+    
+    queue.Push(&task);
+    
+    EXPECT_EQUAL(queue.StealBatch(&destination), &task);
+    EXPECT_EQUAL(queue.Pop(), nullptr);
+    EXPECT_EQUAL(destination.Pop(), nullptr);
+}
+
+TEST(TaskQueueTests, StealBatchTakesNoMoreThanMaximumStealBatch)
+{
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue queue(&allocator);
+    TaskQueue destination(&allocator);
+    std::vector<Task> tasks(TaskQueue::MAXIMUM_STEAL_BATCH * 4);
+    for(auto& task : tasks)
+    {
+        queue.Push(&task);
+    }
+    
+    queue.StealBatch(&destination);
+    
+    uint32_t numMoved = 0;
+    while(destination.Pop() != nullptr)
+    {
+        numMoved++;
+    }
+    EXPECT_EQUAL(numMoved, TaskQueue::MAXIMUM_STEAL_BATCH - 1);
+    EXPECT_EQUAL(queue.Steal(), &tasks[TaskQueue::MAXIMUM_STEAL_BATCH]);
+}
+
+TEST(TaskQueueTests, PushingPastTheCapacityGrowsTheQueue)
+{
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue queue(&allocator, 4);
+    Task tasks[100];
+    for(auto& task : tasks)
+    {
+        queue.Push(&task);
+    }
+    
+    EXPECT_EQUAL(queue.GetCapacity(), 128u);
+    for(int taskIdx = 99; taskIdx >= 0; taskIdx--)
+    {
+        ASSERT_EQUAL(queue.Pop(), &tasks[taskIdx]);
+    }
+    EXPECT_EQUAL(queue.Pop(), nullptr);
+}
+
+TEST(TaskQueueTests, GrowingKeepsTasksThatWrappedAroundTheArray)
+{
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue queue(&allocator, 4);
+    Task tasks[8];
+    
+    // Move the top along, so the tasks wrap around the end of the array before it grows
+    queue.Push(&tasks[0]);
+    queue.Push(&tasks[1]);
+    queue.Push(&tasks[2]);
+    EXPECT_EQUAL(queue.Steal(), &tasks[0]);
+    EXPECT_EQUAL(queue.Steal(), &tasks[1]);
+    for(uint32_t taskIdx = 3; taskIdx < 8; taskIdx++)
+    {
+        queue.Push(&tasks[taskIdx]);
+    }
+    
+    EXPECT_EQUAL(queue.GetCapacity(), 8u);
+    for(uint32_t taskIdx = 2; taskIdx < 8; taskIdx++)
+    {
+        ASSERT_EQUAL(queue.Steal(), &tasks[taskIdx]);
+    }
+}
+
+TEST(TaskQueueTests, ReplacedArraysAreFreedToTheAllocator)
+{
+    TaskTestHelpers::CountingAllocator allocator;
+    Task tasks[64];
+    {
+        TaskQueue queue(&allocator, 4);
+        for(auto& task : tasks)
+        {
+            queue.Push(&task);
+        }
+        
+        // The first array and each one that replaced it
+        EXPECT_EQUAL(allocator._numAllocs, 5u);
+        EXPECT_EQUAL(allocator._numFrees, 4u) << "With no steals running, replaced arrays are freed straight away";
+    }
+    
+    EXPECT_EQUAL(allocator._numFrees, allocator._numAllocs);
+}
+
+// The owner pushes and pops while thieves take single tasks and batches, from it
+// and from each other. Every task has to come out exactly once
+TEST(TaskQueueTests, EveryTaskIsTakenOnceWhileStealingConcurrently)
+{
+    const uint32_t numThieves = 3;
+    const uint32_t numTasks = 50000;
+    // Well under the queue's capacity
+    const uint32_t maxQueuedTasks = 1024;
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue ownerQueue(&allocator);
+    TaskQueue thiefQueues[numThieves] = { TaskQueue(&allocator), TaskQueue(&allocator), TaskQueue(&allocator) };
+    std::vector<Task> tasks(numTasks);
+    std::vector<std::atomic_uint> timesTaken(numTasks);
+    std::atomic_uint numTaken(0);
+    auto take = [&](Task* task) {
+        timesTaken[static_cast<size_t>(task - tasks.data())]++;
+        numTaken++;
+    };
+    
+    std::vector<std::thread> thieves;
+    for(uint32_t thiefIdx = 0; thiefIdx < numThieves; thiefIdx++)
+    {
+        thieves.emplace_back([&, thiefIdx]() {
+            auto& ownQueue = thiefQueues[thiefIdx];
+            auto& otherThiefQueue = thiefQueues[(thiefIdx + 1) % numThieves];
+            uint32_t attempt = 0;
+            while(numTaken < numTasks)
+            {
+                attempt++;
+                Task* task = nullptr;
+                if(attempt % 3 == 0)
+                {
+                    task = ownerQueue.Steal();
+                }
+                else if(attempt % 3 == 1)
+                {
+                    task = ownerQueue.StealBatch(&ownQueue);
+                }
+                else
+                {
+                    task = otherThiefQueue.StealBatch(&ownQueue);
+                }
+                if(task != nullptr)
+                {
+                    take(task);
+                }
+                // Leave some behind so the other thieves can steal them
+                for(uint32_t popIdx = 0; popIdx < 2; popIdx++)
+                {
+                    task = ownQueue.Pop();
+                    if(task != nullptr)
+                    {
+                        take(task);
+                    }
+                }
+            }
+        });
+    }
+    
+    uint32_t numPushed = 0;
+    while(numPushed < numTasks)
+    {
+        // Push a few, then pop a few, never letting the queue fill up
+        auto numToPush = std::min(1 + numPushed % 7, numTasks - numPushed);
+        if(numPushed - numTaken.load() + numToPush > maxQueuedTasks)
+        {
+            numToPush = 0;
+        }
+        for(uint32_t pushIdx = 0; pushIdx < numToPush; pushIdx++)
+        {
+            ownerQueue.Push(&tasks[numPushed++]);
+        }
+        for(uint32_t popIdx = 0; popIdx < 1 + numPushed % 5; popIdx++)
+        {
+            auto task = ownerQueue.Pop();
+            if(task != nullptr)
+            {
+                take(task);
+            }
+        }
+    }
+    while(numTaken < numTasks)
+    {
+        auto task = ownerQueue.Pop();
+        if(task == nullptr)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        take(task);
+    }
+    for(auto& thief : thieves)
+    {
+        thief.join();
+    }
+    
+    for(auto& count : timesTaken)
+    {
+        ASSERT_EQUAL(count.load(), 1u);
+    }
+}
+
+// Thieves keep stealing while the owner fills the queue from a tiny array, so
+// it grows while steals may be reading the old one
+TEST(TaskQueueTests, EveryTaskIsTakenOnceWhileGrowing)
+{
+    const uint32_t numThieves = 2;
+    const uint32_t numTasks = 20000;
+    Memory::MallocAllocator allocator("TaskQueueTests");
+    TaskQueue ownerQueue(&allocator, 2);
+    TaskQueue thiefQueues[numThieves] = { TaskQueue(&allocator, 2), TaskQueue(&allocator, 2) };
+    std::vector<Task> tasks(numTasks);
+    std::vector<std::atomic_uint> timesTaken(numTasks);
+    std::atomic_uint numTaken(0);
+    auto take = [&](Task* task) {
+        timesTaken[static_cast<size_t>(task - tasks.data())]++;
+        numTaken++;
+    };
+    
+    std::vector<std::thread> thieves;
+    for(uint32_t thiefIdx = 0; thiefIdx < numThieves; thiefIdx++)
+    {
+        thieves.emplace_back([&, thiefIdx]() {
+            auto& ownQueue = thiefQueues[thiefIdx];
+            while(numTaken < numTasks)
+            {
+                auto task = ownerQueue.StealBatch(&ownQueue);
+                while(task != nullptr)
+                {
+                    take(task);
+                    task = ownQueue.Pop();
+                }
+            }
+        });
+    }
+    
+    // Pushing everything before popping any makes the queue grow many times
+    for(auto& task : tasks)
+    {
+        ownerQueue.Push(&task);
+    }
+    while(numTaken < numTasks)
+    {
+        auto task = ownerQueue.Pop();
+        if(task == nullptr)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        take(task);
+    }
+    for(auto& thief : thieves)
+    {
+        thief.join();
+    }
+    
+    for(auto& count : timesTaken)
+    {
+        ASSERT_EQUAL(count.load(), 1u);
+    }
+}
+
+// The tests from here on run the owner and thieves in every order that can make
+// a difference, with each load reading every store the memory orders allow it to,
+// so they check the orderings hold on weak memory machines too, see ModelChecker
+
+TEST(TaskQueueTests, PopAndStealNeverBothTakeTheLastTask)
+{
+    QueueModel<ModelTaskQueueTraits<TaskQueue::MAXIMUM_STEAL_BATCH>> model;
+    TaskTestHelpers::ModelChecker checker;
+    
+    auto result = checker.Run(
+        [&]() { model.Reset(4, 1, 1); },
+        {
+            [&]() { model.Took(model.GetQueue().Pop()); },
+            [&]() { model.Took(model.GetQueue().Steal()); }
+        },
+        [&]() { model.ExpectEveryTaskTakenOnce(); });
+    ExpectCheckedEveryOrder(result);
+}
+
+// With a batch of 1, Pop takes a task without a compare and swap as soon as there's
+// one other task above it, so only the fences keep it and the steals apart
+TEST(TaskQueueTests, PushPopAndStealNeverTakeTheSameTask)
+{
+    QueueModel<ModelTaskQueueTraits<1>> model;
+    TaskTestHelpers::ModelChecker checker;
+    
+    auto result = checker.Run(
+        [&]() { model.Reset(4, 2, 1); },
+        {
+            [&]() {
+                model.GetQueue().Push(model.GetTask(1));
+                model.Took(model.GetQueue().Pop());
+                model.Took(model.GetQueue().Pop());
+            },
+            [&]() {
+                model.Took(model.GetQueue().Steal());
+                model.Took(model.GetQueue().Steal());
+            }
+        },
+        [&]() { model.ExpectEveryTaskTakenOnce(); });
+    ExpectCheckedEveryOrder(result);
+}
+
+// Pop takes the tasks near the top without checking the bottom a batch steal
+// read, so this is where the tag on the top has to stop them both taking a task
+TEST(TaskQueueTests, PopAndStealBatchNeverTakeTheSameTask)
+{
+    QueueModel<ModelTaskQueueTraits<2>> model;
+    TaskTestHelpers::ModelChecker checker;
+    
+    auto result = checker.Run(
+        [&]() { model.Reset(4, 3, 3); },
+        {
+            [&]() {
+                model.Took(model.GetQueue().Pop());
+                model.Took(model.GetQueue().Pop());
+            },
+            [&]() {
+                model.Took(model.GetQueue().StealBatch(&model.GetDestination(1)));
+                model.Took(model.GetDestination(1).Pop());
+            }
+        },
+        [&]() { model.ExpectEveryTaskTakenOnce(); });
+    ExpectCheckedEveryOrder(result);
+}
+
+// A steal that started before the queue grew reads the old array, which
+// mustn't be freed, or have lost the task, until the steal is done with it
+TEST(TaskQueueTests, StealsRacingGrowthTakeEveryTaskOnce)
+{
+    QueueModel<ModelTaskQueueTraits<1>> model;
+    TaskTestHelpers::ModelChecker checker;
+    
+    auto result = checker.Run(
+        [&]() { model.Reset(2, 3, 2); },
+        {
+            [&]() {
+                // Grows
+                model.GetQueue().Push(model.GetTask(2));
+                model.Took(model.GetQueue().Pop());
+            },
+            [&]() {
+                model.Took(model.GetQueue().Steal());
+                model.Took(model.GetQueue().Steal());
+            }
+        },
+        [&]() { model.ExpectEveryTaskTakenOnce(); });
+    ExpectCheckedEveryOrder(result);
+}
+
+TEST(TaskQueueTests, TwoThievesAndTheOwnerNeverTakeTheSameTask)
+{
+    QueueModel<ModelTaskQueueTraits<1>> model;
+    TaskTestHelpers::ModelChecker checker;
+    
+    auto result = checker.Run(
+        [&]() { model.Reset(4, 3, 2); },
+        {
+            [&]() {
+                model.GetQueue().Push(model.GetTask(2));
+                model.Took(model.GetQueue().Pop());
+            },
+            [&]() { model.Took(model.GetQueue().Steal()); },
+            [&]() {
+                model.Took(model.GetQueue().StealBatch(&model.GetDestination(2)));
+                model.Took(model.GetDestination(2).Pop());
+            }
+        },
+        [&]() { model.ExpectEveryTaskTakenOnce(); });
+    ExpectCheckedEveryOrder(result);
+}
+
+// Without the fence in Pop, it can read the top from before a steal took a task
+// while the steal reads the bottom from before Pop took one, so they can both take
+// the same task. Checks the model checker is able to find that
+TEST(TaskQueueTests, ModelCheckerFindsAPopWithoutItsFence)
+{
+    QueueModel<ModelTaskQueueTraits<1, Weakening::NoOwnerFences>> model;
+    TaskTestHelpers::ModelChecker checker;
+    
+    auto result = checker.Run(
+        [&]() { model.Reset(4, 2, 2); },
+        {
+            [&]() { model.Took(model.GetQueue().Pop()); },
+            [&]() {
+                model.Took(model.GetQueue().Steal());
+                model.Took(model.GetQueue().Steal());
+            }
+        },
+        [&]() { model.ExpectEveryTaskTakenOnce(); });
+    EXPECT_FALSE(result._passed);
+    EXPECT_TRUE(result._failure.find("A task was taken twice") == 0) << result._failure;
+}
+
+// If Push's store of the bottom isn't a release, a steal that sees the new bottom
+// can still read the slot from before the task was stored in it
+TEST(TaskQueueTests, ModelCheckerFindsAPushWithoutItsRelease)
+{
+    QueueModel<ModelTaskQueueTraits<1, Weakening::NoReleases>> model;
+    TaskTestHelpers::ModelChecker checker;
+    
+    auto result = checker.Run(
+        [&]() { model.Reset(4, 1, 0); },
+        {
+            [&]() { model.GetQueue().Push(model.GetTask(0)); },
+            [&]() { model.Took(model.GetQueue().Steal()); }
+        },
+        [&]() { model.ExpectEveryTaskTakenOnce(); });
+    EXPECT_FALSE(result._passed);
+    EXPECT_TRUE(result._failure.find("A task was lost") == 0) << result._failure;
+}
+
+// The same, the other way round, if the steals' loads aren't acquires. The fence
+// acquires whatever a steal read before it, so this only goes wrong when it looked
+// at the queue before another steal took the task it saw, and only reads the bottom
+// that covers the task it takes after the fence
+TEST(TaskQueueTests, ModelCheckerFindsAStealWithoutItsAcquire)
+{
+    QueueModel<ModelTaskQueueTraits<1, Weakening::NoAcquires>> model;
+    TaskTestHelpers::ModelChecker checker;
+    
+    auto result = checker.Run(
+        [&]() { model.Reset(4, 2, 1); },
+        {
+            [&]() { model.GetQueue().Push(model.GetTask(1)); },
+            [&]() { model.Took(model.GetQueue().Steal()); },
+            [&]() { model.Took(model.GetQueue().Steal()); }
+        },
+        [&]() { model.ExpectEveryTaskTakenOnce(); });
+    EXPECT_FALSE(result._passed);
+    EXPECT_TRUE(result._failure.find("A task was lost") == 0) << result._failure;
+}
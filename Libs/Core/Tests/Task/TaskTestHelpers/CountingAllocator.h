@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Memory/Allocators/MallocAllocator.h"
+
+namespace Flourish
+{
+    namespace TaskTestHelpers
+    {
+        class CountingAllocator : public Memory::MallocAllocator
+        {
+        public:
+            CountingAllocator()
+            : Memory::MallocAllocator("CountingAllocator")
+            , _numAllocs(0)
+            , _numFrees(0)
+            {
+            }
+            
+            void* Alloc(size_t size, const Debug::SourceInfo& sourceInfo) override
+            {
+                _numAllocs++;
+                return Memory::MallocAllocator::Alloc(size, sourceInfo);
+            }
+            
+            void Free(void* ptr) override
+            {
+                _numFrees++;
+                Memory::MallocAllocator::Free(ptr);
+            }
+            
+            uint32_t _numAllocs;
+            uint32_t _numFrees;
+        };
+    }
+}
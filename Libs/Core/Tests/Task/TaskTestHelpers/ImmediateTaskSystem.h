@@ -0,0 +1,62 @@
+#pragma once
+
+#include <map>
+
+#include "Memory/Allocators/MallocAllocator.h"
+#include "Task/Task.h"
+
+namespace Flourish
+{
+    namespace TaskTestHelpers
+    {
+        // Runs every task as soon as FinishAdd is called for it, on the
+        // calling thread, so tasks that add tasks run in a predictable order.
+        // Dependencies are ignored, tasks just run in the order they are finished
+        class ImmediateTaskSystem
+        {
+        public:
+            ImmediateTaskSystem()
+            : _workItems()
+            , _parentTasks()
+            , _nextTaskId(1)
+            , _numTasksRun(0)
+            , _allocator("ImmediateTaskSystem")
+            {
+            }
+            
+            template<typename Callable>
+            WorkItem WorkItemWithTaskAllocator(Callable callable, void* data = nullptr)
+            {
+                return WorkItem(std::move(callable), data, &_allocator);
+            }
+            
+            TaskId BeginAdd(WorkItem workItem)
+            {
+                auto taskId = _nextTaskId++;
+                _workItems.emplace(taskId, std::move(workItem));
+                return taskId;
+            }
+            
+            void AddChild(TaskId parent, TaskId child)
+            {
+                _parentTasks[child] = parent;
+            }
+            
+            void AddDependency(TaskId, TaskId) {}
+            
+            void FinishAdd(TaskId id)
+            {
+                auto workItem = std::move(_workItems.at(id));
+                _workItems.erase(id);
+                workItem();
+                _numTasksRun++;
+            }
+            
+            std::map<TaskId, WorkItem> _workItems;
+            std::map<TaskId, TaskId> _parentTasks;
+            TaskId _nextTaskId;
+            uint32_t _numTasksRun;
+            Memory::MallocAllocator _allocator;
+        };
+    }
+}
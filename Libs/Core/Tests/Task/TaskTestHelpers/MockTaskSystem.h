@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Memory/Allocators/MallocAllocator.h"
 #include "Task/Task.h"
 
 namespace Flourish
@@ -11,13 +12,14 @@ namespace Flourish
         public:
             MockTaskSystem()
             : _taskAdded(false)
+            , _allocator("MockTaskSystem")
             {
             }
             
             template<typename Callable>
             WorkItem WorkItemWithTaskAllocator(Callable callable, void* data = nullptr)
             {
-                return WorkItem(WorkItemFunction(callable), data);
+                return WorkItem(std::move(callable), data, &_allocator);
             }
             
             TaskId BeginAdd(WorkItem)
@@ -34,6 +36,7 @@ namespace Flourish
             void AddChild(TaskId, TaskId) {}
             
             bool _taskAdded;
+            Memory::MallocAllocator _allocator;
         };
     }
 }
@@ -0,0 +1,984 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Memory/Allocators/MallocAllocator.h"
+#include "Task/Fiber.h"
+
+#if defined(__SANITIZE_THREAD__)
+#include <sanitizer/tsan_interface.h>
+#endif
+
+namespace Flourish
+{
+    namespace TaskTestHelpers
+    {
+        // Runs a few threads' worth of code that uses ModelAtomic in every order that can
+        // make a difference, like relacy or CDSChecker, to find the bugs a stress test only
+        // hits once in a blue moon.
+        //
+        // The threads are fibers on the calling thread, and every atomic operation switches
+        // back to the checker, which picks what happens next. Memory follows the C++ release
+        // acquire model, so what one thread sees of another's stores is only what the memory
+        // orders guarantee, as on ARM:
+        // - Each location keeps every store made to it, in the order they ran. A load can
+        //   read any of them that isn't older than one its thread has already seen, and the
+        //   checker tries each. Read-modify-writes always read the newest.
+        // - Each thread has a view of the newest store it has seen to each location. Release
+        //   stores carry the view with them, and acquire loads that read them add it to the
+        //   reading thread's. Relaxed stores only carry the view from the thread's last fence.
+        // - seq_cst fences are in one total order, and each adds the view of the one before
+        //   it to its thread's. seq_cst loads, stores and read-modify-writes are treated as
+        //   acquire and release ones with a seq_cst fence either side, which is stronger than
+        //   C++ needs, so a bug that relies on their weaker ordering won't be found.
+        // Stores to a location can't be seen in a different order to the one they ran in, so
+        // an order where a thread sees a store before one that ran earlier is only found if
+        // the two stores can run the other way round. Weak compare exchanges never fail
+        // spuriously, and consume is treated as acquire.
+        //
+        // Rather than every interleaving, only those that reorder dependent operations (on
+        // the same location, one of them a write, or freeing memory another accesses) are
+        // run, using dynamic partial order reduction with sleep sets (Flanagan and Godefroid,
+        // "Dynamic Partial-Order Reduction for Model Checking Software"). That still covers
+        // every outcome the program can have under the model above
+        class ModelChecker
+        {
+        public:
+            static const uint32_t MAXIMUM_THREADS = 3u;
+            static const size_t THREAD_STACK_SIZE = 256u * 1024u;
+
+            struct Result
+            {
+                bool _passed;
+                // False if it gave up after maxExecutions without trying every order
+                bool _complete;
+                uint32_t _numExecutions;
+                // What failed, and the order the threads (0 to MAXIMUM_THREADS - 1) ran in when
+                // it did. A load that read an older store than the newest has how many stores
+                // back it read in brackets after it
+                std::string _failure;
+            };
+
+            explicit ModelChecker(uint32_t maxExecutions = 1000000u)
+            : _maxExecutions(maxExecutions)
+            , _threads()
+            , _numThreads(0)
+            , _runningThread(NOT_RUNNING)
+            , _lastThread(0)
+            , _depth(0)
+            , _firstNewDepth(0)
+            , _states()
+            , _schedule()
+            , _events()
+            , _locations()
+            , _locationIndices()
+            , _seqCstView()
+            , _freedRanges()
+            , _failure()
+            , _schedulerFiber()
+#if defined(__SANITIZE_THREAD__)
+            , _sanitizerSchedulerFiber(nullptr)
+#endif
+            {
+            }
+
+            ModelChecker(const ModelChecker&) = delete;
+            ModelChecker& operator=(const ModelChecker&) = delete;
+
+            // Calls setup, runs the threads to completion, then calls check, once for
+            // every order of the threads' operations. Stops at the first one where a
+            // thread or check calls Expect with false
+            Result Run(const std::function<void()>& setup, std::vector<std::function<void()>> threads, const std::function<void()>& check)
+            {
+                _numThreads = static_cast<uint32_t>(threads.size());
+                if(_numThreads == 0 || _numThreads > MAXIMUM_THREADS)
+                {
+                    return Result{ false, false, 0, "Can only check 1 to MAXIMUM_THREADS threads" };
+                }
+                for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+                {
+                    _threads[threadIdx]._checker = this;
+                    _threads[threadIdx]._function = std::move(threads[threadIdx]);
+                    _threads[threadIdx]._stack = malloc(THREAD_STACK_SIZE);
+                }
+                GetCurrent() = this;
+                _schedulerFiber.ConvertCurrentThread();
+#if defined(__SANITIZE_THREAD__)
+                _sanitizerSchedulerFiber = __tsan_get_current_fiber();
+#endif
+
+                Result result = { true, true, 0, std::string() };
+                _failure.clear();
+                _states.clear();
+                _schedule.clear();
+                _firstNewDepth = 0;
+                while(true)
+                {
+                    RunExecution(setup, check);
+                    result._numExecutions++;
+                    if(!_failure.empty())
+                    {
+                        result._passed = false;
+                        result._failure = _failure;
+                        break;
+                    }
+                    if(!Backtrack())
+                    {
+                        break;
+                    }
+                    if(result._numExecutions == _maxExecutions)
+                    {
+                        result._complete = false;
+                        break;
+                    }
+                }
+
+                _schedulerFiber.RevertCurrentThread();
+                GetCurrent() = nullptr;
+                for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+                {
+                    free(_threads[threadIdx]._stack);
+                    _threads[threadIdx]._function = nullptr;
+#if defined(__SANITIZE_THREAD__)
+                    __tsan_destroy_fiber(_threads[threadIdx]._sanitizerFiber);
+                    _threads[threadIdx]._sanitizerFiber = nullptr;
+#endif
+                }
+                return result;
+            }
+
+            // Fails the current order if condition is false. Can be called from the threads or check
+            void Expect(bool condition, const char* message)
+            {
+                if(!condition && _failure.empty())
+                {
+                    _failure = message;
+                    _failure += ", with the order";
+                    for(size_t eventIdx = 0; eventIdx < _events.size(); eventIdx++)
+                    {
+                        _failure += " " + std::to_string(_events[eventIdx]._thread);
+                        if(_states[eventIdx]._readChoice != 0)
+                        {
+                            _failure += "(" + std::to_string(_states[eventIdx]._readChoice) + ")";
+                        }
+                    }
+                }
+            }
+
+            // Called by the allocator the model's data structures use, so reading or writing
+            // memory after it has been freed fails. The memory isn't really freed until the
+            // order has finished, so that's all that goes wrong. Freeing is an operation like
+            // any other, so the checker tries the accesses that might come after it in both orders
+            void OnFree(const void* memory, size_t size)
+            {
+                if(IsModelling())
+                {
+                    BeginOperation(Operation::Free, memory, false, size);
+                }
+                _freedRanges.emplace_back(static_cast<const char*>(memory), static_cast<const char*>(memory) + size);
+            }
+
+            static ModelChecker*& GetCurrent()
+            {
+                static ModelChecker* current = nullptr;
+                return current;
+            }
+
+            // Only true on one of the checked threads. The setup and check see memory directly
+            static bool IsModelling()
+            {
+                auto checker = GetCurrent();
+                return checker != nullptr && checker->_runningThread != NOT_RUNNING;
+            }
+
+            // Which of the threads passed to Run is running. Only valid while IsModelling
+            uint32_t GetRunningThread() const
+            {
+                return _runningThread;
+            }
+
+            uint64_t Load(uint64_t* location, std::memory_order order)
+            {
+                auto& thread = BeginOperation(Operation::Load, location, order == std::memory_order_seq_cst);
+                if(order == std::memory_order_seq_cst)
+                {
+                    SeqCstFence(thread);
+                }
+                auto locationIdx = GetLocationIndex(location);
+                auto& stores = _locations[locationIdx]._stores;
+                auto& state = _states[_depth];
+                if(!state._blocked)
+                {
+                    state._numReadChoices = CountReadChoices(stores, GetTime(thread._view, locationIdx));
+                }
+                auto time = static_cast<uint32_t>(stores.size()) - 1u - state._readChoice;
+                Read(thread, locationIdx, time, IsAcquire(order));
+                return stores[time]._value;
+            }
+
+            void Store(uint64_t* location, uint64_t value, std::memory_order order)
+            {
+                auto& thread = BeginOperation(Operation::Store, location, order == std::memory_order_seq_cst);
+                Write(thread, location, value, IsRelease(order) ? thread._view : thread._releaseView);
+                if(order == std::memory_order_seq_cst)
+                {
+                    SeqCstFence(thread);
+                }
+            }
+
+            // Calls modify with the newest value, which returns false if it doesn't write one,
+            // or true and the value to write. Returns the value before
+            template<typename Modify>
+            uint64_t ReadModifyWrite(uint64_t* location, std::memory_order order, std::memory_order failureOrder, const Modify& modify)
+            {
+                auto isSeqCst = order == std::memory_order_seq_cst;
+                auto& thread = BeginOperation(Operation::ReadModifyWrite, location, isSeqCst);
+                if(isSeqCst)
+                {
+                    SeqCstFence(thread);
+                }
+                auto locationIdx = GetLocationIndex(location);
+                auto& stores = _locations[locationIdx]._stores;
+                auto time = static_cast<uint32_t>(stores.size()) - 1u;
+                auto value = stores[time]._value;
+                // Carries on the release sequence of the store it read
+                auto storeView = stores[time]._view;
+                uint64_t newValue = 0;
+                auto writes = modify(value, newValue);
+                Read(thread, locationIdx, time, IsAcquire(writes ? order : failureOrder));
+                if(writes)
+                {
+                    Join(storeView, IsRelease(order) ? thread._view : thread._releaseView);
+                    Write(thread, location, newValue, storeView);
+                }
+                if(isSeqCst)
+                {
+                    SeqCstFence(thread);
+                }
+                return value;
+            }
+
+            // A seq_cst fence
+            void Fence()
+            {
+                auto& thread = BeginOperation(Operation::Fence, nullptr, true);
+                SeqCstFence(thread);
+            }
+
+        private:
+            static const uint32_t NOT_RUNNING = UINT32_MAX;
+            static const uint32_t MAXIMUM_EVENTS = 10000u;
+
+            enum class Operation
+            {
+                Load,
+                Store,
+                ReadModifyWrite,
+                Fence,
+                Free
+            };
+
+            // For each location, by the order it was first used in, how many stores to it
+            // have been seen, less one. Locations past the end haven't been seen at all
+            typedef std::vector<uint32_t> View;
+
+            struct ModelStore
+            {
+                uint64_t _value;
+                // What a thread that acquires this store sees
+                View _view;
+                // The thread that stored it, and its count in that thread's clock
+                uint32_t _thread;
+                uint32_t _count;
+            };
+
+            struct Location
+            {
+                // Every store to it, oldest first. The first is the value it had when the
+                // checker first saw it, which every thread can see
+                std::vector<ModelStore> _stores;
+            };
+
+            struct Thread
+            {
+                ModelChecker* _checker;
+                std::function<void()> _function;
+                void* _stack;
+                Fiber _fiber;
+                bool _finished;
+                // What it's waiting to do, once the checker picks it
+                Operation _nextOperation;
+                const void* _nextLocation;
+                bool _nextIsSeqCst;
+                size_t _nextFreedSize;
+                View _view;
+                // The views of the stores it has read relaxed, which a fence acquires
+                View _acquireView;
+                // Its view at its last fence, which its relaxed stores release
+                View _releaseView;
+#if defined(__SANITIZE_THREAD__)
+                void* _sanitizerFiber;
+#endif
+            };
+
+            // Happens before tracking, one count per thread
+            struct VectorClock
+            {
+                uint32_t _counts[MAXIMUM_THREADS];
+            };
+
+            // An operation that has run, and what it touched. seq_cst operations also read
+            // and write the order of seq_cst fences, which is the _seqCstView
+            struct Event
+            {
+                uint32_t _thread;
+                const void* _locations[2];
+                bool _writes[2];
+                // Frees write to everything from the first location up to this many bytes on
+                size_t _freedSize;
+                VectorClock _clock;
+            };
+
+            // One for every point a choice was made, kept between orders
+            struct State
+            {
+                uint32_t _enabled;
+                // The threads that still have to be tried from here
+                uint32_t _backtrack;
+                uint32_t _done;
+                // Threads that don't need trying from here, as it would only reorder
+                // independent operations of an order that's been tried already
+                uint32_t _sleeping;
+                // If the thread picked loads, how many stores back from the newest it reads,
+                // out of how many it could
+                uint32_t _readChoice;
+                uint32_t _numReadChoices;
+                // Past the point every enabled thread was asleep, where nothing new is tried
+                bool _blocked;
+            };
+
+            static void ThreadMain(void* userData)
+            {
+                auto thread = static_cast<Thread*>(userData);
+                thread->_function();
+                thread->_finished = true;
+                thread->_checker->SwitchToScheduler(*thread);
+            }
+
+            static bool IsAcquire(std::memory_order order)
+            {
+                return order == std::memory_order_consume || order == std::memory_order_acquire
+                    || order == std::memory_order_acq_rel || order == std::memory_order_seq_cst;
+            }
+
+            static bool IsRelease(std::memory_order order)
+            {
+                return order == std::memory_order_release || order == std::memory_order_acq_rel || order == std::memory_order_seq_cst;
+            }
+
+            static uint32_t GetTime(const View& view, uint32_t locationIdx)
+            {
+                return locationIdx < view.size() ? view[locationIdx] : 0u;
+            }
+
+            static void SetTime(View& view, uint32_t locationIdx, uint32_t time)
+            {
+                if(locationIdx >= view.size())
+                {
+                    view.resize(locationIdx + 1, 0u);
+                }
+                if(time > view[locationIdx])
+                {
+                    view[locationIdx] = time;
+                }
+            }
+
+            static void Join(View& view, const View& other)
+            {
+                for(uint32_t locationIdx = 0; locationIdx < other.size(); locationIdx++)
+                {
+                    SetTime(view, locationIdx, other[locationIdx]);
+                }
+            }
+
+            // Waits until the checker picks this thread, then returns it so the operation can run
+            Thread& BeginOperation(Operation operation, const void* location, bool isSeqCst, size_t freedSize = 0)
+            {
+                auto& thread = _threads[_runningThread];
+                thread._nextOperation = operation;
+                thread._nextLocation = location;
+                thread._nextIsSeqCst = isSeqCst;
+                thread._nextFreedSize = freedSize;
+                SwitchToScheduler(thread);
+                CheckNotFreed(location);
+                return thread;
+            }
+
+            void CheckNotFreed(const void* location)
+            {
+                for(auto& freedRange : _freedRanges)
+                {
+                    if(location >= freedRange.first && location < freedRange.second)
+                    {
+                        Expect(false, "Memory was used after it was freed");
+                    }
+                }
+            }
+
+            uint32_t GetLocationIndex(uint64_t* location)
+            {
+                auto inserted = _locationIndices.emplace(location, static_cast<uint32_t>(_locations.size()));
+                if(inserted.second)
+                {
+                    _locations.push_back(Location{ { ModelStore{ *location, View(), NOT_RUNNING, 0u } } });
+                }
+                return inserted.first->second;
+            }
+
+            // How many stores back from the newest the running thread's load can read, given
+            // the oldest its view allows. A store that only comes before the load because
+            // the load reads its location could be moved after it, and that order is tried
+            // too, so reading anything older than such a store is left to that order
+            uint32_t CountReadChoices(const std::vector<ModelStore>& stores, uint32_t oldestTime) const
+            {
+                auto load = _events.back();
+                load._locations[0] = nullptr;
+                auto loadClock = GetThreadClock(load._thread, _depth);
+                for(uint32_t eventIdx = 0; eventIdx < _depth; eventIdx++)
+                {
+                    if(AreDependent(_events[eventIdx], load))
+                    {
+                        JoinClock(loadClock, _events[eventIdx]._clock);
+                    }
+                }
+                uint32_t numReadChoices = 1;
+                for(auto time = static_cast<uint32_t>(stores.size()) - 1u; time > oldestTime; time--)
+                {
+                    auto& store = stores[time];
+                    if(store._thread != NOT_RUNNING && loadClock._counts[store._thread] < store._count)
+                    {
+                        break;
+                    }
+                    numReadChoices++;
+                }
+                return numReadChoices;
+            }
+
+            void Read(Thread& thread, uint32_t locationIdx, uint32_t time, bool acquire)
+            {
+                SetTime(thread._view, locationIdx, time);
+                Join(acquire ? thread._view : thread._acquireView, _locations[locationIdx]._stores[time]._view);
+            }
+
+            void Write(Thread& thread, uint64_t* location, uint64_t value, View view)
+            {
+                auto locationIdx = GetLocationIndex(location);
+                auto& stores = _locations[locationIdx]._stores;
+                auto time = static_cast<uint32_t>(stores.size());
+                SetTime(thread._view, locationIdx, time);
+                SetTime(view, locationIdx, time);
+                stores.push_back(ModelStore{ value, std::move(view), _runningThread, _events.back()._clock._counts[_runningThread] });
+                // So the check sees the newest value of everything
+                *location = value;
+            }
+
+            void SeqCstFence(Thread& thread)
+            {
+                Join(thread._view, thread._acquireView);
+                Join(thread._view, _seqCstView);
+                _seqCstView = thread._view;
+                thread._releaseView = thread._view;
+            }
+
+            void RunExecution(const std::function<void()>& setup, const std::function<void()>& check)
+            {
+                _events.clear();
+                _freedRanges.clear();
+                _locations.clear();
+                _locationIndices.clear();
+                _seqCstView.clear();
+                setup();
+                // Run every thread up to its first atomic operation
+                for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+                {
+                    auto& thread = _threads[threadIdx];
+                    thread._finished = false;
+                    thread._view.clear();
+                    thread._acquireView.clear();
+                    thread._releaseView.clear();
+                    thread._fiber.Create(thread._stack, THREAD_STACK_SIZE, &ThreadMain, &thread);
+#if defined(__SANITIZE_THREAD__)
+                    // The last order's fiber never returned, so start again with a clean one
+                    if(thread._sanitizerFiber != nullptr)
+                    {
+                        __tsan_destroy_fiber(thread._sanitizerFiber);
+                    }
+                    thread._sanitizerFiber = __tsan_create_fiber(0);
+#endif
+                    SwitchToThread(threadIdx);
+                }
+                _lastThread = 0;
+
+                // Once every enabled thread is asleep, the rest of this order is the same as
+                // one that's been tried already. It's run to the end, but nothing new is tried
+                bool blocked = false;
+                uint32_t nextSleeping = 0;
+                for(_depth = 0; ; _depth++)
+                {
+                    auto enabled = GetEnabledThreads();
+                    if(enabled == 0)
+                    {
+                        break;
+                    }
+                    if(_depth == MAXIMUM_EVENTS)
+                    {
+                        Expect(false, "The threads ran for too long, they may never finish");
+                        break;
+                    }
+                    // Earlier states look the same as the last time they were run
+                    if(!blocked && _depth >= _firstNewDepth)
+                    {
+                        AddBacktrackPoints(_depth);
+                    }
+                    if(_depth == _states.size())
+                    {
+                        auto awake = enabled & ~nextSleeping;
+                        if(awake == 0)
+                        {
+                            blocked = true;
+                            awake = enabled;
+                        }
+                        // Somewhere new, carry on with whatever ran last if we can
+                        auto threadIdx = (awake & (1u << _lastThread)) != 0 ? _lastThread : LowestThread(awake);
+                        _states.push_back(State{ enabled, 1u << threadIdx, blocked ? enabled : 1u << threadIdx, blocked ? 0u : nextSleeping, 0u, 1u, blocked });
+                        _schedule.push_back(threadIdx);
+                    }
+
+                    auto threadIdx = _schedule[_depth];
+                    auto& state = _states[_depth];
+                    // Whatever was asleep, or tried already from here, stays asleep after
+                    // this if it doesn't depend on what this does
+                    auto sleepers = (state._sleeping | state._done) & ~(1u << threadIdx);
+                    Event sleeperEvents[MAXIMUM_THREADS];
+                    for(uint32_t sleeper = 0; sleeper < MAXIMUM_THREADS; sleeper++)
+                    {
+                        if((sleepers & (1u << sleeper)) != 0 && !GetNextEvent(sleeper, sleeperEvents[sleeper]))
+                        {
+                            sleepers &= ~(1u << sleeper);
+                        }
+                    }
+                    RunThread(threadIdx);
+                    nextSleeping = 0;
+                    for(uint32_t sleeper = 0; sleeper < MAXIMUM_THREADS; sleeper++)
+                    {
+                        if((sleepers & (1u << sleeper)) != 0 && !AreDependent(sleeperEvents[sleeper], _events.back()))
+                        {
+                            nextSleeping |= 1u << sleeper;
+                        }
+                    }
+                }
+                check();
+            }
+
+            uint32_t GetEnabledThreads() const
+            {
+                uint32_t enabled = 0;
+                for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+                {
+                    if(!_threads[threadIdx]._finished)
+                    {
+                        enabled |= 1u << threadIdx;
+                    }
+                }
+                return enabled;
+            }
+
+            static uint32_t LowestThread(uint32_t threads)
+            {
+                uint32_t threadIdx = 0;
+                while((threads & (1u << threadIdx)) == 0)
+                {
+                    threadIdx++;
+                }
+                return threadIdx;
+            }
+
+            // What the thread would do next, or false if it has nothing left to do
+            bool GetNextEvent(uint32_t threadIdx, Event& event) const
+            {
+                auto& thread = _threads[threadIdx];
+                if(threadIdx >= _numThreads || thread._finished)
+                {
+                    return false;
+                }
+                event._thread = threadIdx;
+                event._locations[0] = thread._nextLocation;
+                event._writes[0] = thread._nextOperation != Operation::Load;
+                event._locations[1] = thread._nextIsSeqCst ? &_seqCstView : nullptr;
+                event._writes[1] = thread._nextIsSeqCst;
+                event._freedSize = thread._nextOperation == Operation::Free ? thread._nextFreedSize : 0;
+                return true;
+            }
+
+            static bool Frees(const Event& free, const Event& access)
+            {
+                if(free._freedSize == 0)
+                {
+                    return false;
+                }
+                auto freedBegin = static_cast<const char*>(free._locations[0]);
+                for(auto location : access._locations)
+                {
+                    if(location >= freedBegin && location < freedBegin + free._freedSize)
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            static bool AreDependent(const Event& first, const Event& second)
+            {
+                if(first._thread == second._thread)
+                {
+                    return true;
+                }
+                if(Frees(first, second) || Frees(second, first))
+                {
+                    return true;
+                }
+                for(uint32_t firstIdx = 0; firstIdx < 2; firstIdx++)
+                {
+                    for(uint32_t secondIdx = 0; secondIdx < 2; secondIdx++)
+                    {
+                        auto location = first._locations[firstIdx];
+                        if(location != nullptr && location == second._locations[secondIdx]
+                           && (first._writes[firstIdx] || second._writes[secondIdx]))
+                        {
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            // For every thread, finds the last event that its next operation races with,
+            // and makes sure running the thread before that event gets tried too
+            void AddBacktrackPoints(uint32_t depth)
+            {
+                for(uint32_t threadIdx = 0; threadIdx < _numThreads; threadIdx++)
+                {
+                    Event next;
+                    if(!GetNextEvent(threadIdx, next))
+                    {
+                        continue;
+                    }
+                    auto threadClock = GetThreadClock(threadIdx, depth);
+                    for(auto eventIdx = depth; eventIdx-- > 0;)
+                    {
+                        auto& event = _events[eventIdx];
+                        if(event._thread == threadIdx || !AreDependent(event, next))
+                        {
+                            continue;
+                        }
+                        if(threadClock._counts[event._thread] >= event._clock._counts[event._thread])
+                        {
+                            // Already happens before us, so it can't be reordered
+                            continue;
+                        }
+                        auto& state = _states[eventIdx];
+                        state._backtrack |= (state._enabled & (1u << threadIdx)) != 0 ? 1u << threadIdx : state._enabled;
+                        break;
+                    }
+                }
+            }
+
+            // The clock of the thread's last event
+            VectorClock GetThreadClock(uint32_t threadIdx, uint32_t depth) const
+            {
+                for(auto eventIdx = depth; eventIdx-- > 0;)
+                {
+                    if(_events[eventIdx]._thread == threadIdx)
+                    {
+                        return _events[eventIdx]._clock;
+                    }
+                }
+                return VectorClock{};
+            }
+
+            static void JoinClock(VectorClock& clock, const VectorClock& other)
+            {
+                for(uint32_t clockIdx = 0; clockIdx < MAXIMUM_THREADS; clockIdx++)
+                {
+                    if(other._counts[clockIdx] > clock._counts[clockIdx])
+                    {
+                        clock._counts[clockIdx] = other._counts[clockIdx];
+                    }
+                }
+            }
+
+            void RunThread(uint32_t threadIdx)
+            {
+                Event event;
+                GetNextEvent(threadIdx, event);
+                event._clock = GetThreadClock(threadIdx, _depth);
+                for(auto& previousEvent : _events)
+                {
+                    if(AreDependent(previousEvent, event))
+                    {
+                        JoinClock(event._clock, previousEvent._clock);
+                    }
+                }
+                event._clock._counts[threadIdx]++;
+                _events.push_back(event);
+                _lastThread = threadIdx;
+                SwitchToThread(threadIdx);
+            }
+
+            void SwitchToThread(uint32_t threadIdx)
+            {
+                _runningThread = threadIdx;
+#if defined(__SANITIZE_THREAD__)
+                __tsan_switch_to_fiber(_threads[threadIdx]._sanitizerFiber, 0);
+#endif
+                Fiber::Switch(&_schedulerFiber, &_threads[threadIdx]._fiber);
+                _runningThread = NOT_RUNNING;
+            }
+
+            void SwitchToScheduler(Thread& thread)
+            {
+#if defined(__SANITIZE_THREAD__)
+                // ThreadSanitizer has to be told the stack is changing, or it loses track of it
+                __tsan_switch_to_fiber(_sanitizerSchedulerFiber, 0);
+#endif
+                Fiber::Switch(&thread._fiber, &_schedulerFiber);
+            }
+
+            // Moves on to the next order to try, returning false if there are none left
+            bool Backtrack()
+            {
+                while(!_states.empty())
+                {
+                    auto& state = _states.back();
+                    // Every store the last load could have read first, then every other thread
+                    if(state._readChoice + 1u < state._numReadChoices)
+                    {
+                        state._readChoice++;
+                        _schedule.resize(_states.size());
+                        _firstNewDepth = static_cast<uint32_t>(_states.size());
+                        return true;
+                    }
+                    auto untried = state._backtrack & ~state._done & ~state._sleeping;
+                    if(untried != 0)
+                    {
+                        auto threadIdx = LowestThread(untried);
+                        state._done |= 1u << threadIdx;
+                        state._readChoice = 0;
+                        state._numReadChoices = 1;
+                        _schedule.resize(_states.size());
+                        _schedule.back() = threadIdx;
+                        _firstNewDepth = static_cast<uint32_t>(_states.size());
+                        return true;
+                    }
+                    _states.pop_back();
+                    _schedule.pop_back();
+                }
+                return false;
+            }
+
+            uint32_t _maxExecutions;
+            Thread _threads[MAXIMUM_THREADS];
+            uint32_t _numThreads;
+            uint32_t _runningThread;
+            uint32_t _lastThread;
+            // The state the running thread was picked at
+            uint32_t _depth;
+            // Where the order being run starts to differ from the last one
+            uint32_t _firstNewDepth;
+            std::vector<State> _states;
+            // The thread picked at each state
+            std::vector<uint32_t> _schedule;
+            std::vector<Event> _events;
+            std::vector<Location> _locations;
+            std::unordered_map<const uint64_t*, uint32_t> _locationIndices;
+            // The view of the last seq_cst fence
+            View _seqCstView;
+            std::vector<std::pair<const char*, const char*>> _freedRanges;
+            std::string _failure;
+            Fiber _schedulerFiber;
+#if defined(__SANITIZE_THREAD__)
+            void* _sanitizerSchedulerFiber;
+#endif
+        };
+
+        // Stands in for std::atomic in code being checked. Every operation is a point
+        // the checker can switch threads at, and sees what its memory order allows, see ModelChecker
+        template<typename T>
+        class ModelAtomic
+        {
+        public:
+            ModelAtomic(T value = T())
+            : _value(ToBits(value))
+            {
+            }
+
+            ModelAtomic(const ModelAtomic&) = delete;
+            ModelAtomic& operator=(const ModelAtomic&) = delete;
+
+            T load(std::memory_order order = std::memory_order_seq_cst) const
+            {
+                if(!ModelChecker::IsModelling())
+                {
+                    return FromBits(_value);
+                }
+                return FromBits(ModelChecker::GetCurrent()->Load(&_value, order));
+            }
+
+            void store(T value, std::memory_order order = std::memory_order_seq_cst)
+            {
+                if(!ModelChecker::IsModelling())
+                {
+                    _value = ToBits(value);
+                    return;
+                }
+                ModelChecker::GetCurrent()->Store(&_value, ToBits(value), order);
+            }
+
+            bool compare_exchange_strong(T& expected, T desired, std::memory_order success = std::memory_order_seq_cst, std::memory_order failure = std::memory_order_seq_cst)
+            {
+                auto previous = Modify(success, failure, [&](T value, T& newValue){
+                    newValue = desired;
+                    return value == expected;
+                });
+                if(previous == expected)
+                {
+                    return true;
+                }
+                expected = previous;
+                return false;
+            }
+
+            bool compare_exchange_weak(T& expected, T desired, std::memory_order success = std::memory_order_seq_cst, std::memory_order failure = std::memory_order_seq_cst)
+            {
+                return compare_exchange_strong(expected, desired, success, failure);
+            }
+
+            T fetch_add(T amount, std::memory_order order = std::memory_order_seq_cst)
+            {
+                return Modify(order, order, [&](T value, T& newValue){
+                    newValue = static_cast<T>(value + amount);
+                    return true;
+                });
+            }
+
+            T fetch_sub(T amount, std::memory_order order = std::memory_order_seq_cst)
+            {
+                return Modify(order, order, [&](T value, T& newValue){
+                    newValue = static_cast<T>(value - amount);
+                    return true;
+                });
+            }
+
+        private:
+            static_assert(std::is_integral<T>::value || std::is_pointer<T>::value, "Only integers and pointers are modelled");
+
+            static uint64_t ToBits(T value)
+            {
+                if constexpr (std::is_pointer<T>::value)
+                {
+                    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+                }
+                else
+                {
+                    return static_cast<uint64_t>(value);
+                }
+            }
+
+            static T FromBits(uint64_t bits)
+            {
+                if constexpr (std::is_pointer<T>::value)
+                {
+                    return reinterpret_cast<T>(static_cast<uintptr_t>(bits));
+                }
+                else
+                {
+                    return static_cast<T>(bits);
+                }
+            }
+
+            // Returns the value from before modifier was applied. The modifier returns false
+            // if it doesn't write, which uses the failure order
+            template<typename Modifier>
+            T Modify(std::memory_order order, std::memory_order failureOrder, const Modifier& modifier)
+            {
+                auto applyToBits = [&](uint64_t bits, uint64_t& newBits){
+                    T newValue = T();
+                    auto writes = modifier(FromBits(bits), newValue);
+                    newBits = ToBits(newValue);
+                    return writes;
+                };
+                if(!ModelChecker::IsModelling())
+                {
+                    auto previous = _value;
+                    uint64_t newBits = 0;
+                    if(applyToBits(previous, newBits))
+                    {
+                        _value = newBits;
+                    }
+                    return FromBits(previous);
+                }
+                return FromBits(ModelChecker::GetCurrent()->ReadModifyWrite(&_value, order, failureOrder, applyToBits));
+            }
+
+            mutable uint64_t _value;
+        };
+
+        // Tells the current ModelChecker about memory as it's freed, see ModelChecker::OnFree
+        class ModelAllocator : public Memory::MallocAllocator
+        {
+        public:
+            ModelAllocator()
+            : Memory::MallocAllocator("ModelAllocator")
+            , _freed()
+            {
+            }
+
+            ~ModelAllocator() override
+            {
+                ReleaseFreed();
+            }
+
+            void Free(void* ptr) override
+            {
+                if(ModelChecker::GetCurrent() == nullptr)
+                {
+                    Memory::MallocAllocator::Free(ptr);
+                    return;
+                }
+                ModelChecker::GetCurrent()->OnFree(ptr, GetAllocationSize(ptr));
+                _freed.push_back(ptr);
+            }
+
+            // Really frees everything that's been freed so far
+            void ReleaseFreed()
+            {
+                for(auto ptr : _freed)
+                {
+                    Memory::MallocAllocator::Free(ptr);
+                }
+                _freed.clear();
+            }
+
+        private:
+            std::vector<void*> _freed;
+        };
+    }
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <utility>
+#include <vector>
+
+#include "Memory/Allocators/MallocAllocator.h"
 #include "Task/Task.h"
 
 namespace Flourish
@@ -12,8 +16,11 @@ namespace Flourish
         public:
             RecordTaskSystem()
             : _numTasksAdded(0)
+            , _numHeapAllocatedWorkItems(0)
             , _parentTasks()
+            , _dependencies()
             , _nextTaskId(0)
+            , _allocator("RecordTaskSystem")
             {
                 for(uint32_t index = 0; index < expectedNumTasks; index++)
                 {
@@ -24,11 +31,15 @@ namespace Flourish
             template<typename Callable>
             WorkItem WorkItemWithTaskAllocator(Callable callable, void* data = nullptr)
             {
-                return WorkItem(WorkItemFunction(callable), data);
+                return WorkItem(std::move(callable), data, &_allocator);
             }
             
-            TaskId BeginAdd(WorkItem)
+            TaskId BeginAdd(WorkItem workItem)
             {
+                if(workItem.IsHeapAllocated())
+                {
+                    _numHeapAllocatedWorkItems++;
+                }
                 return TaskId(_nextTaskId++);
             }
             
@@ -42,14 +53,22 @@ namespace Flourish
                 _parentTasks[child] = parent;
             }
             
+            void AddDependency(TaskId root, TaskId dependent)
+            {
+                _dependencies.emplace_back(root, dependent);
+            }
+            
             void AssertExpectedNumberOfTasksAdded()
             {
                 EXPECT_EQUAL(_numTasksAdded, expectedNumTasks) << "Incorrect number of tasks added";
             }
             
             uint32_t _numTasksAdded;
+            uint32_t _numHeapAllocatedWorkItems;
             TaskId _parentTasks[expectedNumTasks];
+            std::vector<std::pair<TaskId, TaskId>> _dependencies;
             TaskId _nextTaskId;
+            Memory::MallocAllocator _allocator;
         };
     }
 }
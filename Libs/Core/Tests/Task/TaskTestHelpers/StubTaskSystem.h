@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Memory/Allocators/MallocAllocator.h"
 #include "Task/Task.h"
 
 namespace Flourish
@@ -9,10 +10,17 @@ namespace Flourish
         class StubTaskSystem
         {
         public:
+            StubTaskSystem()
+            : _numThreads(0)
+            , _numIdleThreads(0)
+            , _allocator("StubTaskSystem")
+            {
+            }
+            
             template<typename Callable>
             WorkItem WorkItemWithTaskAllocator(Callable callable, void* data = nullptr)
             {
-                return WorkItem(WorkItemFunction(callable), data);
+                return WorkItem(std::move(callable), data, &_allocator);
             }
             
             TaskId BeginAdd(WorkItem)
@@ -22,7 +30,23 @@ namespace Flourish
             
             void AddChild(TaskId, TaskId) {}
             
+            void AddDependency(TaskId, TaskId) {}
+            
             void FinishAdd(TaskId){}
+            
+            uint32_t GetNumThreads() const
+            {
+                return _numThreads;
+            }
+            
+            uint32_t GetNumIdleThreads() const
+            {
+                return _numIdleThreads;
+            }
+            
+            uint32_t _numThreads;
+            uint32_t _numIdleThreads;
+            Memory::MallocAllocator _allocator;
         };
     }
 }
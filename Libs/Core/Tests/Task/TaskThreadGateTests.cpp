@@ -2,23 +2,39 @@
 
 #include "Task/TaskThreadGate.h"
 
+#include <functional>
+#include <thread>
+
 using namespace Flourish;
 
 class MockWaitMechanism
 {
 public:
     template<class Predicate>
-    void wait(std::unique_lock<std::mutex>&, Predicate)
+    void wait(std::unique_lock<std::mutex>& lock, Predicate)
     {
         _hasWaited = true;
+        CallWhileWaiting(lock);
     }
 
 	template<class Rep, class Period, class Predicate>
-	void wait_for(std::unique_lock<std::mutex>&, const std::chrono::duration<Rep, Period>&, Predicate)
+	void wait_for(std::unique_lock<std::mutex>& lock, const std::chrono::duration<Rep, Period>&, Predicate)
 	{
 		_hasWaited = true;
+        CallWhileWaiting(lock);
 	}
     
+    // Like a real wait, the lock is released while waiting
+    void CallWhileWaiting(std::unique_lock<std::mutex>& lock)
+    {
+        if(_whileWaiting)
+        {
+            lock.unlock();
+            _whileWaiting();
+            lock.lock();
+        }
+    }
+    
     void notify_one()
     {
         _notifiedOne = true;
@@ -32,6 +48,7 @@ public:
     bool _hasWaited;
     bool _notifiedOne;
     bool _notifiedAll;
+    std::function<void()> _whileWaiting;
 };
 
 TEST(TaskThreadGate, WaitsWhenNotOpen)
@@ -46,8 +63,9 @@ TEST(TaskThreadGate, WaitsWhenNotOpen)
 TEST(TaskThreadGate, OpenAndNotifyOneNotifiesOne)
 {
     TaskThreadGate<MockWaitMechanism> gate;
+    gate.GetWaitMechanism()->_whileWaiting = [&] { gate.OpenAndNotifyOne(); };
     
-    gate.OpenAndNotifyOne();
+    gate.Wait();
     
     EXPECT_TRUE(gate.GetWaitMechanism()->_notifiedOne) << "Gate should have notified one";
 }
@@ -55,8 +73,9 @@ TEST(TaskThreadGate, OpenAndNotifyOneNotifiesOne)
 TEST(TaskThreadGate, OpenAndNotifyAllNotifiesAll)
 {
     TaskThreadGate<MockWaitMechanism> gate;
+    gate.GetWaitMechanism()->_whileWaiting = [&] { gate.OpenAndNotifyAll(); };
     
-    gate.OpenAndNotifyAll();
+    gate.Wait();
     
     EXPECT_TRUE(gate.GetWaitMechanism()->_notifiedAll) << "Gate should have notified all";
 }
@@ -64,12 +83,53 @@ TEST(TaskThreadGate, OpenAndNotifyAllNotifiesAll)
 TEST(TaskThreadGate, OpenPermenentlyAndNotifyAllNotifiesAll)
 {
     TaskThreadGate<MockWaitMechanism> gate;
+    gate.GetWaitMechanism()->_whileWaiting = [&] { gate.OpenPermenentlyAndNotifyAll(); };
     
-    gate.OpenPermenentlyAndNotifyAll();
+    gate.Wait();
     
     EXPECT_TRUE(gate.GetWaitMechanism()->_notifiedAll) << "Gate should have notified all";
 }
 
+TEST(TaskThreadGate, OpenWithNoSleepersDoesNotNotify)
+{
+    TaskThreadGate<MockWaitMechanism> gate;
+    
+    gate.OpenAndNotifyOne();
+    gate.OpenAndNotifyAll();
+    
+    EXPECT_FALSE(gate.GetWaitMechanism()->_notifiedOne) << "Nobody was asleep, so nobody should have been notified";
+    EXPECT_FALSE(gate.GetWaitMechanism()->_notifiedAll) << "Nobody was asleep, so nobody should have been notified";
+}
+
+TEST(TaskThreadGate, NoSleepersAfterWaitReturns)
+{
+    TaskThreadGate<MockWaitMechanism> gate;
+    uint32_t numSleepersWhileWaiting = 0;
+    gate.GetWaitMechanism()->_whileWaiting = [&] { numSleepersWhileWaiting = gate.GetNumSleepers(); };
+    
+    gate.Wait();
+    
+    EXPECT_EQUAL(numSleepersWhileWaiting, 1u);
+    EXPECT_EQUAL(gate.GetNumSleepers(), 0u);
+}
+
+TEST(TaskThreadGate, SleepingThreadIsWokenWhenOpened)
+{
+    TaskThreadGate<> gate(0);
+    
+    std::thread sleeper([&]() {
+        gate.Wait();
+    });
+    while(gate.GetNumSleepers() == 0)
+    {
+        std::this_thread::yield();
+    }
+    gate.OpenAndNotifyOne();
+    sleeper.join();
+    
+    EXPECT_EQUAL(gate.GetNumSleepers(), 0u);
+}
+
 TEST(TaskThreadGate, WaitAfterOpenAndNotifyOneShouldNotWait)
 {
     TaskThreadGate<MockWaitMechanism> gate;
@@ -119,3 +179,40 @@ TEST(TaskThreadGate, WaitShouldNotCloseGateIfOpenPermenently)
     
     EXPECT_FALSE(gate.GetWaitMechanism()->_hasWaited) << "Gate should not closed after the first wait because it should be open permenently";
 }
+
+TEST(TaskThreadGate, WaitReturnsWithoutClosingGateIfWakeConditionIsMet)
+{
+    TaskThreadGate<MockWaitMechanism> gate;
+    
+    gate.OpenAndNotifyOne();
+    
+    gate.Wait(std::chrono::milliseconds::zero(), [] { return true; });
+    gate.Wait();
+    
+    EXPECT_FALSE(gate.GetWaitMechanism()->_hasWaited) << "The wake condition should have let the first wait through, leaving the gate open for the second";
+}
+
+TEST(TaskThreadGate, NotifySleepersDoesNothingIfNobodyIsAsleep)
+{
+    TaskThreadGate<MockWaitMechanism> gate;
+    auto notified = false;
+    
+    gate.NotifySleepers([&](MockWaitMechanism&) { notified = true; });
+    
+    EXPECT_FALSE(notified) << "Nobody was asleep, so nobody should have been notified";
+}
+
+TEST(TaskThreadGate, NotifySleepersLeavesTheGateClosed)
+{
+    TaskThreadGate<MockWaitMechanism> gate;
+    auto notified = false;
+    gate.GetWaitMechanism()->_whileWaiting = [&] { gate.NotifySleepers([&](MockWaitMechanism&) { notified = true; }); };
+    
+    gate.Wait();
+    gate.GetWaitMechanism()->_whileWaiting = nullptr;
+    gate.GetWaitMechanism()->_hasWaited = false;
+    gate.Wait();
+    
+    EXPECT_TRUE(notified) << "A thread was asleep, so it should have been notified";
+    EXPECT_TRUE(gate.GetWaitMechanism()->_hasWaited) << "The gate should not have been opened, so the second wait should have waited";
+}
@@ -0,0 +1,121 @@
+#include "Test.h"
+#include "Task/TaskTimerWheel.h"
+
+#include <vector>
+
+using namespace Flourish;
+
+namespace
+{
+    TaskTimerWheel::Timer* NewTimer(uint64_t expiryTick, TaskId taskId)
+    {
+        return new TaskTimerWheel::Timer{ nullptr, nullptr, expiryTick, 0, taskId, WorkItem::Empty(), TaskPriority::Normal, 0 };
+    }
+
+    // Advances the wheel a tick at a time, returning the tick each task's timer fired at
+    std::vector<std::pair<TaskId, uint64_t>> AdvanceTickByTick(TaskTimerWheel& wheel, uint64_t tick)
+    {
+        std::vector<std::pair<TaskId, uint64_t>> firedTimers;
+        while(wheel.GetCurrentTick() < tick)
+        {
+            wheel.Advance(wheel.GetCurrentTick() + 1, [&](TaskTimerWheel::Timer* timer) {
+                firedTimers.emplace_back(timer->_taskId, wheel.GetCurrentTick());
+                delete timer;
+            });
+        }
+        return firedTimers;
+    }
+}
+
+TEST(TaskTimerWheelTests, TimersFireOnTheTickTheyAreDue)
+{
+    TaskTimerWheel wheel(std::chrono::steady_clock::now());
+    // One on each level, plus ones due right on the level boundaries
+    std::vector<uint64_t> expiryTicks = { 1, 63, 64, 65, 4095, 4096, 5000, 262144, 300000 };
+    for(TaskId taskId = 0; taskId < expiryTicks.size(); taskId++)
+    {
+        wheel.Add(NewTimer(expiryTicks[taskId], taskId));
+    }
+
+    auto firedTimers = AdvanceTickByTick(wheel, 300000);
+
+    ASSERT_EQUAL(firedTimers.size(), expiryTicks.size());
+    for(TaskId taskId = 0; taskId < expiryTicks.size(); taskId++)
+    {
+        EXPECT_EQUAL(firedTimers[taskId].first, taskId);
+        EXPECT_EQUAL(firedTimers[taskId].second, expiryTicks[taskId]);
+    }
+    EXPECT_EQUAL(wheel.GetNumTimers(), 0u);
+}
+
+TEST(TaskTimerWheelTests, AdvancingPastTimersFiresThemAll)
+{
+    TaskTimerWheel wheel(std::chrono::steady_clock::now());
+    wheel.Add(NewTimer(10, 0));
+    wheel.Add(NewTimer(10, 1));
+    wheel.Add(NewTimer(5000, 2));
+    wheel.Add(NewTimer(5001, 3));
+    std::vector<TaskId> firedTaskIds;
+
+    wheel.Advance(5000, [&](TaskTimerWheel::Timer* timer) {
+        firedTaskIds.push_back(timer->_taskId);
+        delete timer;
+    });
+
+    EXPECT_EQUAL(firedTaskIds.size(), 3u);
+    EXPECT_EQUAL(wheel.GetCurrentTick(), 5000u);
+    EXPECT_EQUAL(wheel.GetNumTimers(), 1u);
+    EXPECT_EQUAL(wheel.GetNextTick(), 5001u);
+}
+
+TEST(TaskTimerWheelTests, TimersBeyondTheWheelStillFireOnTime)
+{
+    TaskTimerWheel wheel(std::chrono::steady_clock::now());
+    uint64_t expiryTick = (1ull << 24) * 3 + 12345;
+    wheel.Add(NewTimer(expiryTick, 0));
+    uint64_t firedTick = 0;
+
+    wheel.Advance(expiryTick - 1, [&](TaskTimerWheel::Timer* timer) {
+        delete timer;
+        firedTick = 1;
+    });
+    EXPECT_EQUAL(firedTick, 0u) << "The timer fired early";
+    wheel.Advance(expiryTick + 100, [&](TaskTimerWheel::Timer* timer) {
+        delete timer;
+        firedTick = wheel.GetCurrentTick();
+    });
+
+    EXPECT_EQUAL(firedTick, expiryTick);
+}
+
+TEST(TaskTimerWheelTests, RemovedTimersDontFire)
+{
+    TaskTimerWheel wheel(std::chrono::steady_clock::now());
+    auto removedTimer = NewTimer(100, 0);
+    wheel.Add(NewTimer(100, 1));
+    wheel.Add(removedTimer);
+    wheel.Add(NewTimer(100, 2));
+
+    wheel.Remove(removedTimer);
+    delete removedTimer;
+    auto firedTimers = AdvanceTickByTick(wheel, 100);
+
+    ASSERT_EQUAL(firedTimers.size(), 2u);
+    EXPECT_NOT_EQUAL(firedTimers[0].first, 0u);
+    EXPECT_NOT_EQUAL(firedTimers[1].first, 0u);
+}
+
+TEST(TaskTimerWheelTests, NextTickIsNeverAfterTheNextTimer)
+{
+    TaskTimerWheel wheel(std::chrono::steady_clock::now());
+    EXPECT_EQUAL(wheel.GetNextTick(), TaskTimerWheel::NO_TICK);
+
+    wheel.Add(NewTimer(5000, 0));
+    EXPECT_TRUE(wheel.GetNextTick() <= 5000u);
+    wheel.Add(NewTimer(3, 1));
+    EXPECT_EQUAL(wheel.GetNextTick(), 3u);
+    wheel.Advance(4000, [](TaskTimerWheel::Timer* timer) {
+        delete timer;
+    });
+    EXPECT_TRUE(wheel.GetNextTick() > 4000u && wheel.GetNextTick() <= 5000u);
+}
@@ -0,0 +1,51 @@
+#include "Test.h"
+#include "Task/TaskWaitTable.h"
+
+#include <thread>
+
+using namespace Flourish;
+
+TEST(TaskWaitTableTests, WaitReturnsImmediatelyIfComplete)
+{
+    TaskWaitTable waitTable;
+    auto start = std::chrono::steady_clock::now();
+    
+    waitTable.WaitForCompletion(1, std::chrono::seconds(10), [] { return true; });
+    
+    EXPECT_LESS_THAN(std::chrono::steady_clock::now() - start, std::chrono::seconds(5)) << "Should not have waited for a complete task";
+}
+
+TEST(TaskWaitTableTests, WaitTimesOutIfNotComplete)
+{
+    TaskWaitTable waitTable;
+    bool checkedIfComplete = false;
+    
+    waitTable.WaitForCompletion(1, std::chrono::milliseconds(1), [&] {
+        checkedIfComplete = true;
+        return false;
+    });
+    
+    EXPECT_TRUE(checkedIfComplete);
+}
+
+TEST(TaskWaitTableTests, NotifyCompletedWakesWaiter)
+{
+    TaskWaitTable waitTable;
+    std::atomic_bool complete(false);
+    std::atomic_bool waiting(false);
+    auto start = std::chrono::steady_clock::now();
+    
+    std::thread waiter([&]() {
+        waiting = true;
+        waitTable.WaitForCompletion(1, std::chrono::seconds(10), [&] { return complete.load(); });
+    });
+    while(!waiting)
+    {
+        std::this_thread::yield();
+    }
+    complete = true;
+    waitTable.NotifyCompleted(1);
+    waiter.join();
+    
+    EXPECT_LESS_THAN(std::chrono::steady_clock::now() - start, std::chrono::seconds(5)) << "Waiter was not woken";
+}
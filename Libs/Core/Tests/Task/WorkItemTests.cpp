@@ -0,0 +1,119 @@
+#include "Test.h"
+#include "Task/WorkItem.h"
+
+#include "Task/TaskTestHelpers/CountingAllocator.h"
+
+using namespace Flourish;
+using namespace Flourish::TaskTestHelpers;
+
+namespace
+{
+    struct LargeCapture
+    {
+        uint8_t bytes[WorkItem::INLINE_STORAGE_SIZE * 2];
+    };
+}
+
+TEST(WorkItemTests, CallsFunctionWithData)
+{
+    int32_t data = 0;
+    WorkItem workItem([](void* data){
+        *static_cast<int32_t*>(data) = 5;
+    }, &data);
+    
+    workItem();
+    
+    EXPECT_EQUAL(data, 5) << "Function was not called with the data";
+}
+
+TEST(WorkItemTests, SmallFunctionIsStoredInline)
+{
+    CountingAllocator allocator;
+    int32_t a = 1, b = 2, c = 3;
+    int32_t result = 0;
+    WorkItem workItem([&a, &b, &c, &result](void*){
+        result = a + b + c;
+    }, nullptr, &allocator);
+    
+    workItem();
+    
+    EXPECT_FALSE(workItem.IsHeapAllocated()) << "Function should have fit inline";
+    EXPECT_EQUAL(allocator._numAllocs, 0u) << "Storing the function should not have allocated";
+    EXPECT_EQUAL(result, 6);
+}
+
+TEST(WorkItemTests, LargeFunctionIsStoredWithAllocator)
+{
+    CountingAllocator allocator;
+    LargeCapture capture = {};
+    capture.bytes[0] = 7;
+    uint8_t result = 0;
+    {
+        WorkItem workItem([capture, &result](void*){
+            result = capture.bytes[0];
+        }, nullptr, &allocator);
+        
+        workItem();
+        
+        EXPECT_TRUE(workItem.IsHeapAllocated()) << "Function should not have fit inline";
+        EXPECT_EQUAL(allocator._numAllocs, 1u);
+    }
+    
+    EXPECT_EQUAL(result, 7);
+    EXPECT_EQUAL(allocator._numFrees, 1u) << "Function memory was not freed";
+}
+
+TEST(WorkItemTests, CopyingLargeFunctionCopiesCapture)
+{
+    CountingAllocator allocator;
+    LargeCapture capture = {};
+    uint32_t numCalls = 0;
+    {
+        WorkItem workItem([capture, &numCalls](void*){
+            numCalls++;
+        }, nullptr, &allocator);
+        WorkItem copy(workItem);
+        
+        workItem();
+        copy();
+        
+        EXPECT_EQUAL(allocator._numAllocs, 2u) << "Copy should have its own memory";
+    }
+    
+    EXPECT_EQUAL(numCalls, 2u);
+    EXPECT_EQUAL(allocator._numFrees, 2u);
+}
+
+TEST(WorkItemTests, MovingLargeFunctionDoesNotAllocate)
+{
+    CountingAllocator allocator;
+    LargeCapture capture = {};
+    uint32_t numCalls = 0;
+    {
+        WorkItem workItem([capture, &numCalls](void*){
+            numCalls++;
+        }, nullptr, &allocator);
+        WorkItem moved(std::move(workItem));
+        
+        moved();
+        workItem();
+        
+        EXPECT_EQUAL(allocator._numAllocs, 1u) << "Move should have taken the memory";
+        EXPECT_FALSE(workItem.IsHeapAllocated()) << "Moved from work item should be empty";
+    }
+    
+    EXPECT_EQUAL(numCalls, 1u) << "Moved from work item should not call the function";
+    EXPECT_EQUAL(allocator._numFrees, 1u);
+}
+
+TEST(WorkItemTests, ResetReleasesCapture)
+{
+    CountingAllocator allocator;
+    LargeCapture capture = {};
+    WorkItem workItem([capture](void*){}, nullptr, &allocator);
+    
+    workItem.Reset();
+    
+    EXPECT_EQUAL(allocator._numFrees, 1u) << "Reset did not free the function";
+    EXPECT_FALSE(workItem.IsHeapAllocated());
+}
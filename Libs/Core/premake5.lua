@@ -31,5 +31,5 @@ project "Core"
       links { "DbgHelp" }
 
    filter {"system:macosx"}
-      linkoptions  { "-std=c++17", "-stdlib=libc++" }
-      buildoptions { "-std=c++17", "-stdlib=libc++" }
\ No newline at end of file
+      linkoptions  { cppStandardOption(), "-stdlib=libc++" }
+      buildoptions { cppStandardOption(), "-stdlib=libc++" }
\ No newline at end of file
@@ -24,5 +24,5 @@ project "UnitTests"
    links { "Core" }
 
    filter {"system:macosx"}
-      linkoptions  { "-std=c++17", "-stdlib=libc++" }
-      buildoptions { "-std=c++17", "-stdlib=libc++" }
\ No newline at end of file
+      linkoptions  { cppStandardOption(), "-stdlib=libc++" }
+      buildoptions { cppStandardOption(), "-stdlib=libc++" }
\ No newline at end of file
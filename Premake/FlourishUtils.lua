@@ -1,3 +1,12 @@
+--the C++ standard, for the flags that pass it to the compiler directly
+--C++17 unless premake is run with --cpp20
+function cppStandardOption()
+   if _OPTIONS["cpp20"] then
+      return "-std=c++20"
+   end
+   return "-std=c++17"
+end
+
 --includes common files by extension in standard libary setup
 function includeCommonFiles()
    files 
@@ -4,6 +4,14 @@ require "cmake"
 
 include "FlourishUtils"
 
+-- Coroutine support (CoTask and the DataStore awaitables) is only compiled, and only
+-- tested by the UnitTestRunner, when building as C++20
+newoption
+{
+   trigger = "cpp20",
+   description = "Build everything as C++20 instead of C++17, including the coroutine tests"
+}
+
 workspace "Flourish"
    configurations { "Debug", "Release" }
    location("../Projects/" .. _ACTION)
@@ -20,6 +28,17 @@ workspace "Flourish"
    warnings "Extra"
    cppdialect "C++17"
 
+   -- This premake has no C++20 dialect, so pass it directly to gcc and clang.
+   -- C++latest is the closest Visual Studio gets
+   filter { "options:cpp20", "action:vs*" }
+      cppdialect "C++latest"
+
+   filter { "options:cpp20", "action:not vs*" }
+      cppdialect "Default"
+      buildoptions { cppStandardOption() }
+
+   filter { }
+
    --Create x32/x64 platforms for each system
 	filter { "system:windows" }
 		platforms { "Win32", "Win64" }
@@ -60,5 +79,6 @@ workspace "Flourish"
    -- Include applications that need all the libs last
    group("Tools")
    	include "../Tools/UnitTestRunner"
+   	include "../Tools/Benchmarks"
 
    --group("Examples") TODO
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace Flourish::Benchmarks
+{
+    // Passed to every benchmark. The benchmark does any setup it needs, then
+    // wraps the code being measured in StartTimer/StopTimer and reports how many
+    // items (tasks, elements etc) were processed in that time.
+    // Benchmarks that care about latency rather than throughput can also
+    // add latency samples, which are reported as percentiles.
+    // Benchmarks registered with BENCHMARK_WITH_ARGS are run once for each argument,
+    // like a number of threads or elements, which GetArg returns
+    class BenchmarkState
+    {
+    public:
+        explicit BenchmarkState(int64_t arg = 0)
+            : _arg(arg)
+            , _itemsProcessed(0)
+            , _elapsed(std::chrono::nanoseconds::zero())
+        {
+        }
+
+        int64_t GetArg() const
+        {
+            return _arg;
+        }
+
+        void StartTimer()
+        {
+            _start = std::chrono::steady_clock::now();
+        }
+
+        void StopTimer()
+        {
+            _elapsed += std::chrono::steady_clock::now() - _start;
+        }
+
+        void SetItemsProcessed(uint64_t itemsProcessed)
+        {
+            _itemsProcessed = itemsProcessed;
+        }
+
+        uint64_t GetItemsProcessed() const
+        {
+            return _itemsProcessed;
+        }
+
+        std::chrono::nanoseconds GetElapsed() const
+        {
+            return _elapsed;
+        }
+
+        void AddLatency(std::chrono::nanoseconds latency)
+        {
+            _latencies.push_back(latency);
+        }
+
+        const std::vector<std::chrono::nanoseconds>& GetLatencies() const
+        {
+            return _latencies;
+        }
+
+    private:
+        int64_t _arg;
+        uint64_t _itemsProcessed;
+        std::chrono::steady_clock::time_point _start;
+        std::chrono::nanoseconds _elapsed;
+        std::vector<std::chrono::nanoseconds> _latencies;
+    };
+
+    typedef void (*BenchmarkFunction)(BenchmarkState& state);
+
+    // Adds the benchmark to the list run by RunAllBenchmarks. Use the BENCHMARK
+    // macros rather than creating these directly
+    struct BenchmarkRegistration
+    {
+        BenchmarkRegistration(const char* groupName, const char* benchmarkName, BenchmarkFunction function, std::initializer_list<int64_t> args = {});
+    };
+
+    // Runs every registered benchmark whose name contains the filter passed on the
+    // command line (or all of them if there isn't one) and prints the results.
+    // With --json <path> the results are also written to path, to compare between builds.
+    // Benchmarks with arguments are named Group.Benchmark/arg, and their scaling is
+    // their throughput relative to the first argument's
+    int RunAllBenchmarks(int argc, char** argv);
+}
+
+#define BENCHMARK(groupName, benchmarkName)                                                              \
+    static void groupName##_##benchmarkName(Flourish::Benchmarks::BenchmarkState& state);                \
+    static Flourish::Benchmarks::BenchmarkRegistration groupName##_##benchmarkName##_Registration(      \
+        #groupName, #benchmarkName, &groupName##_##benchmarkName);                                       \
+    static void groupName##_##benchmarkName(Flourish::Benchmarks::BenchmarkState& state)
+
+// Runs the benchmark once for each of the arguments that follow, in order
+#define BENCHMARK_WITH_ARGS(groupName, benchmarkName, ...)                                               \
+    static void groupName##_##benchmarkName(Flourish::Benchmarks::BenchmarkState& state);                \
+    static Flourish::Benchmarks::BenchmarkRegistration groupName##_##benchmarkName##_Registration(      \
+        #groupName, #benchmarkName, &groupName##_##benchmarkName, { __VA_ARGS__ });                      \
+    static void groupName##_##benchmarkName(Flourish::Benchmarks::BenchmarkState& state)
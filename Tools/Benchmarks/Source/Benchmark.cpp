@@ -0,0 +1,188 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Flourish::Benchmarks
+{
+    namespace
+    {
+        struct RegisteredBenchmark
+        {
+            const char* _groupName;
+            const char* _benchmarkName;
+            BenchmarkFunction _function;
+            std::vector<int64_t> _args;
+        };
+
+        struct BenchmarkResult
+        {
+            std::string _name;
+            bool _hasArg;
+            int64_t _arg;
+            double _nanosecondsPerItem;
+            double _bestNanosecondsPerItem;
+            // Throughput relative to the benchmark's first argument
+            double _scaling;
+            // Sorted
+            std::vector<std::chrono::nanoseconds> _latencies;
+        };
+
+        // Function static so registrations from other translation units can't
+        // run before it has been constructed
+        std::vector<RegisteredBenchmark>& GetRegisteredBenchmarks()
+        {
+            static std::vector<RegisteredBenchmark> registeredBenchmarks;
+            return registeredBenchmarks;
+        }
+
+        const uint32_t NumRepetitions = 5;
+
+        // Latencies must be sorted
+        double GetPercentile(const std::vector<std::chrono::nanoseconds>& latencies, double percentile)
+        {
+            auto index = static_cast<size_t>(percentile * static_cast<double>(latencies.size() - 1));
+            return static_cast<double>(latencies[index].count());
+        }
+
+        // Runs the benchmark NumRepetitions times. Returns false if it didn't process any items
+        bool RunBenchmark(const RegisteredBenchmark& benchmark, int64_t arg, BenchmarkResult& result)
+        {
+            std::vector<double> nanosecondsPerItem;
+            for(uint32_t repetition = 0; repetition < NumRepetitions; repetition++)
+            {
+                BenchmarkState state(arg);
+                benchmark._function(state);
+                result._latencies.insert(result._latencies.end(), state.GetLatencies().begin(), state.GetLatencies().end());
+                if(state.GetItemsProcessed() > 0)
+                {
+                    nanosecondsPerItem.push_back(static_cast<double>(state.GetElapsed().count()) / static_cast<double>(state.GetItemsProcessed()));
+                }
+            }
+            if(nanosecondsPerItem.empty())
+            {
+                return false;
+            }
+
+            std::sort(nanosecondsPerItem.begin(), nanosecondsPerItem.end());
+            std::sort(result._latencies.begin(), result._latencies.end());
+            result._nanosecondsPerItem = nanosecondsPerItem[nanosecondsPerItem.size() / 2];
+            result._bestNanosecondsPerItem = nanosecondsPerItem.front();
+            return true;
+        }
+
+        void PrintResult(const BenchmarkResult& result)
+        {
+            if(result._hasArg)
+            {
+                printf("%-50s %14.2f %14.0f %14.0f %8.2fx\n", result._name.c_str(), result._nanosecondsPerItem,
+                    1e9 / result._nanosecondsPerItem, 1e9 / result._bestNanosecondsPerItem, result._scaling);
+            }
+            else
+            {
+                printf("%-50s %14.2f %14.0f %14.0f\n", result._name.c_str(), result._nanosecondsPerItem,
+                    1e9 / result._nanosecondsPerItem, 1e9 / result._bestNanosecondsPerItem);
+            }
+            if(!result._latencies.empty())
+            {
+                printf("    latency p50 %.0fns, p99 %.0fns, p999 %.0fns, max %.0fns\n", GetPercentile(result._latencies, 0.5),
+                    GetPercentile(result._latencies, 0.99), GetPercentile(result._latencies, 0.999), static_cast<double>(result._latencies.back().count()));
+            }
+        }
+
+        bool WriteJson(const char* path, const std::vector<BenchmarkResult>& results)
+        {
+            auto file = fopen(path, "w");
+            if(file == nullptr)
+            {
+                return false;
+            }
+            fprintf(file, "{\"repetitions\":%u,\"benchmarks\":[", NumRepetitions);
+            for(size_t resultIdx = 0; resultIdx < results.size(); resultIdx++)
+            {
+                auto& result = results[resultIdx];
+                fprintf(file, "%s\n{\"name\":\"%s\"", resultIdx == 0 ? "" : ",", result._name.c_str());
+                if(result._hasArg)
+                {
+                    fprintf(file, ",\"arg\":%lld,\"scaling\":%.4f", static_cast<long long>(result._arg), result._scaling);
+                }
+                fprintf(file, ",\"nsPerItem\":%.4f,\"itemsPerSecond\":%.1f,\"bestItemsPerSecond\":%.1f",
+                    result._nanosecondsPerItem, 1e9 / result._nanosecondsPerItem, 1e9 / result._bestNanosecondsPerItem);
+                if(!result._latencies.empty())
+                {
+                    fprintf(file, ",\"latencyNs\":{\"p50\":%.0f,\"p99\":%.0f,\"p999\":%.0f,\"max\":%.0f,\"samples\":%zu}",
+                        GetPercentile(result._latencies, 0.5), GetPercentile(result._latencies, 0.99), GetPercentile(result._latencies, 0.999),
+                        static_cast<double>(result._latencies.back().count()), result._latencies.size());
+                }
+                fprintf(file, "}");
+            }
+            fprintf(file, "\n]}\n");
+            return fclose(file) == 0;
+        }
+    }
+
+    BenchmarkRegistration::BenchmarkRegistration(const char* groupName, const char* benchmarkName, BenchmarkFunction function, std::initializer_list<int64_t> args)
+    {
+        GetRegisteredBenchmarks().push_back({ groupName, benchmarkName, function, args });
+    }
+
+    int RunAllBenchmarks(int argc, char** argv)
+    {
+        const char* filter = nullptr;
+        const char* jsonPath = nullptr;
+        for(int argIdx = 1; argIdx < argc; argIdx++)
+        {
+            if(strcmp(argv[argIdx], "--json") == 0 && argIdx + 1 < argc)
+            {
+                jsonPath = argv[++argIdx];
+            }
+            else
+            {
+                filter = argv[argIdx];
+            }
+        }
+
+        std::vector<BenchmarkResult> results;
+        printf("%-50s %14s %14s %14s %9s\n", "Benchmark", "ns/item", "items/sec", "best items/sec", "scaling");
+        for(auto& benchmark : GetRegisteredBenchmarks())
+        {
+            auto fullName = std::string(benchmark._groupName) + "." + benchmark._benchmarkName;
+            if(filter != nullptr && strstr(fullName.c_str(), filter) == nullptr)
+            {
+                continue;
+            }
+
+            // A benchmark without arguments is run once, with an argument of zero
+            auto hasArgs = !benchmark._args.empty();
+            auto args = hasArgs ? benchmark._args : std::vector<int64_t>{ 0 };
+            double firstItemsPerSecond = 0.0;
+            for(auto arg : args)
+            {
+                BenchmarkResult result{ hasArgs ? fullName + "/" + std::to_string(arg) : fullName, hasArgs, arg, 0.0, 0.0, 1.0, {} };
+                if(!RunBenchmark(benchmark, arg, result))
+                {
+                    printf("%-50s %14s\n", result._name.c_str(), "no items");
+                    continue;
+                }
+                auto itemsPerSecond = 1e9 / result._nanosecondsPerItem;
+                if(firstItemsPerSecond == 0.0)
+                {
+                    firstItemsPerSecond = itemsPerSecond;
+                }
+                result._scaling = itemsPerSecond / firstItemsPerSecond;
+                PrintResult(result);
+                results.push_back(std::move(result));
+            }
+        }
+
+        if(jsonPath != nullptr && !WriteJson(jsonPath, results))
+        {
+            printf("Couldn't write %s\n", jsonPath);
+            return 1;
+        }
+        return 0;
+    }
+}
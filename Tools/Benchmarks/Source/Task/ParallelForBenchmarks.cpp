@@ -0,0 +1,98 @@
+#include "Benchmark.h"
+
+#include <vector>
+
+#include "Task/AutoSplitter.h"
+#include "Task/CountSplitter.h"
+#include "Task/ParallelFor.h"
+#include "Task/TaskManager.h"
+
+using namespace Flourish;
+
+// The same loop over 1e3 to 1e8 elements, to show where each grain size starts to
+// pay for its tasks. Items are elements, so ns/item is the cost of one element
+// including its share of the scheduling
+namespace
+{
+    template<typename Splitter>
+    void RunLoop(Benchmarks::BenchmarkState& state, TaskManager& taskManager, std::vector<uint32_t>& data, Splitter* splitter)
+    {
+        auto dataCount = static_cast<uint32_t>(data.size());
+
+        state.StartTimer();
+        LazyParallelFor parallelFor(data.data(), dataCount, splitter, [](uint32_t* data, uint32_t dataCount){
+            for(uint32_t index = 0; index < dataCount; index++)
+            {
+                data[index] = data[index] * 3u + 1u;
+            }
+        }, &taskManager);
+        taskManager.Wait(parallelFor.Run());
+        state.StopTimer();
+
+        state.SetItemsProcessed(dataCount);
+    }
+
+    void RunCountSplitter(Benchmarks::BenchmarkState& state, uint32_t grainSize)
+    {
+        std::vector<uint32_t> data(static_cast<size_t>(state.GetArg()), 1u);
+        TaskManager taskManager;
+        CountSplitter<uint32_t> splitter(grainSize);
+        RunLoop(state, taskManager, data, &splitter);
+    }
+}
+
+BENCHMARK_WITH_ARGS(ParallelFor, ElementsGrain1024, 1000, 10000, 100000, 1000000, 10000000, 100000000)
+{
+    RunCountSplitter(state, 1024);
+}
+
+BENCHMARK_WITH_ARGS(ParallelFor, ElementsGrain65536, 1000, 10000, 100000, 1000000, 10000000, 100000000)
+{
+    RunCountSplitter(state, 65536);
+}
+
+BENCHMARK_WITH_ARGS(ParallelFor, ElementsAutoGrain, 1000, 10000, 100000, 1000000, 10000000, 100000000)
+{
+    std::vector<uint32_t> data(static_cast<size_t>(state.GetArg()), 1u);
+    TaskManager taskManager;
+    AutoSplitter<uint32_t> splitter(static_cast<uint32_t>(data.size()), &taskManager);
+    RunLoop(state, taskManager, data, &splitter);
+}
+
+namespace
+{
+    // A ParallelFor with very small leaves, all added to the main thread's queue up front,
+    // so the workers only get any by stealing them. Every leaf is live at once, so the
+    // counts stay under TaskManager::MaxConcurrentTasks. Items are leaves
+    void RunFineGrained(Benchmarks::BenchmarkState& state, bool stealsBatches)
+    {
+        const uint32_t grainSize = 16;
+        std::vector<uint32_t> data(static_cast<size_t>(state.GetArg()) * grainSize, 1u);
+        auto dataCount = static_cast<uint32_t>(data.size());
+        TaskManager taskManager;
+        taskManager.SetStealsBatches(stealsBatches);
+        CountSplitter<uint32_t> splitter(grainSize);
+
+        state.StartTimer();
+        ParallelFor parallelFor(data.data(), dataCount, &splitter, [](uint32_t* data, uint32_t dataCount){
+            for(uint32_t index = 0; index < dataCount; index++)
+            {
+                data[index] = data[index] * 3u + 1u;
+            }
+        }, &taskManager);
+        taskManager.Wait(parallelFor.Run());
+        state.StopTimer();
+
+        state.SetItemsProcessed(state.GetArg());
+    }
+}
+
+BENCHMARK_WITH_ARGS(ParallelFor, FineGrainedBatchSteals, 256, 1024, 3072)
+{
+    RunFineGrained(state, true);
+}
+
+BENCHMARK_WITH_ARGS(ParallelFor, FineGrainedSingleSteals, 256, 1024, 3072)
+{
+    RunFineGrained(state, false);
+}
@@ -0,0 +1,110 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Memory/Allocators/MallocAllocator.h"
+#include "Task/ParallelSort.h"
+#include "Task/TaskManager.h"
+
+using namespace Flourish;
+
+// Each sort is run with 1, 2, 4 and 8 threads (the thread that waits counts as one,
+// so that's 0, 1, 3 and 7 workers) to show how it scales against std::sort.
+// Counts above the number of cores the machine has will only show the overhead
+namespace
+{
+    const uint32_t DataCount = 1 << 22;
+
+    std::vector<uint32_t> MakeRandomKeys()
+    {
+        std::mt19937 generator(12345u);
+        std::uniform_int_distribution<uint32_t> distribution;
+        std::vector<uint32_t> keys(DataCount);
+        for(auto& key : keys)
+        {
+            key = distribution(generator);
+        }
+        return keys;
+    }
+
+    template<typename SortFunc>
+    void RunSort(Benchmarks::BenchmarkState& state, int32_t numThreads, SortFunc sortFunc)
+    {
+        auto keys = MakeRandomKeys();
+        Memory::MallocAllocator allocator("SortBenchmarkAllocator");
+        TaskManager taskManager(numThreads - 1);
+
+        state.StartTimer();
+        sortFunc(keys.data(), &allocator, &taskManager);
+        state.StopTimer();
+
+        state.SetItemsProcessed(DataCount);
+    }
+
+    void RunParallelSort(Benchmarks::BenchmarkState& state, int32_t numThreads)
+    {
+        RunSort(state, numThreads, [](uint32_t* keys, Memory::IAllocator* allocator, TaskManager* taskManager) {
+            ParallelSort(keys, DataCount, allocator, taskManager);
+        });
+    }
+
+    void RunParallelRadixSort(Benchmarks::BenchmarkState& state, int32_t numThreads)
+    {
+        RunSort(state, numThreads, [](uint32_t* keys, Memory::IAllocator* allocator, TaskManager* taskManager) {
+            ParallelRadixSort(keys, DataCount, allocator, taskManager);
+        });
+    }
+}
+
+BENCHMARK(Sort, StdSort)
+{
+    auto keys = MakeRandomKeys();
+
+    state.StartTimer();
+    std::sort(keys.begin(), keys.end());
+    state.StopTimer();
+
+    state.SetItemsProcessed(DataCount);
+}
+
+BENCHMARK(Sort, ParallelSort1Thread)
+{
+    RunParallelSort(state, 1);
+}
+
+BENCHMARK(Sort, ParallelSort2Threads)
+{
+    RunParallelSort(state, 2);
+}
+
+BENCHMARK(Sort, ParallelSort4Threads)
+{
+    RunParallelSort(state, 4);
+}
+
+BENCHMARK(Sort, ParallelSort8Threads)
+{
+    RunParallelSort(state, 8);
+}
+
+BENCHMARK(Sort, ParallelRadixSort1Thread)
+{
+    RunParallelRadixSort(state, 1);
+}
+
+BENCHMARK(Sort, ParallelRadixSort2Threads)
+{
+    RunParallelRadixSort(state, 2);
+}
+
+BENCHMARK(Sort, ParallelRadixSort4Threads)
+{
+    RunParallelRadixSort(state, 4);
+}
+
+BENCHMARK(Sort, ParallelRadixSort8Threads)
+{
+    RunParallelRadixSort(state, 8);
+}
@@ -0,0 +1,71 @@
+#include "Benchmark.h"
+
+#include <cmath>
+#include <vector>
+
+#include "Task/AutoSplitter.h"
+#include "Task/CountSplitter.h"
+#include "Task/ParallelFor.h"
+#include "Task/TaskManager.h"
+
+using namespace Flourish;
+
+namespace
+{
+    const uint32_t DataCount = 1 << 22;
+
+    template<typename Splitter>
+    void RunLoop(Benchmarks::BenchmarkState& state, TaskManager& taskManager, std::vector<float>& data, Splitter* splitter)
+    {
+        state.StartTimer();
+        LazyParallelFor parallelFor(data.data(), DataCount, splitter, [](float* data, uint32_t dataCount){
+            for(uint32_t index = 0; index < dataCount; index++)
+            {
+                data[index] = std::sqrt(data[index] + 1.0f);
+            }
+        }, &taskManager);
+        taskManager.Wait(parallelFor.Run());
+        state.StopTimer();
+
+        state.SetItemsProcessed(DataCount);
+    }
+
+    void RunCountSplitter(Benchmarks::BenchmarkState& state, uint32_t grainSize)
+    {
+        std::vector<float> data(DataCount, 1.0f);
+        TaskManager taskManager;
+        CountSplitter<float> splitter(grainSize);
+        RunLoop(state, taskManager, data, &splitter);
+    }
+}
+
+BENCHMARK(Splitter, CountGrain16)
+{
+    RunCountSplitter(state, 16);
+}
+
+BENCHMARK(Splitter, CountGrain1024)
+{
+    RunCountSplitter(state, 1024);
+}
+
+BENCHMARK(Splitter, CountGrain65536)
+{
+    RunCountSplitter(state, 65536);
+}
+
+BENCHMARK(Splitter, Auto)
+{
+    std::vector<float> data(DataCount, 1.0f);
+    TaskManager taskManager;
+    AutoSplitter<float> splitter(DataCount, &taskManager);
+    RunLoop(state, taskManager, data, &splitter);
+}
+
+BENCHMARK(Splitter, Affinity)
+{
+    std::vector<float> data(DataCount, 1.0f);
+    TaskManager taskManager;
+    AffinitySplitter<float> splitter(DataCount, &taskManager);
+    RunLoop(state, taskManager, data, &splitter);
+}
@@ -0,0 +1,100 @@
+#include "Benchmark.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Task/Task.h"
+
+using namespace Flourish;
+
+// 1, 2 and 4 threads keep finishing children of their own task, as workers do while
+// a parent is in flight, while the timed thread reads what it needs to run each of
+// the same tasks. With the hot atomics on their own line the reads stay in the
+// reader's cache, with them mixed in every read misses. Items are tasks read
+namespace
+{
+    // Keeps the reads from being optimised away
+    std::atomic<uint64_t> readChecksum(0);
+
+    // Task as it was before the atomics were split off, with everything on the same
+    // lines and tasks 176 bytes apart, so neighbours share lines too
+    struct PackedTask
+    {
+        std::atomic<TaskId> _id;
+        WorkItem _workItem;
+        TaskId _parentId;
+        TaskPriority _priority;
+        bool _added;
+        ThreadAffinity _threadAffinity;
+        std::atomic_uint _openWorkItems;
+        std::atomic_uint _unfinishedDependencies;
+        std::atomic<uint64_t> _dependents;
+        std::atomic<Task*> _nextInjected;
+        TaskGroup* _group;
+        uint8_t padding[16];
+
+        PackedTask()
+            : _id(0)
+            , _workItem(WorkItem::Empty())
+            , _parentId(0)
+            , _priority(TaskPriority::Normal)
+            , _added(false)
+            , _threadAffinity(ThreadAffinity::AnyThread())
+            , _openWorkItems(1)
+            , _unfinishedDependencies(1)
+            , _dependents(0)
+            , _nextInjected(nullptr)
+            , _group(nullptr)
+        {
+        }
+    };
+
+    template<typename TaskType>
+    void RunContention(Benchmarks::BenchmarkState& state)
+    {
+        const uint32_t numReads = 1 << 22;
+        auto numWriters = static_cast<uint32_t>(state.GetArg());
+        std::vector<TaskType> tasks(numWriters);
+        std::atomic_bool finished(false);
+        std::vector<std::thread> writers;
+        for(uint32_t writerIdx = 0; writerIdx < numWriters; writerIdx++)
+        {
+            writers.emplace_back([&, writerIdx]{
+                auto& task = tasks[writerIdx];
+                while(!finished.load(std::memory_order_relaxed))
+                {
+                    task._openWorkItems.fetch_add(1, std::memory_order_relaxed);
+                    task._openWorkItems.fetch_sub(1, std::memory_order_acq_rel);
+                }
+            });
+        }
+
+        uint64_t checksum = 0;
+        state.StartTimer();
+        for(uint32_t readIdx = 0; readIdx < numReads; readIdx++)
+        {
+            auto& task = tasks[readIdx % numWriters];
+            checksum += task._id.load(std::memory_order_relaxed) + task._parentId + static_cast<uint64_t>(task._priority) + (task._group == nullptr ? 1u : 0u);
+        }
+        state.StopTimer();
+        finished = true;
+        for(auto& writer : writers)
+        {
+            writer.join();
+        }
+
+        readChecksum.fetch_add(checksum, std::memory_order_relaxed);
+        state.SetItemsProcessed(numReads);
+    }
+}
+
+BENCHMARK_WITH_ARGS(TaskLayout, SplitHotAtomics, 1, 2, 4)
+{
+    RunContention<Task>(state);
+}
+
+BENCHMARK_WITH_ARGS(TaskLayout, PackedHotAtomics, 1, 2, 4)
+{
+    RunContention<PackedTask>(state);
+}
@@ -0,0 +1,311 @@
+#include "Benchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Task/CountSplitter.h"
+#include "Task/CpuTopology.h"
+#include "Task/ParallelFor.h"
+#include "Task/TaskManager.h"
+
+using namespace Flourish;
+
+namespace
+{
+    const uint32_t NumTasks = 200000;
+
+    void Spin(std::chrono::microseconds duration)
+    {
+        auto end = std::chrono::steady_clock::now() + duration;
+        while(std::chrono::steady_clock::now() < end)
+        {
+        }
+    }
+
+    // Halves the range, adding a task for the top half each time, until it's small enough
+    // to work on. Almost every task is taken by a thread that stole it
+    void SplitAndIncrement(TaskManager& taskManager, TaskId rootId, uint32_t* data, uint32_t count)
+    {
+        const uint32_t leafSize = 1024;
+        while(count > leafSize)
+        {
+            auto half = count / 2;
+            auto childId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&taskManager, rootId, data, count, half](void*){
+                SplitAndIncrement(taskManager, rootId, data + half, count - half);
+            }));
+            taskManager.AddChild(rootId, childId);
+            taskManager.FinishAdd(childId);
+            count = half;
+        }
+        for(uint32_t index = 0; index < count; index++)
+        {
+            data[index]++;
+        }
+    }
+
+    // Adds a task for each half of the tree below, and waits for them both. The waits
+    // nest depth deep, with each thread helping with the tasks below the ones it waits on
+    void ForkJoin(TaskManager& taskManager, uint32_t depth)
+    {
+        if(depth == 0)
+        {
+            return;
+        }
+        TaskId childIds[2];
+        for(auto& childId : childIds)
+        {
+            childId = taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&taskManager, depth](void*){
+                ForkJoin(taskManager, depth - 1);
+            }));
+        }
+        taskManager.Wait(childIds[0]);
+        taskManager.Wait(childIds[1]);
+    }
+
+    void RecursiveSplit(Benchmarks::BenchmarkState& state, TaskManager& taskManager)
+    {
+        const uint32_t dataCount = 1 << 24;
+        std::vector<uint32_t> data(dataCount, 0);
+
+        state.StartTimer();
+        auto rootId = taskManager.BeginAdd(WorkItem::Empty());
+        SplitAndIncrement(taskManager, rootId, data.data(), dataCount);
+        taskManager.FinishAdd(rootId);
+        taskManager.Wait(rootId);
+        state.StopTimer();
+
+        state.SetItemsProcessed(dataCount);
+    }
+}
+
+BENCHMARK(TaskManager, SpawnSmallCaptureTasks)
+{
+    TaskManager taskManager;
+    std::atomic_uint counter(0);
+    uint32_t increment = 1;
+
+    state.StartTimer();
+    auto parentId = taskManager.BeginAdd(WorkItem::Empty());
+    for(uint32_t taskIdx = 0; taskIdx < NumTasks; taskIdx++)
+    {
+        auto childId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&counter, increment](void*){
+            counter += increment;
+        }));
+        taskManager.AddChild(parentId, childId);
+        taskManager.FinishAdd(childId);
+    }
+    taskManager.FinishAdd(parentId);
+    taskManager.Wait(parentId);
+    state.StopTimer();
+
+    state.SetItemsProcessed(NumTasks);
+}
+
+// Adds empty tasks from one thread and waits for them, with 1, 2, 4 and 8 threads
+// counting the one that waits. The cost of a task with nothing in it
+BENCHMARK_WITH_ARGS(TaskManager, EmptyTasks, 1, 2, 4, 8)
+{
+    TaskManager taskManager(static_cast<int32_t>(state.GetArg()) - 1);
+
+    state.StartTimer();
+    auto parentId = taskManager.BeginAdd(WorkItem::Empty());
+    for(uint32_t taskIdx = 0; taskIdx < NumTasks; taskIdx++)
+    {
+        auto childId = taskManager.BeginAdd(WorkItem::Empty());
+        taskManager.AddChild(parentId, childId);
+        taskManager.FinishAdd(childId);
+    }
+    taskManager.FinishAdd(parentId);
+    taskManager.Wait(parentId);
+    state.StopTimer();
+
+    state.SetItemsProcessed(NumTasks);
+}
+
+// A binary tree of tasks that wait on their children, as deep as the argument
+BENCHMARK_WITH_ARGS(TaskManager, ForkJoinDepth, 4, 8, 12, 16)
+{
+    auto depth = static_cast<uint32_t>(state.GetArg());
+    TaskManager taskManager;
+
+    state.StartTimer();
+    ForkJoin(taskManager, depth);
+    state.StopTimer();
+
+    state.SetItemsProcessed((2ull << depth) - 2u);
+}
+
+// Captures too large to store inline in the work item, so each one is allocated
+// from the adding thread's TaskAllocator and freed by whichever thread runs it
+BENCHMARK(TaskManager, SpawnLargeCaptureTasks)
+{
+    TaskManager taskManager;
+    std::atomic_uint counter(0);
+    uint32_t increments[16] = { 1 };
+
+    state.StartTimer();
+    auto parentId = taskManager.BeginAdd(WorkItem::Empty());
+    for(uint32_t taskIdx = 0; taskIdx < NumTasks; taskIdx++)
+    {
+        auto childId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([&counter, increments](void*){
+            counter += increments[0];
+        }));
+        taskManager.AddChild(parentId, childId);
+        taskManager.FinishAdd(childId);
+    }
+    taskManager.FinishAdd(parentId);
+    taskManager.Wait(parentId);
+    state.StopTimer();
+
+    state.SetItemsProcessed(NumTasks);
+}
+
+// Measures how long a high priority task waits to start while every thread
+// has a long queue of background work
+BENCHMARK(TaskManager, HighPriorityLatencyUnderBackgroundLoad)
+{
+    const uint32_t numBackgroundTasks = 20000;
+    const uint32_t numHighTasks = 1000;
+    TaskManager taskManager;
+    std::vector<std::chrono::steady_clock::time_point> startTimes(numHighTasks);
+
+    auto backgroundParentId = taskManager.BeginAdd(WorkItem::Empty(), TaskPriority::Background);
+    for(uint32_t taskIdx = 0; taskIdx < numBackgroundTasks; taskIdx++)
+    {
+        auto childId = taskManager.BeginAdd(taskManager.WorkItemWithTaskAllocator([](void*){
+            Spin(std::chrono::microseconds(20));
+        }), TaskPriority::Background);
+        taskManager.AddChild(backgroundParentId, childId);
+        taskManager.FinishAdd(childId);
+    }
+    taskManager.FinishAdd(backgroundParentId);
+
+    state.StartTimer();
+    for(uint32_t taskIdx = 0; taskIdx < numHighTasks; taskIdx++)
+    {
+        auto addTime = std::chrono::steady_clock::now();
+        auto highId = taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&startTimes, taskIdx](void*){
+            startTimes[taskIdx] = std::chrono::steady_clock::now();
+        }), TaskPriority::High);
+        taskManager.Wait(highId);
+        state.AddLatency(startTimes[taskIdx] - addTime);
+    }
+    state.StopTimer();
+    taskManager.Wait(backgroundParentId);
+
+    state.SetItemsProcessed(numHighTasks);
+}
+
+// Measures the time from a task finishing on a worker to a thread
+// sleeping in Wait on it waking up
+BENCHMARK(TaskManager, WaitWakeupLatency)
+{
+    const uint32_t numTasks = 2000;
+    TaskManager taskManager(1);
+    uint32_t numTasksRunByWorker = 0;
+
+    state.StartTimer();
+    for(uint32_t taskIdx = 0; taskIdx < numTasks; taskIdx++)
+    {
+        std::atomic_bool taskStarted(false);
+        std::chrono::steady_clock::time_point finishTime;
+        auto taskId = taskManager.AddTaskWithNoChildrenOrDependencies(taskManager.WorkItemWithTaskAllocator([&](void*){
+            taskStarted = true;
+            Spin(std::chrono::microseconds(50));
+            finishTime = std::chrono::steady_clock::now();
+        }));
+        // Give the worker a chance to take the task so we have to sleep in Wait
+        auto giveUpTime = std::chrono::steady_clock::now() + std::chrono::microseconds(200);
+        while(!taskStarted && std::chrono::steady_clock::now() < giveUpTime)
+        {
+            std::this_thread::yield();
+        }
+        bool runByWorker = taskStarted;
+        taskManager.Wait(taskId);
+        if(runByWorker)
+        {
+            state.AddLatency(std::chrono::steady_clock::now() - finishTime);
+            numTasksRunByWorker++;
+        }
+    }
+    state.StopTimer();
+
+    state.SetItemsProcessed(numTasksRunByWorker);
+}
+
+// Workers are pinned and steal from the nearest queues first. Compare with
+// RecursiveSplitUnpinnedWorkers on a machine with more than one socket
+BENCHMARK(TaskManager, RecursiveSplitPinnedWorkers)
+{
+    TaskManager taskManager;
+    RecursiveSplit(state, taskManager);
+}
+
+// The same number of workers, left wherever the OS puts them
+BENCHMARK(TaskManager, RecursiveSplitUnpinnedWorkers)
+{
+    TaskManager taskManager(static_cast<int32_t>(CpuTopology::Detect().GetNumCpus()) - 1);
+    RecursiveSplit(state, taskManager);
+}
+
+BENCHMARK(ParallelFor, SmallLeaves)
+{
+    const uint32_t dataCount = 1 << 20;
+    std::vector<uint32_t> data(dataCount, 1);
+    CountSplitter<uint32_t> splitter(64);
+    TaskManager taskManager;
+
+    state.StartTimer();
+    auto parallelFor = ParallelFor<uint32_t, CountSplitter<uint32_t>>(data.data(), dataCount, &splitter, [](uint32_t* data, uint32_t dataCount){
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            data[index] *= 3;
+        }
+    }, &taskManager);
+    taskManager.Wait(parallelFor.Run());
+    state.StopTimer();
+
+    state.SetItemsProcessed(dataCount / 64);
+}
+
+BENCHMARK(ParallelFor, SmallLeavesDeducedCallable)
+{
+    const uint32_t dataCount = 1 << 20;
+    std::vector<uint32_t> data(dataCount, 1);
+    CountSplitter<uint32_t> splitter(64);
+    TaskManager taskManager;
+
+    state.StartTimer();
+    auto parallelFor = ParallelFor(data.data(), dataCount, &splitter, [](uint32_t* data, uint32_t dataCount){
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            data[index] *= 3;
+        }
+    }, &taskManager);
+    taskManager.Wait(parallelFor.Run());
+    state.StopTimer();
+
+    state.SetItemsProcessed(dataCount / 64);
+}
+
+BENCHMARK(ParallelFor, LazySmallLeaves)
+{
+    const uint32_t dataCount = 1 << 20;
+    std::vector<uint32_t> data(dataCount, 1);
+    CountSplitter<uint32_t> splitter(64);
+    TaskManager taskManager;
+
+    state.StartTimer();
+    LazyParallelFor parallelFor(data.data(), dataCount, &splitter, [](uint32_t* data, uint32_t dataCount){
+        for(uint32_t index = 0; index < dataCount; index++)
+        {
+            data[index] *= 3;
+        }
+    }, &taskManager);
+    taskManager.Wait(parallelFor.Run());
+    state.StopTimer();
+
+    state.SetItemsProcessed(dataCount / 64);
+}
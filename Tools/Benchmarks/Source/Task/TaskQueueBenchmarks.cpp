@@ -0,0 +1,81 @@
+#include "Benchmark.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Memory/Allocators/MallocAllocator.h"
+#include "Task/Task.h"
+#include "Task/TaskQueue.h"
+
+using namespace Flourish;
+
+namespace
+{
+    // The owner pushes tasks in batches and pops them, while the thieves keep taking tasks
+    // from the same queue with steal, which is given the queue and the thief's own queue
+    template<typename StealFunc>
+    void RunStealContention(Benchmarks::BenchmarkState& state, const StealFunc& steal)
+    {
+        const uint32_t numTasks = 1 << 20;
+        const uint32_t batchSize = 256;
+        Memory::MallocAllocator allocator("TaskQueueBenchmark");
+        TaskQueue queue(&allocator);
+        std::vector<Task> tasks(batchSize);
+        std::atomic_bool finished(false);
+        std::vector<std::thread> thieves;
+        for(int64_t thiefIdx = 0; thiefIdx < state.GetArg(); thiefIdx++)
+        {
+            thieves.emplace_back([&]{
+                TaskQueue thiefQueue(&allocator);
+                while(!finished.load(std::memory_order_relaxed))
+                {
+                    steal(queue, thiefQueue);
+                }
+            });
+        }
+
+        state.StartTimer();
+        for(uint32_t batchIdx = 0; batchIdx < numTasks / batchSize; batchIdx++)
+        {
+            for(auto& task : tasks)
+            {
+                queue.Push(&task);
+            }
+            while(queue.Pop() != nullptr)
+            {
+            }
+        }
+        state.StopTimer();
+        finished = true;
+        for(auto& thief : thieves)
+        {
+            thief.join();
+        }
+
+        state.SetItemsProcessed(numTasks);
+    }
+}
+
+// 1, 2, 4 and 8 thieves stealing one task at a time. Shows how much a busy victim slows
+// down as more threads go for its queue. Items are tasks taken by anyone
+BENCHMARK_WITH_ARGS(TaskQueue, StealContention, 1, 2, 4, 8)
+{
+    RunStealContention(state, [](TaskQueue& queue, TaskQueue&){
+        queue.Steal();
+    });
+}
+
+// The same, with each thief taking up to half the queue at once and then popping them
+// from its own queue, so it comes back to the victim less often
+BENCHMARK_WITH_ARGS(TaskQueue, StealBatchContention, 1, 2, 4, 8)
+{
+    RunStealContention(state, [](TaskQueue& queue, TaskQueue& thiefQueue){
+        if(queue.StealBatch(&thiefQueue) != nullptr)
+        {
+            while(thiefQueue.Pop() != nullptr)
+            {
+            }
+        }
+    });
+}
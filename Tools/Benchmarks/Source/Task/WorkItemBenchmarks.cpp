@@ -0,0 +1,37 @@
+#include "Benchmark.h"
+
+#include <vector>
+
+#include "Task/Task.h"
+
+using namespace Flourish;
+
+namespace
+{
+    const uint32_t NumWorkItems = 1000000;
+}
+
+// Creates work items the way a ParallelFor leaf does (a few pointers and a
+// count captured by value), moves them into storage and runs them
+BENCHMARK(WorkItem, CreateMoveAndInvoke)
+{
+    std::vector<WorkItem> workItems(64, WorkItem::Empty());
+    uint64_t total = 0;
+    uint64_t* totalPtr = &total;
+    uint32_t* dataPtr = nullptr;
+
+    state.StartTimer();
+    for(uint32_t itemIdx = 0; itemIdx < NumWorkItems; itemIdx++)
+    {
+        uint32_t count = itemIdx;
+        WorkItem workItem([totalPtr, dataPtr, count, itemIdx](void*){
+            *totalPtr += count + itemIdx + (dataPtr == nullptr ? 1 : 0);
+        });
+        auto& slot = workItems[itemIdx & 63];
+        slot = std::move(workItem);
+        slot();
+    }
+    state.StopTimer();
+
+    state.SetItemsProcessed(NumWorkItems);
+}
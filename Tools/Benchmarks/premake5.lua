@@ -0,0 +1,27 @@
+project "Benchmarks"
+   kind "ConsoleApp"
+   language "C++"
+   targetdir "../Bin/%{cfg.buildcfg}"
+   systemversion "latest"
+   includedirs 
+   { 
+      "Include", 
+      "../../Libs/Core/Include"
+   }
+
+   links { "Core" }
+
+   files { 
+      "Include/**.h", 
+      "Source/**.cpp"
+   }
+
+   excludePlatformSepecificFilesIfNeeded()
+
+   -- Benchmarks are only meaningful with optimisations on, so always optimise
+   filter "configurations:Debug"
+      optimize "On"
+
+   filter {"system:macosx"}
+      linkoptions  { cppStandardOption(), "-stdlib=libc++" }
+      buildoptions { cppStandardOption(), "-stdlib=libc++" }
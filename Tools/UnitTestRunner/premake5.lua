@@ -27,5 +27,5 @@ project "UnitTestRunner"
    excludePlatformSepecificFilesIfNeeded()
    
    filter {"system:macosx"}
-      linkoptions  { "-std=c++17", "-stdlib=libc++" }
-      buildoptions { "-std=c++17", "-stdlib=libc++" }
\ No newline at end of file
+      linkoptions  { cppStandardOption(), "-stdlib=libc++" }
+      buildoptions { cppStandardOption(), "-stdlib=libc++" }
\ No newline at end of file